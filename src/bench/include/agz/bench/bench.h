@@ -0,0 +1,50 @@
+#pragma once
+
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+class ParamParsingException : public std::invalid_argument
+{
+public:
+
+    using invalid_argument::invalid_argument;
+};
+
+struct Params
+{
+    std::vector<std::string> scenes;
+    std::vector<std::string> renderers;
+
+    int width  = 256;
+    int height = 256;
+
+    // samples per pixel of pt/ao/vol_bdpt, iterations of sppm and
+    // mutations per pixel of pssmlt_pt
+    int spp = 16;
+
+    // thread counts used by each renderer. from 1 to max_thread_count
+    std::vector<int> thread_counts;
+
+    int mesh_triangle_count = 5000000;
+
+    // empty means stdout
+    std::string output_filename;
+};
+
+/*
+    --scenes cornell_box,dense_mesh,...          (default: all)
+    --renderers pt,vol_bdpt,...                  (default: all)
+    --width W --height H                         (default: 256x256)
+    --spp N                                      (default: 16)
+    -t,--threads N                               (default: hardware thread count)
+    --no-scaling                                 only run with N threads
+    --mesh-triangles N                           (default: 5000000)
+    -o,--output Filename                         write json report to file
+*/
+std::optional<Params> parse_opts(int argc, char *argv[]);
+
+const std::vector<std::string> &all_scene_names();
+
+const std::vector<std::string> &all_renderer_names();
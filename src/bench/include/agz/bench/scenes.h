@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <string>
+
+#include <agz/tracer/tracer.h>
+
+/**
+ * @brief aggregate wrapper counting traced rays
+ *
+ * each call of has_intersection/closest_intersection counts as one ray.
+ * counters are sharded by thread to avoid contention between rendering
+ * threads
+ */
+class RayCountingAggregate : public agz::tracer::Aggregate
+{
+public:
+
+    explicit RayCountingAggregate(
+        agz::tracer::RC<agz::tracer::Aggregate> internal);
+
+    void build(
+        const std::vector<agz::tracer::RC<const agz::tracer::Entity>> &entities)
+        override;
+
+    bool has_intersection(const agz::tracer::Ray &r) const noexcept override;
+
+    bool closest_intersection(
+        const agz::tracer::Ray &r,
+        agz::tracer::EntityIntersection *inct) const noexcept override;
+
+    uint64_t ray_count() const noexcept;
+
+    void reset_ray_count() noexcept;
+
+private:
+
+    static constexpr int SHARD_COUNT = 64;
+
+    struct alignas(64) Shard
+    {
+        std::atomic<uint64_t> count = 0;
+    };
+
+    void count_ray() const noexcept;
+
+    agz::tracer::RC<agz::tracer::Aggregate> internal_;
+
+    mutable std::array<Shard, SHARD_COUNT> shards_;
+};
+
+/**
+ * @brief procedurally generated benchmark scene
+ */
+struct BenchScene
+{
+    std::string name;
+
+    agz::tracer::RC<agz::tracer::Scene>  scene;
+    agz::tracer::RC<agz::tracer::Camera> camera;
+
+    agz::tracer::RC<RayCountingAggregate> aggregate;
+
+    size_t entity_count   = 0;
+    size_t triangle_count = 0;
+
+    // time of building triangle mesh bvhs
+    double mesh_bvh_build_seconds = 0;
+
+    // time of building entity aggregate
+    double aggregate_build_seconds = 0;
+
+    // time of generating and building the whole scene
+    double total_build_seconds = 0;
+};
+
+/**
+ * @brief create scene with given name
+ *
+ * throw ParamParsingException when the name is unknown
+ */
+BenchScene create_bench_scene(
+    const std::string &name, agz::tracer::real film_aspect,
+    int mesh_triangle_count);
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * @brief peak resident set size of this process in bytes
+ *
+ * returns 0 when unavailable
+ */
+size_t peak_rss_bytes();
+
+/**
+ * @brief reset the peak resident set size to the current one
+ *
+ * only supported on linux. returns false when the peak can't be reset, in
+ * which case peak_rss_bytes() reports the peak of the whole process
+ */
+bool reset_peak_rss();
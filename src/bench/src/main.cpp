@@ -0,0 +1,284 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <json.hpp>
+
+#include <agz/bench/bench.h>
+#include <agz/bench/scenes.h>
+#include <agz/bench/sys_stats.h>
+#include <agz/tracer/tracer.h>
+
+#include <agz/utility/misc.h>
+
+using namespace agz::tracer;
+
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+    double seconds_since(Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    double to_mb(size_t bytes)
+    {
+        return static_cast<double>(bytes) / (1 << 20);
+    }
+
+    /**
+     * @brief create renderer with fixed sampling budget
+     *
+     * @param sample_count number of camera/light paths generated with the budget
+     */
+    RC<Renderer> create_bench_renderer(
+        const std::string &name, const Params &params, int thread_count,
+        uint64_t *sample_count)
+    {
+        const uint64_t pixel_count = uint64_t(params.width) * params.height;
+
+        if(name == "pt")
+        {
+            PTRendererParams renderer_params;
+            renderer_params.worker_count = thread_count;
+            renderer_params.spp          = params.spp;
+            *sample_count = pixel_count * params.spp;
+            return create_pt_renderer(renderer_params);
+        }
+
+        if(name == "vol_bdpt")
+        {
+            VolBDPTRendererParams renderer_params;
+            renderer_params.worker_count = thread_count;
+            renderer_params.spp          = params.spp;
+            *sample_count = pixel_count * params.spp;
+            return create_vol_bdpt_renderer(renderer_params);
+        }
+
+        if(name == "sppm")
+        {
+            // one camera path per pixel and as many photons in each iteration
+            SPPMRendererParams renderer_params;
+            renderer_params.worker_count          = thread_count;
+            renderer_params.iteration_count       = params.spp;
+            renderer_params.photons_per_iteration = static_cast<int>(pixel_count);
+            *sample_count = 2 * pixel_count * params.spp;
+            return create_sppm_renderer(renderer_params);
+        }
+
+        if(name == "pssmlt_pt")
+        {
+            PSSMLTPTRendererParams renderer_params;
+            renderer_params.worker_count  = thread_count;
+            renderer_params.mut_per_pixel = params.spp;
+            *sample_count = pixel_count * params.spp
+                          + renderer_params.startup_sample_count;
+            return create_pssmlt_pt_renderer(renderer_params);
+        }
+
+        if(name == "ao")
+        {
+            AORendererParams renderer_params;
+            renderer_params.worker_count = thread_count;
+            renderer_params.spp          = params.spp;
+            *sample_count = pixel_count * params.spp;
+            return create_ao_renderer(renderer_params);
+        }
+
+        throw ParamParsingException("unknown renderer: " + name);
+    }
+
+    nlohmann::json run_renderer(
+        const std::string &renderer_name, const Params &params,
+        BenchScene &bench_scene, RendererInteractor &reporter)
+    {
+        nlohmann::json runs = nlohmann::json::array();
+        double single_thread_seconds = 0;
+
+        for(const int thread_count : params.thread_counts)
+        {
+            std::cerr << "  " << renderer_name
+                      << " (" << thread_count << " threads)" << std::endl;
+
+            uint64_t sample_count = 0;
+            auto renderer = create_bench_renderer(
+                renderer_name, params, thread_count, &sample_count);
+
+            FilmFilterApplier filter_applier(
+                params.width, params.height, create_box_filter(real(0.5)));
+
+            const bool rss_reset = reset_peak_rss();
+            bench_scene.aggregate->reset_ray_count();
+
+            const auto start = Clock::now();
+            renderer->render(filter_applier, *bench_scene.scene, reporter);
+            const double seconds = seconds_since(start);
+
+            const uint64_t ray_count = bench_scene.aggregate->ray_count();
+
+            if(thread_count == 1)
+                single_thread_seconds = seconds;
+
+            nlohmann::json run;
+            run["threads"]            = thread_count;
+            run["seconds"]            = seconds;
+            run["samples"]            = sample_count;
+            run["samples_per_second"] = sample_count / seconds;
+            run["rays"]               = ray_count;
+            run["rays_per_second"]    = ray_count / seconds;
+            run["peak_rss_mb"]        = to_mb(peak_rss_bytes());
+            run["peak_rss_is_process_wide"] = !rss_reset;
+
+            if(single_thread_seconds > 0)
+            {
+                const double speedup = single_thread_seconds / seconds;
+                run["speedup"]    = speedup;
+                run["efficiency"] = speedup / thread_count;
+            }
+
+            runs.push_back(std::move(run));
+        }
+
+        nlohmann::json ret;
+        ret["name"] = renderer_name;
+        ret["runs"] = std::move(runs);
+        return ret;
+    }
+
+    nlohmann::json run_scene(
+        const std::string &scene_name, const Params &params,
+        RendererInteractor &reporter)
+    {
+        std::cerr << "building " << scene_name << std::endl;
+
+        const bool rss_reset = reset_peak_rss();
+
+        auto bench_scene = create_bench_scene(
+            scene_name, static_cast<real>(params.width) / params.height,
+            params.mesh_triangle_count);
+
+        nlohmann::json ret;
+        ret["name"]           = scene_name;
+        ret["entity_count"]   = bench_scene.entity_count;
+        ret["triangle_count"] = bench_scene.triangle_count;
+
+        nlohmann::json build;
+        build["total_seconds"]     = bench_scene.total_build_seconds;
+        build["mesh_bvh_seconds"]  = bench_scene.mesh_bvh_build_seconds;
+        build["aggregate_seconds"] = bench_scene.aggregate_build_seconds;
+        build["peak_rss_mb"]       = to_mb(peak_rss_bytes());
+        build["peak_rss_is_process_wide"] = !rss_reset;
+        ret["build"] = std::move(build);
+
+        bench_scene.scene->set_camera(bench_scene.camera);
+
+        const auto preprocess_start = Clock::now();
+        bench_scene.scene->start_rendering();
+        ret["preprocess_seconds"] = seconds_since(preprocess_start);
+
+        nlohmann::json renderers = nlohmann::json::array();
+        for(auto &renderer_name : params.renderers)
+        {
+            try
+            {
+                renderers.push_back(run_renderer(
+                    renderer_name, params, bench_scene, reporter));
+            }
+            catch(const std::exception &e)
+            {
+                std::vector<std::string> msgs;
+                agz::misc::extract_hierarchy_exceptions(e, std::back_inserter(msgs));
+
+                std::string error;
+                for(auto &m : msgs)
+                    error += (error.empty() ? "" : "\n") + m;
+
+                nlohmann::json failed;
+                failed["name"]  = renderer_name;
+                failed["error"] = error;
+                renderers.push_back(std::move(failed));
+            }
+        }
+        ret["renderers"] = std::move(renderers);
+
+        return ret;
+    }
+}
+
+void run(int argc, char *argv[])
+{
+    auto params = parse_opts(argc, argv);
+    if(!params)
+        return;
+
+#ifdef USE_EMBREE
+    init_embree_device();
+    AGZ_SCOPE_GUARD({ destroy_embree_device(); });
+#endif
+
+    // keep stdout clean for the json report
+    spdlog::set_level(spdlog::level::warn);
+
+    auto reporter = create_noout_reporter();
+
+    nlohmann::json report;
+
+    nlohmann::json config;
+    config["width"]               = params->width;
+    config["height"]              = params->height;
+    config["spp"]                 = params->spp;
+    config["thread_counts"]       = params->thread_counts;
+    config["mesh_triangle_count"] = params->mesh_triangle_count;
+    report["config"] = std::move(config);
+
+    nlohmann::json system;
+    system["hardware_threads"] = std::thread::hardware_concurrency();
+#ifdef USE_EMBREE
+    system["use_embree"] = true;
+#else
+    system["use_embree"] = false;
+#endif
+    report["system"] = std::move(system);
+
+    nlohmann::json scenes = nlohmann::json::array();
+    for(auto &scene_name : params->scenes)
+        scenes.push_back(run_scene(scene_name, *params, *reporter));
+    report["scenes"] = std::move(scenes);
+
+    if(params->output_filename.empty())
+    {
+        std::cout << report.dump(4) << std::endl;
+        return;
+    }
+
+    std::ofstream fout(params->output_filename, std::ofstream::trunc);
+    if(!fout)
+        throw std::runtime_error("failed to open " + params->output_filename);
+    fout << report.dump(4) << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    try
+    {
+        run(argc, argv);
+        return 0;
+    }
+    catch(const std::exception &e)
+    {
+        std::vector<std::string> msgs;
+        agz::misc::extract_hierarchy_exceptions(e, std::back_inserter(msgs));
+        for(auto &m : msgs)
+            std::cerr << m << std::endl;
+    }
+    catch(...)
+    {
+        std::cerr << "an unknown error occurred" << std::endl;
+    }
+
+    return -1;
+}
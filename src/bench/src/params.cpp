@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include <cxxopts.hpp>
+
+#include <agz/bench/bench.h>
+
+namespace
+{
+    std::vector<std::string> parse_name_list(
+        const std::string &str, const std::vector<std::string> &all_names,
+        const std::string &category)
+    {
+        std::vector<std::string> ret;
+
+        std::istringstream sin(str);
+        std::string name;
+        while(std::getline(sin, name, ','))
+        {
+            const size_t beg = name.find_first_not_of(" \t");
+            if(beg == std::string::npos)
+                continue;
+            const size_t end = name.find_last_not_of(" \t");
+            const std::string trimmed = name.substr(beg, end - beg + 1);
+
+            if(std::find(all_names.begin(), all_names.end(), trimmed)
+                == all_names.end())
+                throw ParamParsingException("unknown " + category + ": " + trimmed);
+
+            ret.push_back(trimmed);
+        }
+        return ret;
+    }
+
+    std::vector<int> thread_counts_up_to(int max_thread_count)
+    {
+        std::vector<int> ret;
+        for(int n = 1; n < max_thread_count; n *= 2)
+            ret.push_back(n);
+        ret.push_back(max_thread_count);
+        return ret;
+    }
+}
+
+const std::vector<std::string> &all_scene_names()
+{
+    static const std::vector<std::string> ret = {
+        "cornell_box", "dense_mesh", "heterogeneous_volume",
+        "many_lights", "env_interior"
+    };
+    return ret;
+}
+
+const std::vector<std::string> &all_renderer_names()
+{
+    static const std::vector<std::string> ret = {
+        "pt", "vol_bdpt", "sppm", "pssmlt_pt", "ao"
+    };
+    return ret;
+}
+
+std::optional<Params> parse_opts(int argc, char *argv[])
+{
+    cxxopts::Options opts("atrc-bench", "rendering benchmark of agz offline renderer");
+    opts.add_options("")
+        ("scenes", "comma-separated scene names", cxxopts::value<std::string>())
+        ("renderers", "comma-separated renderer names", cxxopts::value<std::string>())
+        ("width", "film width", cxxopts::value<int>())
+        ("height", "film height", cxxopts::value<int>())
+        ("spp", "sampling budget of each renderer", cxxopts::value<int>())
+        ("t,threads", "max worker thread count", cxxopts::value<int>())
+        ("no-scaling", "only run with max worker thread count")
+        ("mesh-triangles", "triangle count of dense_mesh", cxxopts::value<int>())
+        ("o,output", "output json filename", cxxopts::value<std::string>())
+        ("h,help", "help information");
+    auto parse_result = opts.parse(argc, argv);
+
+    if(parse_result.count("help"))
+    {
+        std::cout << opts.help({ "" }) << std::endl;
+        std::cout << "scenes:";
+        for(auto &name : all_scene_names())
+            std::cout << " " << name;
+        std::cout << std::endl << "renderers:";
+        for(auto &name : all_renderer_names())
+            std::cout << " " << name;
+        std::cout << std::endl;
+        return std::nullopt;
+    }
+
+    Params ret;
+
+    if(parse_result.count("scenes"))
+    {
+        ret.scenes = parse_name_list(
+            parse_result["scenes"].as<std::string>(), all_scene_names(), "scene");
+    }
+    else
+        ret.scenes = all_scene_names();
+
+    if(parse_result.count("renderers"))
+    {
+        ret.renderers = parse_name_list(
+            parse_result["renderers"].as<std::string>(),
+            all_renderer_names(), "renderer");
+    }
+    else
+        ret.renderers = all_renderer_names();
+
+    if(parse_result.count("width"))
+        ret.width = parse_result["width"].as<int>();
+    if(parse_result.count("height"))
+        ret.height = parse_result["height"].as<int>();
+    if(ret.width <= 0 || ret.height <= 0)
+        throw ParamParsingException("invalid film size");
+
+    if(parse_result.count("spp"))
+    {
+        ret.spp = parse_result["spp"].as<int>();
+        if(ret.spp <= 0)
+            throw ParamParsingException("invalid spp");
+    }
+
+    int max_thread_count = static_cast<int>(std::thread::hardware_concurrency());
+    if(parse_result.count("threads"))
+    {
+        max_thread_count = parse_result["threads"].as<int>();
+        if(max_thread_count <= 0)
+            throw ParamParsingException("invalid thread count");
+    }
+    max_thread_count = (std::max)(max_thread_count, 1);
+
+    if(parse_result.count("no-scaling"))
+        ret.thread_counts = { max_thread_count };
+    else
+        ret.thread_counts = thread_counts_up_to(max_thread_count);
+
+    if(parse_result.count("mesh-triangles"))
+    {
+        ret.mesh_triangle_count = parse_result["mesh-triangles"].as<int>();
+        if(ret.mesh_triangle_count < 2)
+            throw ParamParsingException("invalid mesh triangle count");
+    }
+
+    if(parse_result.count("output"))
+        ret.output_filename = parse_result["output"].as<std::string>();
+
+    return ret;
+}
@@ -0,0 +1,542 @@
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#include <agz/bench/bench.h>
+#include <agz/bench/scenes.h>
+
+using namespace agz::tracer;
+
+RayCountingAggregate::RayCountingAggregate(RC<Aggregate> internal)
+    : internal_(std::move(internal))
+{
+
+}
+
+void RayCountingAggregate::build(const std::vector<RC<const Entity>> &entities)
+{
+    internal_->build(entities);
+}
+
+bool RayCountingAggregate::has_intersection(const Ray &r) const noexcept
+{
+    count_ray();
+    return internal_->has_intersection(r);
+}
+
+bool RayCountingAggregate::closest_intersection(
+    const Ray &r, EntityIntersection *inct) const noexcept
+{
+    count_ray();
+    return internal_->closest_intersection(r, inct);
+}
+
+uint64_t RayCountingAggregate::ray_count() const noexcept
+{
+    uint64_t ret = 0;
+    for(auto &shard : shards_)
+        ret += shard.count.load(std::memory_order_relaxed);
+    return ret;
+}
+
+void RayCountingAggregate::reset_ray_count() noexcept
+{
+    for(auto &shard : shards_)
+        shard.count.store(0, std::memory_order_relaxed);
+}
+
+void RayCountingAggregate::count_ray() const noexcept
+{
+    static std::atomic<int> next_shard_index = 0;
+    thread_local const int shard_index = next_shard_index++ % SHARD_COUNT;
+    shards_[shard_index].count.fetch_add(1, std::memory_order_relaxed);
+}
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    double seconds_since(Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    RC<const Material> create_diffuse(const FSpectrum &albedo)
+    {
+        return create_ideal_diffuse(
+            create_constant2d_texture({}, albedo), newBox<NormalMapper>());
+    }
+
+    /**
+     * @brief collect entities of a bench scene and measure its building time
+     */
+    class SceneBuilder
+    {
+        BenchScene &output_;
+
+        Clock::time_point start_;
+
+        RC<const Medium> void_medium_;
+        RC<const Material> black_;
+
+        std::vector<RC<Entity>> entities_;
+        RC<EnvirLight> envir_light_;
+
+        void add_entity(
+            RC<const Geometry> geometry, RC<const Material> material,
+            const MediumInterface &med, const FSpectrum &emit_radiance)
+        {
+            entities_.push_back(create_geometric(
+                std::move(geometry), std::move(material),
+                med, emit_radiance, false, -1));
+        }
+
+    public:
+
+        explicit SceneBuilder(BenchScene &output)
+            : output_(output), start_(Clock::now())
+        {
+            void_medium_ = create_void();
+            black_       = create_ideal_black();
+        }
+
+        /**
+         * @brief add parallelogram center +- u +- v facing cross(u, v)
+         */
+        void add_quad(
+            const FVec3 &center, const FVec3 &u, const FVec3 &v,
+            RC<const Material> material, const FSpectrum &emit_radiance = {})
+        {
+            auto geometry = create_quad(
+                center - u - v, center + u - v, center + u + v, center - u + v,
+                { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 }, FTransform3());
+
+            add_entity(
+                std::move(geometry),
+                emit_radiance.is_black() ? std::move(material) : black_,
+                { void_medium_, void_medium_ }, emit_radiance);
+        }
+
+        /**
+         * @brief add axis-aligned box with outward faces
+         */
+        void add_box(
+            const FVec3 &low, const FVec3 &high, RC<const Material> material)
+        {
+            const FVec3 c = real(0.5) * (low + high);
+            const FVec3 e = real(0.5) * (high - low);
+
+            const FVec3 ex(e.x, 0, 0), ey(0, e.y, 0), ez(0, 0, e.z);
+
+            add_quad({ high.x, c.y, c.z }, ey, ez, material);
+            add_quad({ low.x,  c.y, c.z }, ez, ey, material);
+            add_quad({ c.x, high.y, c.z }, ez, ex, material);
+            add_quad({ c.x, low.y,  c.z }, ex, ez, material);
+            add_quad({ c.x, c.y, high.z }, ex, ey, material);
+            add_quad({ c.x, c.y, low.z  }, ey, ex, material);
+        }
+
+        void add_sphere(
+            const FVec3 &center, real radius, RC<const Material> material,
+            const FSpectrum &emit_radiance = {},
+            const MediumInterface *med = nullptr)
+        {
+            auto geometry = create_sphere(
+                radius, Transform3::translate(center.x, center.y, center.z));
+
+            add_entity(
+                std::move(geometry),
+                emit_radiance.is_black() ? std::move(material) : black_,
+                med ? *med : MediumInterface{ void_medium_, void_medium_ },
+                emit_radiance);
+        }
+
+        void add_mesh(
+            std::vector<agz::mesh::triangle_t> triangles, RC<const Material> material)
+        {
+            output_.triangle_count += triangles.size();
+
+            const auto bvh_start = Clock::now();
+            auto geometry = create_triangle_bvh(std::move(triangles), FTransform3());
+            output_.mesh_bvh_build_seconds += seconds_since(bvh_start);
+
+            add_entity(
+                std::move(geometry), std::move(material),
+                { void_medium_, void_medium_ }, {});
+        }
+
+        void set_envir_light(RC<EnvirLight> envir_light)
+        {
+            envir_light_ = std::move(envir_light);
+        }
+
+        void finish(RC<Aggregate> aggregate, RC<Camera> camera)
+        {
+            output_.aggregate = newRC<RayCountingAggregate>(std::move(aggregate));
+
+            std::vector<RC<const Entity>> const_entities;
+            const_entities.reserve(entities_.size());
+            for(auto &ent : entities_)
+                const_entities.push_back(ent);
+
+            const auto aggregate_start = Clock::now();
+            output_.aggregate->build(const_entities);
+            output_.aggregate_build_seconds = seconds_since(aggregate_start);
+
+            DefaultSceneParams scene_params;
+            scene_params.entities    = std::move(entities_);
+            scene_params.envir_light = std::move(envir_light_);
+            scene_params.aggregate   = output_.aggregate;
+
+            output_.entity_count = scene_params.entities.size();
+            output_.scene        = create_default_scene(scene_params);
+            output_.camera       = std::move(camera);
+
+            output_.total_build_seconds = seconds_since(start_);
+        }
+    };
+
+    RC<Camera> create_camera(
+        real film_aspect, const FVec3 &pos, const FVec3 &dst, real fov_deg)
+    {
+        return create_thin_lens_camera(
+            film_aspect, pos, dst, FVec3(0, 0, 1),
+            agz::math::deg2rad(fov_deg), 0, 1);
+    }
+
+    // scenes are z-up
+
+    /**
+     * @brief diffuse box lit by a small area light
+     */
+    void build_cornell_box(BenchScene &output, real film_aspect)
+    {
+        SceneBuilder builder(output);
+
+        const auto white = create_diffuse(FSpectrum(real(0.73)));
+        const auto red   = create_diffuse(FSpectrum(real(0.65), real(0.05), real(0.05)));
+        const auto green = create_diffuse(FSpectrum(real(0.12), real(0.45), real(0.15)));
+
+        builder.add_quad({ 0, 0, 0 }, { 1, 0, 0 }, { 0, 1, 0 }, white);
+        builder.add_quad({ 0, 0, 2 }, { 0, 1, 0 }, { 1, 0, 0 }, white);
+        builder.add_quad({ 0, 1, 1 }, { 1, 0, 0 }, { 0, 0, 1 }, white);
+        builder.add_quad({ -1, 0, 1 }, { 0, 1, 0 }, { 0, 0, 1 }, red);
+        builder.add_quad({ 1, 0, 1 }, { 0, 0, 1 }, { 0, 1, 0 }, green);
+
+        builder.add_quad(
+            { 0, 0, real(1.99) }, { 0, real(0.25), 0 }, { real(0.25), 0, 0 },
+            nullptr, FSpectrum(real(17), real(12), real(4)));
+
+        builder.add_box(
+            { real(-0.6), real(0.0), 0 }, { real(-0.05), real(0.55), real(1.2) },
+            white);
+        builder.add_box(
+            { real(0.05), real(-0.6), 0 }, { real(0.65), real(-0.05), real(0.6) },
+            white);
+
+        builder.finish(
+            create_native_aggregate(),
+            create_camera(film_aspect, { 0, real(-3.4), 1 }, { 0, 0, 1 }, 40));
+    }
+
+    /**
+     * @brief sky-lit terrain with 2 * n * n triangles
+     */
+    void build_dense_mesh(
+        BenchScene &output, real film_aspect, int triangle_count)
+    {
+        SceneBuilder builder(output);
+
+        const int n = (std::max)(1, static_cast<int>(
+            std::round(std::sqrt(real(0.5) * triangle_count))));
+        const real extent = 2;
+
+        auto height = [](real x, real y)
+        {
+            return real(0.15)  * std::sin(3 * x) * std::cos(4 * y)
+                 + real(0.05)  * std::sin(17 * x + 5 * y)
+                 + real(0.015) * std::sin(43 * x - 29 * y);
+        };
+
+        auto normal = [](real x, real y)
+        {
+            const real dhdx = real(0.45)  * std::cos(3 * x) * std::cos(4 * y)
+                            + real(0.85)  * std::cos(17 * x + 5 * y)
+                            + real(0.645) * std::cos(43 * x - 29 * y);
+            const real dhdy = real(-0.6)  * std::sin(3 * x) * std::sin(4 * y)
+                            + real(0.25)  * std::cos(17 * x + 5 * y)
+                            - real(0.435) * std::cos(43 * x - 29 * y);
+            return FVec3(-dhdx, -dhdy, 1).normalize();
+        };
+
+        auto vertex = [&](int xi, int yi)
+        {
+            const real u = real(xi) / n, v = real(yi) / n;
+            const real x = extent * (2 * u - 1), y = extent * (2 * v - 1);
+
+            agz::mesh::vertex_t ret;
+            ret.position  = { x, y, height(x, y) };
+            ret.normal    = normal(x, y);
+            ret.tex_coord = { u, v };
+            return ret;
+        };
+
+        std::vector<agz::mesh::triangle_t> triangles(size_t(2) * n * n);
+        agz::thread::parallel_forrange(0, n, [&](int, int yi)
+        {
+            for(int xi = 0; xi < n; ++xi)
+            {
+                const auto v00 = vertex(xi,     yi);
+                const auto v10 = vertex(xi + 1, yi);
+                const auto v11 = vertex(xi + 1, yi + 1);
+                const auto v01 = vertex(xi,     yi + 1);
+
+                const size_t idx = 2 * (size_t(yi) * n + xi);
+                triangles[idx]     = { { v00, v10, v11 } };
+                triangles[idx + 1] = { { v00, v11, v01 } };
+            }
+        });
+
+        builder.add_mesh(
+            std::move(triangles),
+            create_diffuse(FSpectrum(real(0.45), real(0.5), real(0.35))));
+
+        builder.set_envir_light(create_native_sky(
+            FSpectrum(real(1.2), real(1.3), real(1.6)), FSpectrum(real(0.1))));
+
+        builder.finish(
+            create_native_aggregate(),
+            create_camera(
+                film_aspect, { 0, real(-3.2), real(1.6) }, { 0, 0, 0 }, 45));
+    }
+
+    /**
+     * @brief noisy smoke ball over a diffuse floor
+     */
+    void build_heterogeneous_volume(BenchScene &output, real film_aspect)
+    {
+        SceneBuilder builder(output);
+
+        constexpr int RES = 64;
+        constexpr real MAX_DENSITY = 8;
+
+        auto density_data = newRC<Image3D<real>>(RES, RES, RES);
+        agz::thread::parallel_forrange(0, RES, [&](int, int zi)
+        {
+            for(int yi = 0; yi < RES; ++yi)
+            {
+                for(int xi = 0; xi < RES; ++xi)
+                {
+                    const real x = 2 * (xi + real(0.5)) / RES - 1;
+                    const real y = 2 * (yi + real(0.5)) / RES - 1;
+                    const real z = 2 * (zi + real(0.5)) / RES - 1;
+
+                    const real r = std::sqrt(x * x + y * y + z * z);
+                    const real falloff = agz::math::saturate(1 - r);
+
+                    real noise = 0, amp = real(0.5), freq = 5;
+                    for(int octave = 0; octave < 4; ++octave)
+                    {
+                        noise += amp * std::sin(freq * x + real(1.3) * octave)
+                                     * std::sin(freq * y + real(0.7) * octave)
+                                     * std::sin(freq * z + real(2.1) * octave);
+                        amp  *= real(0.5);
+                        freq *= real(2.1);
+                    }
+
+                    (*density_data)(zi, yi, xi) = MAX_DENSITY *
+                        std::sqrt(falloff) * agz::math::saturate(real(0.5) + noise);
+                }
+            }
+        });
+
+        auto density = create_image3d({}, density_data, true);
+        auto albedo  = create_constant3d_texture({}, FSpectrum(real(0.9)));
+        auto g       = create_constant3d_texture({}, FSpectrum(real(0.2)));
+
+        // medium of unit cube is mapped to bounding box of the sphere
+        const auto medium = create_heterogeneous_medium(
+            Transform3::translate(-1, -1, 0) * Transform3::scale(2, 2, 2),
+            std::move(density), std::move(albedo), std::move(g),
+            (std::numeric_limits<int>::max)());
+
+        const MediumInterface med = { medium, create_void() };
+        builder.add_sphere(
+            { 0, 0, 1 }, 1, create_invisible_surface(nullptr), {}, &med);
+
+        builder.add_quad(
+            { 0, 0, 0 }, { 4, 0, 0 }, { 0, 4, 0 },
+            create_diffuse(FSpectrum(real(0.6))));
+
+        builder.add_sphere(
+            { 2, real(-1.5), 3 }, real(0.3), nullptr, FSpectrum(real(60)));
+
+        builder.set_envir_light(create_native_sky(
+            FSpectrum(real(0.3), real(0.35), real(0.5)), FSpectrum(real(0.05))));
+
+        builder.finish(
+            create_native_aggregate(),
+            create_camera(film_aspect, { 0, -4, real(1.5) }, { 0, 0, 1 }, 45));
+    }
+
+    /**
+     * @brief 256 small colored sphere lights among occluders
+     */
+    void build_many_lights(BenchScene &output, real film_aspect)
+    {
+        SceneBuilder builder(output);
+
+        constexpr int GRID = 16;
+
+        const auto white = create_diffuse(FSpectrum(real(0.7)));
+
+        builder.add_quad({ 0, 0, 0 }, { 3, 0, 0 }, { 0, 3, 0 }, white);
+
+        for(int yi = 0; yi < GRID; ++yi)
+        {
+            for(int xi = 0; xi < GRID; ++xi)
+            {
+                const real x = real(-2.5) + real(5) * xi / (GRID - 1);
+                const real y = real(-2.5) + real(5) * yi / (GRID - 1);
+                const real z = real(0.15) + real(0.1) * ((7 * xi + 3 * yi) % 5);
+
+                const real hue = 2 * PI_r * (xi * GRID + yi) / (GRID * GRID);
+                const FSpectrum color(
+                    real(0.5) + real(0.5) * std::cos(hue),
+                    real(0.5) + real(0.5) * std::cos(hue - 2 * PI_r / 3),
+                    real(0.5) + real(0.5) * std::cos(hue + 2 * PI_r / 3));
+
+                builder.add_sphere(
+                    { x, y, z }, real(0.04), nullptr, real(40) * color);
+            }
+        }
+
+        for(int i = 0; i < 4; ++i)
+        {
+            const real x = real(-1.5) + i;
+            builder.add_box(
+                { x - real(0.2), real(-0.2), 0 },
+                { x + real(0.2), real(0.2), real(0.4) + real(0.3) * i },
+                white);
+            builder.add_sphere(
+                { x, real(1.2), real(0.3) }, real(0.3), white);
+        }
+
+        builder.finish(
+            create_entity_bvh(4),
+            create_camera(film_aspect, { 0, real(-4.5), 3 }, { 0, 0, 0 }, 45));
+    }
+
+    /**
+     * @brief room lit by a procedural sky through a window
+     */
+    void build_env_interior(BenchScene &output, real film_aspect)
+    {
+        SceneBuilder builder(output);
+
+        const auto wall  = create_diffuse(FSpectrum(real(0.75)));
+        const auto floor = create_diffuse(FSpectrum(real(0.5), real(0.35), real(0.2)));
+
+        builder.add_quad({ 0, 0, 0 }, { 2, 0, 0 }, { 0, 2, 0 }, floor);
+        builder.add_quad({ 0, 0, real(2.5) }, { 0, 2, 0 }, { 2, 0, 0 }, wall);
+        builder.add_quad({ -2, 0, real(1.25) }, { 0, 2, 0 }, { 0, 0, real(1.25) }, wall);
+        builder.add_quad({ 2, 0, real(1.25) }, { 0, 0, real(1.25) }, { 0, 2, 0 }, wall);
+        builder.add_quad({ 0, -2, real(1.25) }, { 0, 0, real(1.25) }, { 2, 0, 0 }, wall);
+
+        // wall with window x in [-1, 1], z in [0.8, 1.8]
+        builder.add_quad({ 0, 2, real(0.4) }, { 2, 0, 0 }, { 0, 0, real(0.4) }, wall);
+        builder.add_quad({ 0, 2, real(2.15) }, { 2, 0, 0 }, { 0, 0, real(0.35) }, wall);
+        builder.add_quad({ real(-1.5), 2, real(1.3) }, { real(0.5), 0, 0 }, { 0, 0, real(0.5) }, wall);
+        builder.add_quad({ real(1.5), 2, real(1.3) }, { real(0.5), 0, 0 }, { 0, 0, real(0.5) }, wall);
+
+        // table with a glass ball
+        builder.add_box(
+            { real(-0.6), real(-0.4), real(0.7) },
+            { real(0.6), real(0.4), real(0.78) }, floor);
+        for(int i = 0; i < 4; ++i)
+        {
+            const real x = i & 1 ? real(0.5) : real(-0.5);
+            const real y = i & 2 ? real(0.3) : real(-0.3);
+            builder.add_box(
+                { x - real(0.04), y - real(0.04), 0 },
+                { x + real(0.04), y + real(0.04), real(0.7) }, floor);
+        }
+
+        const auto one = create_constant2d_texture({}, FSpectrum(1));
+        builder.add_sphere(
+            { 0, 0, real(0.98) }, real(0.2),
+            create_glass(one, one, create_constant2d_texture({}, real(1.5)), nullptr));
+
+        // sky texture. row 0 is the zenith
+        constexpr int SKY_WIDTH = 512, SKY_HEIGHT = 256;
+        const FVec3 sun_dir = FVec3(real(0.3), 1, real(0.6)).normalize();
+        const real sun_cos = std::cos(agz::math::deg2rad(real(2)));
+
+        auto sky = newRC<Image2D<agz::math::color3f>>(SKY_HEIGHT, SKY_WIDTH);
+        for(int y = 0; y < SKY_HEIGHT; ++y)
+        {
+            const real theta = PI_r * (y + real(0.5)) / SKY_HEIGHT;
+            for(int x = 0; x < SKY_WIDTH; ++x)
+            {
+                const real phi = 2 * PI_r * (x + real(0.5)) / SKY_WIDTH;
+                const FVec3 dir(
+                    std::sin(theta) * std::cos(phi),
+                    std::sin(theta) * std::sin(phi),
+                    std::cos(theta));
+
+                agz::math::color3f color;
+                if(dot(dir, sun_dir) > sun_cos)
+                    color = agz::math::color3f(500, 450, 400);
+                else if(dir.z > 0)
+                {
+                    const float t = dir.z;
+                    color = agz::math::color3f(
+                        1.5f * (1 - t) + 0.45f * t,
+                        1.35f * (1 - t) + 0.75f * t,
+                        1.2f * (1 - t) + 1.5f * t);
+                }
+                else
+                    color = agz::math::color3f(0.2f, 0.18f, 0.15f);
+
+                (*sky)(y, x) = color;
+            }
+        }
+
+        EnvirLightPortal window;
+        window.a = { -1, 2, real(0.8) };
+        window.b = { 1, 2, real(0.8) };
+        window.c = { 1, 2, real(1.8) };
+
+        builder.set_envir_light(create_ibl_light(
+            create_hdr_texture({}, std::move(sky), "linear"),
+            false, -1, {}, 0, { window }));
+
+        builder.finish(
+            create_native_aggregate(),
+            create_camera(
+                film_aspect, { real(0.3), real(-1.8), real(1.3) },
+                { 0, 2, real(1.1) }, 70));
+    }
+}
+
+BenchScene create_bench_scene(
+    const std::string &name, real film_aspect, int mesh_triangle_count)
+{
+    BenchScene ret;
+    ret.name = name;
+
+    if(name == "cornell_box")
+        build_cornell_box(ret, film_aspect);
+    else if(name == "dense_mesh")
+        build_dense_mesh(ret, film_aspect, mesh_triangle_count);
+    else if(name == "heterogeneous_volume")
+        build_heterogeneous_volume(ret, film_aspect);
+    else if(name == "many_lights")
+        build_many_lights(ret, film_aspect);
+    else if(name == "env_interior")
+        build_env_interior(ret, film_aspect);
+    else
+        throw ParamParsingException("unknown scene: " + name);
+
+    return ret;
+}
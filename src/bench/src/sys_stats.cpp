@@ -0,0 +1,68 @@
+#include <fstream>
+#include <string>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include <agz/bench/sys_stats.h>
+
+#if defined(_WIN32)
+
+size_t peak_rss_bytes()
+{
+    PROCESS_MEMORY_COUNTERS counters;
+    if(!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return counters.PeakWorkingSetSize;
+}
+
+bool reset_peak_rss()
+{
+    return false;
+}
+
+#else
+
+size_t peak_rss_bytes()
+{
+#if defined(__linux__)
+    // unlike ru_maxrss, VmHWM can be reset by writing to clear_refs
+    std::ifstream fin("/proc/self/status");
+    std::string line;
+    while(std::getline(fin, line))
+    {
+        if(line.compare(0, 6, "VmHWM:") == 0)
+            return size_t(std::stoull(line.substr(6))) << 10;
+    }
+#endif
+
+    rusage usage = {};
+    if(getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+
+#if defined(__APPLE__)
+    return size_t(usage.ru_maxrss);
+#else
+    return size_t(usage.ru_maxrss) << 10;
+#endif
+}
+
+bool reset_peak_rss()
+{
+#if defined(__linux__)
+    std::ofstream fout("/proc/self/clear_refs");
+    if(!fout)
+        return false;
+    fout << "5";
+    fout.close();
+    return !fout.fail();
+#else
+    return false;
+#endif
+}
+
+#endif
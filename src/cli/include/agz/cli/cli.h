@@ -3,6 +3,7 @@
 #include <optional>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 class ParamParsingException : public std::invalid_argument
 {
@@ -15,6 +16,21 @@ struct Params
 {
     std::string scene_description;
     std::string scene_filename;
+
+    int tile_cache_budget_mb = 0; // 0 means default budget
+
+    std::string trace_filename; // empty means no tracing
+
+    bool resume = false;
+
+    std::string partial_filename; // empty means rendering the whole frame
+    int partition_index = 0;
+    int partition_count = 1;
+
+    std::vector<std::string> merged_filenames; // empty means no merging
+
+    std::string server_address; // empty means rendering the given scene
+    int scene_memory_budget_mb = 4096;
 };
 
 /*
@@ -23,5 +39,37 @@ struct Params
         -d only: load scene desc from SceneDescriptionFilename
         -s only: use SceneDescription as scene desc and assume that it's loaded from './scene.txt'
         -d and -s: use SceneDescription as scene desc and assume that it's loaded from SceneDescriptionFilename
+
+    --tile-cache-budget MB
+
+        memory budget of tiled textures in megabytes
+
+    --trace TraceFilename
+
+        record timeline of scene loading and rendering into TraceFilename
+        in chrome trace_event format
+
+    --resume
+
+        resume render sessions from their checkpoint files if exist
+
+    --partial-film PartialFilmFilename --partition Index/Count
+
+        divide samples of each pixel into Count shares, render the Index-th
+        share and save the unnormalized film into PartialFilmFilename
+        without running post processors. Index starts from 0
+
+    --merge PartialFilmFilename0,PartialFilmFilename1,...
+
+        merge partial films into the final image and run post processors
+        without loading the scene
+
+    --server Address [--scene-memory-budget MB]
+
+        run as a render server listening on Address, which is a unix domain
+        socket path or a windows named pipe name. loaded scenes are kept
+        resident until their total memory exceeds the budget (4096 by
+        default). scene description is not needed. see render_server.h for
+        the protocol
 */
 std::optional<Params> parse_opts(int argc, char *argv[]);
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include <agz/utility/misc.h>
+
+class LocalSocketException : public std::runtime_error
+{
+public:
+
+    using runtime_error::runtime_error;
+};
+
+/**
+ * @brief connection accepted by LocalServerSocket
+ *
+ * messages are exchanged as lines of text
+ */
+class LocalConnection : public agz::misc::uncopyable_t
+{
+public:
+
+    explicit LocalConnection(intptr_t handle) noexcept;
+
+    ~LocalConnection();
+
+    /**
+     * @brief read the next line without the line break
+     *
+     * return false when the client closes the connection
+     */
+    bool read_line(std::string &line);
+
+    /**
+     * @brief write str followed by a line break
+     */
+    void write_line(const std::string &str);
+
+private:
+
+    // return 0 when the client closes the connection
+    size_t read_some(char *output, size_t max_bytes);
+
+    intptr_t handle_;
+    std::string buffer_;
+};
+
+/**
+ * @brief local server endpoint
+ *
+ * address is the path of a unix domain socket, or the name of a named pipe
+ * on windows. clients are served one at a time
+ *
+ * throw LocalSocketException on failure
+ */
+class LocalServerSocket : public agz::misc::uncopyable_t
+{
+public:
+
+    explicit LocalServerSocket(std::string address);
+
+    ~LocalServerSocket();
+
+    /**
+     * @brief block until a client connects
+     */
+    std::unique_ptr<LocalConnection> accept();
+
+    const std::string &address() const noexcept { return address_; }
+
+private:
+
+    std::string address_;
+    intptr_t handle_;
+};
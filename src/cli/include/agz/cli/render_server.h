@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+
+/*
+    render jobs are sent as json objects, one object per line. the server
+    answers each request with a json object in a line, whose "status" is
+    "ok" or "error" (with "message").
+
+    {
+        "type": "render",
+        "scene_filename": "path/to/scene.json",
+        "session": 0,          // optional. index of render session when
+                               // "rendering" of the scene file is an array
+        "rendering": { ... },  // optional. json merge patch (rfc 7386)
+                               // applied to the render session config
+        "resume": false        // optional. resume from checkpoint
+    }
+
+        render the scene, which is loaded on the first job and kept resident.
+        the response contains "scene_cached", "load_seconds" and
+        "render_seconds"
+
+    { "type": "stats" }
+
+        statistics of the scene cache
+
+    { "type": "evict", "scene_filename": "path/to/scene.json" }
+
+        drop the scene from the cache, or all scenes without scene_filename
+
+    { "type": "shutdown" }
+
+        stop the server after answering this request
+*/
+
+/**
+ * @brief serve render jobs on a unix domain socket or windows named pipe
+ *
+ * loaded scenes are cached and evicted by scene_memory_budget (in bytes).
+ * returns after a shutdown request
+ */
+void run_render_server(const std::string &address, size_t scene_memory_budget);
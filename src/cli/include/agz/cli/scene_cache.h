@@ -0,0 +1,103 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <string>
+
+#include <agz/factory/factory.h>
+#include <agz/tracer/tracer.h>
+
+/**
+ * @brief map ${working-directory} and ${scene-directory} in scene descriptions
+ */
+void add_path_replacers(
+    agz::tracer::factory::BasicPathMapper &path_mapper,
+    const std::string &scene_filename);
+
+/**
+ * @brief loaded scene and everything needed to create render sessions of it
+ */
+struct CachedScene
+{
+    // hash of the scene description and its directory
+    uint64_t key = 0;
+
+    std::string scene_filename;
+
+    agz::tracer::factory::JSON       root_json;
+    agz::tracer::Config              root_config;
+    agz::tracer::factory::BasicPathMapper path_mapper;
+
+    // creators of render sessions may refer to objects in the scene config,
+    // so the context is kept alive with the scene
+    std::unique_ptr<agz::tracer::factory::CreatingContext> context;
+
+    agz::tracer::RC<agz::tracer::Scene> scene;
+
+    // size of decoded meshes, textures, etc. loaded through the resource cache
+    size_t bytes = 0;
+};
+
+/**
+ * @brief scenes kept resident between render jobs
+ *
+ * scenes are identified by the hash of their descriptions and directories,
+ * so editing a scene description reloads it. files referred by the
+ * description are not hashed.
+ *
+ * when the total memory of cached scenes exceeds the budget, least recently
+ * used scenes are evicted. the memory of a scene is estimated by the size
+ * of resources kept by its objects (e.g. decoded images) plus the approximate
+ * size of triangle mesh bvhs, as recorded by the resource cache of its
+ * creating context. other objects (e.g. the scene aggregate) are not counted
+ */
+class SceneCache : public agz::misc::uncopyable_t
+{
+public:
+
+    struct Stats
+    {
+        size_t   scene_count    = 0;
+        size_t   resident_bytes = 0;
+        size_t   budget_bytes   = 0;
+        uint64_t hits           = 0;
+        uint64_t misses         = 0;
+        uint64_t evictions      = 0;
+    };
+
+    explicit SceneCache(size_t budget_bytes) noexcept;
+
+    /**
+     * @brief find a scene or load it on miss
+     *
+     * the returned scene is never evicted by this call. set cached to
+     * whether the scene is found in the cache
+     */
+    std::shared_ptr<const CachedScene> get(
+        const std::string &scene_filename,
+        const std::string &scene_description,
+        bool &cached);
+
+    /**
+     * @brief drop the scene loaded from scene_filename. return false if
+     *  no such scene is cached
+     */
+    bool evict(const std::string &scene_filename);
+
+    void clear();
+
+    Stats stats() const noexcept;
+
+private:
+
+    void evict_to_budget();
+
+    size_t budget_bytes_;
+
+    // most recently used first
+    std::list<std::shared_ptr<CachedScene>> scenes_;
+
+    uint64_t hits_      = 0;
+    uint64_t misses_    = 0;
+    uint64_t evictions_ = 0;
+};
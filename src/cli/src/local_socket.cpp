@@ -0,0 +1,265 @@
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include <agz/cli/local_socket.h>
+
+bool LocalConnection::read_line(std::string &line)
+{
+    for(;;)
+    {
+        if(const size_t pos = buffer_.find('\n'); pos != std::string::npos)
+        {
+            line = buffer_.substr(0, pos);
+            buffer_.erase(0, pos + 1);
+            if(!line.empty() && line.back() == '\r')
+                line.pop_back();
+            return true;
+        }
+
+        char data[4096];
+        const size_t bytes = read_some(data, sizeof(data));
+        if(!bytes)
+        {
+            // the last line may have no line break
+            if(buffer_.empty())
+                return false;
+            line = std::move(buffer_);
+            buffer_.clear();
+            return true;
+        }
+
+        buffer_.append(data, bytes);
+    }
+}
+
+#if defined(_WIN32)
+
+namespace
+{
+    std::string last_error_message()
+    {
+        return "error code " + std::to_string(GetLastError());
+    }
+}
+
+LocalConnection::LocalConnection(intptr_t handle) noexcept
+    : handle_(handle)
+{
+
+}
+
+LocalConnection::~LocalConnection()
+{
+    const HANDLE pipe = reinterpret_cast<HANDLE>(handle_);
+    FlushFileBuffers(pipe);
+    DisconnectNamedPipe(pipe);
+    CloseHandle(pipe);
+}
+
+size_t LocalConnection::read_some(char *output, size_t max_bytes)
+{
+    DWORD bytes = 0;
+    if(!ReadFile(reinterpret_cast<HANDLE>(handle_),
+                 output, DWORD(max_bytes), &bytes, nullptr))
+    {
+        if(GetLastError() == ERROR_BROKEN_PIPE)
+            return 0;
+        throw LocalSocketException(
+            "failed to read from named pipe: " + last_error_message());
+    }
+    return bytes;
+}
+
+void LocalConnection::write_line(const std::string &str)
+{
+    const std::string data = str + "\n";
+
+    size_t offset = 0;
+    while(offset < data.size())
+    {
+        DWORD bytes = 0;
+        if(!WriteFile(reinterpret_cast<HANDLE>(handle_),
+                      data.data() + offset, DWORD(data.size() - offset),
+                      &bytes, nullptr))
+        {
+            throw LocalSocketException(
+                "failed to write to named pipe: " + last_error_message());
+        }
+        offset += bytes;
+    }
+}
+
+LocalServerSocket::LocalServerSocket(std::string address)
+    : address_(std::move(address)), handle_(0)
+{
+    const std::string prefix = R"(\\.\pipe\)";
+    if(address_.compare(0, prefix.size(), prefix) != 0)
+        address_ = prefix + address_;
+}
+
+LocalServerSocket::~LocalServerSocket()
+{
+
+}
+
+std::unique_ptr<LocalConnection> LocalServerSocket::accept()
+{
+    // a new pipe instance is created for each client
+
+    const HANDLE pipe = CreateNamedPipeA(
+        address_.c_str(), PIPE_ACCESS_DUPLEX,
+        PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT,
+        1, 4096, 4096, 0, nullptr);
+    if(pipe == INVALID_HANDLE_VALUE)
+    {
+        throw LocalSocketException(
+            "failed to create named pipe " + address_ +
+            ": " + last_error_message());
+    }
+
+    if(!ConnectNamedPipe(pipe, nullptr) &&
+       GetLastError() != ERROR_PIPE_CONNECTED)
+    {
+        const std::string msg = last_error_message();
+        CloseHandle(pipe);
+        throw LocalSocketException(
+            "failed to connect named pipe " + address_ + ": " + msg);
+    }
+
+    return std::make_unique<LocalConnection>(reinterpret_cast<intptr_t>(pipe));
+}
+
+#else
+
+namespace
+{
+    std::string last_error_message()
+    {
+        return std::strerror(errno);
+    }
+}
+
+LocalConnection::LocalConnection(intptr_t handle) noexcept
+    : handle_(handle)
+{
+
+}
+
+LocalConnection::~LocalConnection()
+{
+    ::close(int(handle_));
+}
+
+size_t LocalConnection::read_some(char *output, size_t max_bytes)
+{
+    for(;;)
+    {
+        const ssize_t bytes = ::recv(int(handle_), output, max_bytes, 0);
+        if(bytes >= 0)
+            return size_t(bytes);
+        if(errno == EINTR)
+            continue;
+        if(errno == ECONNRESET)
+            return 0;
+        throw LocalSocketException(
+            "failed to read from socket: " + last_error_message());
+    }
+}
+
+void LocalConnection::write_line(const std::string &str)
+{
+    const std::string data = str + "\n";
+
+#if defined(MSG_NOSIGNAL)
+    constexpr int flags = MSG_NOSIGNAL;
+#else
+    constexpr int flags = 0;
+#endif
+
+    size_t offset = 0;
+    while(offset < data.size())
+    {
+        const ssize_t bytes = ::send(
+            int(handle_), data.data() + offset, data.size() - offset, flags);
+        if(bytes < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            throw LocalSocketException(
+                "failed to write to socket: " + last_error_message());
+        }
+        offset += size_t(bytes);
+    }
+}
+
+LocalServerSocket::LocalServerSocket(std::string address)
+    : address_(std::move(address)), handle_(-1)
+{
+    sockaddr_un addr = {};
+    if(address_.size() >= sizeof(addr.sun_path))
+        throw LocalSocketException("socket path is too long: " + address_);
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, address_.c_str(), address_.size() + 1);
+
+    // remove the socket left by a killed server. other files are kept
+
+    std::error_code ec;
+    if(std::filesystem::is_socket(address_, ec))
+        std::filesystem::remove(address_, ec);
+
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0)
+    {
+        throw LocalSocketException(
+            "failed to create socket: " + last_error_message());
+    }
+
+    if(::bind(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 ||
+       ::listen(fd, 4) != 0)
+    {
+        const std::string msg = last_error_message();
+        ::close(fd);
+        throw LocalSocketException(
+            "failed to listen on " + address_ + ": " + msg);
+    }
+
+    handle_ = fd;
+}
+
+LocalServerSocket::~LocalServerSocket()
+{
+    ::close(int(handle_));
+    ::unlink(address_.c_str());
+}
+
+std::unique_ptr<LocalConnection> LocalServerSocket::accept()
+{
+    for(;;)
+    {
+        const int fd = ::accept(int(handle_), nullptr, nullptr);
+        if(fd < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            throw LocalSocketException(
+                "failed to accept connection: " + last_error_message());
+        }
+
+#if !defined(MSG_NOSIGNAL) && defined(SO_NOSIGPIPE)
+        const int no_sigpipe = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &no_sigpipe, sizeof(no_sigpipe));
+#endif
+
+        return std::make_unique<LocalConnection>(fd);
+    }
+}
+
+#endif
@@ -5,43 +5,21 @@
 #include <vector>
 
 #include <agz/cli/cli.h>
+#include <agz/cli/render_server.h>
+#include <agz/cli/scene_cache.h>
 #include <agz/factory/factory.h>
 #include <agz/tracer/tracer.h>
 
 #include <agz/utility/misc.h>
 #include <agz/utility/string.h>
 
-void run(int argc, char *argv[])
+void render(const Params &params)
 {
-    auto params = parse_opts(argc, argv);
-    if(!params)
-        return;
-
-#ifdef USE_EMBREE
-        AGZ_INFO("initializing embree device");
-        agz::tracer::init_embree_device();
-        AGZ_SCOPE_GUARD({
-            AGZ_INFO("destroying embree device");
-            agz::tracer::destroy_embree_device();
-        });
-#endif
-
     agz::tracer::factory::BasicPathMapper path_mapper;
-    {
-        const auto working_dir = absolute(
-            std::filesystem::current_path()).lexically_normal().string();
-        path_mapper.add_replacer(AGZ_FACTORY_WORKING_DIR_PATH_NAME, working_dir);
-        AGZ_INFO("working directory: {}", working_dir);
-
-        const auto scene_dir = absolute(
-            std::filesystem::path(params->scene_filename))
-                .parent_path().lexically_normal().string();
-        path_mapper.add_replacer(AGZ_FACTORY_SCENE_DESC_PATH_NAME, scene_dir);
-        AGZ_INFO("scene directory: {}", scene_dir);
-    }
+    add_path_replacers(path_mapper, params.scene_filename);
 
     const auto root_params = agz::tracer::factory::json_to_config(
-        agz::tracer::factory::string_to_json(params->scene_description));
+        agz::tracer::factory::string_to_json(params.scene_description));
     const auto &scene_config = root_params.child_group("scene");
     const auto &rendering_config = root_params.child("rendering");
 
@@ -49,10 +27,36 @@ void run(int argc, char *argv[])
     context.path_mapper = &path_mapper;
     context.reference_root = &scene_config;
 
-    auto scene = context.create<agz::tracer::Scene>(scene_config);
+    // merging partial films does not need the scene
+
+    agz::tracer::RC<agz::tracer::Scene> scene;
+    if(params.merged_filenames.empty())
+        scene = context.create<agz::tracer::Scene>(scene_config);
+
+    auto execute = [&](agz::tracer::RenderSession &render_session)
+    {
+        render_session.render_settings->checkpoint.resume = params.resume;
+
+        if(!params.merged_filenames.empty())
+            render_session.merge_partial_films(params.merged_filenames);
+        else if(!params.partial_filename.empty())
+        {
+            render_session.execute_partial(
+                { params.partition_index, params.partition_count },
+                params.partial_filename);
+        }
+        else
+            render_session.execute();
+    };
 
     if(rendering_config.is_array())
     {
+        if(!params.partial_filename.empty() || !params.merged_filenames.empty())
+        {
+            throw ParamParsingException(
+                "partial rendering and merging only support a single render session");
+        }
+
         const auto &rendering_config_arr = rendering_config.as_array();
         AGZ_INFO("there is {} render sessions", rendering_config_arr.size());
         for(size_t i = 0; i < rendering_config_arr.size(); ++i)
@@ -60,14 +64,59 @@ void run(int argc, char *argv[])
             AGZ_INFO("processing rendering session [{}]", i);
             auto render_session = create_render_session(
                 scene, rendering_config_arr.at_group(i), context);
-            render_session.execute();
+            execute(render_session);
         }
     }
     else
     {
         auto render_session = create_render_session(
             scene, rendering_config.as_group(), context);
-        render_session.execute();
+        execute(render_session);
+    }
+}
+
+void run(int argc, char *argv[])
+{
+    auto params = parse_opts(argc, argv);
+    if(!params)
+        return;
+
+#ifdef USE_EMBREE
+        AGZ_INFO("initializing embree device");
+        agz::tracer::init_embree_device();
+        AGZ_SCOPE_GUARD({
+            AGZ_INFO("destroying embree device");
+            agz::tracer::destroy_embree_device();
+        });
+#endif
+
+    if(params->tile_cache_budget_mb > 0)
+    {
+        AGZ_INFO("tile cache budget: {} MB", params->tile_cache_budget_mb);
+        agz::tracer::TileCache::instance().set_budget(
+            size_t(params->tile_cache_budget_mb) << 20);
+    }
+
+    if(!params->trace_filename.empty())
+    {
+        AGZ_INFO("recording trace events");
+        agz::tracer::trace::start();
+    }
+
+    if(!params->server_address.empty())
+    {
+        run_render_server(
+            params->server_address,
+            size_t(params->scene_memory_budget_mb) << 20);
+    }
+    else
+        render(*params);
+
+    if(!params->trace_filename.empty())
+    {
+        agz::tracer::trace::stop();
+        AGZ_INFO("writing trace events to {}", params->trace_filename);
+        agz::tracer::trace::write_chrome_trace(params->trace_filename);
     }
 }
 
@@ -9,6 +9,14 @@ std::optional<Params> parse_opts(int argc, char *argv[])
     opts.add_options("")
         ("s,scene", "scene description", cxxopts::value<std::string>())
         ("d,scene-filename", "scene description filename", cxxopts::value<std::string>())
+        ("tile-cache-budget", "memory budget of tiled textures in MB", cxxopts::value<int>())
+        ("trace", "output chrome trace filename", cxxopts::value<std::string>())
+        ("resume", "resume from checkpoints")
+        ("partial-film", "output partial film filename", cxxopts::value<std::string>())
+        ("partition", "rendered share of samples, formatted as index/count", cxxopts::value<std::string>())
+        ("merge", "comma-separated partial film filenames to merge", cxxopts::value<std::vector<std::string>>())
+        ("server", "run as a render server listening on given address", cxxopts::value<std::string>())
+        ("scene-memory-budget", "memory budget of scenes resident in the render server in MB", cxxopts::value<int>())
         ("h,help", "help information");
     auto parse_result = opts.parse(argc, argv);
 
@@ -20,6 +28,29 @@ std::optional<Params> parse_opts(int argc, char *argv[])
 
     Params ret;
 
+    if(parse_result.count("server"))
+    {
+        ret.server_address = parse_result["server"].as<std::string>();
+        if(ret.server_address.empty())
+            throw ParamParsingException("empty server address");
+
+        if(parse_result.count("scene-memory-budget"))
+        {
+            ret.scene_memory_budget_mb = parse_result["scene-memory-budget"].as<int>();
+            if(ret.scene_memory_budget_mb <= 0)
+                throw ParamParsingException("invalid scene memory budget");
+        }
+
+        if(parse_result.count("scene") || parse_result.count("scene-filename") ||
+           parse_result.count("partial-film") || parse_result.count("merge") ||
+           parse_result.count("resume"))
+        {
+            throw ParamParsingException(
+                "scene, partial rendering, merging and resuming are specified "
+                "by render jobs in server mode");
+        }
+    }
+
     const bool has_scene_content  = parse_result.count("scene") != 0;
     const bool has_scene_filename = parse_result.count("scene-filename") != 0;
 
@@ -36,8 +67,52 @@ std::optional<Params> parse_opts(int argc, char *argv[])
         ret.scene_filename = parse_result["scene-filename"].as<std::string>();
         ret.scene_description = agz::file::read_txt_file(ret.scene_filename);
     }
-    else
+    else if(ret.server_address.empty())
         throw ParamParsingException("scene description is unspecified");
 
+    if(parse_result.count("tile-cache-budget"))
+    {
+        ret.tile_cache_budget_mb = parse_result["tile-cache-budget"].as<int>();
+        if(ret.tile_cache_budget_mb <= 0)
+            throw ParamParsingException("invalid tile cache budget");
+    }
+
+    if(parse_result.count("trace"))
+        ret.trace_filename = parse_result["trace"].as<std::string>();
+
+    ret.resume = parse_result.count("resume") != 0;
+
+    if(parse_result.count("partial-film"))
+    {
+        ret.partial_filename = parse_result["partial-film"].as<std::string>();
+        if(!parse_result.count("partition"))
+            throw ParamParsingException("partition is unspecified");
+
+        const std::string partition = parse_result["partition"].as<std::string>();
+        const size_t slash = partition.find('/');
+        try
+        {
+            if(slash == std::string::npos)
+                throw std::invalid_argument(partition);
+            ret.partition_index = std::stoi(partition.substr(0, slash));
+            ret.partition_count = std::stoi(partition.substr(slash + 1));
+        }
+        catch(const std::exception &)
+        {
+            throw ParamParsingException("invalid partition: " + partition);
+        }
+
+        if(ret.partition_count <= 0 || ret.partition_index < 0 ||
+           ret.partition_index >= ret.partition_count)
+            throw ParamParsingException("invalid partition: " + partition);
+    }
+
+    if(parse_result.count("merge"))
+    {
+        ret.merged_filenames = parse_result["merge"].as<std::vector<std::string>>();
+        if(!ret.partial_filename.empty())
+            throw ParamParsingException("cannot render and merge partial films at once");
+    }
+
     return ret;
 }
@@ -0,0 +1,213 @@
+#include <chrono>
+#include <iterator>
+#include <vector>
+
+#include <agz/cli/local_socket.h>
+#include <agz/cli/render_server.h>
+#include <agz/cli/scene_cache.h>
+
+#include <agz/utility/file.h>
+#include <agz/utility/misc.h>
+
+using namespace agz::tracer;
+
+namespace
+{
+    using JSON = factory::JSON;
+
+    std::string exception_message(const std::exception &e)
+    {
+        std::vector<std::string> msgs;
+        agz::misc::extract_hierarchy_exceptions(e, std::back_inserter(msgs));
+
+        std::string ret;
+        for(auto &m : msgs)
+        {
+            if(!ret.empty())
+                ret += "\n";
+            ret += m;
+        }
+        return ret;
+    }
+
+    double seconds_since(std::chrono::steady_clock::time_point start)
+    {
+        const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        return elapsed.count();
+    }
+
+    class RenderServer
+    {
+        SceneCache scene_cache_;
+
+        bool shutdown_requested_ = false;
+
+        JSON render(const JSON &request)
+        {
+            const auto start = std::chrono::steady_clock::now();
+
+            const auto scene_filename =
+                request.at("scene_filename").get<std::string>();
+            const auto scene_description =
+                agz::file::read_txt_file(scene_filename);
+
+            bool cached = false;
+            const auto scene = scene_cache_.get(
+                scene_filename, scene_description, cached);
+            const double load_seconds = seconds_since(start);
+
+            JSON rendering_json = scene->root_json.at("rendering");
+            if(rendering_json.is_array())
+            {
+                const auto session = request.value("session", size_t(0));
+                if(session >= rendering_json.size())
+                {
+                    throw std::out_of_range(
+                        "invalid render session index: " +
+                        std::to_string(session));
+                }
+                rendering_json = JSON(rendering_json.at(session));
+            }
+
+            if(auto it = request.find("rendering"); it != request.end())
+                rendering_json.merge_patch(*it);
+
+            const Config rendering_config =
+                factory::json_to_config(rendering_json);
+
+            auto render_session = create_render_session(
+                scene->scene, rendering_config, *scene->context);
+            render_session.render_settings->checkpoint.resume =
+                request.value("resume", false);
+
+            const auto render_start = std::chrono::steady_clock::now();
+            render_session.execute();
+
+            JSON response;
+            response["status"]         = "ok";
+            response["scene_cached"]   = cached;
+            response["load_seconds"]   = load_seconds;
+            response["render_seconds"] = seconds_since(render_start);
+            return response;
+        }
+
+        JSON stats() const
+        {
+            const auto stats = scene_cache_.stats();
+
+            JSON response;
+            response["status"]         = "ok";
+            response["scene_count"]    = stats.scene_count;
+            response["resident_mb"]    = stats.resident_bytes >> 20;
+            response["budget_mb"]      = stats.budget_bytes >> 20;
+            response["hits"]           = stats.hits;
+            response["misses"]         = stats.misses;
+            response["evictions"]      = stats.evictions;
+            return response;
+        }
+
+        JSON evict(const JSON &request)
+        {
+            JSON response;
+            response["status"] = "ok";
+
+            if(auto it = request.find("scene_filename"); it != request.end())
+                response["evicted"] = scene_cache_.evict(it->get<std::string>());
+            else
+            {
+                scene_cache_.clear();
+                response["evicted"] = true;
+            }
+
+            return response;
+        }
+
+    public:
+
+        explicit RenderServer(size_t scene_memory_budget)
+            : scene_cache_(scene_memory_budget)
+        {
+
+        }
+
+        bool is_shutdown_requested() const noexcept
+        {
+            return shutdown_requested_;
+        }
+
+        JSON handle(const JSON &request)
+        {
+            const auto type = request.value("type", std::string("render"));
+            AGZ_INFO("handling {} request", type);
+
+            if(type == "render")
+                return render(request);
+            if(type == "stats")
+                return stats();
+            if(type == "evict")
+                return evict(request);
+
+            if(type == "shutdown")
+            {
+                shutdown_requested_ = true;
+                JSON response;
+                response["status"] = "ok";
+                return response;
+            }
+
+            throw std::invalid_argument("unknown request type: " + type);
+        }
+    };
+}
+
+void run_render_server(const std::string &address, size_t scene_memory_budget)
+{
+    LocalServerSocket socket(address);
+    AGZ_INFO("render server listening on {}", socket.address());
+    AGZ_INFO("scene memory budget: {} MB", scene_memory_budget >> 20);
+
+    RenderServer server(scene_memory_budget);
+
+    while(!server.is_shutdown_requested())
+    {
+        auto connection = socket.accept();
+        AGZ_INFO("client connected");
+
+        try
+        {
+            std::string line;
+            while(!server.is_shutdown_requested() &&
+                  connection->read_line(line))
+            {
+                if(line.find_first_not_of(" \t") == std::string::npos)
+                    continue;
+
+                JSON response;
+                try
+                {
+                    response = server.handle(JSON::parse(line));
+                }
+                catch(const std::exception &e)
+                {
+                    const std::string msg = exception_message(e);
+                    AGZ_ERROR("failed to handle request: {}", msg);
+
+                    response = JSON();
+                    response["status"]  = "error";
+                    response["message"] = msg;
+                }
+
+                connection->write_line(response.dump());
+            }
+        }
+        catch(const LocalSocketException &e)
+        {
+            AGZ_ERROR("{}", e.what());
+        }
+
+        AGZ_INFO("client disconnected");
+    }
+
+    AGZ_INFO("render server shut down");
+}
@@ -0,0 +1,172 @@
+#include <filesystem>
+
+#include <agz/cli/scene_cache.h>
+
+using namespace agz::tracer;
+
+namespace
+{
+    // fnv-1a
+    uint64_t hash_bytes(uint64_t hash, const std::string &bytes) noexcept
+    {
+        for(const char c : bytes)
+        {
+            hash ^= uint8_t(c);
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    uint64_t hash_scene(
+        const std::string &scene_description,
+        const std::string &scene_dir) noexcept
+    {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        hash = hash_bytes(hash, scene_description);
+        hash = hash_bytes(hash, std::string(1, '\0'));
+        hash = hash_bytes(hash, scene_dir);
+        return hash;
+    }
+
+    std::string canonical_filename(const std::string &filename)
+    {
+        return absolute(std::filesystem::path(filename))
+                    .lexically_normal().string();
+    }
+}
+
+void add_path_replacers(
+    factory::BasicPathMapper &path_mapper, const std::string &scene_filename)
+{
+    const auto working_dir = absolute(
+        std::filesystem::current_path()).lexically_normal().string();
+    path_mapper.add_replacer(AGZ_FACTORY_WORKING_DIR_PATH_NAME, working_dir);
+    AGZ_INFO("working directory: {}", working_dir);
+
+    const auto scene_dir = absolute(
+        std::filesystem::path(scene_filename))
+            .parent_path().lexically_normal().string();
+    path_mapper.add_replacer(AGZ_FACTORY_SCENE_DESC_PATH_NAME, scene_dir);
+    AGZ_INFO("scene directory: {}", scene_dir);
+}
+
+SceneCache::SceneCache(size_t budget_bytes) noexcept
+    : budget_bytes_(budget_bytes)
+{
+
+}
+
+std::shared_ptr<const CachedScene> SceneCache::get(
+    const std::string &scene_filename,
+    const std::string &scene_description,
+    bool &cached)
+{
+    const std::string filename = canonical_filename(scene_filename);
+    const uint64_t key = hash_scene(
+        scene_description,
+        std::filesystem::path(filename).parent_path().string());
+
+    for(auto it = scenes_.begin(); it != scenes_.end(); ++it)
+    {
+        if((*it)->key == key)
+        {
+            scenes_.splice(scenes_.begin(), scenes_, it);
+            ++hits_;
+            cached = true;
+            return scenes_.front();
+        }
+    }
+
+    ++misses_;
+    cached = false;
+
+    AGZ_INFO("loading scene {}", filename);
+
+    auto entry = std::make_shared<CachedScene>();
+    entry->key            = key;
+    entry->scene_filename = filename;
+    add_path_replacers(entry->path_mapper, filename);
+
+    entry->root_json   = factory::string_to_json(scene_description);
+    entry->root_config = factory::json_to_config(entry->root_json);
+    const auto &scene_config = entry->root_config.child_group("scene");
+
+    entry->context = std::make_unique<factory::CreatingContext>();
+    entry->context->path_mapper    = &entry->path_mapper;
+    entry->context->reference_root = &scene_config;
+
+    entry->scene = entry->context->create<Scene>(scene_config);
+
+    // each scene has its own context, so all loaded resources belong to it.
+    // decoded meshes are freed after their bvhs are built, so only the
+    // estimated bvh memory is counted for them
+
+    const auto resource_stats = entry->context->resource_cache.stats();
+    entry->bytes = static_cast<size_t>(
+        resource_stats.bytes_kept + resource_stats.bytes_derived);
+    AGZ_INFO("scene loaded. estimated memory: {} MB", entry->bytes >> 20);
+
+    scenes_.push_front(entry);
+    evict_to_budget();
+
+    return entry;
+}
+
+bool SceneCache::evict(const std::string &scene_filename)
+{
+    const std::string filename = canonical_filename(scene_filename);
+
+    const size_t old_size = scenes_.size();
+    scenes_.remove_if([&](const std::shared_ptr<CachedScene> &scene)
+    {
+        return scene->scene_filename == filename;
+    });
+
+    evictions_ += old_size - scenes_.size();
+    return scenes_.size() != old_size;
+}
+
+void SceneCache::clear()
+{
+    evictions_ += scenes_.size();
+    scenes_.clear();
+}
+
+SceneCache::Stats SceneCache::stats() const noexcept
+{
+    Stats ret;
+    ret.scene_count  = scenes_.size();
+    ret.budget_bytes = budget_bytes_;
+    ret.hits         = hits_;
+    ret.misses       = misses_;
+    ret.evictions    = evictions_;
+    for(auto &scene : scenes_)
+        ret.resident_bytes += scene->bytes;
+    return ret;
+}
+
+void SceneCache::evict_to_budget()
+{
+    size_t total_bytes = 0;
+    for(auto &scene : scenes_)
+        total_bytes += scene->bytes;
+
+    // the most recently used scene is always kept
+
+    while(total_bytes > budget_bytes_ && scenes_.size() > 1)
+    {
+        auto &scene = scenes_.back();
+        AGZ_INFO("evicting scene {} ({} MB)",
+                 scene->scene_filename, scene->bytes >> 20);
+
+        total_bytes -= scene->bytes;
+        scenes_.pop_back();
+        ++evictions_;
+    }
+
+    if(total_bytes > budget_bytes_)
+    {
+        AGZ_INFO("scene {} ({} MB) alone exceeds the scene memory budget",
+                 scenes_.front()->scene_filename, total_bytes >> 20);
+    }
+}
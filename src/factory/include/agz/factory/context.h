@@ -6,7 +6,9 @@
 #include <tuple>
 #include <unordered_map>
 
+#include <agz/factory/utility/resource_cache.h>
 #include <agz/tracer/utility/config.h>
+#include <agz/tracer/utility/trace.h>
 #include <agz/utility/misc.h>
 #include <agz/utility/string.h>
 
@@ -117,6 +119,9 @@ public:
     const PathMapper *path_mapper;
     const ConfigGroup *reference_root;
 
+    // resources shared by all creators of this context
+    ResourceCache resource_cache;
+
     template<typename T>
     Factory<T> &factory() noexcept;
 
@@ -289,6 +294,8 @@ RC<T> CreatingContext::create(const ConfigGroup &params, Args&&...args)
             "unknown creator type name: " + type_name);
 
     {
+        AGZ_TRACE_SCOPE("create", this->factory<T>().name() + "/" + type_name);
+
         AGZ_HIERARCHY_TRY
         return creator->create(params, *this, std::forward<Args>(args)...);
         AGZ_HIERARCHY_WRAP(
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+
+#include <agz/tracer/core/camera.h>
+#include <agz/tracer/utility/config.h>
+
+AGZ_TRACER_BEGIN
+
+/**
+ * @brief thin lens camera parameters at a given frame
+ */
+struct CameraKeyframe
+{
+    int frame = 0;
+
+    Vec3 pos;
+    Vec3 dst;
+    Vec3 up;
+
+    real fov            = 0; // in radians
+    real lens_radius    = 0;
+    real focal_distance = 1;
+};
+
+/**
+ * @brief thin lens camera interpolated between keyframes
+ */
+class CameraAnimation
+{
+public:
+
+    enum class Interpolation
+    {
+        Linear,
+        CatmullRom // piecewise cubic hermite with catmull-rom tangents
+    };
+
+    CameraAnimation() = default;
+
+    /**
+     * @brief keyframes must be non-empty and sorted by frame without
+     *  duplicates
+     */
+    CameraAnimation(
+        std::vector<CameraKeyframe> keyframes,
+        Interpolation interpolation);
+
+    /**
+     * @brief frames before the first keyframe or after the last one are
+     *  clamped
+     */
+    CameraKeyframe interpolate(real frame) const;
+
+    RC<Camera> create_camera(real frame, real film_aspect) const;
+
+    int first_frame() const noexcept;
+
+    int last_frame() const noexcept;
+
+private:
+
+    std::vector<CameraKeyframe> keyframes_;
+    Interpolation interpolation_ = Interpolation::CatmullRom;
+};
+
+/**
+ * @brief parse animation.interpolation and animation.keyframes
+ *
+ * fields except frame can be omitted in keyframes other than the first one,
+ * and are then copied from the previous keyframe
+ */
+CameraAnimation parse_camera_animation(const ConfigGroup &params);
+
+AGZ_TRACER_END
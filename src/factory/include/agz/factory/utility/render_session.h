@@ -1,9 +1,11 @@
 #pragma once
 
+#include <functional>
 #include <memory>
 
 #include <agz/tracer/core/renderer.h>
 #include <agz/factory/factory.h>
+#include <agz/factory/utility/camera_animation.h>
 #include <agz/tracer/utility/config.h>
 
 AGZ_TRACER_BEGIN
@@ -18,6 +20,23 @@ class RenderSession
 {
 public:
 
+    /**
+     * @brief frames rendered against the same scene with an animated camera
+     */
+    struct Animation
+    {
+        CameraAnimation camera;
+
+        // rendered frames are [begin_frame, end_frame)
+        int begin_frame = 0;
+        int end_frame   = 1;
+
+        // post processors are created for each frame, so that ${frame} in
+        // their filenames is replaced by the frame index
+        std::function<std::vector<RC<PostProcessor>>(int)>
+            create_post_processors;
+    };
+
     struct RenderSetting
     {
         int width  = 1;
@@ -25,23 +44,72 @@ public:
 
         real eps = real(3e-4);
 
+        // json dump of rendering statistics. empty means no dump
+        std::string stats_filename;
+
+        // periodic checkpoints of the renderer state
+        CheckpointParams checkpoint;
+
+        // record rendering time of each pixel (for save_cost_heatmap)
+        bool record_pixel_cost = false;
+
         RC<Camera>                     camera;
         RC<FilmFilter>                 film_filter;
         RC<Renderer>                   renderer;
         RC<RendererInteractor>           reporter;
         std::vector<RC<PostProcessor>> post_processors;
+
+        // nullptr means rendering a still image
+        Box<Animation> animation;
     };
 
     RenderSession() = default;
 
     RenderSession(RC<Scene> scene, Box<RenderSetting> render_setting) noexcept;
 
+    /**
+     * @brief render the still image, or all frames of the animation
+     *
+     * the scene is prepared once for all frames. post processors of a frame
+     * run in a background thread while the next frame is rendered
+     */
     void execute();
 
+    /**
+     * @brief render a share of samples and save the unnormalized film
+     *
+     * post processors are not executed. animations are not supported
+     */
+    void execute_partial(
+        const FilmPartition &partition, const std::string &partial_filename);
+
+    /**
+     * @brief merge partial films saved by execute_partial, and then
+     *  run post processors
+     *
+     * scene is not used and can be nullptr. animations are not supported
+     */
+    void merge_partial_films(const std::vector<std::string> &partial_filenames);
+
     RC<Scene> scene;
     Box<RenderSetting> render_settings;
+
+private:
+
+    FilmFilterApplier start_rendering();
+
+    void execute_animation();
+
+    void report_rendering_stats();
+
+    static void run_post_processors(
+        const std::vector<RC<PostProcessor>> &post_processors,
+        RenderTarget &render_target);
 };
 
+/**
+ * @brief context must outlive the created session when it is animated
+ */
 RenderSession create_render_session(
     RC<Scene> scene,
     const ConfigGroup &rendering_setting_config,
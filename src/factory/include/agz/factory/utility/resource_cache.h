@@ -0,0 +1,192 @@
+#pragma once
+
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <string>
+#include <typeindex>
+#include <unordered_map>
+
+#include <agz/tracer/common.h>
+#include <agz/utility/mesh.h>
+
+AGZ_TRACER_FACTORY_BEGIN
+
+/**
+ * @brief approximate memory size of cached resources, used in statistics
+ */
+template<typename T>
+size_t resource_bytes(const T &) noexcept
+{
+    return sizeof(T);
+}
+
+template<typename T>
+size_t resource_bytes(const Image2D<T> &data) noexcept
+{
+    return sizeof(T) * static_cast<size_t>(data.width()) * data.height();
+}
+
+inline size_t resource_bytes(const std::vector<mesh::triangle_t> &data) noexcept
+{
+    return sizeof(mesh::triangle_t) * data.size();
+}
+
+/**
+ * @brief whether users keep the cached resource itself instead of a copy
+ *
+ * a hit saves memory only for kept resources. for other ones (e.g. meshes,
+ * which are copied and transformed by each geometry) it only saves decoding
+ */
+template<typename T>
+constexpr bool is_resource_kept(const T &) noexcept
+{
+    return true;
+}
+
+constexpr bool is_resource_kept(const std::vector<mesh::triangle_t> &) noexcept
+{
+    return false;
+}
+
+/**
+ * @brief shared resources (decoded images, meshes, etc.) during scene creation
+ *
+ * resources are identified by their type and a key, which should consist of
+ * the canonical path of the source file and all options affecting decoding.
+ *
+ * the cache is cleared after the scene is created, so resources are only
+ * shared within the creation of a scene.
+ *
+ * loaders run without holding the cache lock, so that distinct resources
+ * can be loaded concurrently. concurrent requests of the same resource wait
+ * for the first loader instead of loading it again.
+ */
+class ResourceCache : public misc::uncopyable_t
+{
+public:
+
+    struct Stats
+    {
+        uint64_t hits         = 0;
+        uint64_t misses       = 0;
+        uint64_t bytes_saved   = 0; // size of kept resources shared on hits
+        uint64_t bytes_loaded  = 0; // total size of resources loaded on misses
+        uint64_t bytes_kept    = 0; // size of loaded resources kept by users
+        uint64_t bytes_derived = 0; // see add_derived_bytes
+    };
+
+    /**
+     * @brief canonical form of a file path used in cache keys
+     */
+    static std::string canonical_path(const std::string &filename);
+
+    /**
+     * @brief find a resource or load it on miss
+     *
+     * loader interface: RC<const T> loader()
+     *
+     * exceptions thrown by loader are passed to all waiting callers, and
+     * the failed resource is removed so that it can be reloaded later
+     */
+    template<typename T, typename Loader>
+    RC<const T> get(const std::string &key, const Loader &loader);
+
+    /**
+     * @brief record memory of data derived from resources and owned by
+     *  created objects, e.g. bvh built from a shared mesh
+     *
+     * only used in statistics
+     */
+    void add_derived_bytes(uint64_t bytes) noexcept;
+
+    Stats stats() const noexcept;
+
+    /**
+     * @brief release all cached resources. statistics are kept
+     */
+    void clear();
+
+    /**
+     * @brief log statistics with AGZ_INFO
+     */
+    void log_stats() const;
+
+private:
+
+    using FullKey = std::pair<std::type_index, std::string>;
+
+    struct FullKeyHash
+    {
+        size_t operator()(const FullKey &key) const noexcept
+        {
+            return key.first.hash_code() ^ std::hash<std::string>()(key.second);
+        }
+    };
+
+    mutable std::mutex mutex_;
+    std::unordered_map<
+        FullKey, std::shared_future<RC<const void>>, FullKeyHash> key2entry_;
+
+    std::atomic<uint64_t> hits_         = 0;
+    std::atomic<uint64_t> misses_       = 0;
+    std::atomic<uint64_t> bytes_saved_  = 0;
+    std::atomic<uint64_t> bytes_loaded_ = 0;
+    std::atomic<uint64_t> bytes_kept_    = 0;
+    std::atomic<uint64_t> bytes_derived_ = 0;
+};
+
+template<typename T, typename Loader>
+RC<const T> ResourceCache::get(const std::string &key, const Loader &loader)
+{
+    const FullKey full_key(std::type_index(typeid(T)), key);
+
+    std::promise<RC<const void>> promise;
+
+    {
+        std::unique_lock lk(mutex_);
+
+        if(auto it = key2entry_.find(full_key); it != key2entry_.end())
+        {
+            auto data = it->second;
+            lk.unlock();
+
+            auto ret = std::static_pointer_cast<const T>(data.get());
+            hits_.fetch_add(1, std::memory_order_relaxed);
+            if(is_resource_kept(*ret))
+            {
+                bytes_saved_.fetch_add(
+                    resource_bytes(*ret), std::memory_order_relaxed);
+            }
+            return ret;
+        }
+
+        key2entry_[full_key] = promise.get_future().share();
+    }
+
+    misses_.fetch_add(1, std::memory_order_relaxed);
+
+    RC<const T> ret;
+    try
+    {
+        ret = loader();
+    }
+    catch(...)
+    {
+        {
+            std::lock_guard lk(mutex_);
+            key2entry_.erase(full_key);
+        }
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+
+    promise.set_value(ret);
+    bytes_loaded_.fetch_add(resource_bytes(*ret), std::memory_order_relaxed);
+    if(is_resource_kept(*ret))
+        bytes_kept_.fetch_add(resource_bytes(*ret), std::memory_order_relaxed);
+
+    return ret;
+}
+
+AGZ_TRACER_FACTORY_END
@@ -3,6 +3,7 @@
 #include <fstream>
 
 #include <agz/factory/context.h>
+#include <agz/tracer/utility/brick_volume.h>
 
 AGZ_TRACER_BEGIN
 
@@ -157,6 +158,14 @@ namespace texture3d_load
         const std::string *filenames, int image_count,
         const factory::PathMapper &path_mapper);
 
+    /**
+     * @brief load sparse brick volume from binary file
+     *
+     * format is the same as load_real_from_binary. texels are streamed into
+     * bricks slice by slice, so that the dense volume is never held in memory
+     */
+    BrickVolume load_bricks_from_binary(std::ifstream &fin);
+
     /**
      * @brief save vol data to binary file
      */
@@ -1,11 +1,118 @@
+#include <fstream>
+
 #include <agz/factory/creator/envir_light_creators.h>
+#include <agz/factory/utility/config_cvt.h>
 #include <agz/tracer/create/envir_light.h>
+#include <agz/tracer/utility/logger.h>
 
 AGZ_TRACER_FACTORY_BEGIN
 
 namespace envir_light
 {
 
+    constexpr uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+
+    /**
+     * @brief continue 64-bit fnv-1a hash with given bytes
+     */
+    uint64_t hash_bytes(uint64_t hash, const char *data, size_t size) noexcept
+    {
+        for(size_t i = 0; i < size; ++i)
+        {
+            hash ^= static_cast<unsigned char>(data[i]);
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    /**
+     * @brief continue 64-bit fnv-1a hash with file content
+     */
+    uint64_t hash_file_content(uint64_t hash, const std::string &filename)
+    {
+        std::ifstream fin(filename, std::ios::in | std::ios::binary);
+        if(!fin)
+        {
+            throw ObjectConstructionException(
+                "failed to open file: " + filename);
+        }
+
+        std::vector<char> buffer(1 << 20);
+        while(fin)
+        {
+            fin.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            hash = hash_bytes(
+                hash, buffer.data(), static_cast<size_t>(fin.gcount()));
+        }
+
+        return hash;
+    }
+
+    /**
+     * @brief hash content of all files named by "filename" in a texture
+     *  config. return false if there is no such file
+     */
+    bool hash_texture_files(
+        const ConfigGroup &params, const PathMapper &path_mapper,
+        uint64_t &hash)
+    {
+        bool found = false;
+        for(auto &p : params)
+        {
+            if(p.second->is_group())
+            {
+                found |= hash_texture_files(
+                    p.second->as_group(), path_mapper, hash);
+            }
+            else if(p.first == "filename" && p.second->is_value())
+            {
+                hash = hash_file_content(
+                    hash, path_mapper.map(p.second->as_value().as_str()));
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    /**
+     * @brief key of cached light sampling distributions of a texture
+     *
+     * derived from the whole texture config (mapping, gamma, wrapping, etc.)
+     * and the content of its files. return 0 for textures without files,
+     * whose distributions are not cached
+     */
+    uint64_t sampler_cache_key(
+        const ConfigGroup &tex_params, const PathMapper &path_mapper)
+    {
+        uint64_t hash = FNV_OFFSET_BASIS;
+        if(!hash_texture_files(tex_params, path_mapper, hash))
+            return 0;
+
+        const std::string config = config_to_json(tex_params).dump();
+        return hash_bytes(hash, config.data(), config.size());
+    }
+
+    std::vector<EnvirLightPortal> parse_portals(const ConfigGroup &params)
+    {
+        std::vector<EnvirLightPortal> ret;
+
+        auto arr = params.find_child_array("portals");
+        if(!arr)
+            return ret;
+
+        for(size_t i = 0; i < arr->size(); ++i)
+        {
+            const auto &group = arr->at_group(i);
+            ret.push_back({
+                group.child_vec3("A"),
+                group.child_vec3("B"),
+                group.child_vec3("C")
+            });
+        }
+
+        return ret;
+    }
+
     class IBLEnvirLightCreator : public Creator<EnvirLight>
     {
     public:
@@ -23,8 +130,28 @@ namespace envir_light
             const bool no_importance_sampling = params.child_int_or(
                 "no_importance_sampling", 0) != 0;
             const real power = params.child_real_or("power", -1);
+
+            std::string sampler_cache;
+            uint64_t sampler_cache_key = 0;
+            if(auto node = params.find_child_value("sampler_cache"))
+            {
+                sampler_cache_key = envir_light::sampler_cache_key(
+                    params.child_group("tex"), *context.path_mapper);
+
+                if(sampler_cache_key)
+                    sampler_cache = context.path_mapper->map(node->as_str());
+                else
+                {
+                    AGZ_INFO("ibl texture is not loaded from files. "
+                             "skip caching its sampler");
+                }
+            }
+
+            const auto portals = parse_portals(params);
+
             return create_ibl_light(
-                std::move(tex), no_importance_sampling, power);
+                std::move(tex), no_importance_sampling, power,
+                sampler_cache, sampler_cache_key, portals);
         }
     };
 
@@ -43,7 +170,8 @@ namespace envir_light
             const auto top    = params.child_spectrum("top");
             const auto bottom = params.child_spectrum("bottom");
             const real power = params.child_real_or("power", -1);
-            return create_native_sky(top, bottom, power);
+            const auto portals = parse_portals(params);
+            return create_native_sky(top, bottom, power, portals);
         }
     };
 
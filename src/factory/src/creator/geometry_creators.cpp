@@ -2,6 +2,7 @@
 #include <agz/factory/utility/bin_mesh.h>
 #include <agz/tracer/create/geometry.h>
 #include <agz/tracer/utility/logger.h>
+#include <agz/tracer/utility/trace.h>
 
 AGZ_TRACER_FACTORY_BEGIN
 
@@ -10,10 +11,37 @@ namespace geometry
     std::vector<mesh::triangle_t> load_triangle_mesh_from_file(
         const std::string &filename)
     {
+        AGZ_TRACE_SCOPE(
+            "io", std::filesystem::path(filename).filename().string());
+
         if(stdstr::ends_with(filename, ".bm"))
             return load_bin_mesh(filename);
         return mesh::load_from_file(filename);
     }
+
+    /**
+     * @brief load triangles through the resource cache of context
+     *
+     * each geometry takes its own copy to transform and build bvh from, so
+     * sharing only avoids decoding the same file more than once
+     */
+    std::vector<mesh::triangle_t> load_shared_triangle_mesh(
+        const std::string &filename, CreatingContext &context)
+    {
+        const auto data = context.resource_cache.get<std::vector<mesh::triangle_t>>(
+            ResourceCache::canonical_path(filename), [&]
+        {
+            AGZ_INFO("load mesh from {}", filename);
+            return newRC<std::vector<mesh::triangle_t>>(
+                load_triangle_mesh_from_file(filename));
+        });
+
+        // the bvh built from the copy stores about as much as the triangles
+
+        context.resource_cache.add_derived_bytes(resource_bytes(*data));
+
+        return *data;
+    }
     
     class DiskCreator : public Creator<Geometry>
     {
@@ -157,8 +185,7 @@ namespace geometry
             const auto local_to_world = params.child_transform3("transform");
             const auto filename = context.path_mapper->map(params.child_str("filename"));
 
-            AGZ_INFO("load mesh from {}", filename);
-            auto build_triangles = load_triangle_mesh_from_file(filename);
+            auto build_triangles = load_shared_triangle_mesh(filename, context);
             AGZ_INFO("triangle count: {}", build_triangles.size());
 
             return create_triangle_bvh_noembree(
@@ -182,8 +209,7 @@ namespace geometry
             const auto local_to_world = params.child_transform3("transform");
             const auto filename = context.path_mapper->map(params.child_str("filename"));
 
-            AGZ_INFO("load mesh from {}", filename);
-            auto build_triangles = load_triangle_mesh_from_file(filename);
+            auto build_triangles = load_shared_triangle_mesh(filename, context);
             AGZ_INFO("triangle count: {}", build_triangles.size());
 
             return create_triangle_bvh_embree(std::move(build_triangles), local_to_world);
@@ -29,9 +29,21 @@ namespace medium
             const int max_scat_count = params.child_int_or(
                 "max_scattering_count", (std::numeric_limits<int>::max)());
 
+            const int majorant_grid_res = params.child_int_or(
+                "majorant_grid_res", 0);
+
+            const std::string tr_estimator = params.child_str_or(
+                "tr_estimator", "residual_ratio");
+            if(tr_estimator != "ratio" && tr_estimator != "residual_ratio")
+            {
+                throw CreatingObjectException(
+                    "unknown transmittance estimator: " + tr_estimator);
+            }
+
             return create_heterogeneous_medium(
                 local_to_world, std::move(density),
-                std::move(albedo), std::move(g), max_scat_count);
+                std::move(albedo), std::move(g), max_scat_count,
+                majorant_grid_res, tr_estimator == "residual_ratio");
         }
     };
 
@@ -23,6 +23,31 @@ namespace post_processor
         }
     };
 
+    class BilateralDenoiserCreator : public Creator<PostProcessor>
+    {
+    public:
+
+        std::string name() const override
+        {
+            return "bilateral_denoiser";
+        }
+
+        RC<PostProcessor> create(
+            const ConfigGroup &params, CreatingContext &context) const override
+        {
+            const int radius          = params.child_int_or("radius", 6);
+            const real sigma_spatial  = params.child_real_or("sigma_spatial", 3);
+            const real sigma_color    = params.child_real_or("sigma_color", real(0.25));
+            const real sigma_albedo   = params.child_real_or("sigma_albedo", real(0.1));
+            const real sigma_normal   = params.child_real_or("sigma_normal", real(0.2));
+            const int worker_count    = params.child_int_or("worker_count", 0);
+
+            return create_bilateral_denoiser(
+                radius, sigma_spatial, sigma_color,
+                sigma_albedo, sigma_normal, worker_count);
+        }
+    };
+
     class GammaCreator : public Creator<PostProcessor>
     {
     public:
@@ -82,6 +107,29 @@ namespace post_processor
         }
     };
 
+    class SaveCostHeatmapCreator : public Creator<PostProcessor>
+    {
+    public:
+
+        std::string name() const override
+        {
+            return "save_cost_heatmap";
+        }
+
+        RC<PostProcessor> create(
+            const ConfigGroup &params, CreatingContext &context) const override
+        {
+            std::string filename = context.path_mapper->map(
+                params.child_str("filename"));
+            const real max_cost   = params.child_real_or("max_cost", 0);
+            const real percentile = params.child_real_or("percentile", real(0.99));
+            const bool log_scale  = params.child_int_or("log_scale", 0) != 0;
+
+            return create_saving_cost_heatmap(
+                std::move(filename), max_cost, percentile, log_scale);
+        }
+    };
+
     class SaveGBufferCreator : public Creator<PostProcessor>
     {
     public:
@@ -156,11 +204,13 @@ namespace post_processor
 void initialize_post_processor_factory(Factory<PostProcessor> &factory)
 {
     factory.add_creator(newBox<post_processor::ACESCreator>());
+    factory.add_creator(newBox<post_processor::BilateralDenoiserCreator>());
     factory.add_creator(newBox<post_processor::GammaCreator>());
 #ifdef USE_OIDN
     factory.add_creator(newBox<post_processor::OIDNDenoiserCreator>());
 #endif
     factory.add_creator(newBox<post_processor::ResizeImageCreator>());
+    factory.add_creator(newBox<post_processor::SaveCostHeatmapCreator>());
     factory.add_creator(newBox<post_processor::SaveGBufferCreator>());
     factory.add_creator(newBox<post_processor::SaveImgCreator>());
 }
@@ -71,6 +71,11 @@ namespace renderer
 
             bdpt_params.use_mis = params.child_int_or("use_mis", 1) != 0;
 
+            bdpt_params.use_light_vertex_cache =
+                params.child_int_or("use_light_vertex_cache", 0) != 0;
+            bdpt_params.lvc_connection_count =
+                params.child_int_or("lvc_connection_count", 0);
+
             return create_vol_bdpt_renderer(bdpt_params);
         }
     };
@@ -136,6 +141,8 @@ namespace renderer
 
             const int specular_depth = params.child_int_or("specular_depth", 20);
 
+            const bool use_guiding = params.child_int_or("use_guiding", 0) != 0;
+
             PTRendererParams pt_params;
             pt_params.worker_count      = worker_count;
             pt_params.task_grid_size    = task_grid_size;
@@ -145,11 +152,121 @@ namespace renderer
             pt_params.cont_prob         = cont_prob;
             pt_params.use_mis           = use_mis;
             pt_params.specular_depth    = specular_depth;
+            pt_params.use_guiding       = use_guiding;
+
+            if(use_guiding)
+            {
+                pt_params.guiding_training_iterations =
+                    params.child_int_or("guiding_training_iterations", 5);
+                pt_params.guiding_training_budget =
+                    params.child_real_or("guiding_training_budget", real(0.25));
+                pt_params.guiding_bsdf_fraction =
+                    params.child_real_or("guiding_bsdf_fraction", real(0.5));
+                pt_params.guiding_spatial_threshold =
+                    params.child_real_or("guiding_spatial_threshold", 12000);
+                pt_params.guiding_directional_threshold =
+                    params.child_real_or("guiding_directional_threshold", real(0.01));
+
+                if(pt_params.guiding_training_iterations < 0)
+                {
+                    throw CreatingObjectException(
+                        "invalid guiding training iteration count: " +
+                        std::to_string(pt_params.guiding_training_iterations));
+                }
+
+                if(pt_params.guiding_training_budget <= 0)
+                {
+                    throw CreatingObjectException(
+                        "invalid guiding training budget: " +
+                        std::to_string(pt_params.guiding_training_budget));
+                }
+
+                if(pt_params.guiding_bsdf_fraction <= 0 ||
+                   pt_params.guiding_bsdf_fraction >= 1)
+                {
+                    throw CreatingObjectException(
+                        "invalid guiding bsdf fraction: " +
+                        std::to_string(pt_params.guiding_bsdf_fraction));
+                }
+            }
 
             return create_pt_renderer(pt_params);
         }
     };
 
+    class IrradianceCacheRendererCreator : public Creator<Renderer>
+    {
+    public:
+
+        std::string name() const override
+        {
+            return "ic";
+        }
+
+        RC<Renderer> create(
+            const ConfigGroup &params, CreatingContext &context) const override
+        {
+            IrradianceCacheRendererParams p;
+
+            p.worker_count       =
+                params.child_int_or("worker_count", p.worker_count);
+            p.task_grid_size     =
+                params.child_int_or("task_grid_size", p.task_grid_size);
+            p.spp                =
+                params.child_int_or("spp", p.spp);
+            p.forward_max_depth  =
+                params.child_int_or("forward_max_depth", p.forward_max_depth);
+            p.gather_theta_count =
+                params.child_int_or("gather_theta_count", p.gather_theta_count);
+            p.gather_phi_count   =
+                params.child_int_or("gather_phi_count", p.gather_phi_count);
+            p.gather_min_depth   =
+                params.child_int_or("gather_min_depth", p.gather_min_depth);
+            p.gather_max_depth   =
+                params.child_int_or("gather_max_depth", p.gather_max_depth);
+            p.gather_cont_prob   =
+                params.child_real_or("gather_cont_prob", p.gather_cont_prob);
+            p.accuracy           =
+                params.child_real_or("accuracy", p.accuracy);
+            p.min_radius         =
+                params.child_real_or("min_radius", p.min_radius);
+            p.max_radius         =
+                params.child_real_or("max_radius", p.max_radius);
+            p.use_gradients      =
+                params.child_int_or("use_gradients", p.use_gradients ? 1 : 0) != 0;
+            p.prepass_stride     =
+                params.child_int_or("prepass_stride", p.prepass_stride);
+
+            if(auto node = params.find_child_value("cache_filename"))
+                p.cache_filename = context.path_mapper->map(node->as_str());
+
+            if(p.gather_theta_count < 1 || p.gather_phi_count < 1)
+            {
+                throw CreatingObjectException(
+                    "invalid gathering strata: " +
+                    std::to_string(p.gather_theta_count) + " x " +
+                    std::to_string(p.gather_phi_count));
+            }
+
+            if(p.accuracy <= 0)
+            {
+                throw CreatingObjectException(
+                    "invalid irradiance cache accuracy: " +
+                    std::to_string(p.accuracy));
+            }
+
+            if(p.min_radius <= 0 || p.max_radius < p.min_radius)
+            {
+                throw CreatingObjectException(
+                    "invalid irradiance cache radius range: [" +
+                    std::to_string(p.min_radius) + ", " +
+                    std::to_string(p.max_radius) + "]");
+            }
+
+            return create_irradiance_cache_renderer(p);
+        }
+    };
+
     class PSSMLTPTCreator : public Creator<Renderer>
     {
     public:
@@ -189,6 +306,59 @@ namespace renderer
         }
     };
 
+    class MMLTCreator : public Creator<Renderer>
+    {
+    public:
+
+        std::string name() const override
+        {
+            return "mmlt";
+        }
+
+        std::shared_ptr<Renderer> create(
+            const ConfigGroup &params, CreatingContext &context) const override
+        {
+            MMLTRendererParams p;
+
+            p.worker_count         =
+                params.child_int_or("worker_count", p.worker_count);
+            p.max_depth            =
+                params.child_int_or("max_depth", p.max_depth);
+            p.startup_sample_count =
+                params.child_int_or("startup_sample_count", p.startup_sample_count);
+            p.mut_per_pixel        =
+                params.child_int_or("mut_per_pixel", p.mut_per_pixel);
+            p.sigma                =
+                params.child_real_or("sigma", p.sigma);
+            p.large_step_prob      =
+                params.child_real_or("large_step_prob", p.large_step_prob);
+            p.chain_count          =
+                params.child_int_or("chain_count", p.chain_count);
+
+            if(p.max_depth < 1)
+            {
+                throw CreatingObjectException(
+                    "invalid mmlt max depth: " + std::to_string(p.max_depth));
+            }
+
+            if(p.startup_sample_count < 1)
+            {
+                throw CreatingObjectException(
+                    "invalid mmlt startup sample count: " +
+                    std::to_string(p.startup_sample_count));
+            }
+
+            if(p.chain_count < 1)
+            {
+                throw CreatingObjectException(
+                    "invalid mmlt chain count: " +
+                    std::to_string(p.chain_count));
+            }
+
+            return create_mmlt_renderer(p);
+        }
+    };
+
     class SPPMRendererCreator : public Creator<Renderer>
     {
     public:
@@ -239,6 +409,8 @@ void initialize_renderer_factory(Factory<Renderer> &factory)
     factory.add_creator(newBox<renderer::AORendererCreator>());
     factory.add_creator(newBox<renderer::ParticleTracingRendererCreator>());
     factory.add_creator(newBox<renderer::PathTracingRendererCreator>());
+    factory.add_creator(newBox<renderer::IrradianceCacheRendererCreator>());
+    factory.add_creator(newBox<renderer::MMLTCreator>());
     factory.add_creator(newBox<renderer::PSSMLTPTCreator>());
     factory.add_creator(newBox<renderer::SPPMRendererCreator>());
     factory.add_creator(newBox<renderer::VolBDPTRendererCreator>());
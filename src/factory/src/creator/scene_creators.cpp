@@ -61,6 +61,12 @@ namespace scene
                 const_entities.push_back(ent);
             scene_params.aggregate->build(const_entities);
 
+            context.resource_cache.log_stats();
+
+            // scene objects own what they need from decoded resources. raw
+            // meshes and images would otherwise stay alive during rendering
+            context.resource_cache.clear();
+
             return create_default_scene(scene_params);
         }
     };
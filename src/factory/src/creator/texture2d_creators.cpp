@@ -1,5 +1,8 @@
+#include <filesystem>
+
 #include <agz/factory/creator/texture2d_creators.h>
 #include <agz/tracer/create/texture2d.h>
+#include <agz/tracer/utility/logger.h>
 #include <agz/utility/image.h>
 
 AGZ_TRACER_FACTORY_BEGIN
@@ -24,6 +27,99 @@ namespace texture
         
         return ret;
     }
+
+    /**
+     * @brief open the tiled version of an image texture
+     *
+     * the tiled file is (re)generated from filename when it doesn't exist,
+     * is older than the source image, or is built with another inv_gamma.
+     * opened files are shared through the resource cache of context
+     *
+     * load_image interface: RC<const Image2D<Texel>> load_image()
+     */
+    template<typename LoadImageFunc>
+    RC<const TiledImageFile> load_tiled_file(
+        const std::string &filename, real inv_gamma, const ConfigGroup &params,
+        CreatingContext &context, const LoadImageFunc &load_image)
+    {
+        namespace fs = std::filesystem;
+
+        // files built with different inv_gamma have different mip chains
+
+        const std::string default_tiled_filename = inv_gamma == 1 ?
+            filename + ".tiled" :
+            filename + ".g" + std::to_string(inv_gamma) + ".tiled";
+
+        const auto tiled_filename = params.find_child("tiled_filename") ?
+            context.path_mapper->map(params.child_str("tiled_filename")) :
+            default_tiled_filename;
+        const int tile_size = params.child_int_or("tile_size", 64);
+
+        const std::string key = ResourceCache::canonical_path(tiled_filename)
+                              + "?tile_size=" + std::to_string(tile_size)
+                              + "&inv_gamma=" + std::to_string(inv_gamma);
+
+        return context.resource_cache.get<TiledImageFile>(key, [&]
+        {
+            const bool need_convert =
+                !fs::exists(tiled_filename) ||
+                (fs::exists(filename) &&
+                 fs::last_write_time(filename) > fs::last_write_time(tiled_filename));
+
+            // source image is released once converted
+
+            auto convert = [&]
+            {
+                AGZ_INFO("converting {} to tiled texture {}",
+                         filename, tiled_filename);
+                write_tiled_texture(
+                    tiled_filename, tile_size, load_image(), inv_gamma);
+            };
+
+            if(need_convert)
+                convert();
+
+            // files of an older layout can't be opened and are regenerated
+
+            RC<TiledImageFile> ret;
+            try
+            {
+                ret = newRC<TiledImageFile>(tiled_filename);
+            }
+            catch(const ObjectConstructionException &)
+            {
+                if(need_convert)
+                    throw;
+            }
+
+            if(!ret || std::abs(ret->inv_gamma() - inv_gamma) > real(1e-5))
+            {
+                ret.reset();
+                convert();
+                ret = newRC<TiledImageFile>(tiled_filename);
+            }
+
+            return ret;
+        });
+    }
+
+    RC<const Image2D<math::color3f>> load_hdr_image(const std::string &filename)
+    {
+        auto raw_data = img::load_rgb_from_hdr_file(filename);
+        if(!raw_data.is_available())
+            throw ObjectConstructionException(
+                "failed to load texture from " + filename);
+        return newRC<Image2D<math::color3f>>(std::move(raw_data));
+    }
+
+    RC<const Image2D<math::color3b>> load_ldr_image(const std::string &filename)
+    {
+        auto raw_data = img::load_rgb_from_file(filename);
+        if(!raw_data.is_available())
+            throw ObjectConstructionException(
+                "failed to load texture from " + filename);
+        return newRC<Image2D<math::color3b>>(std::move(raw_data));
+    }
     
     class CheckerBoardCreator : public Creator<Texture2D>
     {
@@ -66,9 +162,6 @@ namespace texture
 
     class HDRCreator : public Creator<Texture2D>
     {
-        mutable std::map<std::string, RC<const Image2D<math::color3f>>>
-            filename2data_;
-
     public:
 
         std::string name() const override
@@ -85,30 +178,28 @@ namespace texture
             const auto sample =
                 params.child_str_or("sample", "linear");
 
-            RC<const Image2D<math::color3f>> data;
-            if(auto it = filename2data_.find(filename);
-               it != filename2data_.end())
-                data = it->second;
-            else
+            if(params.child_int_or("tiled", 0))
             {
-                const auto raw_data = img::load_rgb_from_hdr_file(filename);
-                if(!raw_data.is_available())
-                    throw ObjectConstructionException(
-                        "failed to load texture from " + filename);
-
-                data = newRC<Image2D<math::color3f>>(std::move(raw_data));
-                filename2data_[filename] = data;
+                auto file = load_tiled_file(
+                    filename, common_params.inv_gamma, params, context, [&]
+                {
+                    return load_hdr_image(filename);
+                });
+                return create_tiled_texture(
+                    common_params, std::move(file), sample);
             }
 
+            auto data = context.resource_cache.get<Image2D<math::color3f>>(
+                ResourceCache::canonical_path(filename) + "?format=rgb32f", [&]
+            {
+                return load_hdr_image(filename);
+            });
             return create_hdr_texture(common_params, std::move(data), sample);
         }
     };
 
     class ImageCreator : public Creator<Texture2D>
     {
-        mutable std::map<std::string, RC<const Image2D<math::color3b>>>
-            filename2data_;
-
     public:
 
         std::string name() const override
@@ -125,21 +216,22 @@ namespace texture
             const auto sample =
                 params.child_str_or("sample", "linear");
 
-            RC<const Image2D<math::color3b>> data;
-            if(auto it = filename2data_.find(filename);
-               it != filename2data_.end())
-                data = it->second;
-            else
+            if(params.child_int_or("tiled", 0))
             {
-                const auto raw_data = img::load_rgb_from_file(filename);
-                if(!raw_data.is_available())
-                    throw ObjectConstructionException(
-                        "failed to load texture from " + filename);
-
-                data = newRC<Image2D<math::color3b>>(std::move(raw_data));
-                filename2data_[filename] = data;
+                auto file = load_tiled_file(
+                    filename, common_params.inv_gamma, params, context, [&]
+                {
+                    return load_ldr_image(filename);
+                });
+                return create_tiled_texture(
+                    common_params, std::move(file), sample);
             }
 
+            auto data = context.resource_cache.get<Image2D<math::color3b>>(
+                ResourceCache::canonical_path(filename) + "?format=rgb8", [&]
+            {
+                return load_ldr_image(filename);
+            });
             return create_image_texture(common_params, std::move(data), sample);
         }
     };
@@ -3,6 +3,7 @@
 #include <agz/factory/creator/texture3d_creators.h>
 #include <agz/factory/utility/texture3d_loader.h>
 #include <agz/tracer/create/texture3d.h>
+#include <agz/tracer/utility/logger.h>
 
 AGZ_TRACER_FACTORY_BEGIN
 
@@ -206,12 +207,70 @@ namespace
         }
     };
 
+    class SparseTexture3DCreator : public Creator<Texture3D>
+    {
+    public:
+
+        std::string name() const override
+        {
+            return "sparse3d";
+        }
+
+        std::shared_ptr<Texture3D> create(
+            const ConfigGroup &params, CreatingContext &context) const override
+        {
+            const Texture3DCommonParams common_params = parse_common_params(params);
+            const std::string sampling_strategy = params.child_str_or(
+                "sampler", "linear");
+            const bool use_linear_sampler = sampling_strategy == "linear";
+
+            auto data = newRC<BrickVolume>();
+
+            if(params.find_child("ascii_filename"))
+            {
+                const std::string filename = context.path_mapper->map(
+                    params.child_str("ascii_filename"));
+                std::ifstream fin(filename, std::ios::in);
+                if(!fin)
+                {
+                    throw ObjectConstructionException(
+                        "failed to open file: " + filename);
+                }
+
+                data->build(texture3d_load::load_real_from_ascii(fin));
+            }
+            else if(params.find_child("binary_filename"))
+            {
+                const std::string filename = context.path_mapper->map(
+                    params.child_str("binary_filename"));
+                std::ifstream fin(filename, std::ios::in | std::ios::binary);
+                if(!fin)
+                {
+                    throw ObjectConstructionException(
+                        "failed to open file: " + filename);
+                }
+
+                *data = texture3d_load::load_bricks_from_binary(fin);
+            }
+            else
+                throw ObjectConstructionException("input filename is unspecified");
+
+            AGZ_INFO("sparse3d: {} / {} bricks allocated",
+                     data->allocated_brick_count(),
+                     data->brick_count().product());
+
+            return create_sparse3d(
+                common_params, std::move(data), use_linear_sampler);
+        }
+    };
+
 }
 
 void initialize_texture3d_factory(Factory<Texture3D> &factory)
 {
     factory.add_creator(newBox<Constant3DCreator>());
     factory.add_creator(newBox<ImageTexture3DCreator>());
+    factory.add_creator(newBox<SparseTexture3DCreator>());
 }
 
 AGZ_TRACER_FACTORY_END
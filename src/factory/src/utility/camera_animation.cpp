@@ -0,0 +1,166 @@
+#include <algorithm>
+
+#include <agz/factory/utility/camera_animation.h>
+#include <agz/tracer/create/camera.h>
+
+AGZ_TRACER_BEGIN
+
+namespace
+{
+    template<typename T>
+    T hermite(
+        const T &p0, const T &m0, const T &p1, const T &m1, real h, real s)
+    {
+        const real s2 = s * s;
+        const real s3 = s2 * s;
+        return (2 * s3 - 3 * s2 + 1) * p0
+             + (s3 - 2 * s2 + s) * h * m0
+             + (-2 * s3 + 3 * s2) * p1
+             + (s3 - s2) * h * m1;
+    }
+}
+
+CameraAnimation::CameraAnimation(
+    std::vector<CameraKeyframe> keyframes, Interpolation interpolation)
+    : keyframes_(std::move(keyframes)), interpolation_(interpolation)
+{
+    assert(!keyframes_.empty());
+}
+
+CameraKeyframe CameraAnimation::interpolate(real frame) const
+{
+    if(frame <= keyframes_.front().frame)
+        return keyframes_.front();
+    if(frame >= keyframes_.back().frame)
+        return keyframes_.back();
+
+    const auto it = std::upper_bound(
+        keyframes_.begin(), keyframes_.end(), frame,
+        [](real f, const CameraKeyframe &k) { return f < k.frame; });
+    const size_t i1 = size_t(it - keyframes_.begin());
+    const size_t i0 = i1 - 1;
+
+    const CameraKeyframe &k0 = keyframes_[i0];
+    const CameraKeyframe &k1 = keyframes_[i1];
+    const real h = real(k1.frame - k0.frame);
+    const real s = (frame - k0.frame) / h;
+
+    // tangent at the i-th keyframe. one-sided at the first and the last one
+    auto tangent = [&](auto CameraKeyframe::*member, size_t i)
+    {
+        const size_t prev = i > 0 ? i - 1 : i;
+        const size_t next = i + 1 < keyframes_.size() ? i + 1 : i;
+        const real dt = real(keyframes_[next].frame - keyframes_[prev].frame);
+        return (keyframes_[next].*member - keyframes_[prev].*member) / dt;
+    };
+
+    auto interp = [&](auto CameraKeyframe::*member)
+    {
+        if(interpolation_ == Interpolation::Linear)
+            return math::lerp(k0.*member, k1.*member, s);
+        return hermite(
+            k0.*member, tangent(member, i0),
+            k1.*member, tangent(member, i1), h, s);
+    };
+
+    CameraKeyframe ret;
+    ret.frame          = static_cast<int>(frame);
+    ret.pos            = interp(&CameraKeyframe::pos);
+    ret.dst            = interp(&CameraKeyframe::dst);
+    ret.up             = interp(&CameraKeyframe::up);
+    ret.fov            = interp(&CameraKeyframe::fov);
+    ret.lens_radius    = interp(&CameraKeyframe::lens_radius);
+    ret.focal_distance = interp(&CameraKeyframe::focal_distance);
+
+    // cubic interpolation may overshoot
+
+    constexpr real EPS = real(1e-4);
+    ret.fov            = math::clamp(ret.fov, EPS, PI_r - EPS);
+    ret.lens_radius    = (std::max)(ret.lens_radius, real(0));
+    ret.focal_distance = (std::max)(ret.focal_distance, EPS);
+
+    return ret;
+}
+
+RC<Camera> CameraAnimation::create_camera(real frame, real film_aspect) const
+{
+    const CameraKeyframe k = interpolate(frame);
+    return create_thin_lens_camera(
+        film_aspect, k.pos, k.dst, k.up, k.fov, k.lens_radius, k.focal_distance);
+}
+
+int CameraAnimation::first_frame() const noexcept
+{
+    return keyframes_.front().frame;
+}
+
+int CameraAnimation::last_frame() const noexcept
+{
+    return keyframes_.back().frame;
+}
+
+CameraAnimation parse_camera_animation(const ConfigGroup &params)
+{
+    CameraAnimation::Interpolation interpolation;
+    const std::string interpolation_name =
+        params.child_str_or("interpolation", "catmull_rom");
+    if(interpolation_name == "linear")
+        interpolation = CameraAnimation::Interpolation::Linear;
+    else if(interpolation_name == "catmull_rom")
+        interpolation = CameraAnimation::Interpolation::CatmullRom;
+    else
+    {
+        throw ObjectConstructionException(
+            "unknown camera interpolation: " + interpolation_name);
+    }
+
+    const auto &arr = params.child_array("keyframes");
+    if(!arr.size())
+        throw ObjectConstructionException("empty camera keyframes");
+
+    std::vector<CameraKeyframe> keyframes;
+    keyframes.reserve(arr.size());
+
+    for(size_t i = 0; i < arr.size(); ++i)
+    {
+        const auto &group = arr.at_group(i);
+
+        CameraKeyframe keyframe;
+        if(!keyframes.empty())
+            keyframe = keyframes.back();
+
+        keyframe.frame = group.child_int("frame");
+        if(!keyframes.empty() && keyframe.frame <= keyframes.back().frame)
+        {
+            throw ObjectConstructionException(
+                "camera keyframes must be sorted by frame without duplicates");
+        }
+
+        if(keyframes.empty())
+        {
+            keyframe.pos = group.child_vec3("pos");
+            keyframe.dst = group.child_vec3("dst");
+            keyframe.up  = group.child_vec3("up");
+            keyframe.fov = math::deg2rad(group.child_real("fov"));
+        }
+        else
+        {
+            keyframe.pos = group.child_vec3_or("pos", keyframe.pos);
+            keyframe.dst = group.child_vec3_or("dst", keyframe.dst);
+            keyframe.up  = group.child_vec3_or("up", keyframe.up);
+            if(auto node = group.find_child_value("fov"))
+                keyframe.fov = math::deg2rad(node->as_real());
+        }
+
+        keyframe.lens_radius = group.child_real_or(
+            "lens_radius", keyframe.lens_radius);
+        keyframe.focal_distance = group.child_real_or(
+            "focal_distance", keyframe.focal_distance);
+
+        keyframes.push_back(keyframe);
+    }
+
+    return CameraAnimation(std::move(keyframes), interpolation);
+}
+
+AGZ_TRACER_END
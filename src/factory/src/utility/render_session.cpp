@@ -1,9 +1,19 @@
+#include <algorithm>
+#include <fstream>
+#include <future>
+
+#include <json.hpp>
+
 #include <agz/factory/utility/render_session.h>
 #include <agz/tracer/core/post_processor.h>
+#include <agz/tracer/core/renderer_interactor.h>
 #include <agz/tracer/core/scene.h>
 #include <agz/factory/factory.h>
 #include <agz/tracer/create/film_filter.h>
 #include <agz/tracer/utility/logger.h>
+#include <agz/tracer/utility/render_stats.h>
+#include <agz/tracer/utility/tile_cache.h>
+#include <agz/tracer/utility/trace.h>
 
 #include <agz/utility/string.h>
 
@@ -11,6 +21,90 @@ AGZ_TRACER_BEGIN
 
 namespace
 {
+    /**
+     * @brief replace ${frame} with zero-padded frame index before mapping
+     */
+    class FramePathMapper : public factory::PathMapper
+    {
+        const factory::PathMapper *base_;
+        std::string frame_;
+
+    public:
+
+        FramePathMapper(const factory::PathMapper *base, int frame)
+            : base_(base), frame_(std::to_string(frame))
+        {
+            if(frame_.size() < 4)
+                frame_.insert(0, 4 - frame_.size(), '0');
+        }
+
+        std::string map(const std::string &path) const override
+        {
+            std::string ret(path);
+            stdstr::replace_(ret, "${frame}", frame_);
+            return base_->map(ret);
+        }
+    };
+
+    std::vector<RC<PostProcessor>> create_post_processors(
+        const ConfigGroup &rendering_config, factory::CreatingContext &context)
+    {
+        std::vector<RC<PostProcessor>> ret;
+
+        if(auto node = rendering_config.find_child("post_processors"))
+        {
+            AGZ_INFO("creating post processors");
+            const auto &arr = node->as_array();
+
+            ret.reserve(arr.size());
+            for(size_t i = 0; i != arr.size(); ++i)
+            {
+                const auto &group = arr.at(i).as_group();
+                if(stdstr::ends_with(group.child_str("type"), "//"))
+                    continue;
+                ret.push_back(context.create<PostProcessor>(group));
+            }
+        }
+        else
+            AGZ_INFO("no post processor");
+
+        return ret;
+    }
+
+    Box<RenderSession::Animation> parse_animation(
+        const Config &rendering_config, const ConfigGroup &animation_config,
+        factory::CreatingContext &context)
+    {
+        auto animation = newBox<RenderSession::Animation>();
+        animation->camera = parse_camera_animation(animation_config);
+
+        animation->begin_frame = animation_config.child_int_or(
+            "begin_frame", animation->camera.first_frame());
+        animation->end_frame = animation_config.child_int_or(
+            "end_frame", animation->camera.last_frame() + 1);
+        if(animation->begin_frame >= animation->end_frame)
+        {
+            throw ObjectConstructionException(
+                "empty animation frame range: [" +
+                std::to_string(animation->begin_frame) + ", " +
+                std::to_string(animation->end_frame) + ")");
+        }
+
+        animation->create_post_processors =
+            [rendering_config, &context](int frame)
+        {
+            const FramePathMapper path_mapper(context.path_mapper, frame);
+
+            const factory::PathMapper *old_path_mapper = context.path_mapper;
+            context.path_mapper = &path_mapper;
+            AGZ_SCOPE_GUARD({ context.path_mapper = old_path_mapper; });
+
+            return create_post_processors(rendering_config, context);
+        };
+
+        return animation;
+    }
+
     Box<RenderSession::RenderSetting> parse_rendering_settings(
         Config rendering_config, factory::CreatingContext &context)
     {
@@ -28,42 +122,93 @@ namespace
             settings->film_filter = create_box_filter(real(0.5));
         AGZ_INFO("resolution: ({}, {})", film_width, film_height);
 
-        AGZ_INFO("creating camera");
-        const auto &camera_params = rendering_config.child_group("camera");
-        settings->camera = context.create<Camera>(
-            camera_params, static_cast<real>(film_width) / film_height);
+        const real film_aspect = static_cast<real>(film_width) / film_height;
+        if(auto group = rendering_config.find_child_group("animation"))
+        {
+            AGZ_INFO("creating camera animation");
+            settings->animation = parse_animation(
+                rendering_config, *group, context);
+            settings->camera = settings->animation->camera.create_camera(
+                real(settings->animation->begin_frame), film_aspect);
+            AGZ_INFO("animation frames: [{}, {})",
+                     settings->animation->begin_frame,
+                     settings->animation->end_frame);
+        }
+        else
+        {
+            AGZ_INFO("creating camera");
+            const auto &camera_params = rendering_config.child_group("camera");
+            settings->camera = context.create<Camera>(camera_params, film_aspect);
+        }
 
         AGZ_INFO("creating renderer");
         const auto &renderer_params = rendering_config.child_group("renderer");
         settings->renderer = context.create<Renderer>(renderer_params);
 
+        settings->record_pixel_cost =
+            rendering_config.child_int_or("record_pixel_cost", 0) != 0;
+        settings->renderer->set_pixel_cost_recording(
+            settings->record_pixel_cost);
+
         AGZ_INFO("creating progress reporter");
         const auto &reporter_params = rendering_config.child_group("reporter");
         settings->reporter = context.create<RendererInteractor>(reporter_params);
 
-        if(auto node = rendering_config.find_child("post_processors"))
+        if(!settings->animation)
         {
-            AGZ_INFO("creating post processors");
-            const auto &arr = node->as_array();
-
-            settings->post_processors.reserve(arr.size());
-            for(size_t i = 0; i != arr.size(); ++i)
-            {
-                const auto &group = arr.at(i).as_group();
-                if(stdstr::ends_with(group.child_str("type"), "//"))
-                    continue;
-                const auto elem = context.create<PostProcessor>(group);
-                settings->post_processors.push_back(elem);
-            }
+            settings->post_processors =
+                create_post_processors(rendering_config, context);
         }
-        else
-            AGZ_INFO("no post processor");
 
         if(auto node = rendering_config.find_child_value("eps"))
             settings->eps = node->as_real();
 
+        if(auto node = rendering_config.find_child_value("stats_filename"))
+        {
+            settings->stats_filename = context.path_mapper->map(
+                node->as_str());
+        }
+
+        if(auto group = rendering_config.find_child_group("checkpoint"))
+        {
+            settings->checkpoint.filename = context.path_mapper->map(
+                group->child_str("filename"));
+            settings->checkpoint.interval = group->child_real_or(
+                "interval", settings->checkpoint.interval);
+            if(settings->checkpoint.interval < 0)
+            {
+                throw ObjectConstructionException(
+                    "invalid checkpoint interval: " +
+                    std::to_string(settings->checkpoint.interval));
+            }
+        }
+
         return settings;
     }
+
+    nlohmann::json render_stats_to_json(const RenderStats &stats)
+    {
+        auto counters_to_json = [](const render_stats::CounterValues &values)
+        {
+            nlohmann::json ret;
+            for(int i = 0; i < render_stats::CounterCount; ++i)
+            {
+                const auto counter = static_cast<render_stats::Counter>(i);
+                ret[render_stats::counter_name(counter)] = values[i];
+            }
+            return ret;
+        };
+
+        nlohmann::json ret;
+        ret["total"] = counters_to_json(stats.total);
+
+        auto per_thread = nlohmann::json::array();
+        for(auto &values : stats.per_thread)
+            per_thread.push_back(counters_to_json(values));
+        ret["per_thread"] = std::move(per_thread);
+
+        return ret;
+    }
 }
 
 RenderSession::RenderSession(
@@ -75,24 +220,234 @@ RenderSession::RenderSession(
 
 void RenderSession::execute()
 {
+    if(render_settings->animation)
+    {
+        execute_animation();
+        return;
+    }
+
     AGZ_INFO("start rendering");
 
+    render_settings->renderer->set_checkpoint(render_settings->checkpoint);
+    FilmFilterApplier filter_applier = start_rendering();
+
+    trace::ScopedEvent render_event("render", "render");
+    RenderTarget render_target = render_settings->renderer->render(
+        filter_applier, *scene, *render_settings->reporter);
+    render_event.end();
+
+    report_rendering_stats();
+
+    run_post_processors(render_settings->post_processors, render_target);
+}
+
+void RenderSession::execute_partial(
+    const FilmPartition &partition, const std::string &partial_filename)
+{
+    if(render_settings->animation)
+    {
+        throw ObjectConstructionException(
+            "partial rendering of animations is not supported");
+    }
+
+    AGZ_INFO("start rendering partition {} of {}",
+             partition.index, partition.count);
+
+    // processes rendering different partitions may share the same config
+
+    CheckpointParams checkpoint = render_settings->checkpoint;
+    if(checkpoint.is_enabled())
+        checkpoint.filename += "." + std::to_string(partition.index);
+    render_settings->renderer->set_checkpoint(std::move(checkpoint));
+
+    FilmFilterApplier filter_applier = start_rendering();
+
+    trace::ScopedEvent render_event("render", "render partial");
+    const PartialFilm film = render_settings->renderer->render_partial(
+        filter_applier, *scene, *render_settings->reporter, partition);
+    render_event.end();
+
+    report_rendering_stats();
+
+    AGZ_INFO("saving partial film to {}", partial_filename);
+    film.save(partial_filename);
+}
+
+void RenderSession::merge_partial_films(
+    const std::vector<std::string> &partial_filenames)
+{
+    if(partial_filenames.empty())
+        throw ObjectConstructionException("no partial film to merge");
+
+    if(render_settings->animation)
+    {
+        throw ObjectConstructionException(
+            "merging partial films of animations is not supported");
+    }
+
+    PartialFilm film;
+    std::vector<bool> merged_partitions;
+
+    for(auto &filename : partial_filenames)
+    {
+        AGZ_INFO("loading partial film {}", filename);
+        PartialFilm partial = PartialFilm::load(
+            filename, render_settings->width, render_settings->height);
+
+        const FilmPartition &partition = partial.partition;
+        if(merged_partitions.empty())
+            merged_partitions.resize(partition.count, false);
+        else if(int(merged_partitions.size()) != partition.count)
+        {
+            throw ObjectConstructionException(
+                "unmatched partition count in " + filename);
+        }
+
+        if(merged_partitions[partition.index])
+        {
+            throw ObjectConstructionException(
+                "partition " + std::to_string(partition.index) +
+                " is merged more than once");
+        }
+        merged_partitions[partition.index] = true;
+
+        if(film.image_buffer.value.is_available())
+            film.merge(partial);
+        else
+            film = std::move(partial);
+    }
+
+    const auto merged_count = std::count(
+        merged_partitions.begin(), merged_partitions.end(), true);
+    AGZ_INFO("merged {} of {} partitions",
+             merged_count, merged_partitions.size());
+
+    RenderTarget render_target = film.to_render_target();
+    run_post_processors(render_settings->post_processors, render_target);
+}
+
+FilmFilterApplier RenderSession::start_rendering()
+{
     set_eps(render_settings->eps);
 
     scene->set_camera(render_settings->camera);
     scene->start_rendering();
 
-    FilmFilterApplier filter_applier(
+    TileCache::instance().reset_stats();
+    render_stats::reset();
+
+    return FilmFilterApplier(
         render_settings->width, render_settings->height,
         render_settings->film_filter);
+}
 
-    RenderTarget render_target = render_settings->renderer->render(
-        filter_applier, *scene, *render_settings->reporter);
+void RenderSession::execute_animation()
+{
+    const Animation &animation = *render_settings->animation;
+    AGZ_INFO("start rendering frames [{}, {})",
+             animation.begin_frame, animation.end_frame);
+
+    // envir light preprocessing and light sampler construction don't
+    // depend on the camera, so the scene is prepared only once
+
+    FilmFilterApplier filter_applier = start_rendering();
+
+    const real film_aspect =
+        static_cast<real>(render_settings->width) / render_settings->height;
+
+    // post processors of the previous frame
+    std::future<void> pending_output;
+
+    for(int frame = animation.begin_frame; frame < animation.end_frame; ++frame)
+    {
+        AGZ_INFO("rendering frame {}", frame);
+
+        scene->set_camera(animation.camera.create_camera(
+            real(frame), film_aspect));
+
+        CheckpointParams checkpoint = render_settings->checkpoint;
+        if(checkpoint.is_enabled())
+            checkpoint.filename += "." + std::to_string(frame);
+        render_settings->renderer->set_checkpoint(std::move(checkpoint));
+
+        TileCache::instance().reset_stats();
+        render_stats::reset();
+
+        trace::ScopedEvent render_event(
+            "render", "render frame " + std::to_string(frame));
+        RenderTarget render_target = render_settings->renderer->render(
+            filter_applier, *scene, *render_settings->reporter);
+        render_event.end();
+
+        report_rendering_stats();
+
+        // creators are not thread-safe, so post processors are created here
+
+        auto post_processors = animation.create_post_processors(frame);
+
+        if(pending_output.valid())
+            pending_output.get();
+
+        pending_output = std::async(std::launch::async,
+            [post_processors = std::move(post_processors),
+             render_target   = std::move(render_target),
+             frame]() mutable
+        {
+            AGZ_INFO("writing frame {}", frame);
+            run_post_processors(post_processors, render_target);
+        });
+    }
+
+    if(pending_output.valid())
+        pending_output.get();
+}
+
+void RenderSession::report_rendering_stats()
+{
+    const RenderStats stats = render_stats::collect();
+
+    const auto tile_stats = TileCache::instance().stats();
+    if(const uint64_t lookups = tile_stats.hits + tile_stats.misses)
+    {
+        AGZ_INFO("tile cache: hit rate {:.2f}% ({} hits, {} misses, {} evictions)",
+                 100.0 * tile_stats.hits / lookups,
+                 tile_stats.hits, tile_stats.misses, tile_stats.evictions);
+        AGZ_INFO("tile cache: {} MB resident, {} MB budget",
+                 tile_stats.resident_bytes >> 20, tile_stats.budget_bytes >> 20);
+    }
+
+    if(stats.enabled)
+    {
+        render_settings->reporter->stats(stats);
+
+        const auto stats_json = render_stats_to_json(stats).dump(4);
+        if(render_settings->stats_filename.empty())
+            AGZ_INFO("rendering statistics: {}", stats_json);
+        else
+        {
+            AGZ_INFO("writing rendering statistics to {}",
+                     render_settings->stats_filename);
+            std::ofstream fout(
+                render_settings->stats_filename, std::ofstream::trunc);
+            if(!fout)
+                AGZ_ERROR("failed to open {}", render_settings->stats_filename);
+            else
+                fout << stats_json << std::endl;
+        }
+    }
+}
 
+void RenderSession::run_post_processors(
+    const std::vector<RC<PostProcessor>> &post_processors,
+    RenderTarget &render_target)
+{
     AGZ_INFO("running post processors");
 
-    for(auto &p : render_settings->post_processors)
-        p->process(render_target);
+    for(size_t i = 0; i < post_processors.size(); ++i)
+    {
+        AGZ_TRACE_SCOPE("post process", "post processor " + std::to_string(i));
+        post_processors[i]->process(render_target);
+    }
 }
 
 RenderSession create_render_session(
@@ -0,0 +1,50 @@
+#include <filesystem>
+
+#include <agz/factory/utility/resource_cache.h>
+#include <agz/tracer/utility/logger.h>
+
+AGZ_TRACER_FACTORY_BEGIN
+
+std::string ResourceCache::canonical_path(const std::string &filename)
+{
+    std::error_code err;
+    const auto ret = std::filesystem::weakly_canonical(filename, err);
+    if(err)
+        return absolute(std::filesystem::path(filename)).lexically_normal().string();
+    return ret.string();
+}
+
+void ResourceCache::add_derived_bytes(uint64_t bytes) noexcept
+{
+    bytes_derived_.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+ResourceCache::Stats ResourceCache::stats() const noexcept
+{
+    Stats ret;
+    ret.hits          = hits_         .load(std::memory_order_relaxed);
+    ret.misses        = misses_       .load(std::memory_order_relaxed);
+    ret.bytes_saved   = bytes_saved_  .load(std::memory_order_relaxed);
+    ret.bytes_loaded  = bytes_loaded_ .load(std::memory_order_relaxed);
+    ret.bytes_kept    = bytes_kept_   .load(std::memory_order_relaxed);
+    ret.bytes_derived = bytes_derived_.load(std::memory_order_relaxed);
+    return ret;
+}
+
+void ResourceCache::clear()
+{
+    std::lock_guard lk(mutex_);
+    key2entry_.clear();
+}
+
+void ResourceCache::log_stats() const
+{
+    const Stats s = stats();
+    AGZ_INFO("resource cache: {} hits (decodings avoided), {} misses, "
+             "{:.2f} MB loaded, {:.2f} MB shared instead of duplicated",
+             s.hits, s.misses,
+             s.bytes_loaded / (1024.0 * 1024.0),
+             s.bytes_saved  / (1024.0 * 1024.0));
+}
+
+AGZ_TRACER_FACTORY_END
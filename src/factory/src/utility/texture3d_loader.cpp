@@ -252,6 +252,64 @@ texture::texture3d_t<math::color3b> load_uint24_from_images(
     return data;
 }
 
+BrickVolume load_bricks_from_binary(std::ifstream &fin)
+{
+    int32_t width, height, depth;
+    fin.read(reinterpret_cast<char *>(&width), sizeof(width));
+    fin.read(reinterpret_cast<char *>(&height), sizeof(height));
+    fin.read(reinterpret_cast<char *>(&depth), sizeof(depth));
+    if(!fin)
+    {
+        throw ObjectConstructionException(
+            "failed to read width/height/depth from file");
+    }
+
+    BrickVolume ret;
+    ret.initialize(Vec3i(width, height, depth));
+
+    // slices [bz * 8, bz * 8 + 8] are needed by brick layer bz.
+    // the last slice is kept as the first one of the next layer
+
+    constexpr int LAYER_SLICE_COUNT = BrickVolume::BRICK_STORAGE_SIZE;
+    const size_t slice_size = static_cast<size_t>(width) * height;
+
+    std::vector<real> slices(slice_size * LAYER_SLICE_COUNT);
+
+    auto read_slice = [&](int local_z)
+    {
+        fin.read(
+            reinterpret_cast<char *>(&slices[local_z * slice_size]),
+            slice_size * sizeof(real));
+        if(!fin)
+            throw ObjectConstructionException("failed to read texel data");
+    };
+
+    int loaded_z = 0;
+    read_slice(0);
+
+    for(int bz = 0; bz < ret.brick_count().z; ++bz)
+    {
+        const int z_beg = bz * BrickVolume::BRICK_SIZE;
+        const int z_end = (std::min)(
+            z_beg + BrickVolume::BRICK_SIZE, depth - 1);
+
+        while(loaded_z < z_end)
+            read_slice(++loaded_z - z_beg);
+
+        ret.build_layer(bz, [&](int x, int y, int z)
+        {
+            return slices[(z - z_beg) * slice_size + y * width + x];
+        });
+
+        std::copy(
+            slices.begin() + (z_end - z_beg) * slice_size,
+            slices.begin() + (z_end - z_beg + 1) * slice_size,
+            slices.begin());
+    }
+
+    return ret;
+}
+
 void save_real_to_binary(
     const std::string &filename, const Vec3i &size, const float *data)
 {
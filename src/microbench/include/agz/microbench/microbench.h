@@ -0,0 +1,89 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <agz/tracer/tracer.h>
+
+/**
+ * @brief timed kernel function
+ *
+ * processes a batch of pre-generated inputs and returns the number of kernel
+ * invocations in the batch
+ */
+using KernelFunc = std::function<size_t()>;
+
+struct KernelBenchmark
+{
+    std::string name;
+
+    /**
+     * @brief generate inputs and scene objects of the kernel
+     *
+     * called once before timing. inputs must be generated with the given
+     * sampler, which is seeded by the benchmark name and the global seed
+     */
+    std::function<KernelFunc(agz::tracer::NativeSampler &)> prepare;
+};
+
+/**
+ * @brief prevent the compiler from discarding computation of value
+ */
+void escape(const void *p) noexcept;
+
+template<typename T>
+void do_not_optimize(const T &value) noexcept
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    escape(&value);
+#endif
+}
+
+struct HarnessParams
+{
+    // kernel is run repeatedly for this duration before timing
+    double warmup_seconds = 0.2;
+
+    // batches are repeated in each sample until it lasts this duration
+    double min_sample_seconds = 0.05;
+
+    int sample_count = 15;
+
+    int seed = 42;
+};
+
+/**
+ * @brief statistics of nanoseconds per kernel invocation
+ */
+struct KernelStats
+{
+    std::string name;
+
+    size_t invocations_per_batch = 0;
+    size_t batches_per_sample    = 0;
+    int sample_count             = 0;
+
+    double prepare_seconds = 0;
+
+    double min_ns    = 0;
+    double median_ns = 0;
+    double mean_ns   = 0;
+    double stddev_ns = 0;
+    double max_ns    = 0;
+};
+
+KernelStats run_kernel_benchmark(
+    const KernelBenchmark &benchmark, const HarnessParams &params);
+
+void add_geometry_kernels(std::vector<KernelBenchmark> &benchmarks);
+
+void add_bsdf_kernels(std::vector<KernelBenchmark> &benchmarks);
+
+void add_texture_kernels(std::vector<KernelBenchmark> &benchmarks);
+
+void add_medium_kernels(std::vector<KernelBenchmark> &benchmarks);
+
+void add_film_kernels(std::vector<KernelBenchmark> &benchmarks);
@@ -0,0 +1,175 @@
+#include <agz/microbench/microbench.h>
+
+using namespace agz::tracer;
+
+namespace
+{
+    constexpr int SHADING_POINT_COUNT = 1024;
+
+    RC<const Texture2D> constant(const FSpectrum &value)
+    {
+        return create_constant2d_texture({}, value);
+    }
+
+    RC<const Texture2D> constant(real value)
+    {
+        return create_constant2d_texture({}, value);
+    }
+
+    /**
+     * @brief shaded bsdfs with random frames and directions
+     */
+    struct BSDFInputs
+    {
+        RC<const Material> material;
+        Arena arena;
+
+        std::vector<const BSDF *> bsdfs;
+        std::vector<FVec3> wos;
+        std::vector<FVec3> wis;
+        std::vector<Sample3> sams;
+    };
+
+    RC<BSDFInputs> create_inputs(RC<const Material> material, Sampler &sampler)
+    {
+        auto ret = newRC<BSDFInputs>();
+        ret->material = std::move(material);
+
+        for(int i = 0; i < SHADING_POINT_COUNT; ++i)
+        {
+            const Sample2 nor_sam = sampler.sample2();
+            const FVec3 nor = agz::math::distribution::uniform_on_sphere(
+                nor_sam.u, nor_sam.v).first;
+            const FCoord coord = FCoord::from_z(nor);
+
+            // wo is on the same side as the normal. wi is on either side
+            const Sample2 wo_sam = sampler.sample2();
+            const FVec3 local_wo = agz::math::distribution::zweighted_on_hemisphere(
+                wo_sam.u, wo_sam.v).first;
+            const Sample2 wi_sam = sampler.sample2();
+            const FVec3 wi = agz::math::distribution::uniform_on_sphere(
+                wi_sam.u, wi_sam.v).first;
+
+            const Sample2 uv_sam = sampler.sample2();
+
+            EntityIntersection inct;
+            inct.pos            = FVec3(0);
+            inct.uv             = Vec2(uv_sam.u, uv_sam.v);
+            inct.geometry_coord = coord;
+            inct.user_coord     = coord;
+            inct.wr             = coord.local_to_global(local_wo);
+            inct.t              = 1;
+
+            const ShadingPoint shd = ret->material->shade(inct, ret->arena);
+
+            ret->bsdfs.push_back(shd.bsdf);
+            ret->wos.push_back(inct.wr);
+            ret->wis.push_back(wi);
+            ret->sams.push_back(sampler.sample3());
+        }
+
+        return ret;
+    }
+
+    void add_material_kernels(
+        std::vector<KernelBenchmark> &benchmarks, const std::string &prefix,
+        std::function<RC<const Material>()> create_material)
+    {
+        benchmarks.push_back({ prefix + "/eval", [=](NativeSampler &sampler)
+        {
+            auto inputs = create_inputs(create_material(), sampler);
+            return KernelFunc([inputs]
+            {
+                FSpectrum checksum;
+                for(size_t i = 0; i < inputs->bsdfs.size(); ++i)
+                {
+                    checksum += inputs->bsdfs[i]->eval_all(
+                        inputs->wis[i], inputs->wos[i], TransMode::Radiance);
+                }
+                do_not_optimize(checksum);
+                return inputs->bsdfs.size();
+            });
+        } });
+
+        benchmarks.push_back({ prefix + "/sample", [=](NativeSampler &sampler)
+        {
+            auto inputs = create_inputs(create_material(), sampler);
+            return KernelFunc([inputs]
+            {
+                real checksum = 0;
+                for(size_t i = 0; i < inputs->bsdfs.size(); ++i)
+                {
+                    const auto result = inputs->bsdfs[i]->sample_all(
+                        inputs->wos[i], TransMode::Radiance, inputs->sams[i]);
+                    checksum += result.pdf;
+                }
+                do_not_optimize(checksum);
+                return inputs->bsdfs.size();
+            });
+        } });
+
+        benchmarks.push_back({ prefix + "/pdf", [=](NativeSampler &sampler)
+        {
+            auto inputs = create_inputs(create_material(), sampler);
+            return KernelFunc([inputs]
+            {
+                real checksum = 0;
+                for(size_t i = 0; i < inputs->bsdfs.size(); ++i)
+                {
+                    checksum += inputs->bsdfs[i]->pdf_all(
+                        inputs->wis[i], inputs->wos[i]);
+                }
+                do_not_optimize(checksum);
+                return inputs->bsdfs.size();
+            });
+        } });
+    }
+}
+
+void add_bsdf_kernels(std::vector<KernelBenchmark> &benchmarks)
+{
+    // aggregate bsdf with a single diffuse component
+    add_material_kernels(benchmarks, "aggregate_bsdf_diffuse", []
+    {
+        return create_ideal_diffuse(
+            constant(FSpectrum(real(0.7))), newBox<NormalMapper>());
+    });
+
+    // aggregate bsdf with diffuse and glossy components
+    add_material_kernels(benchmarks, "aggregate_bsdf_phong", []
+    {
+        return create_phong(
+            constant(FSpectrum(real(0.4))), constant(FSpectrum(real(0.4))),
+            constant(real(64)), newBox<NormalMapper>());
+    });
+
+    // aggregate bsdf with a microfacet conductor component
+    add_material_kernels(benchmarks, "aggregate_bsdf_metal", []
+    {
+        return create_metal(
+            constant(FSpectrum(1)),
+            constant(FSpectrum(real(0.2), real(0.92), real(1.1))),
+            constant(FSpectrum(real(3.9), real(2.45), real(2.14))),
+            constant(real(0.3)), constant(real(0)), newBox<NormalMapper>());
+    });
+
+    // all disney lobes are enabled
+    add_material_kernels(benchmarks, "disney_bsdf", []
+    {
+        return create_disney(
+            constant(FSpectrum(real(0.8), real(0.5), real(0.3))),
+            constant(real(0.3)),   // metallic
+            constant(real(0.4)),   // roughness
+            constant(real(0.3)),   // transmission
+            constant(real(0.3)),   // transmission roughness
+            constant(real(1.5)),   // ior
+            constant(FSpectrum(1)), // specular scale
+            constant(real(0.2)),   // specular tint
+            constant(real(0.3)),   // anisotropic
+            constant(real(0.5)),   // sheen
+            constant(real(0.5)),   // sheen tint
+            constant(real(0.5)),   // clearcoat
+            constant(real(0.8)),   // clearcoat gloss
+            newBox<NormalMapper>(), nullptr);
+    });
+}
@@ -0,0 +1,62 @@
+#include <agz/microbench/microbench.h>
+
+using namespace agz::tracer;
+
+namespace
+{
+    constexpr int GRID_SIZE = 32;
+    constexpr int SAMPLE_COUNT = 4096;
+
+    // texels written by per-pixel renderers: value, weight, albedo, normal, denoise
+    using Grid = FilmFilterApplier::FilmGrid<Spectrum, real, Spectrum, Vec3, real>;
+
+    void add_apply_kernel(
+        std::vector<KernelBenchmark> &benchmarks, const std::string &name,
+        std::function<RC<FilmFilter>()> create_filter)
+    {
+        benchmarks.push_back({ name, [=](NativeSampler &sampler)
+        {
+            const FilmFilterApplier applier(
+                GRID_SIZE, GRID_SIZE, create_filter());
+            auto grid = newRC<Grid>(applier.create_subgrid<
+                Spectrum, real, Spectrum, Vec3, real>(
+                    { { 0, 0 }, { GRID_SIZE - 1, GRID_SIZE - 1 } }));
+
+            std::vector<Vec2> positions;
+            std::vector<Spectrum> values;
+            for(int i = 0; i < SAMPLE_COUNT; ++i)
+            {
+                const Sample2 pos_sam = sampler.sample2();
+                positions.push_back(real(GRID_SIZE) * Vec2(pos_sam.u, pos_sam.v));
+
+                const Sample3 value_sam = sampler.sample3();
+                values.push_back(Spectrum(value_sam.u, value_sam.v, value_sam.w));
+            }
+
+            return KernelFunc([grid, positions, values]
+            {
+                for(size_t i = 0; i < positions.size(); ++i)
+                {
+                    grid->apply(
+                        positions[i].x, positions[i].y,
+                        values[i], 1, values[i], Vec3(0, 0, 1), 1);
+                }
+                do_not_optimize(*grid);
+                return positions.size();
+            });
+        } });
+    }
+}
+
+void add_film_kernels(std::vector<KernelBenchmark> &benchmarks)
+{
+    add_apply_kernel(benchmarks, "film_grid_box/apply", []
+    {
+        return create_box_filter(real(0.5));
+    });
+
+    add_apply_kernel(benchmarks, "film_grid_gaussian/apply", []
+    {
+        return create_gaussian_filter(real(1.5), real(2));
+    });
+}
@@ -0,0 +1,157 @@
+#include <cmath>
+
+#include <agz/microbench/microbench.h>
+
+using namespace agz::tracer;
+
+namespace
+{
+    constexpr int RAY_COUNT = 4096;
+
+    /**
+     * @brief bumpy sphere with 2 * theta_res * phi_res triangles
+     */
+    std::vector<agz::mesh::triangle_t> create_bumpy_sphere(
+        int theta_res, int phi_res)
+    {
+        auto vertex = [&](int ti, int pi)
+        {
+            const real theta = PI_r * ti / theta_res;
+            const real phi   = 2 * PI_r * pi / phi_res;
+            const FVec3 dir(
+                std::sin(theta) * std::cos(phi),
+                std::sin(theta) * std::sin(phi),
+                std::cos(theta));
+            const real radius = 1 + real(0.1) * std::sin(8 * theta) * std::sin(8 * phi);
+
+            agz::mesh::vertex_t ret;
+            ret.position  = radius * dir;
+            ret.normal    = dir;
+            ret.tex_coord = { real(pi) / phi_res, real(ti) / theta_res };
+            return ret;
+        };
+
+        std::vector<agz::mesh::triangle_t> ret;
+        ret.reserve(size_t(2) * theta_res * phi_res);
+        for(int ti = 0; ti < theta_res; ++ti)
+        {
+            for(int pi = 0; pi < phi_res; ++pi)
+            {
+                const auto v00 = vertex(ti,     pi);
+                const auto v10 = vertex(ti + 1, pi);
+                const auto v11 = vertex(ti + 1, pi + 1);
+                const auto v01 = vertex(ti,     pi + 1);
+                ret.push_back({ { v00, v10, v11 } });
+                ret.push_back({ { v00, v11, v01 } });
+            }
+        }
+        return ret;
+    }
+
+    FVec3 random_point_in_cube(Sampler &sampler, real half_size)
+    {
+        const Sample3 sam = sampler.sample3();
+        return half_size * FVec3(2 * sam.u - 1, 2 * sam.v - 1, 2 * sam.w - 1);
+    }
+
+    /**
+     * @brief rays from outside toward random points around the mesh
+     */
+    std::vector<Ray> create_camera_rays(Sampler &sampler)
+    {
+        std::vector<Ray> ret;
+        ret.reserve(RAY_COUNT);
+        for(int i = 0; i < RAY_COUNT; ++i)
+        {
+            const Sample2 sam = sampler.sample2();
+            const FVec3 o = real(3) * agz::math::distribution::uniform_on_sphere(
+                sam.u, sam.v).first;
+            const FVec3 dst = random_point_in_cube(sampler, real(1.2));
+            ret.emplace_back(o, (dst - o).normalize());
+        }
+        return ret;
+    }
+
+    /**
+     * @brief segments between random points around the mesh
+     */
+    std::vector<Ray> create_shadow_rays(Sampler &sampler)
+    {
+        std::vector<Ray> ret;
+        ret.reserve(RAY_COUNT);
+        for(int i = 0; i < RAY_COUNT; ++i)
+        {
+            const FVec3 a = random_point_in_cube(sampler, real(1.2));
+            const FVec3 b = random_point_in_cube(sampler, real(1.2));
+            const real dis = distance(a, b);
+            ret.emplace_back(a, (b - a) / dis, EPS(), dis - EPS());
+        }
+        return ret;
+    }
+
+    void add_mesh_kernels(
+        std::vector<KernelBenchmark> &benchmarks, const std::string &prefix,
+        int theta_res, int phi_res,
+        RC<Geometry> (*create_bvh)(
+            std::vector<agz::mesh::triangle_t>, const FTransform3 &))
+    {
+        // the bvh is shared by both kernels and built by the first prepared one
+        auto bvh = newRC<RC<Geometry>>();
+        auto get_bvh = [=]
+        {
+            if(!*bvh)
+                *bvh = create_bvh(create_bumpy_sphere(theta_res, phi_res), FTransform3());
+            return *bvh;
+        };
+
+        benchmarks.push_back({ prefix + "/closest_intersection", [=](NativeSampler &sampler)
+        {
+            auto geometry = get_bvh();
+            auto rays = create_camera_rays(sampler);
+            return KernelFunc([geometry, rays]
+            {
+                real checksum = 0;
+                for(auto &r : rays)
+                {
+                    GeometryIntersection inct;
+                    if(geometry->closest_intersection(r, &inct))
+                        checksum += inct.t;
+                }
+                do_not_optimize(checksum);
+                return rays.size();
+            });
+        } });
+
+        benchmarks.push_back({ prefix + "/has_intersection", [=](NativeSampler &sampler)
+        {
+            auto geometry = get_bvh();
+            auto rays = create_shadow_rays(sampler);
+            return KernelFunc([geometry, rays]
+            {
+                int hit_count = 0;
+                for(auto &r : rays)
+                    hit_count += geometry->has_intersection(r) ? 1 : 0;
+                do_not_optimize(hit_count);
+                return rays.size();
+            });
+        } });
+    }
+}
+
+void add_geometry_kernels(std::vector<KernelBenchmark> &benchmarks)
+{
+    // ~1k triangles fits in cache. ~260k triangles stresses bvh traversal
+
+    add_mesh_kernels(
+        benchmarks, "triangle_bvh_small", 16, 32,
+        &create_triangle_bvh_noembree);
+    add_mesh_kernels(
+        benchmarks, "triangle_bvh_large", 256, 512,
+        &create_triangle_bvh_noembree);
+
+#ifdef USE_EMBREE
+    add_mesh_kernels(
+        benchmarks, "triangle_bvh_embree_large", 256, 512,
+        &create_triangle_bvh_embree);
+#endif
+}
@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+
+#include <agz/microbench/microbench.h>
+
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+    double seconds_since(Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // fnv-1a. std::hash is not reproducible between standard libraries
+    int hash_name(const std::string &name, int seed)
+    {
+        uint32_t ret = 2166136261u ^ static_cast<uint32_t>(seed);
+        for(const char c : name)
+        {
+            ret ^= static_cast<uint8_t>(c);
+            ret *= 16777619u;
+        }
+        return static_cast<int>(ret & 0x7fffffff);
+    }
+}
+
+void escape(const void *p) noexcept
+{
+    static const void *volatile sink;
+    sink = p;
+}
+
+KernelStats run_kernel_benchmark(
+    const KernelBenchmark &benchmark, const HarnessParams &params)
+{
+    KernelStats ret;
+    ret.name = benchmark.name;
+
+    // prepare
+
+    const auto prepare_start = Clock::now();
+    agz::tracer::NativeSampler sampler(
+        hash_name(benchmark.name, params.seed), false);
+    const KernelFunc kernel = benchmark.prepare(sampler);
+    ret.prepare_seconds = seconds_since(prepare_start);
+
+    // warmup. the batch count of each sample is also estimated here
+
+    size_t warmup_batches = 0;
+    const auto warmup_start = Clock::now();
+    double warmup_seconds = 0;
+    do
+    {
+        ret.invocations_per_batch = kernel();
+        ++warmup_batches;
+        warmup_seconds = seconds_since(warmup_start);
+    } while(warmup_seconds < params.warmup_seconds);
+
+    const double seconds_per_batch = warmup_seconds / warmup_batches;
+    ret.batches_per_sample = (std::max)(
+        size_t(1),
+        static_cast<size_t>(std::ceil(params.min_sample_seconds / seconds_per_batch)));
+
+    // samples
+
+    std::vector<double> ns_per_invocation;
+    ns_per_invocation.reserve(params.sample_count);
+
+    for(int i = 0; i < params.sample_count; ++i)
+    {
+        size_t invocations = 0;
+        const auto sample_start = Clock::now();
+        for(size_t j = 0; j < ret.batches_per_sample; ++j)
+            invocations += kernel();
+        const double seconds = seconds_since(sample_start);
+
+        ns_per_invocation.push_back(
+            1e9 * seconds / (std::max)(invocations, size_t(1)));
+    }
+
+    ret.sample_count = params.sample_count;
+
+    std::sort(ns_per_invocation.begin(), ns_per_invocation.end());
+
+    const size_t n = ns_per_invocation.size();
+    ret.min_ns = ns_per_invocation.front();
+    ret.max_ns = ns_per_invocation.back();
+    ret.median_ns = n % 2 ? ns_per_invocation[n / 2] :
+        0.5 * (ns_per_invocation[n / 2 - 1] + ns_per_invocation[n / 2]);
+
+    ret.mean_ns = std::accumulate(
+        ns_per_invocation.begin(), ns_per_invocation.end(), 0.0) / n;
+
+    double var = 0;
+    for(const double ns : ns_per_invocation)
+        var += (ns - ret.mean_ns) * (ns - ret.mean_ns);
+    ret.stddev_ns = n > 1 ? std::sqrt(var / (n - 1)) : 0.0;
+
+    return ret;
+}
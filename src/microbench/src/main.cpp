@@ -0,0 +1,148 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include <cxxopts.hpp>
+#include <json.hpp>
+
+#include <agz/microbench/microbench.h>
+
+#include <agz/utility/misc.h>
+
+namespace
+{
+    std::vector<KernelBenchmark> all_benchmarks()
+    {
+        std::vector<KernelBenchmark> ret;
+        add_geometry_kernels(ret);
+        add_bsdf_kernels(ret);
+        add_texture_kernels(ret);
+        add_medium_kernels(ret);
+        add_film_kernels(ret);
+        return ret;
+    }
+
+    nlohmann::json to_json(const KernelStats &stats)
+    {
+        nlohmann::json ret;
+        ret["name"]                  = stats.name;
+        ret["invocations_per_batch"] = stats.invocations_per_batch;
+        ret["batches_per_sample"]    = stats.batches_per_sample;
+        ret["sample_count"]          = stats.sample_count;
+        ret["prepare_seconds"]       = stats.prepare_seconds;
+        ret["min_ns"]                = stats.min_ns;
+        ret["median_ns"]             = stats.median_ns;
+        ret["mean_ns"]               = stats.mean_ns;
+        ret["stddev_ns"]             = stats.stddev_ns;
+        ret["max_ns"]                = stats.max_ns;
+        return ret;
+    }
+}
+
+void run(int argc, char *argv[])
+{
+    cxxopts::Options opts("atrc-microbench", "kernel microbenchmarks of agz offline renderer");
+    opts.add_options("")
+        ("f,filter", "regex of benchmark names to run", cxxopts::value<std::string>())
+        ("l,list", "list benchmark names")
+        ("samples", "number of timed samples", cxxopts::value<int>())
+        ("warmup", "warmup seconds of each benchmark", cxxopts::value<double>())
+        ("min-sample-time", "min seconds of each sample", cxxopts::value<double>())
+        ("seed", "seed of input generation", cxxopts::value<int>())
+        ("o,output", "output json filename", cxxopts::value<std::string>())
+        ("h,help", "help information");
+    auto parse_result = opts.parse(argc, argv);
+
+    if(parse_result.count("help"))
+    {
+        std::cout << opts.help({ "" }) << std::endl;
+        return;
+    }
+
+    const auto benchmarks = all_benchmarks();
+
+    if(parse_result.count("list"))
+    {
+        for(auto &b : benchmarks)
+            std::cout << b.name << std::endl;
+        return;
+    }
+
+    HarnessParams params;
+    if(parse_result.count("samples"))
+        params.sample_count = (std::max)(1, parse_result["samples"].as<int>());
+    if(parse_result.count("warmup"))
+        params.warmup_seconds = parse_result["warmup"].as<double>();
+    if(parse_result.count("min-sample-time"))
+        params.min_sample_seconds = parse_result["min-sample-time"].as<double>();
+    if(parse_result.count("seed"))
+        params.seed = parse_result["seed"].as<int>();
+
+    const std::regex filter(
+        parse_result.count("filter") ?
+        parse_result["filter"].as<std::string>() : std::string(".*"));
+
+    std::printf("%-48s %12s %12s %12s %8s\n",
+                "benchmark", "median ns", "min ns", "mean ns", "cv %");
+
+    nlohmann::json results = nlohmann::json::array();
+    for(auto &b : benchmarks)
+    {
+        if(!std::regex_search(b.name, filter))
+            continue;
+
+        const KernelStats stats = run_kernel_benchmark(b, params);
+
+        std::printf("%-48s %12.2f %12.2f %12.2f %8.2f\n",
+                    stats.name.c_str(), stats.median_ns, stats.min_ns,
+                    stats.mean_ns, 100 * stats.stddev_ns / stats.mean_ns);
+        std::fflush(stdout);
+
+        results.push_back(to_json(stats));
+    }
+
+    if(!parse_result.count("output"))
+        return;
+
+    nlohmann::json report;
+    report["seed"]               = params.seed;
+    report["warmup_seconds"]     = params.warmup_seconds;
+    report["min_sample_seconds"] = params.min_sample_seconds;
+    report["benchmarks"]         = std::move(results);
+
+    const auto filename = parse_result["output"].as<std::string>();
+    std::ofstream fout(filename, std::ofstream::trunc);
+    if(!fout)
+        throw std::runtime_error("failed to open " + filename);
+    fout << report.dump(4) << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    try
+    {
+#ifdef USE_EMBREE
+        agz::tracer::init_embree_device();
+        AGZ_SCOPE_GUARD({ agz::tracer::destroy_embree_device(); });
+#endif
+
+        run(argc, argv);
+        return 0;
+    }
+    catch(const std::exception &e)
+    {
+        std::vector<std::string> msgs;
+        agz::misc::extract_hierarchy_exceptions(e, std::back_inserter(msgs));
+        for(auto &m : msgs)
+            std::cerr << m << std::endl;
+    }
+    catch(...)
+    {
+        std::cerr << "an unknown error occurred" << std::endl;
+    }
+
+    return -1;
+}
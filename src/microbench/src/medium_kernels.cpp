@@ -0,0 +1,95 @@
+#include <cmath>
+#include <limits>
+
+#include <agz/microbench/microbench.h>
+
+using namespace agz::tracer;
+
+namespace
+{
+    constexpr int DENSITY_RES = 64;
+    constexpr int SEGMENT_COUNT = 1024;
+
+    RC<const Texture3D> create_noise_density(real max_density)
+    {
+        auto data = newRC<Image3D<real>>(DENSITY_RES, DENSITY_RES, DENSITY_RES);
+        for(int zi = 0; zi < DENSITY_RES; ++zi)
+        {
+            for(int yi = 0; yi < DENSITY_RES; ++yi)
+            {
+                for(int xi = 0; xi < DENSITY_RES; ++xi)
+                {
+                    const real x = (xi + real(0.5)) / DENSITY_RES;
+                    const real y = (yi + real(0.5)) / DENSITY_RES;
+                    const real z = (zi + real(0.5)) / DENSITY_RES;
+
+                    real noise = 0, amp = real(0.5), freq = 10;
+                    for(int octave = 0; octave < 4; ++octave)
+                    {
+                        noise += amp * std::sin(freq * x + real(1.3) * octave)
+                                     * std::sin(freq * y + real(0.7) * octave)
+                                     * std::sin(freq * z + real(2.1) * octave);
+                        amp  *= real(0.5);
+                        freq *= real(2.1);
+                    }
+
+                    (*data)(zi, yi, xi) =
+                        max_density * agz::math::saturate(real(0.5) + noise);
+                }
+            }
+        }
+        return create_image3d({}, std::move(data), true);
+    }
+
+    void add_tr_kernel(
+        std::vector<KernelBenchmark> &benchmarks, const std::string &name,
+        real max_density, bool use_residual_ratio_tracking)
+    {
+        benchmarks.push_back({ name, [=](NativeSampler &sampler)
+        {
+            const RC<const Medium> medium = create_heterogeneous_medium(
+                FTransform3(), create_noise_density(max_density),
+                create_constant3d_texture({}, FSpectrum(real(0.9))),
+                create_constant3d_texture({}, FSpectrum(0)),
+                (std::numeric_limits<int>::max)(), 0,
+                use_residual_ratio_tracking);
+
+            // segments may start or end outside the medium
+            std::vector<std::pair<FVec3, FVec3>> segments;
+            for(int i = 0; i < SEGMENT_COUNT; ++i)
+            {
+                const Sample3 a = sampler.sample3();
+                const Sample3 b = sampler.sample3();
+                segments.push_back({
+                    real(1.4) * FVec3(a.u, a.v, a.w) - FVec3(real(0.2)),
+                    real(1.4) * FVec3(b.u, b.v, b.w) - FVec3(real(0.2))
+                });
+            }
+
+            // tr is stochastic. its sampler keeps advancing between batches
+            auto tr_sampler = newRC<NativeSampler>(
+                static_cast<int>(sampler.sample1().u * 1e6f), false);
+
+            return KernelFunc([medium, segments, tr_sampler]
+            {
+                FSpectrum checksum;
+                for(auto &seg : segments)
+                    checksum += medium->tr(seg.first, seg.second, *tr_sampler);
+                do_not_optimize(checksum);
+                return segments.size();
+            });
+        } });
+    }
+}
+
+void add_medium_kernels(std::vector<KernelBenchmark> &benchmarks)
+{
+    add_tr_kernel(
+        benchmarks, "heterogeneous_medium_thin/tr_ratio", 2, false);
+    add_tr_kernel(
+        benchmarks, "heterogeneous_medium_thin/tr_residual_ratio", 2, true);
+    add_tr_kernel(
+        benchmarks, "heterogeneous_medium_dense/tr_ratio", 50, false);
+    add_tr_kernel(
+        benchmarks, "heterogeneous_medium_dense/tr_residual_ratio", 50, true);
+}
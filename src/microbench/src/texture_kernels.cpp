@@ -0,0 +1,133 @@
+#include <cmath>
+
+#include <agz/microbench/microbench.h>
+
+using namespace agz::tracer;
+
+namespace
+{
+    constexpr int TEXTURE_SIZE = 1024;
+    constexpr int LOOKUP_COUNT = 4096;
+
+    /**
+     * @brief random uvs and uv derivatives
+     *
+     * derivative lengths are log-uniform between 1/4 and 64 texels
+     */
+    struct LookupInputs
+    {
+        std::vector<Vec2> uvs;
+        std::vector<Vec2> duvdxs;
+        std::vector<Vec2> duvdys;
+    };
+
+    LookupInputs create_lookups(Sampler &sampler)
+    {
+        LookupInputs ret;
+        for(int i = 0; i < LOOKUP_COUNT; ++i)
+        {
+            const Sample2 uv_sam = sampler.sample2();
+            ret.uvs.push_back({ uv_sam.u, uv_sam.v });
+
+            const Sample3 d_sam = sampler.sample3();
+            const real len = std::exp2(-2 + 8 * d_sam.u) / TEXTURE_SIZE;
+            const real angle = 2 * PI_r * d_sam.v;
+            const real aspect = 1 + 3 * d_sam.w;
+
+            ret.duvdxs.push_back(len * Vec2(std::cos(angle), std::sin(angle)));
+            ret.duvdys.push_back(
+                len / aspect * Vec2(-std::sin(angle), std::cos(angle)));
+        }
+        return ret;
+    }
+
+    RC<const Texture2D> create_hdr(Sampler &sampler, const std::string &sample)
+    {
+        auto data = newRC<Image2D<agz::math::color3f>>(TEXTURE_SIZE, TEXTURE_SIZE);
+        for(int y = 0; y < TEXTURE_SIZE; ++y)
+        {
+            for(int x = 0; x < TEXTURE_SIZE; ++x)
+            {
+                const Sample3 sam = sampler.sample3();
+                (*data)(y, x) = agz::math::color3f(sam.u, sam.v, sam.w);
+            }
+        }
+        return create_hdr_texture({}, std::move(data), sample);
+    }
+
+    RC<const Texture2D> create_ldr(Sampler &sampler, const std::string &sample)
+    {
+        auto data = newRC<Image2D<agz::math::color3b>>(TEXTURE_SIZE, TEXTURE_SIZE);
+        for(int y = 0; y < TEXTURE_SIZE; ++y)
+        {
+            for(int x = 0; x < TEXTURE_SIZE; ++x)
+            {
+                const Sample3 sam = sampler.sample3();
+                (*data)(y, x) = agz::math::color3b(
+                    static_cast<uint8_t>(255 * sam.u),
+                    static_cast<uint8_t>(255 * sam.v),
+                    static_cast<uint8_t>(255 * sam.w));
+            }
+        }
+        return create_image_texture({}, std::move(data), sample);
+    }
+
+    void add_lookup_kernel(
+        std::vector<KernelBenchmark> &benchmarks, const std::string &name,
+        RC<const Texture2D> (*create_texture)(Sampler &, const std::string &),
+        const std::string &sample, bool use_derivatives)
+    {
+        benchmarks.push_back({ name, [=](NativeSampler &sampler)
+        {
+            auto texture = create_texture(sampler, sample);
+            auto lookups = create_lookups(sampler);
+
+            if(use_derivatives)
+            {
+                return KernelFunc([texture, lookups]
+                {
+                    FSpectrum checksum;
+                    for(size_t i = 0; i < lookups.uvs.size(); ++i)
+                    {
+                        checksum += texture->sample_spectrum(
+                            lookups.uvs[i], lookups.duvdxs[i], lookups.duvdys[i]);
+                    }
+                    do_not_optimize(checksum);
+                    return lookups.uvs.size();
+                });
+            }
+
+            return KernelFunc([texture, lookups]
+            {
+                FSpectrum checksum;
+                for(auto &uv : lookups.uvs)
+                    checksum += texture->sample_spectrum(uv);
+                do_not_optimize(checksum);
+                return lookups.uvs.size();
+            });
+        } });
+    }
+}
+
+void add_texture_kernels(std::vector<KernelBenchmark> &benchmarks)
+{
+    add_lookup_kernel(
+        benchmarks, "hdr_texture_nearest/sample_spectrum",
+        &create_hdr, "nearest", false);
+    add_lookup_kernel(
+        benchmarks, "hdr_texture_linear/sample_spectrum",
+        &create_hdr, "linear", false);
+    add_lookup_kernel(
+        benchmarks, "hdr_texture_trilinear/sample_spectrum",
+        &create_hdr, "trilinear", true);
+    add_lookup_kernel(
+        benchmarks, "hdr_texture_anisotropic/sample_spectrum",
+        &create_hdr, "anisotropic", true);
+
+    add_lookup_kernel(
+        benchmarks, "image_texture_linear/sample_spectrum",
+        &create_ldr, "linear", false);
+    add_lookup_kernel(
+        benchmarks, "image_texture_trilinear/sample_spectrum",
+        &create_ldr, "trilinear", true);
+}
@@ -1,6 +1,7 @@
 ﻿#pragma once
 
 #include <agz/tracer/common.h>
+#include <agz/tracer/utility/render_stats.h>
 #include <agz/utility/misc.h>
 
 AGZ_TRACER_BEGIN
@@ -192,6 +193,7 @@ inline FSpectrum BSDF::eval_all(
 inline BSDFSampleResult BSDF::sample_all(
     const FVec3 &wo, TransMode mode, const Sample3 &sam) const noexcept
 {
+    AGZ_RENDER_STATS_ADD(BSDFSamples, 1);
     return sample(wo, mode, sam, BSDF_ALL);
 }
 
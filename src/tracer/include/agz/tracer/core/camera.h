@@ -100,6 +100,17 @@ struct CameraSampleWiResult
 inline const CameraSampleWiResult CAMERA_SAMPLE_WI_RESULT_INVALID =
     CameraSampleWiResult({}, {}, {}, {}, 0, {});
 
+/**
+ * @brief rays through neighboring film positions of a camera ray
+ *
+ * used to estimate texture footprint at primary intersections
+ */
+struct CameraRayDifferential
+{
+    Ray rx; // ray through film_coord + (film_dxy.x, 0)
+    Ray ry; // ray through film_coord + (0, film_dxy.y)
+};
+
 /**
  * @brief camera interface
  */
@@ -119,6 +130,32 @@ public:
     virtual CameraSampleWeResult sample_we(
         const Vec2 &film_coord, const Sample2 &aperture_sam) const noexcept = 0;
 
+    /**
+     * @brief generate a ray as well as its differentials
+     *
+     * @param film_dxy film coordinate offset between the differential rays
+     *  and the main ray, typically the size of one pixel
+     *
+     * default implementation calls sample_we at offset film coordinates
+     * with the same aperture sample. cameras that can share the lens
+     * sampling among the three rays should override it
+     */
+    virtual CameraSampleWeResult sample_we_differential(
+        const Vec2 &film_coord, const Vec2 &film_dxy,
+        const Sample2 &aperture_sam,
+        CameraRayDifferential *differential) const noexcept
+    {
+        const auto rx = sample_we(
+            { film_coord.x + film_dxy.x, film_coord.y }, aperture_sam);
+        const auto ry = sample_we(
+            { film_coord.x, film_coord.y + film_dxy.y }, aperture_sam);
+
+        differential->rx = Ray(rx.pos_on_cam, rx.pos_to_out);
+        differential->ry = Ray(ry.pos_on_cam, ry.pos_to_out);
+
+        return sample_we(film_coord, aperture_sam);
+    }
+
     /**
      * @brief eval we(pos_on_cam -> pos_to_out)
      */
@@ -37,6 +37,10 @@ struct GeometryIntersection : SurfacePoint
 {
     real t = -1;
     FVec3 wr;
+
+    // partial derivatives of pos w.r.t. uv. zero means unknown
+    FVec3 dpdu;
+    FVec3 dpdv;
 };
 
 /**
@@ -49,6 +53,11 @@ struct EntityIntersection : GeometryIntersection
     const Medium *medium_in  = nullptr;
     const Medium *medium_out = nullptr;
 
+    // uv offsets corresponding to camera ray differentials.
+    // zero means unknown, and textures are sampled at the finest level
+    Vec2 duvdx;
+    Vec2 duvdy;
+
     const Medium *wr_medium() const noexcept
     {
         return dot(wr, geometry_coord.z) >= 0 ? medium_out : medium_in;
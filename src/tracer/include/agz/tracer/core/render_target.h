@@ -60,6 +60,9 @@ struct ImageBufferTemplate
  * @brief output of rendering algorithm
  *
  * assert(image.is_available())
+ *
+ * cost is the rendering time of each pixel in microseconds. it is only
+ * available with renderers recording it
  */
 struct RenderTarget
 {
@@ -67,6 +70,7 @@ struct RenderTarget
     Image2D<Spectrum> albedo;
     Image2D<Vec3>     normal;
     Image2D<real>     denoise;
+    Image2D<real>     cost;
 
     RenderTarget() = default;
 
@@ -207,6 +211,11 @@ public:
          * @brief get sample pixel range
          */
         const Rect2i &sample_pixels() const noexcept;
+
+        /**
+         * @brief get range of pixels written by this view
+         */
+        const Rect2i &pixels() const noexcept;
     };
 
     FilmFilterApplier(
@@ -271,6 +280,8 @@ inline bool RenderTarget::is_valid() const noexcept
         return false;
     if(denoise.is_available() && denoise.size() != image.size())
         return false;
+    if(cost.is_available() && cost.size() != image.size())
+        return false;
     return true;
 }
 
@@ -501,6 +512,13 @@ const Rect2i &FilmFilterApplier::FilmGridView<TexelTypes...>
     return sample_pixels_;
 }
 
+template<typename...TexelTypes>
+const Rect2i &FilmFilterApplier::FilmGridView<TexelTypes...>
+    ::pixels() const noexcept
+{
+    return pixels_;
+}
+
 inline FilmFilterApplier::FilmFilterApplier(
     int width, int height, RC<const FilmFilter> film_filter) noexcept
     : width_(width), height_(height), film_filter_(std::move(film_filter))
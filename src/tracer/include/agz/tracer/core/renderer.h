@@ -4,6 +4,8 @@
 #include <future>
 
 #include <agz/tracer/core/render_target.h>
+#include <agz/tracer/utility/checkpoint.h>
+#include <agz/tracer/utility/partial_film.h>
 
 AGZ_TRACER_BEGIN
 
@@ -23,6 +25,10 @@ protected:
     bool is_waitable_ = false;
     std::future<RenderTarget> async_thread_;
 
+    CheckpointParams checkpoint_params_;
+
+    bool record_pixel_cost_ = false;
+
 public:
 
     virtual ~Renderer() { stop_async(); }
@@ -34,6 +40,40 @@ public:
         FilmFilterApplier filter, Scene &scene,
         RendererInteractor &reporter) = 0;
 
+    /**
+     * @brief blocking rendering of a share of samples
+     *
+     * the returned film is not normalized, so that films of all shares
+     * can be merged into the final image
+     *
+     * throw ObjectConstructionException if not supported by the renderer
+     */
+    virtual PartialFilm render_partial(
+        FilmFilterApplier filter, Scene &scene,
+        RendererInteractor &reporter, const FilmPartition &partition);
+
+    /**
+     * @brief set where and how often to save checkpoints, and whether
+     *  to resume from the saved one
+     *
+     * ignored by renderers not supporting checkpoints
+     */
+    void set_checkpoint(CheckpointParams params)
+    {
+        checkpoint_params_ = std::move(params);
+    }
+
+    /**
+     * @brief whether to record rendering time of each pixel into the cost
+     *  image of the result
+     *
+     * ignored by renderers not supporting pixel costs
+     */
+    void set_pixel_cost_recording(bool enabled) noexcept
+    {
+        record_pixel_cost_ = enabled;
+    }
+
     /**
      * @brief start the async rendering
      */
@@ -1,6 +1,7 @@
 ﻿#pragma once
 
 #include <agz/tracer/common.h>
+#include <agz/tracer/utility/render_stats.h>
 
 AGZ_TRACER_BEGIN
 
@@ -52,6 +53,13 @@ public:
      */
     virtual void end() = 0;
 
+    /**
+     * @brief report statistics aggregated after rendering
+     *
+     * only called when the tracer is built with USE_RENDER_STATS
+     */
+    virtual void stats(const RenderStats &stats) { }
+
     /**
      * @brief start a new rendering stage.
      *  progress percentage will be reset to 0
@@ -36,6 +36,16 @@ public:
      */
     NativeSampler *clone(int seed, Arena &arena) const;
 
+    /**
+     * @brief restart the random sequence at given sample of given stream
+     *
+     * the sequence only depends on the internal seed, stream and index,
+     * so that rendering results are independent of the thread count and the
+     * order of tasks. typically stream is the pixel index and index is the
+     * sample index in the pixel
+     */
+    void start_sample(uint64_t stream, uint64_t index) noexcept;
+
     Sample1 sample1() override;
     Sample2 sample2() override;
     Sample3 sample3() override;
@@ -79,6 +89,28 @@ inline NativeSampler *NativeSampler::clone(int seed, Arena &arena) const
     return arena.create<NativeSampler>(int(new_seed), false);
 }
 
+namespace sampler_impl
+{
+    /**
+     * @brief splitmix64 finalizer
+     */
+    inline uint64_t mix_bits(uint64_t v) noexcept
+    {
+        v ^= v >> 30;
+        v *= 0xbf58476d1ce4e5b9ull;
+        v ^= v >> 27;
+        v *= 0x94d049bb133111ebull;
+        v ^= v >> 31;
+        return v;
+    }
+}
+
+inline void NativeSampler::start_sample(uint64_t stream, uint64_t index) noexcept
+{
+    using sampler_impl::mix_bits;
+    rng_ = rng_t(mix_bits(mix_bits(mix_bits(seed_) ^ stream) ^ index));
+}
+
 inline Sample1 NativeSampler::sample1()
 {
     return { dis_(rng_) };
@@ -1,6 +1,6 @@
 ﻿#pragma once
 
-#include <agz/tracer/common.h>
+#include <agz/tracer/core/intersection.h>
 #include <agz/tracer/utility/config.h>
 
 AGZ_TRACER_BEGIN
@@ -64,6 +64,14 @@ protected:
 
     real inv_gamma_ = 1;
 
+    // fast paths chosen at construction
+    bool identity_transform_ = true;
+    bool clamp_uv_           = true;
+
+    // set by textures which override the uv-differential version of
+    // sample_spectrum_impl/sample_real_impl
+    bool use_uv_differential_ = false;
+
     static real wrap_clamp(real x) noexcept
     {
         return math::clamp<real>(x, 0, 1);
@@ -111,6 +119,47 @@ protected:
         }
 
         inv_gamma_ = params.inv_gamma;
+
+        // an affine transform is identity iff it fixes three affinely
+        // independent points
+
+        identity_transform_ =
+            transform_.apply_to_point(Vec2(0, 0)) == Vec2(0, 0) &&
+            transform_.apply_to_point(Vec2(1, 0)) == Vec2(1, 0) &&
+            transform_.apply_to_point(Vec2(0, 1)) == Vec2(0, 1);
+
+        clamp_uv_ = wrapper_u_ == &wrap_clamp && wrapper_v_ == &wrap_clamp;
+    }
+
+    /**
+     * @brief apply transform and wrapping to uv
+     */
+    Vec2 to_texture_uv(const Vec2 &uv) const noexcept
+    {
+        const Vec2 uv1 = identity_transform_ ? uv : transform_.apply_to_point(uv);
+        if(clamp_uv_)
+            return uv1.saturate();
+        return { wrapper_u_(uv1.x), wrapper_v_(uv1.y) };
+    }
+
+    Vec2 to_texture_duv(const Vec2 &duv) const noexcept
+    {
+        return identity_transform_ ? duv : transform_.apply_to_vector(duv);
+    }
+
+    FSpectrum apply_inv_gamma(const FSpectrum &spec) const noexcept
+    {
+        if(inv_gamma_ == 1)
+            return spec;
+        FSpectrum ret;
+        for(int i = 0; i < SPECTRUM_COMPONENT_COUNT; ++i)
+            ret[i] = std::pow(spec[i], inv_gamma_);
+        return ret;
+    }
+
+    real apply_inv_gamma(real value) const noexcept
+    {
+        return inv_gamma_ == 1 ? value : std::pow(value, inv_gamma_);
     }
 
     virtual FSpectrum sample_spectrum_impl(const Vec2 &uv) const noexcept
@@ -123,6 +172,18 @@ protected:
         return sample_spectrum_impl(uv).r;
     }
 
+    virtual FSpectrum sample_spectrum_impl(
+        const Vec2 &uv, const Vec2 &duvdx, const Vec2 &duvdy) const noexcept
+    {
+        return sample_spectrum_impl(uv);
+    }
+
+    virtual real sample_real_impl(
+        const Vec2 &uv, const Vec2 &duvdx, const Vec2 &duvdy) const noexcept
+    {
+        return sample_spectrum_impl(uv, duvdx, duvdy).r;
+    }
+
 public:
 
     virtual ~Texture2D() = default;
@@ -132,16 +193,7 @@ public:
      */
     virtual FSpectrum sample_spectrum(const Vec2 &uv) const noexcept
     {
-        const Vec2 uv1 = transform_.apply_to_point(uv);
-        const real u = wrapper_u_(uv1.x);
-        const real v = wrapper_v_(uv1.y);
-        FSpectrum ret = sample_spectrum_impl({ u, v });
-        if(inv_gamma_ != 1)
-        {
-            for(int i = 0; i < SPECTRUM_COMPONENT_COUNT; ++i)
-                ret[i] = std::pow(ret[i], inv_gamma_);
-        }
-        return ret;
+        return apply_inv_gamma(sample_spectrum_impl(to_texture_uv(uv)));
     }
 
     /**
@@ -149,13 +201,52 @@ public:
      */
     virtual real sample_real(const Vec2 &uv) const noexcept
     {
-        const Vec2 uv1 = transform_.apply_to_point(uv);
-        const real u = wrapper_u_(uv1.x);
-        const real v = wrapper_v_(uv1.y);
-        real ret = sample_real_impl({ u, v });
-        if(inv_gamma_ != 1)
-            ret = std::pow(ret, inv_gamma_);
-        return ret;
+        return apply_inv_gamma(sample_real_impl(to_texture_uv(uv)));
+    }
+
+    /**
+     * @brief sample spectrum value at uv with its screen-space derivatives
+     *
+     * derivatives are used to select mipmap levels. textures without
+     * mipmaps fall back to sample_spectrum(uv)
+     */
+    virtual FSpectrum sample_spectrum(
+        const Vec2 &uv, const Vec2 &duvdx, const Vec2 &duvdy) const noexcept
+    {
+        if(!use_uv_differential_)
+            return sample_spectrum(uv);
+
+        return apply_inv_gamma(sample_spectrum_impl(
+            to_texture_uv(uv), to_texture_duv(duvdx), to_texture_duv(duvdy)));
+    }
+
+    /**
+     * @brief sample real value at uv with its screen-space derivatives
+     */
+    virtual real sample_real(
+        const Vec2 &uv, const Vec2 &duvdx, const Vec2 &duvdy) const noexcept
+    {
+        if(!use_uv_differential_)
+            return sample_real(uv);
+
+        return apply_inv_gamma(sample_real_impl(
+            to_texture_uv(uv), to_texture_duv(duvdx), to_texture_duv(duvdy)));
+    }
+
+    /**
+     * @brief sample spectrum value at an intersection, using its uv differentials
+     */
+    FSpectrum sample_spectrum(const EntityIntersection &inct) const noexcept
+    {
+        return sample_spectrum(inct.uv, inct.duvdx, inct.duvdy);
+    }
+
+    /**
+     * @brief sample real value at an intersection, using its uv differentials
+     */
+    real sample_real(const EntityIntersection &inct) const noexcept
+    {
+        return sample_real(inct.uv, inct.duvdx, inct.duvdy);
     }
 
     virtual int width() const noexcept = 0;
@@ -51,6 +51,14 @@ protected:
 
     void init_common_params(const Texture3DCommonParams &params);
 
+    /**
+     * @brief range of texels which may be touched when sampling in uvw_bound
+     *  with either nearest or linear sampler
+     */
+    void texel_range_in_bound(
+        const AABB &uvw_bound, const Vec3i &size,
+        Vec3i &beg, Vec3i &end) const noexcept;
+
     virtual FSpectrum sample_spectrum_impl(const FVec3 &uvw) const noexcept;
 
     virtual real sample_real_impl(const FVec3 &uvw) const noexcept;
@@ -84,6 +92,23 @@ public:
      * @brief maximal real value
      */
     virtual real max_real() const noexcept = 0;
+
+    /**
+     * @brief conservative upper bound of real values sampled in a uvw box
+     *
+     * uvw_bound is specified before applying transform & wrapping.
+     * default implementation returns max_real()
+     */
+    virtual real max_real_in_bound(const AABB &uvw_bound) const noexcept;
+
+    /**
+     * @brief conservative lower bound of real values sampled in a uvw box
+     *
+     * uvw_bound is specified before applying transform & wrapping.
+     * default implementation returns 0, which is only valid for non-negative
+     * textures like densities
+     */
+    virtual real min_real_in_bound(const AABB &uvw_bound) const noexcept;
 };
 
 inline FTransform3 Texture3DCommonParams::full_transform() const
@@ -183,6 +208,54 @@ inline void Texture3D::init_common_params(const Texture3DCommonParams &params)
     inv_gamma_ = params.inv_gamma;
 }
 
+inline void Texture3D::texel_range_in_bound(
+    const AABB &uvw_bound, const Vec3i &size,
+    Vec3i &beg, Vec3i &end) const noexcept
+{
+    // bound of texture coordinates after transformation
+
+    AABB tex_bound;
+    for(int i = 0; i < 8; ++i)
+    {
+        const FVec3 corner(
+            (i & 1) ? uvw_bound.high.x : uvw_bound.low.x,
+            (i & 2) ? uvw_bound.high.y : uvw_bound.low.y,
+            (i & 4) ? uvw_bound.high.z : uvw_bound.low.z);
+        tex_bound |= transform_.apply_to_point(corner);
+    }
+
+    // clamping keeps the bound contiguous, while other wrapping methods
+    // may map out-of-range coordinates to anywhere in [0, 1]
+
+    const WrapFuncPtr wrappers[3] = { wrapper_u_, wrapper_v_, wrapper_w_ };
+    for(int i = 0; i < 3; ++i)
+    {
+        if(wrappers[i] != &wrap_clamp &&
+           (tex_bound.low[i] < 0 || tex_bound.high[i] >= 1))
+        {
+            tex_bound.low[i]  = 0;
+            tex_bound.high[i] = 1;
+        }
+        else
+        {
+            tex_bound.low[i]  = math::clamp<real>(tex_bound.low[i],  0, 1);
+            tex_bound.high[i] = math::clamp<real>(tex_bound.high[i], 0, 1);
+        }
+    }
+
+    // texel range that may be touched by both nearest & linear sampler
+
+    for(int i = 0; i < 3; ++i)
+    {
+        beg[i] = math::clamp<int>(
+            static_cast<int>(std::floor(tex_bound.low[i] * size[i])) - 1,
+            0, size[i] - 1);
+        end[i] = math::clamp<int>(
+            static_cast<int>(std::floor(tex_bound.high[i] * size[i])) + 1,
+            0, size[i] - 1);
+    }
+}
+
 inline FSpectrum Texture3D::sample_spectrum_impl(const FVec3 &uvw) const noexcept
 {
     return FSpectrum(sample_real_impl(uvw));
@@ -193,6 +266,16 @@ inline real Texture3D::sample_real_impl(const FVec3 &uvw) const noexcept
     return sample_spectrum_impl(uvw).r;
 }
 
+inline real Texture3D::max_real_in_bound(const AABB &uvw_bound) const noexcept
+{
+    return max_real();
+}
+
+inline real Texture3D::min_real_in_bound(const AABB &uvw_bound) const noexcept
+{
+    return 0;
+}
+
 inline FSpectrum Texture3D::sample_spectrum(const FVec3 &uvw) const noexcept
 {
     auto tuvw = transform_.apply_to_point(uvw);
@@ -5,14 +5,37 @@
 
 AGZ_TRACER_BEGIN
 
+/**
+ * @brief parallelogram ABCD through which environment light enters the scene
+ *
+ * D = A + C - B
+ */
+struct EnvirLightPortal
+{
+    FVec3 a;
+    FVec3 b;
+    FVec3 c;
+};
+
+/**
+ * @param portals when not empty, light is sampled only through these portals
+ * @param sampler_cache_filename when not empty, importance sampling data is
+ *  loaded from this file if it was saved with the same sampler_cache_key.
+ *  otherwise, the data is built from tex and saved to this file
+ * @param sampler_cache_key typically a hash of the texture file
+ */
 RC<EnvirLight> create_ibl_light(
     RC<const Texture2D> tex,
     bool no_importance_sampling = false,
-    real user_specified_power = -1);
+    real user_specified_power = -1,
+    const std::string &sampler_cache_filename = {},
+    uint64_t sampler_cache_key = 0,
+    const std::vector<EnvirLightPortal> &portals = {});
 
 RC<EnvirLight> create_native_sky(
     const FSpectrum &top,
     const FSpectrum &bottom,
-    real user_specified_power = -1);
+    real user_specified_power = -1,
+    const std::vector<EnvirLightPortal> &portals = {});
 
 AGZ_TRACER_END
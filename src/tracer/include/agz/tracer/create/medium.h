@@ -7,12 +7,20 @@
 
 AGZ_TRACER_BEGIN
 
+/**
+ * @param majorant_grid_res resolution of local majorant grid.
+ *  non-positive value means automatically determined by density texture size
+ * @param use_residual_ratio_tracking estimate transmittance with residual
+ *  ratio tracking instead of ratio tracking
+ */
 RC<Medium> create_heterogeneous_medium(
     const FTransform3 &local_to_world,
     RC<const Texture3D> density,
     RC<const Texture3D> albedo,
     RC<const Texture3D> g,
-    int max_scattering_count);
+    int max_scattering_count,
+    int majorant_grid_res = 0,
+    bool use_residual_ratio_tracking = true);
 
 RC<Medium> create_homogeneous_medium(
     const FSpectrum &sigma_a,
@@ -7,12 +7,27 @@ AGZ_TRACER_BEGIN
 RC<PostProcessor> create_aces_tone_mapper(
     real exposure);
 
+RC<PostProcessor> create_bilateral_denoiser(
+    int radius,
+    real sigma_spatial, real sigma_color,
+    real sigma_albedo, real sigma_normal,
+    int worker_count);
+
 RC<PostProcessor> create_gamma_corrector(
     real gamma);
 
 RC<PostProcessor> create_oidn_denoiser(
     bool clamp_color);
 
+/**
+ * @brief save per-pixel rendering cost as a false-colour heatmap
+ *
+ * @param max_cost cost mapped to the hottest colour. non-positive value
+ *  means using the given percentile of pixel costs
+ */
+RC<PostProcessor> create_saving_cost_heatmap(
+    std::string filename, real max_cost, real percentile, bool log_scale);
+
 RC<PostProcessor> create_saving_gbuffer_to_png(
     std::string albedo_filename,
     std::string normal_filename);
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <string>
+
 #include <agz/tracer/core/renderer.h>
 #include <agz/tracer/core/sampler.h>
 
@@ -21,11 +23,62 @@ struct PTRendererParams
     int spp = 1;
 
     int specular_depth = 20;
+
+    // path guiding. when enabled, training iterations with 1, 2, 4, ... spp
+    // are rendered before the final pass to learn incident radiance. the
+    // total training spp is at most guiding_training_budget * spp
+
+    bool use_guiding = false;
+    int guiding_training_iterations = 5;
+    real guiding_training_budget = real(0.25);
+    real guiding_bsdf_fraction = real(0.5);
+    real guiding_spatial_threshold = 12000;
+    real guiding_directional_threshold = real(0.01);
 };
 
 RC<Renderer> create_pt_renderer(
     const PTRendererParams &params);
 
+// irradiance cache
+
+struct IrradianceCacheRendererParams
+{
+    int worker_count   = 0;
+    int task_grid_size = 32;
+
+    int spp = 4;
+
+    // max number of non-diffuse scatterings before reaching a diffuse surface
+    int forward_max_depth = 8;
+
+    // final gathering
+
+    int gather_theta_count = 16;
+    int gather_phi_count   = 48;
+
+    int gather_min_depth  = 3;
+    int gather_max_depth  = 8;
+    real gather_cont_prob = real(0.9);
+
+    // record placement and interpolation
+
+    real accuracy   = real(0.2);
+    real min_radius = real(0.0005);
+    real max_radius = real(0.05);
+
+    bool use_gradients = true;
+
+    // initial pixel stride of the prepass. 0 disables the prepass
+    int prepass_stride = 16;
+
+    // when not empty, records are loaded from this file if possible,
+    // and all records are saved to it after rendering
+    std::string cache_filename;
+};
+
+RC<Renderer> create_irradiance_cache_renderer(
+    const IrradianceCacheRendererParams &params);
+
 // particle tracing
 
 struct AdjointPTRendererParams
@@ -82,6 +135,13 @@ struct VolBDPTRendererParams
     int spp = 1;
 
     bool use_mis = true;
+
+    // trace light subpaths once per iteration and share them among all
+    // pixels. camera vertices connect to lvc_connection_count vertices
+    // resampled from the cache (0 means the average light subpath length)
+
+    bool use_light_vertex_cache = false;
+    int lvc_connection_count = 0;
 };
 
 RC<Renderer> create_vol_bdpt_renderer(const VolBDPTRendererParams &params);
@@ -138,4 +198,25 @@ struct PSSMLTPTRendererParams
 
 RC<Renderer> create_pssmlt_pt_renderer(const PSSMLTPTRendererParams &params);
 
+// multiplexed mlt
+
+struct MMLTRendererParams
+{
+    int worker_count = 0;
+
+    // max number of path edges. each depth has its own markov chains
+    int max_depth = 10;
+
+    // number of startup samples of each depth
+    int startup_sample_count = 100000;
+    int mut_per_pixel = 100;
+
+    real sigma = real(0.01);
+    real large_step_prob = real(0.3);
+
+    int chain_count = 1000;
+};
+
+RC<Renderer> create_mmlt_renderer(const MMLTRendererParams &params);
+
 AGZ_TRACER_END
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <agz/tracer/core/texture2d.h>
+#include <agz/tracer/utility/tile_cache.h>
 
 AGZ_TRACER_BEGIN
 
@@ -24,4 +25,28 @@ RC<Texture2D> create_image_texture(
     const Texture2DCommonParams &common_params,
     RC<const Image2D<math::color3b>> data, const std::string &sampler);
 
+/**
+ * @brief texture streamed from a tiled texture file
+ *
+ * only tiles being accessed are kept in memory, with the budget given by
+ * TileCache::set_budget
+ */
+RC<Texture2D> create_tiled_texture(
+    const Texture2DCommonParams &common_params,
+    RC<const TiledImageFile> file, const std::string &sampler);
+
+/**
+ * @brief convert an image to tiled texture file, including its mip chain
+ *
+ * @param inv_gamma gamma decoding exponent of texels. levels are filtered in
+ *  linear space
+ */
+void write_tiled_texture(
+    const std::string &filename, int tile_size,
+    RC<const Image2D<math::color3b>> data, real inv_gamma = 1);
+
+void write_tiled_texture(
+    const std::string &filename, int tile_size,
+    RC<const Image2D<math::color3f>> data, real inv_gamma = 1);
+
 AGZ_TRACER_END
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <agz/tracer/core/texture3d.h>
+#include <agz/tracer/utility/brick_volume.h>
 #include <agz/utility/texture/texture3d.h>
 
 AGZ_TRACER_BEGIN
@@ -29,4 +30,12 @@ RC<Texture3D> create_image3d(
     RC<const Image3D<math::color3b>> data,
     bool use_linear_sampler);
 
+/**
+ * @brief real-valued 3d texture backed by a sparse brick volume
+ */
+RC<Texture3D> create_sparse3d(
+    const Texture3DCommonParams &common_params,
+    RC<const BrickVolume> data,
+    bool use_linear_sampler);
+
 AGZ_TRACER_END
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <algorithm>
+#include <vector>
+
 #include <agz/tracer/core/light.h>
 #include <agz/tracer/render/common.h>
 
@@ -116,6 +119,121 @@ struct LightSubpath : Subpath
 
 };
 
+/**
+ * @brief light subpaths shared by all camera subpaths of an iteration
+ *
+ * instead of tracing one light subpath per camera subpath, light subpaths of
+ * an iteration are traced once into the cache, and each camera vertex
+ * connects to a few vertices resampled uniformly from the cache.
+ *
+ * each thread stores vertices in its own block, so that tracing needs no
+ * synchronization. bsdfs of cached vertices are allocated in the block
+ * arenas and stay valid until clear() is called.
+ *
+ * the ith subpath is recorded in the ith slot, so the order of subpaths and
+ * connectable vertices doesn't depend on which thread traced them.
+ */
+class LightVertexCache : public misc::uncopyable_t
+{
+public:
+
+    /**
+     * @brief a connectable vertex. it's light_subpath[t - 1]
+     */
+    struct Entry
+    {
+        const Vertex *light_subpath = nullptr;
+        int t = 0;
+    };
+
+    explicit LightVertexCache(int thread_count);
+
+    /**
+     * @brief remove all subpaths, release memory of bsdfs and prepare slots
+     *  for subpath_count subpaths
+     */
+    void clear(int subpath_count);
+
+    /**
+     * @brief trace a light subpath into the given slot
+     *
+     * can be called concurrently with different thread_index and
+     * subpath_index
+     */
+    void add_subpath(
+        int thread_index, int subpath_index, int max_vertex_count,
+        const Scene &scene, Sampler &sampler);
+
+    /**
+     * @brief build the subpath and connectable vertex lists in slot order
+     *
+     * must be called after all add_subpath and before sampling
+     */
+    void finalize();
+
+    /**
+     * @brief number of traced subpaths, including failed ones
+     */
+    int traced_subpath_count() const noexcept;
+
+    /**
+     * @brief number of non-empty subpaths
+     */
+    int subpath_count() const noexcept;
+
+    /**
+     * @brief get the ith non-empty subpath
+     */
+    LightSubpath subpath(int i) const noexcept;
+
+    /**
+     * @brief number of connectable vertices (t >= 2)
+     */
+    int vertex_count() const noexcept;
+
+    /**
+     * @brief uniformly sample a connectable vertex
+     *
+     * vertex_count() must be positive
+     */
+    const Entry &sample(real u) const noexcept;
+
+    /**
+     * @brief relative connection count used by mis weights
+     *
+     * connections_per_vertex * traced_subpath_count / vertex_count
+     */
+    real connect_count(int connections_per_vertex) const noexcept;
+
+    /**
+     * @brief the average number of connectable vertices of each subpath
+     */
+    int average_vertex_count() const noexcept;
+
+private:
+
+    struct Block
+    {
+        Arena arena;
+        std::vector<Vertex> vertices;
+    };
+
+    struct Slot
+    {
+        int block        = 0;
+        int vertex_count = -1; // -1 for untraced subpaths
+        size_t offset    = 0;  // of the first vertex in the block
+    };
+
+    std::vector<Box<Block>> blocks_;
+    std::vector<Slot> slots_;
+
+    std::vector<LightSubpath> subpaths_;
+    std::vector<Entry> entries_;
+
+    int traced_subpath_count_ = 0;
+};
+
 CameraSubpath build_camera_subpath(
     int max_vertex_count, const Ray &ray,
     const Scene &scene, Sampler &sampler,
@@ -156,33 +274,45 @@ FSpectrum unweighted_contrib_sx_tx(
     const Vertex *light_subpath, int t,
     Sampler &sampler);
 
+/*
+ * connect_count: number of s >= 2, t >= 2 connections sampled per camera
+ * vertex, relative to standard bdpt where each camera subpath connects to
+ * one light subpath. it's 1 except when using a light vertex cache
+ */
+
 real mis_weight_sx_t0(
     const Scene &scene,
-    Vertex *camera_subpath, int s);
+    Vertex *camera_subpath, int s,
+    real connect_count = 1);
 
 real mis_weight_sx_t1(
     const Scene &scene,
     Vertex *camera_subpath, int s,
-    Vertex *light_subpath);
+    Vertex *light_subpath,
+    real connect_count = 1);
 
 real mis_weight_s1_tx(
     const Scene &scene,
     Vertex *camera_subpath,
-    Vertex *light_subpath, int t);
+    Vertex *light_subpath, int t,
+    real connect_count = 1);
 
 real mis_weight_sx_tx(
     Vertex *camera_subpath, int s,
-    Vertex *light_subpath, int t);
+    Vertex *light_subpath, int t,
+    real connect_count = 1);
 
 FSpectrum weighted_contrib_sx_t0(
     const Scene &scene,
-    Vertex *camera_subpath, int s);
+    Vertex *camera_subpath, int s,
+    real connect_count = 1);
 
 FSpectrum weighted_contrib_sx_t1(
     const Scene &scene,
     Vertex *camera_subpath, int s,
     Vertex *light_subpath,
-    Sampler &sampler);
+    Sampler &sampler,
+    real connect_count = 1);
 
 FSpectrum weighted_contrib_s1_tx(
     const Scene &scene,
@@ -191,13 +321,15 @@ FSpectrum weighted_contrib_s1_tx(
     Sampler &sampler,
     const Rect2 &sample_pixel_bound,
     const Vec2 &full_res,
-    Vec2 &pixel_coord);
+    Vec2 &pixel_coord,
+    real connect_count = 1);
 
 FSpectrum weighted_contrib_sx_tx(
     const Scene &scene,
     Vertex *camera_subpath, int s,
     Vertex *light_subpath, int t,
-    Sampler &sampler);
+    Sampler &sampler,
+    real connect_count = 1);
 
 struct EvalBDPTPathParams
 {
@@ -330,6 +462,103 @@ FSpectrum eval_bdpt_path(
     return ret;
 }
 
+/**
+ * @brief eval a camera subpath with a light vertex cache
+ *
+ * strategies with s = 1 are not evaluated here, and should be evaluated
+ * for each cached light subpath.
+ *
+ * @param light_vertex freshly sampled light subpath with at most 1 vertex,
+ *  used by strategies with t = 1
+ * @param subpath_space space of at least max light subpath vertex count,
+ *  where resampled light subpaths are copied to, since mis weight evaluation
+ *  temporarily modifies vertices
+ */
+template<bool UseMIS>
+FSpectrum eval_lvc_path(
+    const EvalBDPTPathParams &params,
+    Vertex *camera_subpath, int camera_vertex_count,
+    Vertex *light_vertex, int light_vertex_count,
+    const LightVertexCache &cache, int connections_per_vertex,
+    Vertex *subpath_space)
+{
+    FSpectrum ret;
+
+    const bool can_connect = cache.vertex_count() > 0 &&
+                             connections_per_vertex > 0;
+    const real connect_count = can_connect ?
+        cache.connect_count(connections_per_vertex) : real(1);
+
+    for(int s = 2; s <= camera_vertex_count; ++s)
+    {
+        // t = 0
+
+        if(s == 2)
+            ret += contrib_s2_t0(params.scene, camera_subpath);
+        else if constexpr(UseMIS)
+        {
+            ret += weighted_contrib_sx_t0(
+                params.scene, camera_subpath, s, connect_count);
+        }
+        else
+        {
+            ret += unweighted_contrib_sx_t0(
+                params.scene, camera_subpath, s) / real(s);
+        }
+
+        // t = 1
+
+        if(light_vertex_count >= 1)
+        {
+            if constexpr(UseMIS)
+            {
+                ret += weighted_contrib_sx_t1(
+                    params.scene, camera_subpath, s, light_vertex,
+                    params.sampler, connect_count);
+            }
+            else
+            {
+                ret += unweighted_contrib_sx_t1(
+                    params.scene, camera_subpath, s, light_vertex,
+                    params.sampler) / real(s + 1);
+            }
+        }
+
+        // t >= 2: connect to resampled cached vertices
+
+        if(!can_connect)
+            continue;
+
+        FSpectrum connect_sum;
+        for(int i = 0; i < connections_per_vertex; ++i)
+        {
+            const auto &entry = cache.sample(params.sampler.sample1().u);
+            const int t = entry.t;
+            std::copy(entry.light_subpath, entry.light_subpath + t, subpath_space);
+
+            if constexpr(UseMIS)
+            {
+                connect_sum += weighted_contrib_sx_tx(
+                    params.scene, camera_subpath, s, subpath_space, t,
+                    params.sampler, connect_count);
+            }
+            else
+            {
+                connect_sum += unweighted_contrib_sx_tx(
+                    params.scene, camera_subpath, s, subpath_space, t,
+                    params.sampler) / real(s + t);
+            }
+        }
+
+        // each vertex is selected with probability 1 / vertex_count, and
+        // the estimation is shared by all traced subpaths
+
+        ret += connect_sum / connect_count;
+    }
+
+    return ret;
+}
+
 } // namespace bdpt
 
 AGZ_TRACER_RENDER_END
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+
+#include <agz/tracer/core/camera.h>
+#include <agz/tracer/core/intersection.h>
+#include <agz/tracer/render/common.h>
+#include <agz/tracer/render/path_tracing.h>
+
+AGZ_TRACER_RENDER_BEGIN
+
+namespace ic
+{
+
+/**
+ * irradiance caching with final gathering:
+ *  1. indirect irradiance is computed at sparse world-space records by
+ *     gathering incident radiance over the hemisphere with path tracing
+ *  2. a new record is created only when no existing record can be used at
+ *     the query point within the error bound (split-sphere heuristic), so
+ *     that records concentrate near geometric details
+ *  3. records store translational and rotational gradients, which are used
+ *     to extrapolate irradiance before interpolation
+ *  4. the octree of records supports lock-free concurrent insertion and
+ *     lookup, so that records can be created by all rendering threads
+ */
+
+/**
+ * @brief irradiance record
+ */
+struct Record
+{
+    FVec3 pos;
+    FVec3 nor;
+
+    // harmonic mean distance to surfaces visible from pos
+    real radius = 0;
+
+    FSpectrum irradiance;
+
+    // gradients of each spectrum channel
+    FVec3 trans_grad[SPECTRUM_COMPONENT_COUNT];
+    FVec3 rot_grad  [SPECTRUM_COMPONENT_COUNT];
+};
+
+struct CacheParams
+{
+    // max allowed interpolation error. smaller value leads to more records
+    real accuracy = real(0.2);
+
+    // bounds of record radius, relative to diagonal of the world bound
+    real min_radius = real(0.0005);
+    real max_radius = real(0.05);
+
+    bool use_gradients = true;
+};
+
+/**
+ * @brief octree of irradiance records
+ */
+class IrradianceCache : public misc::uncopyable_t
+{
+public:
+
+    IrradianceCache(const AABB &world_bound, const CacheParams &params);
+
+    ~IrradianceCache();
+
+    /**
+     * @brief interpolate irradiance at given surface point
+     *
+     * nor must be on the same side as the incident radiance.
+     * thread-safe
+     *
+     * @return false when no record is valid at pos
+     */
+    bool lookup(
+        const FVec3 &pos, const FVec3 &nor,
+        FSpectrum *irradiance) const noexcept;
+
+    /**
+     * @brief add a record. thread-safe
+     *
+     * radius of the record is clamped by gradients and the radius bounds
+     */
+    void insert(const Record &record);
+
+    size_t record_count() const noexcept;
+
+    /**
+     * @brief save all records to file
+     */
+    void save(const std::string &filename) const;
+
+    /**
+     * @brief add records saved by save()
+     *
+     * throw when the file can't be read or has an incompatible format
+     */
+    void load(const std::string &filename);
+
+private:
+
+    struct RecordNode;
+    struct RecordRef;
+    struct OctreeNode;
+
+    void insert(
+        OctreeNode *node, const FVec3 &low, real size, int depth,
+        const Record *record, const AABB &record_bound);
+
+    static void destroy(OctreeNode *node) noexcept;
+
+    CacheParams params_;
+
+    real min_radius_;
+    real max_radius_;
+
+    // root node covers a cube
+    FVec3 root_low_;
+    real root_size_;
+
+    OctreeNode *root_;
+
+    // all records, for serialization and destruction
+    std::atomic<RecordNode*> all_records_;
+    std::atomic<size_t> record_count_;
+};
+
+struct GatherParams
+{
+    // strata of gathering rays. theta_count * phi_count rays are traced
+    // for each record
+    int theta_count = 16;
+    int phi_count   = 48;
+
+    // params of paths computing incident radiance along gathering rays
+    TraceParams trace_params;
+};
+
+/**
+ * @brief compute a record at a surface point by final gathering
+ *
+ * only indirect incident radiance is gathered. radiance directly emitted by
+ * lights should be computed with direct illumination at the query point.
+ *
+ * @param nor normal of the gathering hemisphere. must be on the same side
+ *  as inct.wr
+ */
+Record compute_record(
+    const GatherParams &params, const Scene &scene,
+    const EntityIntersection &inct, const FVec3 &nor,
+    Sampler &sampler);
+
+} // namespace ic
+
+struct IrradianceCacheTraceParams
+{
+    // max number of non-diffuse scatterings before reaching a diffuse surface
+    int forward_max_depth = 8;
+
+    int direct_illum_sample_count = 1;
+
+    ic::GatherParams gather_params;
+};
+
+/**
+ * @brief trace a camera path with irradiance cache
+ *
+ * the path is traced through non-diffuse surfaces until a surface with
+ * diffuse component, where indirect illumination is approximated as
+ * albedo / pi * cached irradiance. missing records are computed and
+ * inserted into the cache.
+ *
+ * participating media are not supported
+ */
+Pixel trace_irradiance_cache(
+    const IrradianceCacheTraceParams &params,
+    ic::IrradianceCache &cache,
+    const Scene &scene, const Ray &ray,
+    Sampler &sampler, Arena &arena,
+    const CameraRayDifferential *ray_diff = nullptr);
+
+AGZ_TRACER_RENDER_END
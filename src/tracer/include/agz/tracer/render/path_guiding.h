@@ -0,0 +1,248 @@
+#pragma once
+
+#include <vector>
+
+#include <agz/tracer/core/camera.h>
+#include <agz/tracer/render/common.h>
+#include <agz/tracer/render/path_tracing.h>
+
+AGZ_TRACER_RENDER_BEGIN
+
+namespace guiding
+{
+
+/**
+ * practical path guiding with a spatial-directional tree (sd-tree):
+ *  1. the spatial part is a binary tree over the world bound. each leaf
+ *     owns two directional quadtrees (d-trees)
+ *  2. the sampling d-tree of a leaf approximates the incident radiance
+ *     learnt in earlier iterations, and is used to sample directions
+ *  3. the building d-tree collects radiance of the current iteration.
+ *     rendering threads record into their own SDTreeRecorder, which are
+ *     merged into building d-trees at the end of the iteration
+ *  4. after each iteration, building d-trees become sampling d-trees, and
+ *     both the spatial and the directional structures are refined
+ */
+
+/**
+ * @brief map a point in [0, 1]^2 to a unit direction
+ *
+ * the mapping is area-preserving (cylindrical), so pdf w.r.t. solid angle
+ * equals pdf in [0, 1]^2 divided by 4pi
+ */
+FVec3 square_to_dir(const Vec2 &p) noexcept;
+
+/**
+ * @brief inverse of square_to_dir
+ */
+Vec2 dir_to_square(const FVec3 &dir) noexcept;
+
+/**
+ * @brief directional quadtree over [0, 1]^2
+ *
+ * each node stores energy of its four quadrants. a quadrant is either a
+ * leaf or refers to a child node.
+ */
+class DTree
+{
+public:
+
+    DTree();
+
+    /**
+     * @brief add energy at the given direction
+     */
+    void record(const FVec3 &dir, real value) noexcept;
+
+    /**
+     * @brief add energy of another tree with the same structure
+     */
+    void merge(const DTree &other) noexcept;
+
+    /**
+     * @brief clear energy of all nodes and keep the structure
+     */
+    void clear_energy() noexcept;
+
+    /**
+     * @brief total recorded energy
+     */
+    real total() const noexcept;
+
+    /**
+     * @brief sample a direction proportional to recorded energy
+     *
+     * pdf is w.r.t. solid angle
+     */
+    FVec3 sample(const Sample2 &sam, real *pdf) const noexcept;
+
+    /**
+     * @brief pdf w.r.t. solid angle of sampling dir with sample()
+     */
+    real pdf(const FVec3 &dir) const noexcept;
+
+    /**
+     * @brief create an empty tree with structure refined by energy of this
+     *
+     * a quadrant is subdivided when it holds more than energy_threshold of
+     * the total energy, and its depth is less than max_depth
+     */
+    DTree refined(real energy_threshold, int max_depth) const;
+
+    /**
+     * @brief number of quadtree nodes
+     */
+    size_t node_count() const noexcept;
+
+private:
+
+    struct Node
+    {
+        real sum(int quadrant) const noexcept;
+
+        real total() const noexcept;
+
+        real sums[4] = { 0, 0, 0, 0 };
+
+        // child node index of each quadrant. 0 means leaf quadrant
+        int32_t children[4] = { 0, 0, 0, 0 };
+    };
+
+    std::vector<Node> nodes_;
+};
+
+struct SDTreeParams
+{
+    // a spatial leaf is split when its sample count exceeds
+    // spatial_threshold * sqrt(spp of the last iteration)
+    real spatial_threshold = 12000;
+
+    // a directional quadrant is subdivided when it holds more than
+    // directional_threshold of the energy of its d-tree
+    real directional_threshold = real(0.01);
+
+    int max_directional_depth = 20;
+};
+
+class SDTree;
+
+/**
+ * @brief per-thread radiance records of a training iteration
+ *
+ * d-trees of a spatial leaf are copied from the building d-tree when the
+ * leaf is recorded into for the first time
+ */
+class SDTreeRecorder
+{
+public:
+
+    explicit SDTreeRecorder(const SDTree &sd_tree);
+
+    /**
+     * @param value incident radiance divided by pdf of sampling dir
+     */
+    void record(int leaf, const FVec3 &dir, real value);
+
+private:
+
+    friend class SDTree;
+
+    struct Leaf
+    {
+        bool touched = false;
+        DTree dtree;
+        uint64_t sample_count = 0;
+    };
+
+    const SDTree *sd_tree_;
+    std::vector<Leaf> leaves_;
+};
+
+/**
+ * @brief spatial-directional tree
+ */
+class SDTree : public misc::uncopyable_t
+{
+public:
+
+    SDTree(const AABB &world_bound, const SDTreeParams &params);
+
+    /**
+     * @brief find spatial leaf containing pos
+     */
+    int find_leaf(const FVec3 &pos) const noexcept;
+
+    /**
+     * @brief d-tree for sampling directions at the given leaf
+     */
+    const DTree &sampling_dtree(int leaf) const noexcept;
+
+    /**
+     * @brief finish a training iteration
+     *
+     * merge recorders into building d-trees, use the recorded radiance for
+     * sampling, and refine the tree for the next iteration. recorders are
+     * reset for the refined tree. must not be called concurrently with other
+     * methods.
+     *
+     * @param iteration_spp spp of the finished iteration
+     */
+    void update(int iteration_spp, std::vector<SDTreeRecorder> &recorders);
+
+    int leaf_count() const noexcept;
+
+private:
+
+    friend class SDTreeRecorder;
+
+    struct Node
+    {
+        int axis     = 0;
+        int leaf     = -1; // -1 for interior nodes
+        int children[2] = { 0, 0 };
+    };
+
+    struct Leaf
+    {
+        DTree sampling;
+        DTree building;
+
+        uint64_t sample_count = 0;
+    };
+
+    SDTreeParams params_;
+
+    FVec3 bound_low_;
+    FVec3 bound_size_;
+
+    std::vector<Node> nodes_;
+    std::vector<Leaf> leaves_;
+};
+
+} // namespace guiding
+
+struct GuidingParams
+{
+    // probability of sampling bsdf instead of the guiding distribution
+    real bsdf_sampling_fraction = real(0.5);
+};
+
+/**
+ * @brief path tracing with mis and path guiding
+ *
+ * at non-specular surface vertices, directions are sampled from a
+ * one-sample mis mixture of the bsdf and the sampling d-tree.
+ *
+ * when recorder is not nullptr, incident radiance at all guided vertices
+ * are recorded into it
+ */
+Pixel trace_guided(
+    const TraceParams &params,
+    const GuidingParams &guiding_params,
+    const guiding::SDTree &sd_tree,
+    guiding::SDTreeRecorder *recorder,
+    const Scene &scene, const Ray &ray,
+    Sampler &sampler, Arena &arena,
+    const CameraRayDifferential *ray_diff = nullptr);
+
+AGZ_TRACER_RENDER_END
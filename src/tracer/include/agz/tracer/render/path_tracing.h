@@ -1,5 +1,7 @@
 #pragma once
 
+#include <agz/tracer/core/camera.h>
+#include <agz/tracer/core/intersection.h>
 #include <agz/tracer/render/common.h>
 
 AGZ_TRACER_RENDER_BEGIN
@@ -32,15 +34,48 @@ struct AlbedoAOParams
     real max_occlusion_distance = 1;
 };
 
+/**
+ * @brief fill uv differentials of a primary intersection
+ *
+ * differential rays are intersected with the tangent plane at the
+ * intersection, and offsets are converted to uv with dpdu and dpdv. uv
+ * differentials are left as zero when dpdu/dpdv are unknown or the rays are
+ * parallel to the plane
+ */
+void compute_uv_differentials(
+    EntityIntersection &inct, const CameraRayDifferential &ray_diff);
+
+/**
+ * @brief path tracing with mis
+ *
+ * @param ray_diff differentials of primary ray. used for texture filtering
+ *  at the first intersection when not nullptr
+ */
 Pixel trace_std(
     const TraceParams &params,
     const Scene &scene, const Ray &ray,
+    Sampler &sampler, Arena &arena,
+    const CameraRayDifferential *ray_diff = nullptr);
+
+/**
+ * @brief trace_std with a known closest intersection of ray
+ *
+ * radiance emitted at first_inct is not included
+ */
+Pixel trace_std_from(
+    const TraceParams &params,
+    const Scene &scene, const Ray &ray,
+    const EntityIntersection &first_inct,
     Sampler &sampler, Arena &arena);
 
+/**
+ * @brief path tracing without mis
+ */
 Pixel trace_nomis(
     const TraceParams &params,
     const Scene &scene, const Ray &ray,
-    Sampler &sampler, Arena &arena);
+    Sampler &sampler, Arena &arena,
+    const CameraRayDifferential *ray_diff = nullptr);
 
 Pixel trace_ao(
     const AOParams &params,
@@ -8,13 +8,28 @@ AGZ_TRACER_RENDER_BEGIN
 namespace pssmlt
 {
 
+/**
+ * @brief primary sample space sampler
+ *
+ * primary samples can be divided into several interleaved streams, so that
+ * samples consumed by one part of the path (camera subpath, light subpath,
+ * etc.) don't shift dimensions of another part
+ */
 class PSSMLTSampler : public Sampler
 {
 public:
 
     PSSMLTSampler(
         real sigma, real large_mut_prob,
-        const NativeSampler &native_sampler);
+        const NativeSampler &native_sampler,
+        int stream_count = 1);
+
+    /**
+     * @brief following samples are taken from the given stream
+     *
+     * each stream restarts from its first dimension in every iteration
+     */
+    void start_stream(int stream_index);
 
     Sample1 sample1() override;
     Sample2 sample2() override;
@@ -49,7 +64,9 @@ private:
     uint64_t curr_iter_;
     uint64_t last_large_iter_;
 
-    size_t next_dim_;
+    int stream_count_;
+    int stream_index_;
+    std::vector<size_t> next_stream_dims_;
 
     std::vector<PrimarySample> primary_samples_;
 };
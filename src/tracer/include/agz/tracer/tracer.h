@@ -47,5 +47,7 @@
 #include <agz/tracer/utility/parallel_grid.h>
 #include <agz/tracer/utility/phase_function.h>
 #include <agz/tracer/utility/reflection.h>
+#include <agz/tracer/utility/render_stats.h>
 #include <agz/tracer/utility/sphere_aux.h>
+#include <agz/tracer/utility/trace.h>
 #include <agz/tracer/utility/triangle_aux.h>
@@ -0,0 +1,353 @@
+#pragma once
+
+#include <cassert>
+#include <mutex>
+#include <vector>
+
+#include <agz/tracer/common.h>
+#include <agz/utility/thread.h>
+
+AGZ_TRACER_BEGIN
+
+/**
+ * @brief sparse real-valued volume stored as a pool of 8^3 bricks
+ *
+ * each brick stores 9^3 texels: its own 8^3 texels plus one texel of apron
+ * on the positive side of each axis. thus the 8 texels used by a trilinear
+ * lookup always come from the same brick.
+ *
+ * bricks whose texels (including apron) are all equal are not allocated,
+ * and only their value is recorded in the top-level index. this culls empty
+ * regions of typical smoke/cloud data.
+ *
+ * texel coordinate convention is the same as dense 3d textures:
+ *  nearest: p = floor(u * size), linear: f = u * size - 0.5 (texel centres
+ *  at (i + 0.5) / size), clamped to the edge texels
+ */
+class BrickVolume
+{
+public:
+
+    static constexpr int BRICK_SIZE         = 8;
+    static constexpr int BRICK_STORAGE_SIZE = BRICK_SIZE + 1;
+    static constexpr int BRICK_TEXEL_COUNT  =
+        BRICK_STORAGE_SIZE * BRICK_STORAGE_SIZE * BRICK_STORAGE_SIZE;
+
+    /**
+     * @brief initialize an empty volume with given texel count on each axis
+     *
+     * bricks must be built with build_layer before sampling
+     */
+    void initialize(const Vec3i &size);
+
+    /**
+     * @brief build all bricks with the given brick z index
+     *
+     * func interface: real func(int x, int y, int z)
+     *
+     * func is called with global texel coordinates, and
+     * z is in [bz * 8, min(bz * 8 + 8, size.z - 1)].
+     * func may be called concurrently
+     */
+    template<typename Func>
+    void build_layer(int bz, const Func &texel);
+
+    /**
+     * @brief build all bricks from dense data
+     */
+    void build(const Image3D<real> &data);
+
+    const Vec3i &size() const noexcept;
+
+    const Vec3i &brick_count() const noexcept;
+
+    /**
+     * @brief number of bricks actually allocated in the brick pool
+     */
+    int allocated_brick_count() const noexcept;
+
+    /**
+     * @brief maximal texel value of the whole volume
+     */
+    real max_value() const noexcept;
+
+    /**
+     * @brief minimal texel value of the whole volume
+     */
+    real min_value() const noexcept;
+
+    /**
+     * @brief min/max value of a brick, including its apron
+     */
+    real brick_min(int bx, int by, int bz) const noexcept;
+
+    real brick_max(int bx, int by, int bz) const noexcept;
+
+    /**
+     * @brief min/max of bricks covering texels in [beg, end]
+     */
+    std::pair<real, real> range_in_texel_box(
+        const Vec3i &beg, const Vec3i &end) const noexcept;
+
+    /**
+     * @brief fetch a single texel
+     */
+    real texel(int x, int y, int z) const noexcept;
+
+    /**
+     * @brief nearest sampling with uvw in [0, 1]^3
+     */
+    real sample_nearest(const FVec3 &uvw) const noexcept;
+
+    /**
+     * @brief trilinear sampling with uvw in [0, 1]^3
+     */
+    real sample_linear(const FVec3 &uvw) const noexcept;
+
+private:
+
+    static constexpr int UNIFORM_BRICK = -1;
+
+    struct BrickInfo
+    {
+        int  pool_index = UNIFORM_BRICK; // offset in pool = index * BRICK_TEXEL_COUNT
+        real min_value  = 0;             // also the value of uniform brick
+        real max_value  = 0;
+    };
+
+    int brick_index(int bx, int by, int bz) const noexcept;
+
+    Vec3i size_;
+    Vec3i brick_count_;
+
+    std::vector<BrickInfo> bricks_;
+    std::vector<real>      pool_;
+};
+
+inline void BrickVolume::initialize(const Vec3i &size)
+{
+    if(size.x <= 0 || size.y <= 0 || size.z <= 0)
+        throw ObjectConstructionException("invalid brick volume size");
+
+    size_ = size;
+    brick_count_ = Vec3i(
+        (size.x - 1) / BRICK_SIZE + 1,
+        (size.y - 1) / BRICK_SIZE + 1,
+        (size.z - 1) / BRICK_SIZE + 1);
+
+    bricks_.assign(static_cast<size_t>(brick_count_.product()), BrickInfo{});
+    pool_.clear();
+}
+
+template<typename Func>
+void BrickVolume::build_layer(int bz, const Func &texel)
+{
+    assert(0 <= bz && bz < brick_count_.z);
+
+    std::mutex pool_mutex;
+
+    thread::parallel_forrange(0, brick_count_.y, [&](int, int by)
+    {
+        std::vector<real> row_pool;
+        std::vector<int> row_bricks;
+
+        real brick_texels[BRICK_TEXEL_COUNT];
+
+        for(int bx = 0; bx < brick_count_.x; ++bx)
+        {
+            const Vec3i org = Vec3i(bx, by, bz) * BRICK_SIZE;
+
+            real min_val = REAL_MAX, max_val = REAL_MIN;
+            int i = 0;
+            for(int lz = 0; lz < BRICK_STORAGE_SIZE; ++lz)
+            {
+                const int z = (std::min)(org.z + lz, size_.z - 1);
+                for(int ly = 0; ly < BRICK_STORAGE_SIZE; ++ly)
+                {
+                    const int y = (std::min)(org.y + ly, size_.y - 1);
+                    for(int lx = 0; lx < BRICK_STORAGE_SIZE; ++lx)
+                    {
+                        const int x = (std::min)(org.x + lx, size_.x - 1);
+                        const real val = texel(x, y, z);
+                        brick_texels[i++] = val;
+                        min_val = (std::min)(min_val, val);
+                        max_val = (std::max)(max_val, val);
+                    }
+                }
+            }
+
+            BrickInfo &info = bricks_[brick_index(bx, by, bz)];
+            info.min_value = min_val;
+            info.max_value = max_val;
+
+            if(min_val != max_val)
+            {
+                row_bricks.push_back(bx);
+                row_pool.insert(
+                    row_pool.end(),
+                    brick_texels, brick_texels + BRICK_TEXEL_COUNT);
+            }
+        }
+
+        if(row_bricks.empty())
+            return;
+
+        std::lock_guard lk(pool_mutex);
+
+        int pool_index = static_cast<int>(pool_.size() / BRICK_TEXEL_COUNT);
+        for(int bx : row_bricks)
+            bricks_[brick_index(bx, by, bz)].pool_index = pool_index++;
+        pool_.insert(pool_.end(), row_pool.begin(), row_pool.end());
+    });
+}
+
+inline void BrickVolume::build(const Image3D<real> &data)
+{
+    initialize(Vec3i(data.width(), data.height(), data.depth()));
+    for(int bz = 0; bz < brick_count_.z; ++bz)
+    {
+        build_layer(bz, [&](int x, int y, int z)
+        {
+            return data(z, y, x);
+        });
+    }
+}
+
+inline const Vec3i &BrickVolume::size() const noexcept
+{
+    return size_;
+}
+
+inline const Vec3i &BrickVolume::brick_count() const noexcept
+{
+    return brick_count_;
+}
+
+inline int BrickVolume::allocated_brick_count() const noexcept
+{
+    return static_cast<int>(pool_.size() / BRICK_TEXEL_COUNT);
+}
+
+inline real BrickVolume::max_value() const noexcept
+{
+    real ret = REAL_MIN;
+    for(auto &b : bricks_)
+        ret = (std::max)(ret, b.max_value);
+    return ret;
+}
+
+inline real BrickVolume::min_value() const noexcept
+{
+    real ret = REAL_MAX;
+    for(auto &b : bricks_)
+        ret = (std::min)(ret, b.min_value);
+    return ret;
+}
+
+inline real BrickVolume::brick_min(int bx, int by, int bz) const noexcept
+{
+    return bricks_[brick_index(bx, by, bz)].min_value;
+}
+
+inline real BrickVolume::brick_max(int bx, int by, int bz) const noexcept
+{
+    return bricks_[brick_index(bx, by, bz)].max_value;
+}
+
+inline std::pair<real, real> BrickVolume::range_in_texel_box(
+    const Vec3i &beg, const Vec3i &end) const noexcept
+{
+    real min_val = REAL_MAX, max_val = REAL_MIN;
+    for(int bz = beg.z / BRICK_SIZE; bz <= end.z / BRICK_SIZE; ++bz)
+    {
+        for(int by = beg.y / BRICK_SIZE; by <= end.y / BRICK_SIZE; ++by)
+        {
+            for(int bx = beg.x / BRICK_SIZE; bx <= end.x / BRICK_SIZE; ++bx)
+            {
+                const BrickInfo &info = bricks_[brick_index(bx, by, bz)];
+                min_val = (std::min)(min_val, info.min_value);
+                max_val = (std::max)(max_val, info.max_value);
+            }
+        }
+    }
+    return { min_val, max_val };
+}
+
+inline real BrickVolume::texel(int x, int y, int z) const noexcept
+{
+    const BrickInfo &info = bricks_[brick_index(
+        x / BRICK_SIZE, y / BRICK_SIZE, z / BRICK_SIZE)];
+    if(info.pool_index == UNIFORM_BRICK)
+        return info.min_value;
+
+    const int lx = x % BRICK_SIZE;
+    const int ly = y % BRICK_SIZE;
+    const int lz = z % BRICK_SIZE;
+
+    const real *brick = &pool_[
+        static_cast<size_t>(info.pool_index) * BRICK_TEXEL_COUNT];
+    return brick[(lz * BRICK_STORAGE_SIZE + ly) * BRICK_STORAGE_SIZE + lx];
+}
+
+inline real BrickVolume::sample_nearest(const FVec3 &uvw) const noexcept
+{
+    const int x = math::clamp(
+        static_cast<int>(uvw.x * size_.x), 0, size_.x - 1);
+    const int y = math::clamp(
+        static_cast<int>(uvw.y * size_.y), 0, size_.y - 1);
+    const int z = math::clamp(
+        static_cast<int>(uvw.z * size_.z), 0, size_.z - 1);
+    return texel(x, y, z);
+}
+
+inline real BrickVolume::sample_linear(const FVec3 &uvw) const noexcept
+{
+    const real fx = math::clamp(
+        uvw.x * size_.x - real(0.5), real(0), real(size_.x - 1));
+    const real fy = math::clamp(
+        uvw.y * size_.y - real(0.5), real(0), real(size_.y - 1));
+    const real fz = math::clamp(
+        uvw.z * size_.z - real(0.5), real(0), real(size_.z - 1));
+
+    // lower corner of the lookup. its +1 neighbors are always in the apron
+    // of the same brick
+
+    const int px = (std::min)(static_cast<int>(fx), (std::max)(size_.x - 2, 0));
+    const int py = (std::min)(static_cast<int>(fy), (std::max)(size_.y - 2, 0));
+    const int pz = (std::min)(static_cast<int>(fz), (std::max)(size_.z - 2, 0));
+
+    const BrickInfo &info = bricks_[brick_index(
+        px / BRICK_SIZE, py / BRICK_SIZE, pz / BRICK_SIZE)];
+    if(info.pool_index == UNIFORM_BRICK)
+        return info.min_value;
+
+    const real dx = fx - px, dy = fy - py, dz = fz - pz;
+
+    const int lx = px % BRICK_SIZE;
+    const int ly = py % BRICK_SIZE;
+    const int lz = pz % BRICK_SIZE;
+
+    constexpr int SY = BRICK_STORAGE_SIZE;
+    constexpr int SZ = BRICK_STORAGE_SIZE * BRICK_STORAGE_SIZE;
+
+    const real *t = &pool_[
+        static_cast<size_t>(info.pool_index) * BRICK_TEXEL_COUNT
+      + lz * SZ + ly * SY + lx];
+
+    const real c00 = t[0]       + (t[1]           - t[0])       * dx;
+    const real c10 = t[SY]      + (t[SY + 1]      - t[SY])      * dx;
+    const real c01 = t[SZ]      + (t[SZ + 1]      - t[SZ])      * dx;
+    const real c11 = t[SZ + SY] + (t[SZ + SY + 1] - t[SZ + SY]) * dx;
+
+    const real c0 = c00 + (c10 - c00) * dy;
+    const real c1 = c01 + (c11 - c01) * dy;
+
+    return c0 + (c1 - c0) * dz;
+}
+
+inline int BrickVolume::brick_index(int bx, int by, int bz) const noexcept
+{
+    return (bz * brick_count_.y + by) * brick_count_.x + bx;
+}
+
+AGZ_TRACER_END
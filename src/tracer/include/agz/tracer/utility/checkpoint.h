@@ -0,0 +1,238 @@
+#pragma once
+
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <agz/tracer/common.h>
+
+AGZ_TRACER_BEGIN
+
+/**
+ * @brief checkpoint settings of a rendering session
+ */
+struct CheckpointParams
+{
+    // empty means no checkpointing
+    std::string filename;
+
+    // min interval between two checkpoints, in seconds
+    real interval = 600;
+
+    // resume from filename if it exists
+    bool resume = false;
+
+    bool is_enabled() const noexcept { return !filename.empty(); }
+};
+
+/**
+ * @brief sampling range a checkpoint is rendered for
+ *
+ * resuming with another spp or film partition would mix samples of different
+ * sample sequences, so such checkpoints are rejected
+ */
+struct CheckpointSampleRange
+{
+    int spp             = 0; // spp (or iteration count) of the whole render
+    int partition_index = 0;
+    int partition_count = 1;
+
+    bool operator==(const CheckpointSampleRange &rhs) const noexcept
+    {
+        return spp             == rhs.spp &&
+               partition_index == rhs.partition_index &&
+               partition_count == rhs.partition_count;
+    }
+
+    bool operator!=(const CheckpointSampleRange &rhs) const noexcept
+    {
+        return !(*this == rhs);
+    }
+
+    std::string to_string() const;
+};
+
+/**
+ * @brief serialize renderer state into a checkpoint
+ *
+ * the header identifies the renderer, the film size and the sampling range.
+ * the renderer state must be read back by CheckpointReader in the same order
+ */
+class CheckpointWriter
+{
+public:
+
+    CheckpointWriter(
+        const std::string &renderer_name, int width, int height,
+        const CheckpointSampleRange &sample_range);
+
+    template<typename T,
+             typename = std::enable_if_t<std::is_arithmetic_v<T>>>
+    void write(T value)
+    {
+        const size_t offset = data_.size();
+        data_.resize(offset + sizeof(T));
+        std::memcpy(data_.data() + offset, &value, sizeof(T));
+    }
+
+    void write(const std::string &str);
+
+    void write(const Spectrum &s);
+
+    void write(const FSpectrum &s);
+
+    void write(const Vec3 &v);
+
+    template<typename T>
+    void write(const Image2D<T> &img)
+    {
+        write(int32_t(img.width()));
+        write(int32_t(img.height()));
+        for(int y = 0; y < img.height(); ++y)
+        {
+            for(int x = 0; x < img.width(); ++x)
+                write(img(y, x));
+        }
+    }
+
+    const std::vector<char> &data() const noexcept { return data_; }
+
+private:
+
+    std::vector<char> data_;
+};
+
+/**
+ * @brief deserialize renderer state written by CheckpointWriter
+ *
+ * throw ObjectConstructionException on invalid data
+ */
+class CheckpointReader
+{
+public:
+
+    /**
+     * @param renderer_name expected renderer name
+     * @param width expected film width
+     * @param height expected film height
+     */
+    CheckpointReader(
+        std::vector<char> data,
+        const std::string &renderer_name, int width, int height);
+
+    /**
+     * @brief sampling range recorded in the header
+     */
+    const CheckpointSampleRange &sample_range() const noexcept;
+
+    template<typename T,
+             typename = std::enable_if_t<std::is_arithmetic_v<T>>>
+    void read(T &value)
+    {
+        read_bytes(&value, sizeof(T));
+    }
+
+    void read(std::string &str);
+
+    void read(Spectrum &s);
+
+    void read(FSpectrum &s);
+
+    void read(Vec3 &v);
+
+    /**
+     * @brief img must be already initialized with the expected size
+     */
+    template<typename T>
+    void read(Image2D<T> &img)
+    {
+        int32_t width = 0, height = 0;
+        read(width);
+        read(height);
+        if(width != img.width() || height != img.height())
+            throw ObjectConstructionException(
+                "unmatched image size in checkpoint");
+
+        for(int y = 0; y < img.height(); ++y)
+        {
+            for(int x = 0; x < img.width(); ++x)
+                read(img(y, x));
+        }
+    }
+
+private:
+
+    void read_bytes(void *output, size_t bytes);
+
+    std::vector<char> data_;
+    size_t offset_;
+
+    CheckpointSampleRange sample_range_;
+};
+
+/**
+ * @brief periodically save checkpoints of a renderer
+ *
+ * checkpoints are written by a background thread, so that the rendering
+ * thread only pays for serializing its state. the file is first written
+ * to a temporary file and then renamed, so that a render killed during
+ * writing leaves the previous checkpoint intact
+ */
+class Checkpointer
+{
+public:
+
+    explicit Checkpointer(CheckpointParams params);
+
+    /**
+     * @brief wait for the pending write
+     */
+    ~Checkpointer();
+
+    Checkpointer(const Checkpointer &) = delete;
+
+    Checkpointer &operator=(const Checkpointer &) = delete;
+
+    bool is_enabled() const noexcept;
+
+    /**
+     * @brief load the checkpoint if resuming is requested and the
+     *  checkpoint file exists
+     *
+     * throw ObjectConstructionException when the checkpoint is saved with
+     * another sampling range
+     */
+    std::optional<CheckpointReader> load(
+        const std::string &renderer_name, int width, int height,
+        const CheckpointSampleRange &sample_range) const;
+
+    /**
+     * @brief whether the interval has elapsed since the last checkpoint
+     */
+    bool is_due() const noexcept;
+
+    /**
+     * @brief write the checkpoint in the background thread
+     *
+     * only blocks when the previous write is unfinished. failed writes
+     * are logged instead of interrupting the rendering
+     */
+    void save_async(CheckpointWriter writer);
+
+private:
+
+    using Clock = std::chrono::steady_clock;
+
+    void wait_pending() noexcept;
+
+    CheckpointParams params_;
+    Clock::time_point last_save_;
+
+    std::future<void> pending_;
+};
+
+AGZ_TRACER_END
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <agz/tracer/common.h>
+#include <agz/tracer/utility/trace.h>
 #include <agz/utility/thread.h>
 
 AGZ_TRACER_BEGIN
@@ -12,6 +13,8 @@ AGZ_TRACER_BEGIN
  * func interface: bool func(int thread_index, int beg, int end)
  *
  * if any one func call returns false, that worker thread is stopped immediately
+ *
+ * each func call is recorded as a trace event
  */
 template<typename Func>
 void parallel_for_1d_grid(
@@ -33,6 +36,8 @@ void parallel_for_1d_grid(
             const int beg = task_idx * grid_size;
             const int end = (std::min)(beg + grid_size, total_width);
 
+            AGZ_TRACE_SCOPE("task", "range");
+
             if constexpr(
                 std::is_convertible_v<
                 decltype(func(thread_index, beg, end)), bool>)
@@ -55,6 +60,8 @@ void parallel_for_1d_grid(
  * func interface: bool func(int thread_index, Rect2i grid)
  *
  * if any one func call returns false, that worker thread is stopped immediately
+ *
+ * each func call is recorded as a trace event
  */
 template<typename Func>
 void parallel_for_2d_grid(
@@ -86,6 +93,8 @@ void parallel_for_2d_grid(
 
             const Rect2i grid = { { x_beg, y_beg }, { x_end, y_end } };
 
+            AGZ_TRACE_SCOPE("task", "tile");
+
             if constexpr(
                 std::is_convertible_v<
                 decltype(func(thread_index, grid)), bool>)
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <agz/tracer/core/render_target.h>
+
+AGZ_TRACER_BEGIN
+
+/**
+ * @brief which share of the samples of a frame to render
+ *
+ * samples of each pixel are divided into count consecutive ranges of
+ * sample indices. since samplers are seeded by sample indices, partial
+ * films rendered by different processes can be merged into the same frame
+ * as rendered by a single process
+ */
+struct FilmPartition
+{
+    int index = 0;
+    int count = 1;
+
+    bool is_whole() const noexcept { return count == 1; }
+
+    /**
+     * @brief index of the first sample of this share among total_spp samples
+     */
+    int first_sample(int total_spp) const noexcept
+    {
+        return static_cast<int>(int64_t(total_spp) * index / count);
+    }
+
+    /**
+     * @brief number of samples of this share among total_spp samples
+     */
+    int spp(int total_spp) const noexcept
+    {
+        const int64_t end = int64_t(total_spp) * (index + 1) / count;
+        return static_cast<int>(end - first_sample(total_spp));
+    }
+};
+
+/**
+ * @brief unnormalized film
+ *
+ * image_buffer holds filter-weighted sums of pixel samples and the sum of
+ * filter weights. particle_image holds the sum of contributions of light
+ * subpaths, and is only available for light tracing renderers.
+ *
+ * partial films are merged by summation and normalized into a RenderTarget
+ */
+struct PartialFilm
+{
+    using ImageBuffer = ImageBufferTemplate<true, true, true, true, true>;
+
+    FilmPartition partition;
+
+    ImageBuffer image_buffer;
+
+    Image2D<Spectrum> particle_image;
+    uint64_t particle_count = 0;
+
+    // empty when pixel costs are not recorded
+    Image2D<real> cost;
+
+    PartialFilm() = default;
+
+    /**
+     * @brief zero-initialized film. cost is allocated when with_cost is true
+     */
+    PartialFilm(int width, int height, bool with_cost);
+
+    int width() const noexcept { return image_buffer.value.width(); }
+
+    int height() const noexcept { return image_buffer.value.height(); }
+
+    /**
+     * @brief accumulate samples of another partial film with the same size
+     */
+    void merge(const PartialFilm &other);
+
+    RenderTarget to_render_target() const;
+
+    /**
+     * @brief throw ObjectConstructionException on failure
+     */
+    void save(const std::string &filename) const;
+
+    /**
+     * @brief throw ObjectConstructionException on failure or unmatched size
+     */
+    static PartialFilm load(
+        const std::string &filename, int width, int height);
+};
+
+AGZ_TRACER_END
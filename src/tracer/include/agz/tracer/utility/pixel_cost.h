@@ -0,0 +1,63 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+
+#include <agz/tracer/common.h>
+
+AGZ_TRACER_BEGIN
+
+/**
+ * @brief accumulate rendering time of pixels into a cost image
+ *
+ * costs are measured in microseconds.
+ *
+ * time spent on a pixel outside the owned pixel range (typically pixels
+ * sampled for the film filter radius) is charged to the nearest owned
+ * pixel. thus tasks owning disjoint pixel ranges can share the cost image
+ * without synchronization.
+ *
+ * a recorder without cost image does nothing, so that clocks are not read
+ * when pixel costs are not requested
+ */
+class PixelCostRecorder
+{
+public:
+
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @param cost cost image. nullptr disables recording
+     * @param pixels owned pixel range, inclusive
+     */
+    PixelCostRecorder(Image2D<real> *cost, const Rect2i &pixels) noexcept
+        : cost_(cost), pixels_(pixels)
+    {
+
+    }
+
+    void begin_pixel() noexcept
+    {
+        if(cost_)
+            pixel_start_ = Clock::now();
+    }
+
+    void end_pixel(int px, int py) noexcept
+    {
+        if(!cost_)
+            return;
+        const auto duration = Clock::now() - pixel_start_;
+        const int x = (std::clamp)(px, pixels_.low.x, pixels_.high.x);
+        const int y = (std::clamp)(py, pixels_.low.y, pixels_.high.y);
+        (*cost_)(y, x) += std::chrono::duration<real, std::micro>(duration).count();
+    }
+
+private:
+
+    Image2D<real> *cost_;
+    Rect2i pixels_;
+
+    Clock::time_point pixel_start_;
+};
+
+AGZ_TRACER_END
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include <agz/tracer/common.h>
+
+AGZ_TRACER_BEGIN
+
+/**
+ * @brief per-thread rendering statistics
+ *
+ * counters are only collected when the tracer is built with USE_RENDER_STATS.
+ * otherwise AGZ_RENDER_STATS_ADD expands to nothing and collected stats are
+ * always empty.
+ */
+namespace render_stats
+{
+
+enum Counter : int
+{
+    CameraRays = 0,
+    ClosestHitRays,
+    ShadowRays,
+    BVHNodesVisited,
+    TrianglesTested,
+    BSDFSamples,
+    MediumNullCollisions,
+    ArenaBytes,
+    CounterCount
+};
+
+/**
+ * @brief snake_case name of a counter
+ */
+const char *counter_name(Counter counter) noexcept;
+
+using CounterValues = std::array<uint64_t, CounterCount>;
+
+/**
+ * @brief statistics aggregated from all threads since the last reset
+ *
+ * per_thread contains one entry for each thread slot having nonzero counters.
+ * a slot is reused by later threads once its owner thread exits.
+ */
+struct RenderStats
+{
+    bool enabled = false;
+
+    CounterValues total = {};
+
+    std::vector<CounterValues> per_thread;
+};
+
+/**
+ * @brief clear counters of all threads
+ *
+ * should not be called during rendering
+ */
+void reset() noexcept;
+
+/**
+ * @brief aggregate counters of all threads
+ */
+RenderStats collect();
+
+#ifdef USE_RENDER_STATS
+
+/**
+ * @brief counters owned by a rendering thread
+ *
+ * only the owner thread writes to them. other threads may read them when
+ * collecting stats.
+ */
+struct alignas(64) ThreadCounters
+{
+    std::atomic<uint64_t> values[CounterCount] = {};
+};
+
+/**
+ * @brief registers the counters of current thread on construction and
+ *  returns them to the free list on destruction
+ */
+class ThreadSlot
+{
+    ThreadCounters *counters_;
+
+public:
+
+    ThreadSlot();
+
+    ~ThreadSlot();
+
+    ThreadSlot(const ThreadSlot &) = delete;
+
+    ThreadSlot &operator=(const ThreadSlot &) = delete;
+
+    ThreadCounters &counters() noexcept { return *counters_; }
+};
+
+inline void add(Counter counter, uint64_t n) noexcept
+{
+    thread_local ThreadSlot slot;
+    auto &value = slot.counters().values[counter];
+    value.store(
+        value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+#endif
+
+} // namespace render_stats
+
+using render_stats::RenderStats;
+
+AGZ_TRACER_END
+
+#ifdef USE_RENDER_STATS
+#   define AGZ_RENDER_STATS_ADD(COUNTER, N) \
+        (::agz::tracer::render_stats::add( \
+            ::agz::tracer::render_stats::COUNTER, static_cast<uint64_t>(N)))
+#else
+#   define AGZ_RENDER_STATS_ADD(COUNTER, N) ((void)0)
+#endif
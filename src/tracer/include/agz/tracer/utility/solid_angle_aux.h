@@ -0,0 +1,472 @@
+#pragma once
+
+#include <limits>
+#include <vector>
+
+#include <agz/tracer/utility/triangle_aux.h>
+
+AGZ_TRACER_BEGIN
+
+/*
+ * solid angle sampling of planar emitters
+ *
+ * spherical triangles are sampled with Arvo's method, and spherical
+ * rectangles with the method of Urena et al. both are numerically unstable
+ * when the subtended solid angle is very small or very large, in which case
+ * callers should fall back to sampling by area.
+ */
+
+constexpr real SOLID_ANGLE_SAMPLING_MIN = real(3e-4);
+constexpr real SOLID_ANGLE_SAMPLING_MAX = real(6.22);
+
+/**
+ * @brief whether a subtended solid angle is suitable for solid angle sampling
+ */
+inline bool use_solid_angle_sampling(real solid_angle) noexcept
+{
+    return SOLID_ANGLE_SAMPLING_MIN <= solid_angle &&
+           solid_angle <= SOLID_ANGLE_SAMPLING_MAX;
+}
+
+/**
+ * @brief angle between two unit vectors, accurate for nearly (anti)parallel ones
+ */
+inline real angle_between_unit(const FVec3 &a, const FVec3 &b) noexcept
+{
+    if(dot(a, b) < 0)
+        return PI_r - 2 * std::asin((std::min)((a + b).length() / 2, real(1)));
+    return 2 * std::asin((std::min)((b - a).length() / 2, real(1)));
+}
+
+/**
+ * @brief convert pdf w.r.t. solid angle at ref to pdf w.r.t. area at pos
+ */
+inline real solid_angle_pdf_to_area(
+    real pdf_sa, const FVec3 &ref, const FVec3 &pos, const FVec3 &nor) noexcept
+{
+    const FVec3 pos_to_ref = ref - pos;
+    const real dist2 = pos_to_ref.length_square();
+    if(dist2 <= 0)
+        return 0;
+    const real abs_cos = std::abs(dot(nor, pos_to_ref)) / std::sqrt(dist2);
+    return pdf_sa * abs_cos / dist2;
+}
+
+/**
+ * @brief uniformly sample a direction from ref in the solid angle subtended by
+ *  triangle (A, A + B_A, A + C_A)
+ *
+ * the intersection of the sampled direction with the triangle is returned
+ * through bi_coord, which satisfies pos = A + bi_coord.x * B_A + bi_coord.y * C_A
+ *
+ * @return subtended solid angle. 0 when failed. both the solid angle and
+ *  the failure only depend on ref and the triangle, not on u and v
+ */
+inline real sample_spherical_triangle(
+    const FVec3 &ref, const FVec3 &A, const FVec3 &B_A, const FVec3 &C_A,
+    real u, real v, Vec2 *bi_coord) noexcept
+{
+    assert(bi_coord);
+
+    const FVec3 a = (A - ref).normalize();
+    const FVec3 b = (A + B_A - ref).normalize();
+    const FVec3 c = (A + C_A - ref).normalize();
+
+    // normals of the great circles through triangle edges
+
+    FVec3 n_ab = cross(a, b), n_bc = cross(b, c), n_ca = cross(c, a);
+    if(n_ab.length_square() <= 0 || n_bc.length_square() <= 0 ||
+       n_ca.length_square() <= 0)
+        return 0;
+    n_ab = n_ab.normalize();
+    n_bc = n_bc.normalize();
+    n_ca = n_ca.normalize();
+
+    // spherical angles at vertices
+
+    const real alpha = angle_between_unit(n_ab, -n_ca);
+    const real beta  = angle_between_unit(n_bc, -n_ab);
+    const real gamma = angle_between_unit(n_ca, -n_bc);
+
+    const real area = alpha + beta + gamma - PI_r;
+    if(area <= 0)
+        return 0;
+
+    // sample sub-triangle area and compute the new vertex c' on arc ac
+
+    const real area_pi = PI_r + u * area;
+
+    const real cos_alpha = std::cos(alpha), sin_alpha = std::sin(alpha);
+    const real sin_phi = std::sin(area_pi) * cos_alpha
+                       - std::cos(area_pi) * sin_alpha;
+    const real cos_phi = std::cos(area_pi) * cos_alpha
+                       + std::sin(area_pi) * sin_alpha;
+
+    const real k1 = cos_phi + cos_alpha;
+    const real k2 = sin_phi - sin_alpha * dot(a, b);
+    const real cos_bp_denom = (k2 * sin_phi + k1 * cos_phi) * sin_alpha;
+
+    real cos_bp = cos_bp_denom != 0 ?
+        (k2 + (k2 * cos_phi - k1 * sin_phi) * cos_alpha) / cos_bp_denom : real(1);
+    cos_bp = math::clamp<real>(cos_bp, -1, 1);
+    const real sin_bp = std::sqrt((std::max)(real(0), 1 - cos_bp * cos_bp));
+
+    const FVec3 c_perp = c - dot(c, a) * a;
+    if(c_perp.length_square() <= 0)
+        return 0;
+    const FVec3 cp = cos_bp * a + sin_bp * c_perp.normalize();
+
+    // sample a direction on arc bc'
+
+    const real cos_theta = 1 - v * (1 - dot(cp, b));
+    const real sin_theta = std::sqrt((std::max)(real(0), 1 - cos_theta * cos_theta));
+
+    const FVec3 cp_perp = cp - dot(cp, b) * b;
+    FVec3 dir = cos_theta * b;
+    if(cp_perp.length_square() > 0)
+        dir = dir + sin_theta * cp_perp.normalize();
+
+    // intersect the direction with the triangle
+
+    const FVec3 s1 = cross(dir, C_A);
+    const real div = dot(s1, B_A);
+    if(!div)
+    {
+        *bi_coord = Vec2(real(1) / 3, real(1) / 3);
+        return area;
+    }
+    const real inv_div = 1 / div;
+
+    const FVec3 s = ref - A;
+    real b1 = math::saturate(dot(s, s1) * inv_div);
+    real b2 = math::saturate(dot(dir, cross(s, B_A)) * inv_div);
+    if(b1 + b2 > 1)
+    {
+        const real sum = b1 + b2;
+        b1 /= sum;
+        b2 /= sum;
+    }
+
+    *bi_coord = Vec2(b1, b2);
+    return area;
+}
+
+/**
+ * @brief spherical rectangle subtended by rectangle
+ *  (corner, corner + ex, corner + ex + ey, corner + ey) seen from ref
+ *
+ * ex must be orthogonal to ey
+ */
+class SphericalRectangle
+{
+    real ex_len_ = 0, ey_len_ = 0;
+
+    real x0_ = 0, y0_ = 0, z0_ = 0, x1_ = 0, y1_ = 0;
+    real b0_ = 0, b1_ = 0, k_ = 0;
+    real solid_angle_ = 0;
+
+public:
+
+    SphericalRectangle(
+        const FVec3 &ref, const FVec3 &corner,
+        const FVec3 &ex, const FVec3 &ey) noexcept
+    {
+        ex_len_ = ex.length();
+        ey_len_ = ey.length();
+        if(ex_len_ <= 0 || ey_len_ <= 0)
+            return;
+
+        const FVec3 ex_n = ex / ex_len_;
+        const FVec3 ey_n = ey / ey_len_;
+        const FVec3 ez_n = cross(ex_n, ey_n);
+
+        // local coordinate of corner with ref as origin. z0 <= 0
+
+        const FVec3 d = corner - ref;
+        x0_ = dot(d, ex_n);
+        y0_ = dot(d, ey_n);
+        z0_ = -std::abs(dot(d, ez_n));
+        x1_ = x0_ + ex_len_;
+        y1_ = y0_ + ey_len_;
+
+        if(z0_ >= 0)
+            return;
+
+        const FVec3 v00(x0_, y0_, z0_), v01(x0_, y1_, z0_);
+        const FVec3 v10(x1_, y0_, z0_), v11(x1_, y1_, z0_);
+
+        const FVec3 n0 = cross(v00, v10).normalize();
+        const FVec3 n1 = cross(v10, v11).normalize();
+        const FVec3 n2 = cross(v11, v01).normalize();
+        const FVec3 n3 = cross(v01, v00).normalize();
+
+        const real g0 = angle_between_unit(-n0, n1);
+        const real g1 = angle_between_unit(-n1, n2);
+        const real g2 = angle_between_unit(-n2, n3);
+        const real g3 = angle_between_unit(-n3, n0);
+
+        b0_ = n0.z;
+        b1_ = n2.z;
+        k_  = g2 + g3;
+
+        solid_angle_ = (std::max)(real(0), g0 + g1 + g2 + g3 - 2 * PI_r);
+    }
+
+    real solid_angle() const noexcept
+    {
+        return solid_angle_;
+    }
+
+    /**
+     * @brief uniformly sample a point on the rectangle w.r.t. solid angle
+     *
+     * return (s, t) in [0, 1]^2, where pos = corner + s * ex + t * ey
+     */
+    Vec2 sample(real u, real v) const noexcept
+    {
+        // sample x
+
+        const real au = u * solid_angle_ - k_;
+        const real sin_au = std::sin(au);
+        const real fu = sin_au != 0 ?
+            (std::cos(au) * b0_ - b1_) / sin_au : real(0);
+        real cu = 1 / std::sqrt(fu * fu + b0_ * b0_);
+        if(fu < 0)
+            cu = -cu;
+        cu = math::clamp<real>(cu, -1, 1);
+
+        const real sin_cu = std::sqrt((std::max)(real(0), 1 - cu * cu));
+        real xu = sin_cu > 0 ? -(cu * z0_) / sin_cu : x1_;
+        xu = math::clamp(xu, x0_, x1_);
+
+        // sample y
+
+        const real dd = std::sqrt(xu * xu + z0_ * z0_);
+        const real h0 = y0_ / std::sqrt(dd * dd + y0_ * y0_);
+        const real h1 = y1_ / std::sqrt(dd * dd + y1_ * y1_);
+        const real hv = h0 + v * (h1 - h0);
+        const real hv2 = hv * hv;
+        real yv = hv2 < 1 - real(1e-6) ? hv * dd / std::sqrt(1 - hv2) : y1_;
+        yv = math::clamp(yv, y0_, y1_);
+
+        return Vec2(
+            math::saturate((xu - x0_) / ex_len_),
+            math::saturate((yv - y0_) / ey_len_));
+    }
+};
+
+/**
+ * @brief sample triangles of a small mesh w.r.t. solid angle
+ *
+ * a triangle is selected in proportion to an approximation of the solid angle
+ * it subtends from the reference point (projected area over squared distance
+ * to its centroid, clamped to 2pi), and then a point on it is sampled
+ * uniformly in its solid angle (or by area when the solid angle is unsuitable
+ * or spherical triangle sampling fails).
+ *
+ * both sampling and pdf evaluation cost O(triangle count), so only meshes with
+ * at most MAX_TRIANGLE_COUNT triangles are supported.
+ */
+class TriangleMeshSolidAngleSampler
+{
+    struct Triangle
+    {
+        FVec3 a, b_a, c_a, z, centroid;
+        real area = 0;
+    };
+
+    std::vector<Triangle> triangles_;
+
+    // approximate solid angles. cheap enough to be evaluated for all
+    // triangles in each call
+    real compute_weights(const FVec3 &ref, real *weights) const noexcept
+    {
+        real sum = 0;
+        for(size_t i = 0; i < triangles_.size(); ++i)
+        {
+            const Triangle &tri = triangles_[i];
+            const FVec3 d = tri.centroid - ref;
+            const real dist2 = d.length_square();
+            const real proj = tri.area * std::abs(dot(tri.z, d));
+            weights[i] = proj < 2 * PI_r * dist2 * std::sqrt(dist2) ?
+                         proj / (dist2 * std::sqrt(dist2)) : 2 * PI_r;
+            sum += weights[i];
+        }
+        return sum;
+    }
+
+    /**
+     * @brief solid angle used to sample a point on tri. 0 when it should be
+     *  sampled by area
+     *
+     * shared by sample and pdf, so that they always take the same branch
+     */
+    static real triangle_solid_angle(
+        const FVec3 &ref, const Triangle &tri, real u, real v,
+        Vec2 *bi_coord) noexcept
+    {
+        const real solid_angle = sample_spherical_triangle(
+            ref, tri.a, tri.b_a, tri.c_a, u, v, bi_coord);
+        return use_solid_angle_sampling(solid_angle) ? solid_angle : real(0);
+    }
+
+public:
+
+    static constexpr int MAX_TRIANGLE_COUNT = 256;
+
+    /**
+     * @brief add a triangle
+     *
+     * when there are too many triangles, all triangles are discarded and
+     * false is returned
+     */
+    bool add_triangle(const FVec3 &a, const FVec3 &b_a, const FVec3 &c_a)
+    {
+        if(triangles_.size() >= MAX_TRIANGLE_COUNT)
+        {
+            triangles_.clear();
+            return false;
+        }
+
+        Triangle tri;
+        tri.a    = a;
+        tri.b_a  = b_a;
+        tri.c_a  = c_a;
+        tri.z    = cross(b_a, c_a).normalize();
+        tri.area = triangle_area(b_a, c_a);
+        tri.centroid = a + (b_a + c_a) / real(3);
+        triangles_.push_back(tri);
+
+        return true;
+    }
+
+    bool available() const noexcept
+    {
+        return !triangles_.empty();
+    }
+
+    /**
+     * @brief sample a point on the mesh
+     *
+     * @param prim_idx index of sampled triangle in the order of add_triangle
+     * @param bi_coord barycentric coordinate of sampled point w.r.t. (b - a, c - a)
+     * @param pdf_area pdf w.r.t. area
+     *
+     * @return false when the mesh should be sampled by area
+     */
+    bool sample(
+        const FVec3 &ref, const Sample3 &sam,
+        int *prim_idx, Vec2 *bi_coord, real *pdf_area) const noexcept
+    {
+        real weights[MAX_TRIANGLE_COUNT];
+        const real sum = compute_weights(ref, weights);
+        if(sum < SOLID_ANGLE_SAMPLING_MIN)
+            return false;
+
+        // select a triangle
+
+        const int tri_count = static_cast<int>(triangles_.size());
+        const real target = sam.u * sum;
+
+        int idx = tri_count - 1;
+        real accu = 0;
+        for(int i = 0; i < tri_count; ++i)
+        {
+            accu += weights[i];
+            if(target < accu && weights[i] > 0)
+            {
+                idx = i;
+                break;
+            }
+        }
+        while(idx > 0 && weights[idx] <= 0)
+            --idx;
+
+        const Triangle &tri = triangles_[idx];
+        const real select_pdf = weights[idx] / sum;
+
+        // sample a point on the selected triangle
+
+        *prim_idx = idx;
+
+        const real solid_angle = triangle_solid_angle(
+            ref, tri, sam.v, sam.w, bi_coord);
+        if(solid_angle > 0)
+        {
+            const FVec3 pos = tri.a + bi_coord->x * tri.b_a
+                                    + bi_coord->y * tri.c_a;
+            *pdf_area = select_pdf * solid_angle_pdf_to_area(
+                1 / solid_angle, ref, pos, tri.z);
+            return true;
+        }
+
+        *bi_coord = math::distribution::uniform_on_triangle(sam.v, sam.w);
+        *pdf_area = select_pdf / tri.area;
+        return true;
+    }
+
+    /**
+     * @brief pdf w.r.t. area of sampling pos with sample(ref, ...)
+     *
+     * @return false when the mesh should be sampled by area
+     */
+    bool pdf(const FVec3 &ref, const FVec3 &pos, real *pdf_area) const noexcept
+    {
+        real weights[MAX_TRIANGLE_COUNT];
+        const real sum = compute_weights(ref, weights);
+        if(sum < SOLID_ANGLE_SAMPLING_MIN)
+            return false;
+
+        // find the triangle containing pos
+
+        constexpr real BI_COORD_EPS = real(1e-4);
+
+        int idx = -1;
+        real min_plane_dist = std::numeric_limits<real>::max();
+
+        for(size_t i = 0; i < triangles_.size(); ++i)
+        {
+            const Triangle &tri = triangles_[i];
+
+            const FVec3 p_a = pos - tri.a;
+            const real plane_dist = std::abs(dot(p_a, tri.z));
+            if(plane_dist >= min_plane_dist)
+                continue;
+
+            const FVec3 n = cross(tri.b_a, tri.c_a);
+            const real inv_n_len_square = 1 / n.length_square();
+            const real b1 = dot(cross(p_a, tri.c_a), n) * inv_n_len_square;
+            const real b2 = dot(cross(tri.b_a, p_a), n) * inv_n_len_square;
+            if(b1 < -BI_COORD_EPS || b2 < -BI_COORD_EPS ||
+               b1 + b2 > 1 + BI_COORD_EPS)
+                continue;
+
+            idx = static_cast<int>(i);
+            min_plane_dist = plane_dist;
+        }
+
+        if(idx < 0 || weights[idx] <= 0)
+        {
+            *pdf_area = 0;
+            return true;
+        }
+
+        const Triangle &tri = triangles_[idx];
+        const real select_pdf = weights[idx] / sum;
+
+        Vec2 unused_bi_coord;
+        const real solid_angle = triangle_solid_angle(
+            ref, tri, 0, 0, &unused_bi_coord);
+        if(solid_angle > 0)
+        {
+            *pdf_area = select_pdf * solid_angle_pdf_to_area(
+                1 / solid_angle, ref, pos, tri.z);
+        }
+        else
+            *pdf_area = select_pdf / tri.area;
+
+        return true;
+    }
+};
+
+AGZ_TRACER_END
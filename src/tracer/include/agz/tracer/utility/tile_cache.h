@@ -0,0 +1,339 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <agz/tracer/common.h>
+
+AGZ_TRACER_BEGIN
+
+/**
+ * @brief process-wide cache of texture tiles with a memory budget
+ *
+ * tiles are identified by 64-bit keys. the cache is split into shards, each
+ * of which is protected by its own reader-writer lock.
+ *
+ * tiles are evicted by the clock (second chance) policy. a hit only takes
+ * the shared lock and sets the reference bit of the tile, so that hits
+ * never wait for each other. the exclusive lock is only taken to insert
+ * loaded tiles and evict old ones.
+ *
+ * tiles are reference-counted. an evicted tile stays alive until all its
+ * users release it.
+ */
+class TileCache
+{
+public:
+
+    using TileData = std::vector<unsigned char>;
+
+    struct Stats
+    {
+        uint64_t hits      = 0;
+        uint64_t misses    = 0;
+        uint64_t evictions = 0;
+
+        size_t resident_bytes = 0;
+        size_t budget_bytes   = 0;
+    };
+
+    static TileCache &instance();
+
+    /**
+     * @brief set memory budget of all cached tiles in bytes
+     *
+     * tiles beyond the new budget are evicted at the next insertion
+     */
+    void set_budget(size_t bytes) noexcept;
+
+    size_t budget() const noexcept;
+
+    /**
+     * @brief allocate an id used as high 32 bits of tile keys
+     *
+     * each tile source (typically a tiled texture file) should have its own id
+     */
+    uint32_t new_source_id() noexcept;
+
+    /**
+     * @brief find a tile or load it on miss
+     *
+     * loader interface: TileData loader()
+     *
+     * loader is called without holding any lock, so concurrent misses of the
+     * same tile may load it more than once. only one copy is kept.
+     */
+    template<typename Loader>
+    RC<const TileData> get(uint64_t key, const Loader &loader);
+
+    /**
+     * @brief accumulated statistics since the last reset
+     */
+    Stats stats() const noexcept;
+
+    void reset_stats() noexcept;
+
+private:
+
+    static constexpr int SHARD_COUNT = 64;
+
+    struct Entry
+    {
+        Entry(uint64_t key, RC<const TileData> data) noexcept
+            : key(key), data(std::move(data))
+        {
+
+        }
+
+        uint64_t key;
+        RC<const TileData> data;
+
+        // set by hits, cleared when passed by the clock hand
+        std::atomic<bool> referenced = true;
+    };
+
+    struct alignas(64) Shard
+    {
+        mutable std::shared_mutex mutex;
+
+        // circular list of entries. hand is the next eviction candidate
+        std::list<Entry> entries;
+        std::list<Entry>::iterator hand = entries.end();
+
+        std::unordered_map<uint64_t, std::list<Entry>::iterator> key2entry;
+        size_t bytes = 0;
+
+        std::atomic<uint64_t> hits      = 0;
+        std::atomic<uint64_t> misses    = 0;
+        std::atomic<uint64_t> evictions = 0;
+    };
+
+    TileCache() = default;
+
+    Shard &shard_of(uint64_t key) noexcept;
+
+    RC<const TileData> find(Shard &shard, uint64_t key);
+
+    RC<const TileData> insert(Shard &shard, uint64_t key, TileData data);
+
+    std::atomic<size_t> budget_ = size_t(2) << 30;
+    std::atomic<uint32_t> next_source_id_ = 0;
+
+    Shard shards_[SHARD_COUNT];
+};
+
+/**
+ * @brief tiled texture file stored on disk
+ *
+ * layout (all integers are int32):
+ *  magic "ATILED02"
+ *  texel format, tile size, level count
+ *  inv_gamma (float32)
+ *  width and height of each level
+ *  tiles of each level, in level order and row-major tile order.
+ *  each tile contains tile_size * tile_size texels. texels out of image
+ *  are filled with the nearest edge texel
+ *
+ * level 0 is the original image and each following level is half the size
+ * of the previous one, until 1x1 is reached
+ *
+ * levels are filtered in linear space. rgb8 texels are stored encoded and
+ * decoded with inv_gamma. rgb32f texels are stored linear, with inv_gamma
+ * already applied
+ */
+class TiledImageFile
+{
+public:
+
+    enum class TexelFormat : int32_t
+    {
+        RGB8    = 0, // math::color3b
+        RGB32F  = 1  // math::color3f
+    };
+
+    static constexpr char MAGIC[8] = { 'A', 'T', 'I', 'L', 'E', 'D', '0', '2' };
+
+    static constexpr int MAX_LEVEL_COUNT = 32;
+
+    /**
+     * @brief open a tiled texture file. tiles are read lazily
+     */
+    explicit TiledImageFile(const std::string &filename);
+
+    ~TiledImageFile();
+
+    TiledImageFile(const TiledImageFile &) = delete;
+
+    TiledImageFile &operator=(const TiledImageFile &) = delete;
+
+    TexelFormat texel_format() const noexcept;
+
+    int texel_bytes() const noexcept;
+
+    int tile_size() const noexcept;
+
+    /**
+     * @brief gamma decoding exponent the file was built with
+     */
+    real inv_gamma() const noexcept;
+
+    int level_count() const noexcept;
+
+    int width(int level) const noexcept;
+
+    int height(int level) const noexcept;
+
+    /**
+     * @brief number of tiles on x/y axis of a level
+     */
+    int tile_count_x(int level) const noexcept;
+
+    int tile_count_y(int level) const noexcept;
+
+    /**
+     * @brief fetch a tile through the process-wide tile cache
+     *
+     * tiles are read with positional reads, so concurrent misses don't wait
+     * for each other. unreadable tiles are filled with zero
+     */
+    RC<const TileCache::TileData> tile(int level, int tx, int ty) const;
+
+    /**
+     * @brief write a mip chain as tiled texture file
+     *
+     * Texel must be math::color3b or math::color3f. levels must be built
+     * with the given inv_gamma, as described in the file layout
+     */
+    template<typename Texel>
+    static void write(
+        const std::string &filename, int tile_size,
+        const std::vector<RC<const Image2D<Texel>>> &levels,
+        real inv_gamma = 1);
+
+private:
+
+    struct Level
+    {
+        int width        = 0;
+        int height       = 0;
+        int tile_count_x = 0;
+        int tile_count_y = 0;
+        int64_t first_tile_offset = 0;
+    };
+
+    TileCache::TileData read_tile(int level, int tx, int ty) const;
+
+    TexelFormat format_ = TexelFormat::RGB8;
+    int tile_size_ = 0;
+    real inv_gamma_ = 1;
+    std::vector<Level> levels_;
+
+    uint32_t source_id_ = 0;
+    uint32_t level_tile_base_[MAX_LEVEL_COUNT] = {}; // index of first tile in each level
+
+    // native file handle. a file descriptor on posix systems
+    intptr_t handle_ = -1;
+};
+
+template<typename Loader>
+RC<const TileCache::TileData> TileCache::get(uint64_t key, const Loader &loader)
+{
+    Shard &shard = shard_of(key);
+
+    if(auto ret = find(shard, key))
+    {
+        shard.hits.fetch_add(1, std::memory_order_relaxed);
+        return ret;
+    }
+
+    shard.misses.fetch_add(1, std::memory_order_relaxed);
+    return insert(shard, key, loader());
+}
+
+template<typename Texel>
+void TiledImageFile::write(
+    const std::string &filename, int tile_size,
+    const std::vector<RC<const Image2D<Texel>>> &levels,
+    real inv_gamma)
+{
+    static_assert(std::is_same_v<Texel, math::color3b> ||
+                  std::is_same_v<Texel, math::color3f>);
+
+    if(tile_size <= 0)
+        throw ObjectConstructionException("invalid tile size");
+    if(levels.empty() || levels.size() > MAX_LEVEL_COUNT)
+        throw ObjectConstructionException("invalid tiled texture level count");
+
+    std::ofstream fout(filename, std::ios::out | std::ios::binary);
+    if(!fout)
+    {
+        throw ObjectConstructionException(
+            "failed to open file: " + filename);
+    }
+
+    auto write_int = [&](int32_t v)
+    {
+        fout.write(reinterpret_cast<const char*>(&v), sizeof(v));
+    };
+
+    const auto format = std::is_same_v<Texel, math::color3b> ?
+                        TexelFormat::RGB8 : TexelFormat::RGB32F;
+
+    fout.write(MAGIC, sizeof(MAGIC));
+    write_int(static_cast<int32_t>(format));
+    write_int(tile_size);
+    write_int(static_cast<int32_t>(levels.size()));
+
+    const float file_inv_gamma = static_cast<float>(inv_gamma);
+    fout.write(reinterpret_cast<const char*>(&file_inv_gamma),
+               sizeof(file_inv_gamma));
+
+    for(auto &level : levels)
+    {
+        write_int(level->width());
+        write_int(level->height());
+    }
+
+    std::vector<Texel> tile(static_cast<size_t>(tile_size * tile_size));
+
+    for(auto &level : levels)
+    {
+        const int w = level->width(), h = level->height();
+        const int tile_count_x = (w - 1) / tile_size + 1;
+        const int tile_count_y = (h - 1) / tile_size + 1;
+
+        for(int ty = 0; ty < tile_count_y; ++ty)
+        {
+            for(int tx = 0; tx < tile_count_x; ++tx)
+            {
+                for(int ly = 0; ly < tile_size; ++ly)
+                {
+                    const int y = (std::min)(ty * tile_size + ly, h - 1);
+                    for(int lx = 0; lx < tile_size; ++lx)
+                    {
+                        const int x = (std::min)(tx * tile_size + lx, w - 1);
+                        tile[ly * tile_size + lx] = (*level)(y, x);
+                    }
+                }
+
+                fout.write(
+                    reinterpret_cast<const char*>(tile.data()),
+                    static_cast<std::streamsize>(tile.size() * sizeof(Texel)));
+            }
+        }
+    }
+
+    if(!fout)
+    {
+        throw ObjectConstructionException(
+            "failed to write tiled texture to " + filename);
+    }
+}
+
+AGZ_TRACER_END
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include <agz/tracer/common.h>
+
+AGZ_TRACER_BEGIN
+
+/**
+ * @brief timeline of scoped events in chrome trace_event format
+ *
+ * recording is disabled by default. once enabled, each thread appends its
+ * events to its own ring buffer without locking. when a ring buffer is full,
+ * its oldest events are overwritten.
+ *
+ * the written json can be viewed in chrome://tracing or ui.perfetto.dev
+ */
+namespace trace
+{
+
+namespace detail
+{
+    inline std::atomic<bool> enabled = false;
+}
+
+/**
+ * @brief start recording with given ring buffer size of each thread
+ *
+ * previously recorded events are discarded.
+ * should not be called when traced work is running
+ */
+void start(size_t events_per_thread = 1 << 16);
+
+/**
+ * @brief stop recording. recorded events are kept
+ */
+void stop() noexcept;
+
+inline bool is_enabled() noexcept
+{
+    return detail::enabled.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief write recorded events of all threads to a json file
+ *
+ * should not be called when traced work is running
+ */
+void write_chrome_trace(const std::string &filename);
+
+/**
+ * @brief record an event lasting from construction to destruction
+ *  or to the call of end()
+ *
+ * category must be a string literal. name is copied and truncated to
+ * MAX_NAME_LENGTH characters
+ */
+class ScopedEvent
+{
+public:
+
+    static constexpr size_t MAX_NAME_LENGTH = 63;
+
+    ScopedEvent(const char *category, std::string_view name) noexcept;
+
+    ~ScopedEvent();
+
+    /**
+     * @brief record the event now instead of on destruction
+     */
+    void end() noexcept;
+
+    ScopedEvent(const ScopedEvent &) = delete;
+
+    ScopedEvent &operator=(const ScopedEvent &) = delete;
+
+private:
+
+    const char *category_;
+    char name_[MAX_NAME_LENGTH + 1];
+    int64_t begin_ns_;
+};
+
+} // namespace trace
+
+AGZ_TRACER_END
+
+#define AGZ_TRACE_CONCAT_IMPL(A, B) A##B
+#define AGZ_TRACE_CONCAT(A, B) AGZ_TRACE_CONCAT_IMPL(A, B)
+
+/**
+ * @brief record the enclosing scope as an event
+ */
+#define AGZ_TRACE_SCOPE(CATEGORY, NAME) \
+    ::agz::tracer::trace::ScopedEvent AGZ_TRACE_CONCAT( \
+        _agz_trace_scope_, __LINE__)(CATEGORY, NAME)
@@ -73,6 +73,24 @@ inline real triangle_area(const FVec3 &B_A, const FVec3 &C_A) noexcept
     return cross(B_A, C_A).length() / 2;
 }
 
+/**
+ * @brief partial derivatives of position w.r.t. uv on a triangle
+ *
+ * dpdu and dpdv are left unchanged when the uv mapping is degenerate
+ */
+inline void triangle_dpdu_dpdv(
+    const FVec3 &B_A, const FVec3 &C_A,
+    const Vec2 &b_a, const Vec2 &c_a,
+    FVec3 *dpdu, FVec3 *dpdv) noexcept
+{
+    const real det = b_a.x * c_a.y - b_a.y * c_a.x;
+    if(!det)
+        return;
+    const real inv_det = 1 / det;
+    *dpdu = inv_det * (c_a.y * B_A - b_a.y * C_A);
+    *dpdv = inv_det * (b_a.x * C_A - c_a.x * B_A);
+}
+
 inline FVec3 dpdu_as_ex(
     const FVec3 &B_A, const FVec3 &C_A,
     const Vec2 &b_a, const Vec2 &c_a,
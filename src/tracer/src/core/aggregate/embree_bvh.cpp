@@ -5,6 +5,7 @@
 #include <agz/tracer/core/aggregate.h>
 #include <agz/tracer/core/entity.h>
 #include <agz/tracer/utility/embree.h>
+#include <agz/tracer/utility/trace.h>
 #include <agz/utility/misc.h>
 
 AGZ_TRACER_BEGIN
@@ -211,6 +212,8 @@ public:
 
     void build(const std::vector<RC<const Entity>> &entities) override
     {
+        AGZ_TRACE_SCOPE("bvh", "embree entity bvh build");
+
         if(bvh_)
         {
             rtcReleaseBVH(bvh_);
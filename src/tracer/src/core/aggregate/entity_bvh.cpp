@@ -1,5 +1,7 @@
 #include <agz/tracer/core/aggregate.h>
 #include <agz/tracer/core/entity.h>
+#include <agz/tracer/utility/render_stats.h>
+#include <agz/tracer/utility/trace.h>
 #include <agz/utility/misc.h>
 
 AGZ_TRACER_BEGIN
@@ -118,6 +120,8 @@ class EntityBVH : public Aggregate
     bool has_intersection_aux(
         const FVec3 &inv_dir, const Ray &r, const Node &node) const noexcept
     {
+        AGZ_RENDER_STATS_ADD(BVHNodesVisited, 1);
+
         if(const Leaf *leaf = node.as_if<Leaf>())
         {
             if(!leaf->bound.intersect(r.o, inv_dir, r.t_min, r.t_max))
@@ -142,6 +146,8 @@ class EntityBVH : public Aggregate
         const FVec3 &inv_dir, Ray &r, const Node &node,
         EntityIntersection *inct) const noexcept
     {
+        AGZ_RENDER_STATS_ADD(BVHNodesVisited, 1);
+
         if(const Leaf *leaf = node.as_if<Leaf>())
         {
             if(!leaf->bound.intersect(r.o, inv_dir, r.t_min, r.t_max))
@@ -182,6 +188,8 @@ public:
 
     void build(const std::vector<RC<const Entity>> &entities) override
     {
+        AGZ_TRACE_SCOPE("bvh", "entity bvh build");
+
         nodes_.clear();
         prims_.clear();
 
@@ -88,7 +88,41 @@ public:
         const FVec3 pos_on_cam = camera_to_world_.apply_to_point(lens_pos);;
         const FVec3 pos_to_out = camera_to_world_.apply_to_vector(
             focal_film_pos - lens_pos).normalize();
-        
+
+        return CameraSampleWeResult(
+            pos_on_cam, pos_to_out, dir_, FSpectrum(1));
+    }
+
+    CameraSampleWeResult sample_we_differential(
+        const Vec2 &film_coord, const Vec2 &film_dxy,
+        const Sample2 &aperture_sample,
+        CameraRayDifferential *differential) const noexcept override
+    {
+        const FVec3 focal_film_pos = {
+            (real(0.5) - film_coord.x) * focal_film_width_,
+            (film_coord.y - real(0.5)) * focal_film_height_,
+            focal_distance_
+        };
+        const Vec2 disk_sam = math::distribution::uniform_on_unit_disk(
+            aperture_sample.u, aperture_sample.v);
+        const FVec3 lens_pos = FVec3(
+            lens_radius_ * disk_sam.x, lens_radius_ * disk_sam.y, 0);
+
+        // differential rays share the lens position with the main ray
+
+        const FVec3 local_dir = focal_film_pos - lens_pos;
+        const FVec3 local_dx(-film_dxy.x * focal_film_width_, 0, 0);
+        const FVec3 local_dy(0, film_dxy.y * focal_film_height_, 0);
+
+        const FVec3 pos_on_cam = camera_to_world_.apply_to_point(lens_pos);
+        const FVec3 pos_to_out = camera_to_world_.apply_to_vector(
+            local_dir).normalize();
+
+        differential->rx = Ray(pos_on_cam, camera_to_world_.apply_to_vector(
+            local_dir + local_dx).normalize());
+        differential->ry = Ray(pos_on_cam, camera_to_world_.apply_to_vector(
+            local_dir + local_dy).normalize());
+
         return CameraSampleWeResult(
             pos_on_cam, pos_to_out, dir_, FSpectrum(1));
     }
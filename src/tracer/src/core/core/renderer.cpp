@@ -1,7 +1,16 @@
 #include <agz/tracer/core/renderer.h>
+#include <agz/tracer/core/renderer_interactor.h>
 
 AGZ_TRACER_BEGIN
 
+PartialFilm Renderer::render_partial(
+    FilmFilterApplier filter, Scene &scene,
+    RendererInteractor &reporter, const FilmPartition &partition)
+{
+    throw ObjectConstructionException(
+        "partial rendering is not supported by this renderer");
+}
+
 void Renderer::render_async(
     FilmFilterApplier filter, Scene &scene, RendererInteractor &reporter)
 {
@@ -11,7 +20,15 @@ void Renderer::render_async(
         std::launch::async, [this, filter, &scene, &reporter]()
     {
         AGZ_SCOPE_GUARD({ doing_rendering_ = false; });
-        return this->render(std::move(filter), scene, reporter);
+
+        render_stats::reset();
+        auto ret = this->render(std::move(filter), scene, reporter);
+
+        const RenderStats stats = render_stats::collect();
+        if(stats.enabled)
+            reporter.stats(stats);
+
+        return ret;
     });
     is_waitable_ = true;
 }
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <vector>
+
+#include <agz/tracer/create/envir_light.h>
+
+AGZ_TRACER_BEGIN
+
+/**
+ * @brief helper class for sampling environment light through portals
+ *
+ * a portal is a parallelogram through which environment light enters the
+ * scene (windows, doors, etc). directions are sampled by choosing a portal
+ * uniformly and then a point on it uniformly by area.
+ *
+ * directions that don't pass through any portal have zero pdf, so the
+ * environment light must only be visible through portals.
+ */
+class EnvironmentLightPortals
+{
+    struct Portal
+    {
+        FVec3 o;   // corner A
+        FVec3 e0;  // B - A
+        FVec3 e1;  // D - A = C - B
+        FVec3 n;   // cross(e0, e1), whose length is the area
+        real inv_n_len_square = 0;
+    };
+
+    std::vector<Portal> portals_;
+
+public:
+
+    EnvironmentLightPortals() = default;
+
+    explicit EnvironmentLightPortals(const std::vector<EnvirLightPortal> &portals)
+    {
+        for(auto &p : portals)
+        {
+            Portal portal;
+            portal.o  = p.a;
+            portal.e0 = p.b - p.a;
+            portal.e1 = p.c - p.b;
+            portal.n  = cross(portal.e0, portal.e1);
+
+            const real n_len_square = portal.n.length_square();
+            if(n_len_square < EPS() * EPS())
+                throw ObjectConstructionException("degenerate portal");
+            portal.inv_n_len_square = 1 / n_len_square;
+
+            portals_.push_back(portal);
+        }
+    }
+
+    bool empty() const noexcept
+    {
+        return portals_.empty();
+    }
+
+    /**
+     * @brief sample a direction from ref through portals
+     *
+     * return (ref_to_light, pdf w.r.t. solid angle). pdf is 0 when failed
+     */
+    std::pair<FVec3, real> sample(
+        const FVec3 &ref, const Sample3 &sam) const noexcept
+    {
+        const int portal_count = static_cast<int>(portals_.size());
+        const int idx = (std::min)(
+            static_cast<int>(sam.u * portal_count), portal_count - 1);
+        const Portal &portal = portals_[idx];
+
+        const FVec3 pos = portal.o + sam.v * portal.e0 + sam.w * portal.e1;
+        const FVec3 ref_to_pos = pos - ref;
+        const real dist = ref_to_pos.length();
+        if(dist < EPS())
+            return { {}, 0 };
+
+        const FVec3 dir = ref_to_pos / dist;
+        return { dir, pdf(ref, dir) };
+    }
+
+    /**
+     * @brief pdf of sampling ref_to_light with sample(ref, ...)
+     *
+     * overlapping portals are summed up
+     */
+    real pdf(const FVec3 &ref, const FVec3 &ref_to_light) const noexcept
+    {
+        const FVec3 dir = ref_to_light.normalize();
+
+        real ret = 0;
+        for(auto &portal : portals_)
+        {
+            const real dir_dot_n = dot(dir, portal.n);
+            if(std::abs(dir_dot_n) < EPS())
+                continue;
+
+            const real t = dot(portal.o - ref, portal.n) / dir_dot_n;
+            if(t <= 0)
+                continue;
+
+            const FVec3 q = ref + t * dir - portal.o;
+            const real s0 = dot(cross(q, portal.e1), portal.n)
+                          * portal.inv_n_len_square;
+            const real s1 = dot(cross(portal.e0, q), portal.n)
+                          * portal.inv_n_len_square;
+            if(s0 < 0 || s0 > 1 || s1 < 0 || s1 > 1)
+                continue;
+
+            // area pdf = 1 / area, and area * |cos| = |dot(dir, n)|
+
+            ret += t * t / std::abs(dir_dot_n);
+        }
+
+        return ret / portals_.size();
+    }
+};
+
+AGZ_TRACER_END
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <algorithm>
+#include <fstream>
 #include <vector>
 
 #include <agz/tracer/core/texture2d.h>
@@ -11,160 +12,246 @@ AGZ_TRACER_BEGIN
 
 /**
  * @brief helper class for importance sampling of environment light
+ *
+ * texels of the environment texture are sampled at full resolution with
+ * a marginal/conditional cdf over the (u, v) domain, where
+ *  u = phi / 2pi, v = theta / pi.
+ *
+ * each texel is weighted by luminance * sin(theta) of its centre. sampling
+ * costs O(log(width) + log(height)), and pdf costs O(1).
  */
 class EnvironmentLightSampler : public misc::uncopyable_t
 {
-    texture::texture2d_t<real> probs_;
-    math::distribution::alias_sampler_t<real> sampler_;
+    int width_  = 0;
+    int height_ = 0;
+
+    // marginal_cdf_[y] = sum of rows [0, y), normalized. size: height + 1
+    std::vector<real> marginal_cdf_;
+
+    // conditional_cdf_[y * (width + 1) + x] = sum of texels [0, x) in row y,
+    // normalized. size: height * (width + 1)
+    std::vector<real> conditional_cdf_;
+
+    // magic number and version of cached sampler files
+    static constexpr uint64_t CACHE_MAGIC = 0x31504d4153564e45ull;
+
+    const real *row_cdf(int y) const noexcept
+    {
+        return &conditional_cdf_[static_cast<size_t>(y) * (width_ + 1)];
+    }
+
+    /**
+     * @brief find i in [0, n) with cdf[i] <= u < cdf[i + 1]
+     */
+    static int find_interval(const real *cdf, int n, real u) noexcept
+    {
+        const real *it = std::upper_bound(cdf, cdf + n + 1, u);
+        return math::clamp(static_cast<int>(it - cdf) - 1, 0, n - 1);
+    }
+
+    /**
+     * @brief compute inclusive prefix sum of func and normalize it into cdf
+     *
+     * cdf has n + 1 elements. returns sum of func
+     */
+    static real build_cdf(const real *func, int n, real *cdf) noexcept
+    {
+        // accumulate in double to keep small texels of a large row
+
+        double sum = 0;
+        cdf[0] = 0;
+        for(int i = 0; i < n; ++i)
+        {
+            sum += func[i];
+            cdf[i + 1] = static_cast<real>(sum);
+        }
+
+        if(sum > 0)
+        {
+            const double ratio = 1 / sum;
+            for(int i = 1; i <= n; ++i)
+                cdf[i] = static_cast<real>(cdf[i] * ratio);
+        }
+        else
+        {
+            for(int i = 1; i <= n; ++i)
+                cdf[i] = real(i) / n;
+        }
+
+        cdf[n] = 1;
+        return static_cast<real>(sum);
+    }
 
 public:
 
     explicit EnvironmentLightSampler(RC<const Texture2D> tex)
     {
-        const int width = tex->width(), height = tex->height();
-        const int new_width  = (std::min)(width, 200);
-        const int new_height = (std::min)(height, 200);
+        width_  = (std::max)(tex->width(),  1);
+        height_ = (std::max)(tex->height(), 1);
 
-        // compute energy distribution
+        conditional_cdf_.resize(static_cast<size_t>(height_) * (width_ + 1));
+        std::vector<real> row_sums(height_);
 
-        std::atomic<real> lum_sum = 0;
-        probs_.initialize(new_height, new_width);
+        // compute energy distribution and per-row cdf
 
-        thread::parallel_forrange(0, new_height, [&](int, int y)
+        thread::parallel_forrange(0, height_, [&](int, int y)
         {
-            const real y0 = real(y)     / real(new_height);
-            const real y1 = real(y + 1) / real(new_height);
-
-            const real y0_src = y0 * height;
-            const real y1_src = y1 * height;
+            std::vector<real> row(width_);
 
-            const int y_src_beg = (std::max)(0, int(std::floor(y0_src) - 1));
-            const int y_src_lst = (std::min)(height - 1, int(std::floor(y1_src) + 1));
+            const real v = (y + real(0.5)) / height_;
+            const real sin_theta = std::sin(PI_r * v);
 
-            for(int x = 0; x < new_width; ++x)
+            for(int x = 0; x < width_; ++x)
             {
-                const real x0 = real(x)     / new_width;
-                const real x1 = real(x + 1) / new_width;
-
-                const real x0_src = x0 * width;
-                const real x1_src = x1 * width;
-
-                const int x_src_beg = (std::max)(0, int(std::floor(x0_src) - 1));
-                const int x_src_lst = (std::min)(width - 1, int(std::floor(x1_src) + 1));
-
-                real pixel_lum = 0;
-                for(int y_src = y_src_beg; y_src <= y_src_lst; ++y_src)
-                {
-                    for(int x_src = x_src_beg; x_src <= x_src_lst; ++x_src)
-                    {
-                        const real src_u = (real(x_src) + real(0.5)) / real(width);
-                        const real src_v = (real(y_src) + real(0.5)) / real(height);
-                        pixel_lum += tex->sample_spectrum({ src_u, src_v }).lum();
-                    }
-                }
-
-                const real delta_area = std::abs(
-                    2 * PI_r * (x1 - x0) * (std::cos(PI_r * y1)
-                  - std::cos(PI_r * y0)));
-                  
-                const real area_lum = pixel_lum * delta_area;
-                probs_(y, x) = area_lum;
-                math::atomic_add(lum_sum, area_lum);
+                const real u = (x + real(0.5)) / width_;
+                const real lum = tex->sample_spectrum({ u, v }).lum();
+                row[x] = (std::max)(lum, real(0)) * sin_theta;
             }
+
+            real *cdf = &conditional_cdf_[static_cast<size_t>(y) * (width_ + 1)];
+            row_sums[y] = build_cdf(row.data(), width_, cdf);
         });
 
-        // normalize the energy distribution
+        // marginal distribution of rows
+
+        marginal_cdf_.resize(height_ + 1);
+        build_cdf(row_sums.data(), height_, marginal_cdf_.data());
+    }
 
-        if(lum_sum > EPS())
+    /**
+     * @brief load a sampler saved by save()
+     *
+     * throw when the file doesn't exist or was saved with another key
+     */
+    EnvironmentLightSampler(const std::string &filename, uint64_t key)
+    {
+        std::ifstream fin(filename, std::ios::in | std::ios::binary);
+        if(!fin)
+            throw ObjectConstructionException("failed to open " + filename);
+
+        uint64_t magic = 0, file_key = 0;
+        int32_t width = 0, height = 0;
+        fin.read(reinterpret_cast<char*>(&magic),    sizeof(magic));
+        fin.read(reinterpret_cast<char*>(&file_key), sizeof(file_key));
+        fin.read(reinterpret_cast<char*>(&width),    sizeof(width));
+        fin.read(reinterpret_cast<char*>(&height),   sizeof(height));
+
+        if(!fin || magic != CACHE_MAGIC || file_key != key ||
+           width <= 0 || height <= 0)
         {
-            const real ratio = 1 / lum_sum;
-            for(int y = 0; y < new_height; ++y)
-            {
-                for(int x = 0; x < new_width; ++x)
-                    probs_(y, x) *= ratio;
-            }
+            throw ObjectConstructionException(
+                "outdated environment light sampler cache: " + filename);
         }
 
-        // linearize the energy distribution
+        width_  = width;
+        height_ = height;
 
-        std::vector<real> linear_probs(probs_.size().product());
-        for(int y = 0; y < new_height; ++y)
+        marginal_cdf_.resize(height_ + 1);
+        conditional_cdf_.resize(static_cast<size_t>(height_) * (width_ + 1));
+
+        fin.read(reinterpret_cast<char*>(marginal_cdf_.data()),
+                 static_cast<std::streamsize>(
+                    marginal_cdf_.size() * sizeof(real)));
+        fin.read(reinterpret_cast<char*>(conditional_cdf_.data()),
+                 static_cast<std::streamsize>(
+                    conditional_cdf_.size() * sizeof(real)));
+
+        if(!fin)
         {
-            const int y_base = y * new_width;
-            for(int x = 0; x < new_width; ++x)
-            {
-                const int idx = y_base + x;
-                linear_probs[idx] = probs_(y, x);
-            }
+            throw ObjectConstructionException(
+                "failed to read environment light sampler cache: " + filename);
         }
+    }
 
-        // construct sampler
-
-        sampler_.initialize(linear_probs.data(), int(linear_probs.size()));
+    /**
+     * @brief save the sampler to file, which can be loaded with the same key
+     */
+    void save(const std::string &filename, uint64_t key) const
+    {
+        std::ofstream fout(filename, std::ios::out | std::ios::binary);
+        if(!fout)
+            throw ObjectConstructionException("failed to open " + filename);
+
+        const int32_t width = width_, height = height_;
+        fout.write(reinterpret_cast<const char*>(&CACHE_MAGIC), sizeof(CACHE_MAGIC));
+        fout.write(reinterpret_cast<const char*>(&key),         sizeof(key));
+        fout.write(reinterpret_cast<const char*>(&width),       sizeof(width));
+        fout.write(reinterpret_cast<const char*>(&height),      sizeof(height));
+
+        fout.write(reinterpret_cast<const char*>(marginal_cdf_.data()),
+                   static_cast<std::streamsize>(
+                        marginal_cdf_.size() * sizeof(real)));
+        fout.write(reinterpret_cast<const char*>(conditional_cdf_.data()),
+                   static_cast<std::streamsize>(
+                        conditional_cdf_.size() * sizeof(real)));
+
+        if(!fout)
+        {
+            throw ObjectConstructionException(
+                "failed to write environment light sampler cache: " + filename);
+        }
     }
 
     // return (ref_to_light, pdf)
     std::pair<FVec3, real> sample(const Sample3 &sam) const
     {
-        const int patch_idx = sampler_.sample(sam.u);
-        const int patch_y = patch_idx / probs_.width();
-        const int patch_x = patch_idx % probs_.width();
-        assert(patch_y < probs_.height());
-        assert(patch_x < probs_.width());
+        // select row
 
-        const real patch_pdf = probs_(patch_y, patch_x);
+        const int y = find_interval(marginal_cdf_.data(), height_, sam.u);
+        const real row_beg = marginal_cdf_[y], row_end = marginal_cdf_[y + 1];
+        const real row_prob = row_end - row_beg;
+        const real dv = row_prob > 0 ? (sam.u - row_beg) / row_prob : real(0.5);
 
-        const real u0 = real(patch_x)     / real(probs_.width());
-        const real u1 = real(patch_x + 1) / real(probs_.width());
-        const real v0 = real(patch_y)     / real(probs_.height());
-        const real v1 = real(patch_y + 1) / real(probs_.height());
+        // select texel in the row
 
-        const auto [cvmin, cvmax] = math::minmax(
-            std::cos(PI_r * v1), std::cos(PI_r * v0));
+        const real *cdf = row_cdf(y);
+        const int x = find_interval(cdf, width_, sam.v);
+        const real texel_prob = cdf[x + 1] - cdf[x];
+        const real du = texel_prob > 0 ? (sam.v - cdf[x]) / texel_prob : real(0.5);
 
-        const real cos_theta = cvmin + sam.w * (cvmax - cvmin);
-        const real sin_theta = local_angle::cos_2_sin(cos_theta);
-        const real u         = math::mix(u0, u1, sam.v);
-        const real phi       = 2 * PI_r * u;
+        // uv -> direction
+
+        const real u = (x + math::saturate(du)) / width_;
+        const real v = (y + math::saturate(dv)) / height_;
+
+        const real phi   = 2 * PI_r * u;
+        const real theta = PI_r * v;
+        const real sin_theta = std::sin(theta);
+        const real cos_theta = std::cos(theta);
 
         const FVec3 dir = {
             sin_theta * std::cos(phi),
             sin_theta * std::sin(phi),
             cos_theta
         };
-        const real in_patch_pdf = 1 / (2 * PI_r * ((u1 - u0) * (cvmax - cvmin)));
 
-        return { dir, patch_pdf * in_patch_pdf };
+        if(sin_theta <= 0)
+            return { dir, 0 };
+
+        const real pdf_uv = row_prob * texel_prob * width_ * height_;
+        return { dir, pdf_uv / (2 * PI_r * PI_r * sin_theta) };
     }
 
     real pdf(const FVec3 &ref_to_light) const
     {
         const FVec3 dir = ref_to_light.normalize();
-        const real cos_theta = local_angle::cos_theta(dir);
-        const real theta = std::acos(cos_theta);
-        const real phi = local_angle::phi(dir);
-
-        const real u = phi / (2 * PI_r);
-        const real v = theta / PI_r;
-
-        const int patch_x = (std::min)(probs_.width() - 1,
-                                       int(std::floor(u * probs_.width())));
-        const int patch_y = (std::min)(probs_.height() - 1,
-                                       int(std::floor(v * probs_.height())));
+        const real cos_theta = math::clamp<real>(local_angle::cos_theta(dir), -1, 1);
+        const real sin_theta = local_angle::cos_2_sin(cos_theta);
+        if(sin_theta <= 0)
+            return 0;
 
-        const real patch_pdf = probs_(patch_y, patch_x);
+        const real u = local_angle::phi(dir) / (2 * PI_r);
+        const real v = std::acos(cos_theta) / PI_r;
 
-        const real u0 = real(patch_x)     / real(probs_.width());
-        const real u1 = real(patch_x + 1) / real(probs_.width());
-        const real v0 = real(patch_y)     / real(probs_.height());
-        const real v1 = real(patch_y + 1) / real(probs_.height());
+        const int x = math::clamp(static_cast<int>(u * width_),  0, width_  - 1);
+        const int y = math::clamp(static_cast<int>(v * height_), 0, height_ - 1);
 
-        const auto [cvmin, cvmax] = math::minmax(
-            std::cos(PI_r * v1), std::cos(PI_r * v0));
-        
-        const real in_patch_pdf = 1 / (2 * PI_r * ((u1 - u0) * (cvmax - cvmin)));
+        const real row_prob   = marginal_cdf_[y + 1] - marginal_cdf_[y];
+        const real *cdf       = row_cdf(y);
+        const real texel_prob = cdf[x + 1] - cdf[x];
 
-        return patch_pdf * in_patch_pdf;
+        const real pdf_uv = row_prob * texel_prob * width_ * height_;
+        return pdf_uv / (2 * PI_r * PI_r * sin_theta);
     }
 };
 
@@ -1,9 +1,12 @@
 ﻿#include <agz/tracer/core/light.h>
 #include <agz/tracer/core/texture2d.h>
 #include <agz/tracer/create/texture2d.h>
+#include <agz/tracer/utility/logger.h>
+#include <agz/tracer/utility/trace.h>
 #include <agz/utility/misc.h>
 #include <agz/utility/texture.h>
 
+#include "./env_portal.h"
 #include "./env_sampler.h"
 
 AGZ_TRACER_BEGIN
@@ -16,14 +19,50 @@ class IBL : public EnvirLight
 
     Box<EnvironmentLightSampler> sampler_;
 
+    EnvironmentLightPortals portals_;
+
     real user_specified_power_;
 
+    void init_sampler(
+        const std::string &sampler_cache_filename, uint64_t sampler_cache_key)
+    {
+        AGZ_TRACE_SCOPE("scene", "envir light sampler");
+
+        if(sampler_cache_filename.empty())
+        {
+            sampler_ = newBox<EnvironmentLightSampler>(tex_);
+            return;
+        }
+
+        try
+        {
+            sampler_ = newBox<EnvironmentLightSampler>(
+                sampler_cache_filename, sampler_cache_key);
+            AGZ_INFO("environment light sampler loaded from {}",
+                     sampler_cache_filename);
+            return;
+        }
+        catch(const std::exception &)
+        {
+            // cache is missing or outdated
+        }
+
+        sampler_ = newBox<EnvironmentLightSampler>(tex_);
+        sampler_->save(sampler_cache_filename, sampler_cache_key);
+        AGZ_INFO("environment light sampler saved to {}",
+                 sampler_cache_filename);
+    }
+
 public:
 
     IBL(
         RC<const Texture2D> tex,
         bool no_importance_sampling,
-        real user_specified_power = -1)
+        real user_specified_power,
+        const std::string &sampler_cache_filename,
+        uint64_t sampler_cache_key,
+        const std::vector<EnvirLightPortal> &portals)
+        : portals_(portals)
     {
         tex_ = tex;
         user_specified_power_ = user_specified_power;
@@ -32,7 +71,7 @@ public:
             sampler_ = newBox<EnvironmentLightSampler>(
                 create_constant2d_texture({}, FSpectrum(1)));
         else
-            sampler_ = newBox<EnvironmentLightSampler>(tex_);
+            init_sampler(sampler_cache_filename, sampler_cache_key);
 
         if(no_importance_sampling)
         {
@@ -41,7 +80,9 @@ public:
         else
         {
             const int tex_width = tex_->width(), tex_height = tex_->height();
-            for(int y = 0; y < tex_height; ++y)
+            std::vector<FSpectrum> row_rad(tex_height);
+
+            thread::parallel_forrange(0, tex_height, [&](int, int y)
             {
                 const real v0 = real(y) / tex_height;
                 const real v1 = real(y + 1) / tex_height;
@@ -55,16 +96,23 @@ public:
                                             (std::cos(PI_r * v1) - std::cos(PI_r * v0)));
 
                     const real u = (u0 + u1) / 2, v = (v0 + v1) / 2;
-                    avg_rad_ += PI_r * delta_area * tex_->sample_spectrum({ u, v });
+                    row_rad[y] += PI_r * delta_area * tex_->sample_spectrum({ u, v });
                 }
-            }
+            });
+
+            for(auto &r : row_rad)
+                avg_rad_ += r;
         }
     }
 
     LightSampleResult sample(
         const FVec3 &ref, const Sample5 &sam) const noexcept override
     {
-        const auto [dir, pdf] = sampler_->sample({ sam.u, sam.v, sam.w });
+        const auto [dir, pdf] = portals_.empty() ?
+            sampler_->sample({ sam.u, sam.v, sam.w }) :
+            portals_.sample(ref, { sam.u, sam.v, sam.w });
+        if(!pdf)
+            return LIGHT_SAMPLE_RESULT_NULL;
 
         return LightSampleResult(
             ref, emit_pos(ref, dir).pos, -dir, radiance(ref, dir), pdf);
@@ -72,6 +120,8 @@ public:
 
     real pdf(const FVec3 &ref, const FVec3 &ref_to_light) const noexcept override
     {
+        if(!portals_.empty())
+            return portals_.pdf(ref, ref_to_light);
         return sampler_->pdf(ref_to_light);
     }
 
@@ -158,9 +208,14 @@ public:
 RC<EnvirLight> create_ibl_light(
     RC<const Texture2D> tex,
     bool no_importance_sampling,
-    real user_specified_power)
+    real user_specified_power,
+    const std::string &sampler_cache_filename,
+    uint64_t sampler_cache_key,
+    const std::vector<EnvirLightPortal> &portals)
 {
-    return newRC<IBL>(tex, no_importance_sampling, user_specified_power);
+    return newRC<IBL>(
+        tex, no_importance_sampling, user_specified_power,
+        sampler_cache_filename, sampler_cache_key, portals);
 }
 
 AGZ_TRACER_END
@@ -1,6 +1,8 @@
 #include <agz/tracer/core/light.h>
 #include <agz/utility/misc.h>
 
+#include "./env_portal.h"
+
 AGZ_TRACER_BEGIN
 
 class NativeSky : public EnvirLight
@@ -10,6 +12,8 @@ class NativeSky : public EnvirLight
 
     real user_specified_power_;
 
+    EnvironmentLightPortals portals_;
+
     FSpectrum radiance_impl(const FVec3 &ref_to_light) const noexcept
     {
         const real cos_theta = math::clamp<real>(
@@ -23,7 +27,9 @@ public:
 
     NativeSky(
         const FSpectrum &top, const FSpectrum &bottom,
-        real user_specified_power)
+        real user_specified_power,
+        const std::vector<EnvirLightPortal> &portals)
+        : portals_(portals)
     {
         top_    = top;
         bottom_ = bottom;
@@ -33,14 +39,26 @@ public:
     LightSampleResult sample(
         const FVec3 &ref, const Sample5 &sam) const noexcept override
     {
+        if(!portals_.empty())
+        {
+            const auto [dir, pdf] = portals_.sample(ref, { sam.u, sam.v, sam.w });
+            if(!pdf)
+                return LIGHT_SAMPLE_RESULT_NULL;
+
+            return LightSampleResult(
+                ref, emit_pos(ref, dir).pos, -dir, radiance_impl(dir), pdf);
+        }
+
         const auto [dir, pdf] = math::distribution::uniform_on_sphere(sam.u, sam.v);
 
         return LightSampleResult(
             ref, emit_pos(ref, dir).pos, -dir, radiance_impl(dir), pdf);
     }
 
-    real pdf(const FVec3 &ref, const FVec3 &) const noexcept override
+    real pdf(const FVec3 &ref, const FVec3 &ref_to_light) const noexcept override
     {
+        if(!portals_.empty())
+            return portals_.pdf(ref, ref_to_light);
         return math::distribution::uniform_on_sphere_pdf<real>;
     }
 
@@ -123,9 +141,10 @@ public:
 RC<EnvirLight> create_native_sky(
     const FSpectrum &top,
     const FSpectrum &bottom,
-    real user_specified_power)
+    real user_specified_power,
+    const std::vector<EnvirLightPortal> &portals)
 {
-    return newRC<NativeSky>(top, bottom, user_specified_power);
+    return newRC<NativeSky>(top, bottom, user_specified_power, portals);
 }
 
 AGZ_TRACER_END
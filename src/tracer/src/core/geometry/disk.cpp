@@ -76,6 +76,12 @@ public:
         inct->wr = -local_r.d;
         inct->t = t_val;
 
+        // u = phi / 2pi, v = radius / radius_
+
+        inct->dpdu = 2 * PI_r * FVec3(-pos.y, pos.x, 0);
+        if(radius > 0)
+            inct->dpdv = (radius_ / radius) * FVec3(pos.x, pos.y, 0);
+
         to_world(inct);
         return true;
     }
@@ -1,5 +1,5 @@
 #include <agz/tracer/core/geometry.h>
-#include <agz/tracer/utility/triangle_aux.h>
+#include <agz/tracer/utility/solid_angle_aux.h>
 #include <agz/utility/misc.h>
 
 AGZ_TRACER_BEGIN
@@ -40,6 +40,8 @@ public:
             inct->user_coord     = inct->geometry_coord;
             inct->wr             = -r.d;
             inct->t              = inct_rcd.t_ray;
+            inct->dpdu           = dpdu_abc_;
+            inct->dpdv           = dpdv_abc_;
             return true;
         }
         
@@ -51,6 +53,8 @@ public:
             inct->user_coord     = inct->geometry_coord;
             inct->wr             = -r.d;
             inct->t              = inct_rcd.t_ray;
+            inct->dpdu           = dpdu_acd_;
+            inct->dpdv           = dpdv_acd_;
             return true;
         }
 
@@ -105,9 +109,48 @@ public:
     }
 
     SurfacePoint sample(
-        const FVec3 &, real *pdf, const Sample3 &sam) const noexcept override
+        const FVec3 &ref, real *pdf, const Sample3 &sam) const noexcept override
     {
-        return sample(pdf, sam);
+        if(is_rectangle_)
+        {
+            const SphericalRectangle rect(ref, a_, b_a_, d_a_);
+            if(!use_solid_angle_sampling(rect.solid_angle()))
+                return sample(pdf, sam);
+
+            // a_ + s * b_a_ + t * d_a_ = a_ + (s - t) * b_a_ + t * c_a_
+            //                          = a_ + s * c_a_ + (t - s) * d_a_
+
+            const Vec2 st = rect.sample(sam.u, sam.v);
+            SurfacePoint spt = st.x >= st.y ?
+                point_on_abc({ st.x - st.y, st.y }) :
+                point_on_acd({ st.x, st.y - st.x });
+
+            *pdf = solid_angle_pdf_to_area(
+                1 / rect.solid_angle(), ref, spt.pos, z_);
+            return spt;
+        }
+
+        // solid angles given by spherical triangle sampling don't depend on
+        // the sample, so pdf takes the same branch. a failed triangle has
+        // zero solid angle and is never selected
+
+        Vec2 bi_coord_abc, bi_coord_acd;
+        const real solid_angle_abc = sample_spherical_triangle(
+            ref, a_, b_a_, c_a_, sam.u, sam.v, &bi_coord_abc);
+        const real solid_angle_acd = sample_spherical_triangle(
+            ref, a_, c_a_, d_a_, sam.u, sam.v, &bi_coord_acd);
+        const real solid_angle = solid_angle_abc + solid_angle_acd;
+        if(!use_solid_angle_sampling(solid_angle))
+            return sample(pdf, sam);
+
+        // select a triangle in proportion to its solid angle
+
+        const SurfacePoint spt = sam.w * solid_angle < solid_angle_abc ?
+                                 point_on_abc(bi_coord_abc) :
+                                 point_on_acd(bi_coord_acd);
+
+        *pdf = solid_angle_pdf_to_area(1 / solid_angle, ref, spt.pos, z_);
+        return spt;
     }
 
     real pdf(const FVec3 &) const noexcept override
@@ -115,12 +158,52 @@ public:
         return 1 / surface_area_;
     }
 
-    real pdf(const FVec3 &, const FVec3 &sample) const noexcept override
+    real pdf(const FVec3 &ref, const FVec3 &sample) const noexcept override
     {
-        return pdf(sample);
+        real solid_angle;
+        if(is_rectangle_)
+        {
+            solid_angle = SphericalRectangle(
+                ref, a_, b_a_, d_a_).solid_angle();
+        }
+        else
+        {
+            Vec2 unused_bi_coord;
+            solid_angle = sample_spherical_triangle(
+                              ref, a_, b_a_, c_a_, 0, 0, &unused_bi_coord)
+                        + sample_spherical_triangle(
+                              ref, a_, c_a_, d_a_, 0, 0, &unused_bi_coord);
+        }
+
+        if(!use_solid_angle_sampling(solid_angle))
+            return pdf(sample);
+
+        return solid_angle_pdf_to_area(1 / solid_angle, ref, sample, z_);
     }
 
 private:
+
+    SurfacePoint point_on_abc(const Vec2 &bi_coord) const noexcept
+    {
+        SurfacePoint spt;
+        spt.pos = a_ + bi_coord.x * b_a_ + bi_coord.y * c_a_;
+        spt.geometry_coord = FCoord(x_abc_, cross(z_, x_abc_), z_);
+
+        spt.uv = t_a_ + bi_coord.x * t_b_a_ + bi_coord.y * t_c_a_;
+        spt.user_coord = spt.geometry_coord;
+        return spt;
+    }
+
+    SurfacePoint point_on_acd(const Vec2 &bi_coord) const noexcept
+    {
+        SurfacePoint spt;
+        spt.pos = a_ + bi_coord.x * c_a_ + bi_coord.y * d_a_;
+        spt.geometry_coord = FCoord(x_acd_, cross(z_, x_acd_), z_);
+
+        spt.uv = t_a_ + bi_coord.x * t_c_a_ + bi_coord.y * t_d_a_;
+        spt.user_coord = spt.geometry_coord;
+        return spt;
+    }
     
     FVec3 a_;
     FVec3 b_a_, c_a_, d_a_;
@@ -129,10 +212,14 @@ private:
     Vec2 t_b_a_, t_c_a_, t_d_a_;
 
     FVec3 x_abc_, x_acd_, z_;
+    FVec3 dpdu_abc_, dpdv_abc_, dpdu_acd_, dpdv_acd_;
 
     real surface_area_ = 1;
     real sample_abc_prob_ = 0;
 
+    // use spherical rectangle sampling when abcd is a rectangle
+    bool is_rectangle_ = false;
+
     Params params_;
 
     void init_from_params(const Params &params)
@@ -157,10 +244,22 @@ private:
 
         x_acd_ = dpdu_as_ex(c_a_, d_a_, t_c_a_, t_d_a_, z_);
 
+        triangle_dpdu_dpdv(
+            b_a_, c_a_, t_b_a_, t_c_a_, &dpdu_abc_, &dpdv_abc_);
+        triangle_dpdu_dpdv(
+            c_a_, d_a_, t_c_a_, t_d_a_, &dpdu_acd_, &dpdv_acd_);
+
         const real area_abc = triangle_area(b_a_, c_a_);
         const real area_acd = triangle_area(c_a_, d_a_);
         surface_area_ = area_abc + area_acd;
         sample_abc_prob_ = area_abc / surface_area_;
+
+        constexpr real RECT_EPS = real(1e-4);
+        const real len_b_a = b_a_.length(), len_d_a = d_a_.length();
+        is_rectangle_ =
+            std::abs(dot(b_a_, d_a_)) <= RECT_EPS * len_b_a * len_d_a &&
+            (c_a_ - b_a_ - d_a_).length() <=
+                RECT_EPS * (std::max)(len_b_a, len_d_a);
     }
 };
 
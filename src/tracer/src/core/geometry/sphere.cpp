@@ -55,6 +55,16 @@ public:
         inct->wr = -local_r.d;
         inct->t = t;
 
+        // u = phi / 2pi, v = theta / pi + 1/2
+
+        const real rho = Vec2(pos.x, pos.y).length();
+        inct->dpdu = 2 * PI_r * FVec3(-pos.y, pos.x, 0);
+        if(rho > 0)
+        {
+            inct->dpdv = PI_r * FVec3(
+                -pos.z * pos.x / rho, -pos.z * pos.y / rho, rho);
+        }
+
         to_world(inct);
 
         return true;
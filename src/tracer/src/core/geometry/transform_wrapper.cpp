@@ -63,6 +63,8 @@ public:
         inct->geometry_coord = local_to_world_.apply_to_coord(inct->geometry_coord);
         inct->user_coord     = local_to_world_.apply_to_coord(inct->user_coord);
         inct->wr             = -r.d;
+        inct->dpdu           = local_to_world_.apply_to_vector(inct->dpdu);
+        inct->dpdv           = local_to_world_.apply_to_vector(inct->dpdv);
 
         return true;
     }
@@ -1,4 +1,4 @@
-#include <agz/tracer/utility/triangle_aux.h>
+#include <agz/tracer/utility/solid_angle_aux.h>
 #include <agz/utility/misc.h>
 
 #include "./transformed_geometry.h"
@@ -44,6 +44,8 @@ public:
         inct->user_coord     = inct->geometry_coord;
         inct->wr             = -local_r.d;
         inct->t              = inct_rcd.t_ray;
+        inct->dpdu           = dpdu_;
+        inct->dpdv           = dpdv_;
 
         to_world(inct);
 
@@ -87,9 +89,30 @@ public:
     }
 
     SurfacePoint sample(
-        const FVec3 &, real *pdf, const Sample3 &sam) const noexcept override
+        const FVec3 &ref, real *pdf, const Sample3 &sam) const noexcept override
     {
-        return sample(pdf, sam);
+        // the solid angle (and failure) of spherical triangle sampling
+        // doesn't depend on the sample, so pdf takes the same branch
+
+        Vec2 bi_coord;
+        const real solid_angle = sample_spherical_triangle(
+            ref, world_a_, world_b_a_, world_c_a_, sam.u, sam.v, &bi_coord);
+        if(!use_solid_angle_sampling(solid_angle))
+            return sample(pdf, sam);
+
+        // barycentric coordinates are preserved by affine transform
+
+        SurfacePoint spt;
+        spt.pos            = a_ + bi_coord.x * b_a_ + bi_coord.y * c_a_;
+        spt.geometry_coord = FCoord(x_, cross(z_, x_), z_);
+        spt.uv             = t_a_ + bi_coord.x * t_b_a_ + bi_coord.y * t_c_a_;
+        spt.user_coord     = spt.geometry_coord;
+
+        to_world(&spt);
+
+        *pdf = solid_angle_pdf_to_area(
+            1 / solid_angle, ref, spt.pos, world_z_);
+        return spt;
     }
 
     real pdf(const FVec3 &) const noexcept override
@@ -97,9 +120,16 @@ public:
         return 1 / surface_area_;
     }
 
-    real pdf(const FVec3 &, const FVec3 &sample) const noexcept override
+    real pdf(const FVec3 &ref, const FVec3 &sample) const noexcept override
     {
-        return pdf(sample);
+        Vec2 unused_bi_coord;
+        const real solid_angle = sample_spherical_triangle(
+            ref, world_a_, world_b_a_, world_c_a_, 0, 0, &unused_bi_coord);
+        if(!use_solid_angle_sampling(solid_angle))
+            return pdf(sample);
+
+        return solid_angle_pdf_to_area(
+            1 / solid_angle, ref, sample, world_z_);
     }
 
 private:
@@ -118,19 +148,25 @@ private:
 
         z_ = cross(b_a_, c_a_).normalize();
         x_ = dpdu_as_ex(b_a_, c_a_, t_b_a_, t_c_a_, z_);
+        triangle_dpdu_dpdv(b_a_, c_a_, t_b_a_, t_c_a_, &dpdu_, &dpdv_);
 
-        const FVec3 world_b_a = local_to_world_.apply_to_vector(b_a_);
-        const FVec3 world_c_a = local_to_world_.apply_to_vector(c_a_);
-        surface_area_ = triangle_area(world_b_a, world_c_a);
+        world_a_   = local_to_world_.apply_to_point(a_);
+        world_b_a_ = local_to_world_.apply_to_vector(b_a_);
+        world_c_a_ = local_to_world_.apply_to_vector(c_a_);
+        world_z_   = cross(world_b_a_, world_c_a_).normalize();
+        surface_area_ = triangle_area(world_b_a_, world_c_a_);
     }
 
     Params params_;
 
     FVec3 a_, b_a_, c_a_;
     Vec2 t_a_, t_b_a_, t_c_a_;
+    FVec3 dpdu_, dpdv_;
     FVec3 x_, z_;
     real surface_area_ = 1;
 
+    FVec3 world_a_, world_b_a_, world_c_a_, world_z_;
+
 };
 
 RC<Geometry> create_triangle(
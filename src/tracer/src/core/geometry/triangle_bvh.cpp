@@ -4,7 +4,9 @@
 #include <vector>
 
 #include <agz/tracer/utility/logger.h>
-#include <agz/tracer/utility/triangle_aux.h>
+#include <agz/tracer/utility/render_stats.h>
+#include <agz/tracer/utility/solid_angle_aux.h>
+#include <agz/tracer/utility/trace.h>
 
 #include <agz/utility/mesh.h>
 #include <agz/utility/misc.h>
@@ -312,6 +314,9 @@ namespace
 
         math::distribution::alias_sampler_t<real> prim_sampler_;
 
+        // available only for small meshes
+        TriangleMeshSolidAngleSampler solid_angle_sampler_;
+
         real surface_area_ = 0;
         AABB local_bound_;
 
@@ -358,6 +363,12 @@ namespace
 
             prim_sampler_.initialize(
                 area_arr.data(), static_cast<int>(triangle_count));
+
+            if(triangle_count <= TriangleMeshSolidAngleSampler::MAX_TRIANGLE_COUNT)
+            {
+                for(auto &prim : prims_)
+                    solid_angle_sampler_.add_triangle(prim.a_, prim.b_a_, prim.c_a_);
+            }
         }
 
         bool has_intersection(const Ray &r) const noexcept
@@ -375,11 +386,13 @@ namespace
             {
                 const uint32_t task_node_idx = traversal_stack[--top];
                 const Node &node = nodes_[task_node_idx];
+                AGZ_RENDER_STATS_ADD(BVHNodesVisited, 1);
 
                 if(node.is_leaf())
                 {
                     for(uint32_t i = node.start; i < node.end_or_right_offset; ++i)
                     {
+                        AGZ_RENDER_STATS_ADD(TrianglesTested, 1);
                         const Primitive &prim = prims_[i];
                         if(has_intersection_with_triangle(r, prim.a_, prim.b_a_, prim.c_a_))
                             return true;
@@ -420,9 +433,12 @@ namespace
             {
                 const uint32_t task_node_idx = traversal_stack[--top];
                 const Node &node = nodes_[task_node_idx];
+                AGZ_RENDER_STATS_ADD(BVHNodesVisited, 1);
 
                 if(node.is_leaf())
                 {
+                    AGZ_RENDER_STATS_ADD(
+                        TrianglesTested, node.end_or_right_offset - node.start);
                     for(uint32_t i = node.start; i < node.end_or_right_offset; ++i)
                     {
                         const Primitive &prim = prims_[i];
@@ -482,6 +498,11 @@ namespace
                                                + rcd.uv.y * FVec3(prim_info.n_c_a_);
             inct->user_coord = inct->geometry_coord.rotate_to_new_z(user_z);
 
+            const Primitive &prim = prims_[final_prim_idx];
+            triangle_dpdu_dpdv(
+                prim.b_a_, prim.c_a_, prim_info.t_b_a_, prim_info.t_c_a_,
+                &inct->dpdu, &inct->dpdv);
+
             inct->wr = -r.d;
 
             return true;
@@ -495,12 +516,38 @@ namespace
         SurfacePoint sample(real *pdf, const Sample3 &sam) const noexcept
         {
             const int prim_idx = prim_sampler_.sample(sam.u);
+            const Vec2 uv = math::distribution::uniform_on_triangle(sam.v, sam.w);
+
+            *pdf = 1 / surface_area_;
+
+            return point_on_prim(prim_idx, uv);
+        }
+
+        SurfacePoint sample(
+            const FVec3 &ref, real *pdf, const Sample3 &sam) const noexcept
+        {
+            int prim_idx; Vec2 uv;
+            if(!solid_angle_sampler_.available() ||
+               !solid_angle_sampler_.sample(ref, sam, &prim_idx, &uv, pdf))
+                return sample(pdf, sam);
+            return point_on_prim(prim_idx, uv);
+        }
+
+        real pdf(const FVec3 &ref, const FVec3 &pos) const noexcept
+        {
+            real ret;
+            if(!solid_angle_sampler_.available() ||
+               !solid_angle_sampler_.pdf(ref, pos, &ret))
+                return 1 / surface_area_;
+            return ret;
+        }
+
+        SurfacePoint point_on_prim(int prim_idx, const Vec2 &uv) const noexcept
+        {
             assert(0 <= prim_idx && static_cast<size_t>(prim_idx) < prims_.size());
             const Primitive &prim = prims_[prim_idx];
             const PrimitiveInfo &prim_info = prim_info_[prim_idx];
 
-            const Vec2 uv = math::distribution::uniform_on_triangle(sam.v, sam.w);
-
             SurfacePoint spt;
             spt.pos            = prim.a_ + uv.x * prim.b_a_ + uv.y * prim.c_a_;
             spt.geometry_coord = FCoord(
@@ -512,8 +559,6 @@ namespace
                                                + uv.y * FVec3(prim_info.n_c_a_);
             spt.user_coord = spt.geometry_coord.rotate_to_new_z(user_z);
 
-            *pdf = 1 / surface_area_;
-
             return spt;
         }
 
@@ -549,6 +594,8 @@ class TriangleBVH : public Geometry
                 tri.vertices[2].normal);
         }
 
+        AGZ_TRACE_SCOPE("bvh", "triangle bvh build");
+
         auto ret = newBox<UntransformedTriangleBVH>();
         ret->initialize(
             build_triangles.data(),
@@ -612,9 +659,9 @@ public:
     }
 
     SurfacePoint sample(
-        const FVec3 &, real *pdf, const Sample3 &sam) const noexcept override
+        const FVec3 &ref, real *pdf, const Sample3 &sam) const noexcept override
     {
-        return sample(pdf, sam);
+        return untransformed_->sample(ref, pdf, sam);
     }
 
     real pdf(const FVec3 &) const noexcept override
@@ -622,9 +669,9 @@ public:
         return 1 / surface_area();
     }
 
-    real pdf(const FVec3 &, const FVec3 &sample) const noexcept override
+    real pdf(const FVec3 &ref, const FVec3 &sample) const noexcept override
     {
-        return pdf(sample);
+        return untransformed_->pdf(ref, sample);
     }
 };
 
@@ -7,7 +7,8 @@
 #include <agz/tracer/core/intersection.h>
 #include <agz/tracer/utility/embree.h>
 #include <agz/tracer/utility/logger.h>
-#include <agz/tracer/utility/triangle_aux.h>
+#include <agz/tracer/utility/solid_angle_aux.h>
+#include <agz/tracer/utility/trace.h>
 #include <agz/utility/mesh.h>
 #include <agz/utility/misc.h>
 
@@ -72,6 +73,9 @@ namespace tri_bvh_embree_ws
 
         math::distribution::alias_sampler_t<real> prim_sampler_;
 
+        // available only for small meshes
+        TriangleMeshSolidAngleSampler solid_angle_sampler_;
+
         real surface_area_ = 0;
         AABB local_bound_;
 
@@ -179,6 +183,12 @@ namespace tri_bvh_embree_ws
 
             prim_sampler_.initialize(areas.data(), static_cast<int>(areas.size()));
 
+            if(triangle_count <= TriangleMeshSolidAngleSampler::MAX_TRIANGLE_COUNT)
+            {
+                for(auto &prim : prims_)
+                    solid_angle_sampler_.add_triangle(prim.a, prim.b_a, prim.c_a);
+            }
+
             rtcSetGeometryBuildQuality(mesh, RTC_BUILD_QUALITY_HIGH);
             rtcCommitGeometry(mesh);
 
@@ -243,6 +253,11 @@ namespace tri_bvh_embree_ws
                                  v * FVec3(info.n_c_a);
             inct->user_coord = inct->geometry_coord.rotate_to_new_z(user_z);
 
+            const Primitive &prim = prims_[rayhit.hit.primID];
+            triangle_dpdu_dpdv(
+                prim.b_a, prim.c_a, info.t_b_a, info.t_c_a,
+                &inct->dpdu, &inct->dpdv);
+
             inct->wr = -r.d;
 
             return true;
@@ -251,12 +266,40 @@ namespace tri_bvh_embree_ws
         SurfacePoint uniformly_sample(const Sample3 &sam) const noexcept
         {
             const int prim_idx = prim_sampler_.sample(sam.u);
+            auto uv = math::distribution::uniform_on_triangle(sam.v, sam.w);
+            return point_on_prim(prim_idx, uv);
+        }
+
+        /**
+         * @brief sample w.r.t. solid angle seen from ref
+         *
+         * return false when the mesh should be sampled uniformly by area
+         */
+        bool sample_solid_angle(
+            const FVec3 &ref, const Sample3 &sam,
+            SurfacePoint *spt, real *pdf) const noexcept
+        {
+            int prim_idx; Vec2 uv;
+            if(!solid_angle_sampler_.available() ||
+               !solid_angle_sampler_.sample(ref, sam, &prim_idx, &uv, pdf))
+                return false;
+            *spt = point_on_prim(prim_idx, uv);
+            return true;
+        }
+
+        bool solid_angle_pdf(
+            const FVec3 &ref, const FVec3 &pos, real *pdf) const noexcept
+        {
+            return solid_angle_sampler_.available() &&
+                   solid_angle_sampler_.pdf(ref, pos, pdf);
+        }
+
+        SurfacePoint point_on_prim(int prim_idx, const Vec2 &uv) const noexcept
+        {
             assert(0 <= prim_idx && static_cast<size_t>(prim_idx) < prims_.size());
             const Primitive &prim = prims_[prim_idx];
             const PrimitiveInfo &prim_info = prim_info_[prim_idx];
 
-            auto uv = math::distribution::uniform_on_triangle(sam.v, sam.w);
-
             SurfacePoint spt;
 
             spt.pos = prim.a + uv.x * prim.b_a + uv.y * prim.c_a;
@@ -319,6 +362,8 @@ class TriangleBVHEmbree : public Geometry
                 tri.vertices[2].normal);
         }
 
+        AGZ_TRACE_SCOPE("bvh", "embree triangle bvh build");
+
         auto ret = newBox<tri_bvh_embree_ws::UntransformedTriangleBVH>();
         ret->initialize(build_triangles.data(), build_triangles.size());
 
@@ -383,8 +428,11 @@ public:
     }
 
     SurfacePoint sample(
-        const FVec3 &, real *pdf, const Sample3 &sam) const noexcept override
+        const FVec3 &ref, real *pdf, const Sample3 &sam) const noexcept override
     {
+        SurfacePoint spt;
+        if(untransformed_->sample_solid_angle(ref, sam, &spt, pdf))
+            return spt;
         return sample(pdf, sam);
     }
 
@@ -393,8 +441,11 @@ public:
         return 1 / surface_area();
     }
 
-    real pdf(const FVec3 &, const FVec3 &sample) const noexcept override
+    real pdf(const FVec3 &ref, const FVec3 &sample) const noexcept override
     {
+        real ret;
+        if(untransformed_->solid_angle_pdf(ref, sample, &ret))
+            return ret;
         return pdf(sample);
     }
 };
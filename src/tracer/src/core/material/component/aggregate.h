@@ -1,5 +1,7 @@
 #pragma once
 
+#include <agz/tracer/utility/render_stats.h>
+
 #include "./component.h"
 
 AGZ_TRACER_BEGIN
@@ -248,6 +250,8 @@ template<int MAX_COMP_CNT>
 BSDFSampleResult AggregateBSDF<MAX_COMP_CNT>::sample_all(
     const FVec3 &wo, TransMode mode, const Sample3 &sam) const noexcept
 {
+    AGZ_RENDER_STATS_ADD(BSDFSamples, 1);
+
     // process black fringes
 
     if(cause_black_fringes(wo))
@@ -755,19 +755,19 @@ public:
     ShadingPoint shade(const EntityIntersection &inct, Arena &arena) const override
     {
         const Vec2 uv = inct.uv;
-        const FSpectrum base_color             = base_color_      ->sample_spectrum(uv);
-        const real     metallic               = metallic_        ->sample_real(uv);
-        const real     roughness              = roughness_       ->sample_real(uv);
-        const real     transmission           = transmission_    ->sample_real(uv);
-        const real     transmission_roughness = transmission_roughness_->sample_real(uv);
-        const real     ior                    = IOR_             ->sample_real(uv);
-        const FSpectrum specular_scale         = specular_scale_  ->sample_spectrum(uv);
-        const real     specular_tint          = specular_tint_   ->sample_real(uv);
-        const real     anisotropic            = anisotropic_     ->sample_real(uv);
-        const real     sheen                  = sheen_           ->sample_real(uv);
-        const real     sheen_tint             = sheen_tint_      ->sample_real(uv);
-        const real     clearcoat              = clearcoat_       ->sample_real(uv);
-        const real     clearcoat_gloss        = clearcoat_gloss_ ->sample_real(uv);
+        const FSpectrum base_color             = base_color_      ->sample_spectrum(inct);
+        const real     metallic               = metallic_        ->sample_real(inct);
+        const real     roughness              = roughness_       ->sample_real(inct);
+        const real     transmission           = transmission_    ->sample_real(inct);
+        const real     transmission_roughness = transmission_roughness_->sample_real(inct);
+        const real     ior                    = IOR_             ->sample_real(inct);
+        const FSpectrum specular_scale         = specular_scale_  ->sample_spectrum(inct);
+        const real     specular_tint          = specular_tint_   ->sample_real(inct);
+        const real     anisotropic            = anisotropic_     ->sample_real(inct);
+        const real     sheen                  = sheen_           ->sample_real(inct);
+        const real     sheen_tint             = sheen_tint_      ->sample_real(inct);
+        const real     clearcoat              = clearcoat_       ->sample_real(inct);
+        const real     clearcoat_gloss        = clearcoat_gloss_ ->sample_real(inct);
 
         const FCoord shading_coord = normal_mapper_->reorient(uv, inct.user_coord);
         const BSDF *bsdf = arena.create_nodestruct<disney_impl::DisneyBSDF>(
@@ -146,9 +146,9 @@ public:
     {
         ShadingPoint ret;
 
-        const real     ior              = ior_->sample_real(inct.uv);
-        const FSpectrum color_reflection = color_reflection_map_->sample_spectrum(inct.uv);
-        const FSpectrum color_refraction = color_refraction_map_->sample_spectrum(inct.uv);
+        const real     ior              = ior_->sample_real(inct);
+        const FSpectrum color_reflection = color_reflection_map_->sample_spectrum(inct);
+        const FSpectrum color_refraction = color_refraction_map_->sample_spectrum(inct);
 
         const DielectricFresnelPoint *fresnel_point =
             arena.create<DielectricFresnelPoint>(ior, real(1));
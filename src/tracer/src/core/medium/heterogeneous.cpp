@@ -1,9 +1,12 @@
 #include <agz/tracer/core/medium.h>
 #include <agz/tracer/core/texture3d.h>
 #include <agz/tracer/utility/phase_function.h>
+#include <agz/tracer/utility/render_stats.h>
 #include <agz/utility/misc.h>
 #include <agz/utility/texture.h>
 
+#include "./majorant_grid.h"
+
 AGZ_TRACER_BEGIN
 
 class HeterogeneousMedium : public Medium
@@ -15,10 +18,86 @@ class HeterogeneousMedium : public Medium
     RC<const Texture3D> g_;
 
     real max_density_;
-    real inv_max_density_;
+
+    MajorantGrid majorant_grid_;
 
     int max_scattering_count_;
 
+    bool use_residual_ratio_tracking_;
+
+    static Vec3i auto_majorant_grid_res(const Texture3D &density) noexcept
+    {
+        // about 8 texels per cell, but no more than 64 cells on each axis
+
+        const int max_size = (std::max)(
+            density.width(), (std::max)(density.height(), density.depth()));
+        const int res = math::clamp(max_size / 8, 1, 64);
+        return Vec3i(res);
+    }
+
+    /**
+     * @brief estimate exp(-integral of sigma(x) from a to b)
+     *
+     * sigma(unit_pos) must be in [0, density(unit_pos)] for each channel.
+     * when RESIDUAL is true, the control density of each cell is integrated
+     * analytically and only the residual part is tracked, which requires
+     * control <= sigma
+     */
+    template<bool RESIDUAL, typename SigmaFunc>
+    FSpectrum ratio_tracking(
+        const FVec3 &a, const FVec3 &b,
+        Sampler &sampler, const SigmaFunc &sigma) const noexcept
+    {
+        const real t_max = distance(a, b);
+        if(t_max <= 0)
+            return FSpectrum(1);
+
+        const FVec3 local_a = local_to_world_.apply_inverse_to_point(a);
+        const FVec3 local_b = local_to_world_.apply_inverse_to_point(b);
+
+        FSpectrum result(1);
+        real control_tau = 0;
+
+        majorant_grid_.traverse(local_a, local_b,
+            [&](real s_beg, real s_end, real majorant, real control)
+        {
+            const real t_end = s_end * t_max;
+            real t = s_beg * t_max;
+
+            if constexpr(RESIDUAL)
+            {
+                control_tau += control * (t_end - t);
+                majorant -= control;
+            }
+            else
+                control = 0;
+
+            if(majorant <= 0)
+                return true;
+            const real inv_majorant = 1 / majorant;
+
+            for(;;)
+            {
+                t -= std::log(1 - sampler.sample1().u) * inv_majorant;
+                if(t >= t_end)
+                    return true;
+
+                const FVec3 unit_pos = lerp(local_a, local_b, t / t_max);
+                const FSpectrum residual = sigma(unit_pos) - FSpectrum(control);
+                result *= FSpectrum(1) - residual * inv_majorant;
+                AGZ_RENDER_STATS_ADD(MediumNullCollisions, 1);
+
+                if(!result)
+                    return false;
+            }
+        });
+
+        if constexpr(RESIDUAL)
+            result *= std::exp(-control_tau);
+
+        return result;
+    }
+
 public:
 
     HeterogeneousMedium(
@@ -26,7 +105,9 @@ public:
         RC<const Texture3D> density,
         RC<const Texture3D> albedo,
         RC<const Texture3D> g,
-        int max_scattering_count)
+        int max_scattering_count,
+        int majorant_grid_res,
+        bool use_residual_ratio_tracking)
     {
         local_to_world_ = local_to_world;
 
@@ -36,9 +117,14 @@ public:
 
         max_density_ = density_->max_real();
         max_density_ = (std::max)(max_density_, EPS());
-        inv_max_density_ = 1 / max_density_;
+
+        const Vec3i grid_res = majorant_grid_res > 0 ?
+            Vec3i(majorant_grid_res) : auto_majorant_grid_res(*density_);
+        majorant_grid_.initialize(*density_, grid_res, max_density_);
 
         max_scattering_count_ = max_scattering_count;
+
+        use_residual_ratio_tracking_ = use_residual_ratio_tracking;
     }
 
     int get_max_scattering_count() const noexcept override
@@ -49,32 +135,33 @@ public:
     FSpectrum tr(
         const FVec3 &a, const FVec3 &b, Sampler &sampler) const noexcept override
     {
-        real result = 1;
-        real t = 0;
-        const real t_max = distance(a, b);
-
-        for(;;)
+        auto sigma_t = [&](const FVec3 &unit_pos)
         {
-            const real delta_t = -std::log(1 - sampler.sample1().u)
-                               * inv_max_density_;
-            t += delta_t;
-            if(t >= t_max)
-                break;
-
-            const FVec3 pos = lerp(a, b, t / t_max);
-            const FVec3 unit_pos = local_to_world_.apply_inverse_to_point(pos);
-            const real density = density_->sample_real(unit_pos);
-            result *= 1 - density / max_density_;
-        }
+            return FSpectrum(density_->sample_real(unit_pos));
+        };
 
-        return FSpectrum(result);
+        if(use_residual_ratio_tracking_)
+            return ratio_tracking<true>(a, b, sampler, sigma_t);
+        return ratio_tracking<false>(a, b, sampler, sigma_t);
     }
 
     FSpectrum ab(
         const FVec3 &a, const FVec3 &b, Sampler &sampler) const noexcept override
     {
-        // FIXME
-        return tr(a, b, sampler);
+        // sigma_a = density * (1 - albedo) is also bounded by the density
+        // majorants. control densities are not valid lower bounds of it
+
+        auto sigma_a = [&](const FVec3 &unit_pos)
+        {
+            const real density = density_->sample_real(unit_pos);
+            const FSpectrum albedo = albedo_->sample_spectrum(unit_pos);
+            return density * FSpectrum(
+                1 - math::saturate(albedo.r),
+                1 - math::saturate(albedo.g),
+                1 - math::saturate(albedo.b));
+        };
+
+        return ratio_tracking<false>(a, b, sampler, sigma_a);
     }
 
     SampleOutScatteringResult sample_scattering(
@@ -82,39 +169,72 @@ public:
         Sampler &sampler, Arena &arena) const noexcept override
     {
         const real t_max = distance(a, b);
-        real t = 0;
+        if(t_max <= 0)
+            return SampleOutScatteringResult({}, FSpectrum(1), nullptr);
 
-        for(;;)
+        const FVec3 local_a = local_to_world_.apply_inverse_to_point(a);
+        const FVec3 local_b = local_to_world_.apply_inverse_to_point(b);
+
+        // optical depth to the next tentative collision,
+        // carried across cells with different majorants
+
+        real tau = -std::log(1 - sampler.sample1().u);
+
+        bool scattered = false;
+        real scattering_t = 0;
+        FVec3 scattering_unit_pos;
+
+        majorant_grid_.traverse(local_a, local_b,
+            [&](real s_beg, real s_end, real majorant, real)
         {
-            const real delta_t = -std::log(1 - sampler.sample1().u)
-                               * inv_max_density_;
-            t += delta_t;
-            if(t >= t_max)
-                break;
-
-            const FVec3 pos = lerp(a, b, t / t_max);
-            const FVec3 unit_pos = local_to_world_.apply_inverse_to_point(pos);
-            const real density = density_->sample_real(unit_pos);
-            if(sampler.sample1().u < density / max_density_)
-            {
-                const FSpectrum albedo = albedo_->sample_spectrum(unit_pos);
-                const real     g      = g_->sample_real(unit_pos);
+            const real t_end = s_end * t_max;
+            real t = s_beg * t_max;
 
-                MediumScattering scattering;
-                scattering.pos    = pos;
-                scattering.medium = this;
-                scattering.wr     = (a - b) / t_max;
+            if(majorant <= 0)
+                return true;
 
-                auto phase_function =
-                    arena.create<HenyeyGreensteinPhaseFunction>(
-                        g, FSpectrum(albedo));
+            for(;;)
+            {
+                const real delta_t = tau / majorant;
+                if(t + delta_t >= t_end)
+                {
+                    tau -= (t_end - t) * majorant;
+                    return true;
+                }
+                t += delta_t;
+
+                const FVec3 unit_pos = lerp(local_a, local_b, t / t_max);
+                const real density = density_->sample_real(unit_pos);
+                if(sampler.sample1().u < density / majorant)
+                {
+                    scattered           = true;
+                    scattering_t        = t;
+                    scattering_unit_pos = unit_pos;
+                    return false;
+                }
 
-                return SampleOutScatteringResult(
-                    scattering, FSpectrum(albedo), phase_function);
+                AGZ_RENDER_STATS_ADD(MediumNullCollisions, 1);
+                tau = -std::log(1 - sampler.sample1().u);
             }
-        }
+        });
+
+        if(!scattered)
+            return SampleOutScatteringResult({}, FSpectrum(1), nullptr);
+
+        const FSpectrum albedo = albedo_->sample_spectrum(scattering_unit_pos);
+        const real     g      = g_->sample_real(scattering_unit_pos);
+
+        MediumScattering scattering;
+        scattering.pos    = lerp(a, b, scattering_t / t_max);
+        scattering.medium = this;
+        scattering.wr     = (a - b) / t_max;
+
+        auto phase_function =
+            arena.create<HenyeyGreensteinPhaseFunction>(
+                g, FSpectrum(albedo));
 
-        return SampleOutScatteringResult({}, FSpectrum(1), nullptr);
+        return SampleOutScatteringResult(
+            scattering, FSpectrum(albedo), phase_function);
     }
 };
 
@@ -123,11 +243,15 @@ RC<Medium> create_heterogeneous_medium(
     RC<const Texture3D> density,
     RC<const Texture3D> albedo,
     RC<const Texture3D> g,
-    int max_scattering_count)
+    int max_scattering_count,
+    int majorant_grid_res,
+    bool use_residual_ratio_tracking)
 {
     return newRC<HeterogeneousMedium>(
         local_to_world, std::move(density),
-        std::move(albedo), std::move(g), max_scattering_count);
+        std::move(albedo), std::move(g),
+        max_scattering_count, majorant_grid_res,
+        use_residual_ratio_tracking);
 }
 
 AGZ_TRACER_END
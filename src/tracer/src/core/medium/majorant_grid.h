@@ -0,0 +1,214 @@
+#pragma once
+
+#include <vector>
+
+#include <agz/tracer/core/texture3d.h>
+#include <agz/utility/thread.h>
+
+AGZ_TRACER_BEGIN
+
+/**
+ * @brief coarse grid of local density majorants over the unit cube
+ *  of a heterogeneous medium
+ *
+ * each cell also stores a control density (lower bound of density in the
+ * cell) for residual ratio tracking.
+ *
+ * segments are traversed with 3d-dda. parts of a segment outside the unit
+ * cube use the majorant of the whole density texture and zero control density
+ */
+class MajorantGrid
+{
+    Vec3i res_;
+    FVec3 fres_;
+
+    real outer_majorant_ = 0;
+
+    std::vector<real> majorants_;
+    std::vector<real> controls_;
+
+public:
+
+    /**
+     * @brief compute local majorants & control densities of the given
+     *  density texture
+     *
+     * @param res resolution of the grid
+     * @param outer_majorant majorant out of the unit cube
+     */
+    void initialize(
+        const Texture3D &density, const Vec3i &res, real outer_majorant);
+
+    /**
+     * @brief majorant of the given cell
+     */
+    real majorant(int x, int y, int z) const noexcept;
+
+    /**
+     * @brief control density of the given cell
+     *
+     * guaranteed to be in [0, majorant(x, y, z)]
+     */
+    real control(int x, int y, int z) const noexcept;
+
+    /**
+     * @brief traverse the cells overlapped by a segment in local space
+     *
+     * func interface:
+     *  bool func(real s_beg, real s_end, real majorant, real control)
+     *
+     * s is the segment parameter in [0, 1], and [s_beg, s_end) is the part of
+     * segment in one cell. returning false stops the traversal
+     */
+    template<typename Func>
+    void traverse(const FVec3 &a, const FVec3 &b, Func &&func) const;
+};
+
+inline void MajorantGrid::initialize(
+    const Texture3D &density, const Vec3i &res, real outer_majorant)
+{
+    res_  = Vec3i((std::max)(res.x, 1), (std::max)(res.y, 1), (std::max)(res.z, 1));
+    fres_ = FVec3(real(res_.x), real(res_.y), real(res_.z));
+
+    outer_majorant_ = outer_majorant;
+
+    majorants_.resize(static_cast<size_t>(res_.product()));
+    controls_.resize(static_cast<size_t>(res_.product()));
+
+    thread::parallel_forrange(0, res_.z, [&](int, int z)
+    {
+        for(int y = 0; y < res_.y; ++y)
+        {
+            for(int x = 0; x < res_.x; ++x)
+            {
+                const AABB cell_bound(
+                    FVec3(real(x),     real(y),     real(z))     / fres_,
+                    FVec3(real(x + 1), real(y + 1), real(z + 1)) / fres_);
+
+                const real max_density = (std::max)(
+                    density.max_real_in_bound(cell_bound), real(0));
+                const real min_density = math::clamp(
+                    density.min_real_in_bound(cell_bound), real(0), max_density);
+
+                const int idx = (z * res_.y + y) * res_.x + x;
+                majorants_[idx] = max_density;
+                controls_[idx]  = min_density;
+            }
+        }
+    });
+}
+
+inline real MajorantGrid::majorant(int x, int y, int z) const noexcept
+{
+    return majorants_[(z * res_.y + y) * res_.x + x];
+}
+
+inline real MajorantGrid::control(int x, int y, int z) const noexcept
+{
+    return controls_[(z * res_.y + y) * res_.x + x];
+}
+
+template<typename Func>
+void MajorantGrid::traverse(const FVec3 &a, const FVec3 &b, Func &&func) const
+{
+    const FVec3 d = b - a;
+
+    // clip the segment with the unit cube
+
+    real s_enter = 0, s_exit = 1;
+    for(int i = 0; i < 3; ++i)
+    {
+        if(d[i] == 0)
+        {
+            if(a[i] < 0 || a[i] > 1)
+                s_exit = -1;
+            continue;
+        }
+
+        real t0 = -a[i] / d[i];
+        real t1 = (1 - a[i]) / d[i];
+        if(t0 > t1)
+            std::swap(t0, t1);
+
+        s_enter = (std::max)(s_enter, t0);
+        s_exit  = (std::min)(s_exit,  t1);
+    }
+
+    if(s_enter >= s_exit)
+    {
+        func(real(0), real(1), outer_majorant_, real(0));
+        return;
+    }
+
+    if(s_enter > 0 && !func(real(0), s_enter, outer_majorant_, real(0)))
+        return;
+
+    // 3d-dda
+
+    const FVec3 enter_pos = a + s_enter * d;
+
+    int   cell[3];
+    int   step[3];
+    real  s_next[3];
+    real  s_delta[3];
+
+    for(int i = 0; i < 3; ++i)
+    {
+        cell[i] = math::clamp<int>(
+            static_cast<int>(enter_pos[i] * fres_[i]), 0, res_[i] - 1);
+
+        if(d[i] > 0)
+        {
+            step[i]    = 1;
+            s_next[i]  = ((cell[i] + 1) / fres_[i] - a[i]) / d[i];
+            s_delta[i] = 1 / (fres_[i] * d[i]);
+        }
+        else if(d[i] < 0)
+        {
+            step[i]    = -1;
+            s_next[i]  = (cell[i] / fres_[i] - a[i]) / d[i];
+            s_delta[i] = -1 / (fres_[i] * d[i]);
+        }
+        else
+        {
+            step[i]    = 0;
+            s_next[i]  = REAL_INF;
+            s_delta[i] = REAL_INF;
+        }
+    }
+
+    real s = s_enter;
+    for(;;)
+    {
+        int axis = s_next[0] < s_next[1] ? 0 : 1;
+        if(s_next[2] < s_next[axis])
+            axis = 2;
+
+        const real s_end = (std::min)(s_next[axis], s_exit);
+        if(s_end > s && !func(s, s_end,
+                              majorant(cell[0], cell[1], cell[2]),
+                              control (cell[0], cell[1], cell[2])))
+            return;
+
+        if(s_end >= s_exit)
+            break;
+
+        cell[axis] += step[axis];
+        if(cell[axis] < 0 || cell[axis] >= res_[axis])
+        {
+            // numeric error at the cube boundary
+
+            if(!func(s_end, s_exit, outer_majorant_, real(0)))
+                return;
+            break;
+        }
+
+        s = s_end;
+        s_next[axis] += s_delta[axis];
+    }
+
+    if(s_exit < 1)
+        func(s_exit, real(1), outer_majorant_, real(0));
+}
+
+AGZ_TRACER_END
@@ -0,0 +1,449 @@
+#include <vector>
+
+#ifdef AGZ_UTILS_SSE
+#include <emmintrin.h>
+#endif
+
+#include <agz/tracer/core/post_processor.h>
+#include <agz/tracer/utility/logger.h>
+#include <agz/tracer/utility/parallel_grid.h>
+#include <agz/utility/misc.h>
+#include <agz/utility/thread.h>
+
+AGZ_TRACER_BEGIN
+
+namespace
+{
+    // same threshold as oidn_denoiser
+    constexpr real DENOISE_THRESHOLD = real(0.8);
+
+    constexpr int TASK_GRID_SIZE = 32;
+
+    /**
+     * @brief filter inputs in planar layout
+     *
+     * planes are padded by filter radius on each side, and padding pixels
+     * have zero mask. thus neighbors can be accessed without bound checking,
+     * and consecutive pixels of a row are consecutive in memory
+     */
+    struct Planes
+    {
+        int width  = 0;
+        int height = 0;
+        int radius = 0;
+        int stride = 0;
+
+        // original color
+        std::vector<float> color[3];
+
+        // tone mapped and prefiltered color for computing weights
+        std::vector<float> guide[3];
+
+        std::vector<float> albedo[3];
+        std::vector<float> normal[3];
+
+        // whether a pixel can contribute to its neighbors
+        std::vector<float> mask;
+
+        Planes(int width, int height, int radius)
+            : width(width), height(height), radius(radius),
+              stride(width + 2 * radius)
+        {
+            const size_t size = static_cast<size_t>(stride) * (height + 2 * radius);
+            for(int c = 0; c < 3; ++c)
+            {
+                color[c] .resize(size, 0.0f);
+                guide[c] .resize(size, 0.0f);
+                albedo[c].resize(size, 0.0f);
+                normal[c].resize(size, 0.0f);
+            }
+            mask.resize(size, 0.0f);
+        }
+
+        int index(int x, int y) const noexcept
+        {
+            return (y + radius) * stride + x + radius;
+        }
+    };
+
+    // 1 / (2 * sigma^2) of each kind of distance
+    struct DistanceScales
+    {
+        float spatial;
+        float color;
+        float albedo;
+        float normal;
+    };
+
+    struct Accumulator
+    {
+        float *weight;
+        float *color[3];
+    };
+
+#ifdef AGZ_UTILS_SSE
+
+    /**
+     * @brief exp(x) for x <= 0
+     *
+     * relative error is below 1e-5
+     */
+    inline __m128 exp_neg_ps(__m128 x) noexcept
+    {
+        x = _mm_max_ps(x, _mm_set1_ps(-80.0f));
+
+        // exp(x) = 2^i * 2^f, where i is an integer and f is in [0, 1)
+
+        const __m128 t = _mm_mul_ps(x, _mm_set1_ps(1.44269504f));
+        __m128 fi = _mm_cvtepi32_ps(_mm_cvttps_epi32(t));
+        fi = _mm_sub_ps(fi, _mm_and_ps(_mm_cmpgt_ps(fi, t), _mm_set1_ps(1.0f)));
+        const __m128 f = _mm_sub_ps(t, fi);
+
+        __m128 p = _mm_set1_ps(1.535336188319500e-4f);
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.339887440266574e-3f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(9.618437357674640e-3f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(5.550332471162809e-2f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(2.402264791363012e-1f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(6.931472028550421e-1f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.0f));
+
+        const __m128i e = _mm_slli_epi32(
+            _mm_add_epi32(_mm_cvtps_epi32(fi), _mm_set1_epi32(127)), 23);
+        return _mm_mul_ps(p, _mm_castsi128_ps(e));
+    }
+
+    inline __m128 dist2_ps(
+        const std::vector<float> *planes, int p, int q) noexcept
+    {
+        __m128 sum = _mm_setzero_ps();
+        for(int c = 0; c < 3; ++c)
+        {
+            const __m128 d = _mm_sub_ps(
+                _mm_loadu_ps(&planes[c][p]), _mm_loadu_ps(&planes[c][q]));
+            sum = _mm_add_ps(sum, _mm_mul_ps(d, d));
+        }
+        return sum;
+    }
+
+#endif
+
+    inline float dist2(const std::vector<float> *planes, int p, int q) noexcept
+    {
+        float sum = 0;
+        for(int c = 0; c < 3; ++c)
+        {
+            const float d = planes[c][p] - planes[c][q];
+            sum += d * d;
+        }
+        return sum;
+    }
+
+    /**
+     * @brief accumulate contribution of neighbors with the same offset to
+     *  consecutive pixels of a row
+     *
+     * @param p first pixel index
+     * @param q first neighbor index
+     * @param spatial spatial distance term of the offset
+     */
+    void accumulate_row(
+        const Planes &planes, const DistanceScales &scales,
+        int p, int q, int count, float spatial, const Accumulator &acc)
+    {
+        int i = 0;
+
+#ifdef AGZ_UTILS_SSE
+
+        const __m128 spatial4 = _mm_set1_ps(spatial);
+        const __m128 color4   = _mm_set1_ps(scales.color);
+        const __m128 albedo4  = _mm_set1_ps(scales.albedo);
+        const __m128 normal4  = _mm_set1_ps(scales.normal);
+
+        for(; i + 4 <= count; i += 4)
+        {
+            const int pi = p + i, qi = q + i;
+
+            __m128 d = spatial4;
+            d = _mm_add_ps(d, _mm_mul_ps(color4,  dist2_ps(planes.guide,  pi, qi)));
+            d = _mm_add_ps(d, _mm_mul_ps(albedo4, dist2_ps(planes.albedo, pi, qi)));
+            d = _mm_add_ps(d, _mm_mul_ps(normal4, dist2_ps(planes.normal, pi, qi)));
+
+            const __m128 w = _mm_mul_ps(
+                exp_neg_ps(_mm_sub_ps(_mm_setzero_ps(), d)),
+                _mm_loadu_ps(&planes.mask[qi]));
+
+            _mm_storeu_ps(
+                acc.weight + i, _mm_add_ps(_mm_loadu_ps(acc.weight + i), w));
+
+            for(int c = 0; c < 3; ++c)
+            {
+                const __m128 wc = _mm_mul_ps(w, _mm_loadu_ps(&planes.color[c][qi]));
+                _mm_storeu_ps(
+                    acc.color[c] + i, _mm_add_ps(_mm_loadu_ps(acc.color[c] + i), wc));
+            }
+        }
+
+#endif
+
+        for(; i < count; ++i)
+        {
+            const int pi = p + i, qi = q + i;
+
+            const float d = spatial
+                          + scales.color  * dist2(planes.guide,  pi, qi)
+                          + scales.albedo * dist2(planes.albedo, pi, qi)
+                          + scales.normal * dist2(planes.normal, pi, qi);
+
+            const float w = std::exp(-d) * planes.mask[qi];
+
+            acc.weight[i] += w;
+            for(int c = 0; c < 3; ++c)
+                acc.color[c][i] += w * planes.color[c][qi];
+        }
+    }
+}
+
+/**
+ * @brief joint bilateral filter guided by albedo and normal
+ *
+ * pixel weights are determined by spatial distance, and differences of
+ * prefiltered color, albedo and normal. the filter is evaluated in tiles
+ * by multiple threads, and neighbors of the same offset are processed
+ * with sse
+ */
+class BilateralDenoiser : public PostProcessor
+{
+    int radius_;
+
+    real sigma_spatial_;
+    real sigma_color_;
+    real sigma_albedo_;
+    real sigma_normal_;
+
+    int worker_count_;
+
+    static float inv_2sigma2(real sigma) noexcept
+    {
+        return static_cast<float>(real(1) / (2 * sigma * sigma));
+    }
+
+    void fill_planes(const RenderTarget &render_target, Planes &planes) const
+    {
+        const auto &image = render_target.image;
+        const int w = planes.width, h = planes.height;
+
+        const bool has_albedo  = render_target.albedo.is_available();
+        const bool has_normal  = render_target.normal.is_available();
+        const bool has_denoise = render_target.denoise.is_available();
+
+        // tone mapped color is less sensitive to fireflies
+
+        std::vector<float> mapped[3];
+        for(auto &m : mapped)
+            m.resize(planes.mask.size(), 0.0f);
+
+        for(int y = 0; y < h; ++y)
+        {
+            for(int x = 0; x < w; ++x)
+            {
+                const int idx = planes.index(x, y);
+                const Spectrum &color = image(y, x);
+
+                const bool valid = color.is_finite() &&
+                    (!has_denoise ||
+                     render_target.denoise(y, x) >= DENOISE_THRESHOLD);
+                planes.mask[idx] = valid ? 1.0f : 0.0f;
+
+                for(int c = 0; c < 3; ++c)
+                {
+                    const float value = valid ?
+                        static_cast<float>((std::max)(color[c], real(0))) : 0.0f;
+                    planes.color[c][idx] = value;
+                    mapped[c][idx] = value / (1 + value);
+                }
+
+                if(has_albedo)
+                {
+                    const Spectrum albedo = render_target.albedo(y, x).clamp(0, 1);
+                    for(int c = 0; c < 3; ++c)
+                        planes.albedo[c][idx] = static_cast<float>(albedo[c]);
+                }
+
+                if(has_normal)
+                {
+                    const Vec3 &n = render_target.normal(y, x);
+                    if(n)
+                    {
+                        const Vec3 nn = n.normalize();
+                        for(int c = 0; c < 3; ++c)
+                            planes.normal[c][idx] = static_cast<float>(nn[c]);
+                    }
+                }
+            }
+        }
+
+        // 3x3 box prefiltering of valid pixels
+
+        for(int y = 0; y < h; ++y)
+        {
+            for(int x = 0; x < w; ++x)
+            {
+                const int idx = planes.index(x, y);
+
+                float sum[3] = { 0, 0, 0 }, weight = 0;
+                for(int dy = -1; dy <= 1; ++dy)
+                {
+                    for(int dx = -1; dx <= 1; ++dx)
+                    {
+                        const int nidx = idx + dy * planes.stride + dx;
+                        const float m = planes.mask[nidx];
+                        for(int c = 0; c < 3; ++c)
+                            sum[c] += m * mapped[c][nidx];
+                        weight += m;
+                    }
+                }
+
+                for(int c = 0; c < 3; ++c)
+                {
+                    planes.guide[c][idx] = weight > 0 ?
+                        sum[c] / weight : mapped[c][idx];
+                }
+            }
+        }
+    }
+
+public:
+
+    BilateralDenoiser(
+        int radius,
+        real sigma_spatial, real sigma_color,
+        real sigma_albedo, real sigma_normal,
+        int worker_count)
+    {
+        AGZ_HIERARCHY_TRY
+
+        if(radius < 1)
+            throw ObjectConstructionException("invalid filter radius");
+
+        if(sigma_spatial <= 0 || sigma_color <= 0 ||
+           sigma_albedo <= 0 || sigma_normal <= 0)
+            throw ObjectConstructionException("invalid filter sigma");
+
+        radius_        = radius;
+        sigma_spatial_ = sigma_spatial;
+        sigma_color_   = sigma_color;
+        sigma_albedo_  = sigma_albedo;
+        sigma_normal_  = sigma_normal;
+        worker_count_  = worker_count;
+
+        AGZ_HIERARCHY_WRAP("in initializing bilateral denoiser")
+    }
+
+    void process(RenderTarget &render_target) override
+    {
+        AGZ_INFO("bilateral denoising");
+
+        auto &image = render_target.image;
+        const int w = image.width(), h = image.height();
+
+        Planes planes(w, h, radius_);
+        fill_planes(render_target, planes);
+
+        const DistanceScales scales = {
+            inv_2sigma2(sigma_spatial_),
+            inv_2sigma2(sigma_color_),
+            inv_2sigma2(sigma_albedo_),
+            inv_2sigma2(sigma_normal_)
+        };
+
+        Image2D<Spectrum> output(h, w);
+
+        const int thread_count = thread::actual_worker_count(worker_count_);
+
+        parallel_for_2d_grid(
+            thread_count, w, h, TASK_GRID_SIZE, TASK_GRID_SIZE,
+            [&](int thread_index, const Rect2i &grid)
+        {
+            const int tile_w = grid.high.x - grid.low.x;
+            const int tile_h = grid.high.y - grid.low.y;
+            const size_t tile_size = static_cast<size_t>(tile_w) * tile_h;
+
+            std::vector<float> acc_weight(tile_size, 0.0f);
+            std::vector<float> acc_color[3];
+            for(auto &a : acc_color)
+                a.resize(tile_size, 0.0f);
+
+            for(int dy = -radius_; dy <= radius_; ++dy)
+            {
+                for(int dx = -radius_; dx <= radius_; ++dx)
+                {
+                    const int d2 = dx * dx + dy * dy;
+                    if(d2 > radius_ * radius_)
+                        continue;
+
+                    const float spatial = scales.spatial * static_cast<float>(d2);
+
+                    for(int ty = 0; ty < tile_h; ++ty)
+                    {
+                        const int y = grid.low.y + ty;
+                        const int p = planes.index(grid.low.x, y);
+                        const int q = planes.index(grid.low.x + dx, y + dy);
+
+                        const size_t row = static_cast<size_t>(ty) * tile_w;
+                        const Accumulator acc = {
+                            &acc_weight[row],
+                            {
+                                &acc_color[0][row],
+                                &acc_color[1][row],
+                                &acc_color[2][row]
+                            }
+                        };
+
+                        accumulate_row(planes, scales, p, q, tile_w, spatial, acc);
+                    }
+                }
+            }
+
+            for(int ty = 0; ty < tile_h; ++ty)
+            {
+                for(int tx = 0; tx < tile_w; ++tx)
+                {
+                    const int x = grid.low.x + tx;
+                    const int y = grid.low.y + ty;
+                    const size_t i = static_cast<size_t>(ty) * tile_w + tx;
+
+                    // pixels flagged as not denoised are left untouched
+
+                    if(planes.mask[planes.index(x, y)] <= 0 || acc_weight[i] <= 0)
+                    {
+                        output(y, x) = image(y, x);
+                        continue;
+                    }
+
+                    const float inv_weight = 1 / acc_weight[i];
+                    output(y, x) = Spectrum(
+                        acc_color[0][i] * inv_weight,
+                        acc_color[1][i] * inv_weight,
+                        acc_color[2][i] * inv_weight);
+                }
+            }
+
+            return true;
+        });
+
+        image = std::move(output);
+    }
+};
+
+RC<PostProcessor> create_bilateral_denoiser(
+    int radius,
+    real sigma_spatial, real sigma_color,
+    real sigma_albedo, real sigma_normal,
+    int worker_count)
+{
+    return newRC<BilateralDenoiser>(
+        radius, sigma_spatial, sigma_color,
+        sigma_albedo, sigma_normal, worker_count);
+}
+
+AGZ_TRACER_END
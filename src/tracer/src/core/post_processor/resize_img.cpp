@@ -41,6 +41,8 @@ public:
             resize<Vec3, 3>(renderer_target.normal);
         if(renderer_target.denoise.is_available())
             resize<real, 1>(renderer_target.denoise);
+        if(renderer_target.cost.is_available())
+            resize<real, 1>(renderer_target.cost);
     }
 };
 
@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <agz/tracer/core/post_processor.h>
+#include <agz/tracer/utility/logger.h>
+#include <agz/utility/file.h>
+#include <agz/utility/image.h>
+
+AGZ_TRACER_BEGIN
+
+class SaveCostHeatmap : public PostProcessor
+{
+    std::string filename_;
+    real max_cost_;
+    real percentile_;
+    bool log_scale_;
+
+    /**
+     * @brief map t in [0, 1] to a colour from black through purple, red
+     *  and orange to light yellow
+     */
+    static Spectrum heat_color(real t) noexcept
+    {
+        static const Spectrum STOPS[] = {
+            Spectrum(real(0.001), real(0.000), real(0.014)),
+            Spectrum(real(0.341), real(0.063), real(0.431)),
+            Spectrum(real(0.735), real(0.216), real(0.330)),
+            Spectrum(real(0.976), real(0.557), real(0.035)),
+            Spectrum(real(0.988), real(1.000), real(0.643))
+        };
+        constexpr int STOP_COUNT = sizeof(STOPS) / sizeof(STOPS[0]);
+
+        const real s = math::saturate(t) * (STOP_COUNT - 1);
+        const int i = (std::min)(static_cast<int>(s), STOP_COUNT - 2);
+        return math::lerp(STOPS[i], STOPS[i + 1], s - i);
+    }
+
+    real auto_max_cost(const Image2D<real> &cost) const
+    {
+        std::vector<real> sorted;
+        sorted.reserve(size_t(cost.width()) * cost.height());
+        for(int y = 0; y < cost.height(); ++y)
+        {
+            for(int x = 0; x < cost.width(); ++x)
+                sorted.push_back(cost(y, x));
+        }
+
+        const size_t idx = (std::min)(
+            sorted.size() - 1,
+            static_cast<size_t>(percentile_ * (sorted.size() - 1)));
+        std::nth_element(sorted.begin(), sorted.begin() + idx, sorted.end());
+        return sorted[idx];
+    }
+
+public:
+
+    SaveCostHeatmap(
+        std::string filename, real max_cost, real percentile, bool log_scale)
+        : filename_(std::move(filename)), max_cost_(max_cost),
+          percentile_(math::saturate(percentile)), log_scale_(log_scale)
+    {
+
+    }
+
+    void process(RenderTarget &render_target) override
+    {
+        const Image2D<real> &cost = render_target.cost;
+        if(!cost.is_available())
+        {
+            AGZ_INFO("no pixel cost is recorded by the renderer "
+                     "(is record_pixel_cost enabled?). "
+                     "skip saving cost heatmap");
+            return;
+        }
+
+        real total_cost = 0, peak_cost = 0;
+        for(int y = 0; y < cost.height(); ++y)
+        {
+            for(int x = 0; x < cost.width(); ++x)
+            {
+                total_cost += cost(y, x);
+                peak_cost = (std::max)(peak_cost, cost(y, x));
+            }
+        }
+
+        const real max_cost = max_cost_ > 0 ? max_cost_ : auto_max_cost(cost);
+        AGZ_INFO("pixel cost: mean {:.2f}us, max {:.2f}us, heatmap range {:.2f}us",
+                 total_cost / (cost.width() * cost.height()),
+                 peak_cost, max_cost);
+
+        auto to_unit = [&](real c)
+        {
+            if(max_cost <= 0)
+                return real(0);
+            if(log_scale_)
+                return std::log1p(c) / std::log1p(max_cost);
+            return c / max_cost;
+        };
+
+        texture::texture2d_t<Spectrum> heatmap(cost.height(), cost.width());
+        for(int y = 0; y < cost.height(); ++y)
+        {
+            for(int x = 0; x < cost.width(); ++x)
+                heatmap(y, x) = heat_color(to_unit(cost(y, x)));
+        }
+
+        file::create_directory_for_file(filename_);
+        AGZ_INFO("saving cost heatmap to {}", filename_);
+        img::save_rgb_to_png_file(
+            filename_, heatmap.flip_vertically().get_data().map(
+                                    math::to_color3b<real>));
+    }
+};
+
+RC<PostProcessor> create_saving_cost_heatmap(
+    std::string filename, real max_cost, real percentile, bool log_scale)
+{
+    return newRC<SaveCostHeatmap>(
+        std::move(filename), max_cost, percentile, log_scale);
+}
+
+AGZ_TRACER_END
@@ -14,6 +14,7 @@
 #include <agz/tracer/create/renderer.h>
 #include <agz/tracer/render/particle_tracing.h>
 #include <agz/tracer/utility/parallel_grid.h>
+#include <agz/tracer/utility/render_stats.h>
 #include <agz/utility/thread.h>
 
 AGZ_TRACER_BEGIN
@@ -163,6 +164,7 @@ private:
 
                         const auto cam_ray = camera->sample_we(
                             { film_x, film_y }, sampler->sample2());
+                        AGZ_RENDER_STATS_ADD(CameraRays, 1);
 
                         const Ray ray(cam_ray.pos_on_cam, cam_ray.pos_to_out);
                         auto pixel = trace_camera_ray(scene, ray, arena);
@@ -172,6 +174,7 @@ private:
                             cam_ray.throughput * pixel.value, 1,
                             pixel.albedo, pixel.normal, pixel.denoise);
 
+                        AGZ_RENDER_STATS_ADD(ArenaBytes, arena.used_bytes());
                         arena.release();
 
                         if(stop_rendering_)
@@ -273,6 +276,7 @@ private:
                     ++task_particle_count;
                     trace_vol_particle(
                         particle_params_, scene, *sampler, film_grid, arena);
+                    AGZ_RENDER_STATS_ADD(ArenaBytes, arena.used_bytes());
                     arena.release();
 
                     if(stop_rendering_)
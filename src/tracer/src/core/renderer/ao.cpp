@@ -35,6 +35,7 @@ protected:
 
     Pixel eval_pixel(
         const Scene &scene, const Ray &ray,
+        const CameraRayDifferential &ray_diff,
         Sampler &sampler, Arena &arena) const override
     {
         return trace_ao(params_, scene, ray, sampler);
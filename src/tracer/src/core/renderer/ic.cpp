@@ -0,0 +1,225 @@
+#include <filesystem>
+
+#include <agz/tracer/core/camera.h>
+#include <agz/tracer/core/renderer_interactor.h>
+#include <agz/tracer/core/sampler.h>
+#include <agz/tracer/core/scene.h>
+#include <agz/tracer/create/renderer.h>
+#include <agz/tracer/render/irradiance_cache.h>
+#include <agz/tracer/utility/parallel_grid.h>
+#include <agz/tracer/utility/render_stats.h>
+
+#include "./perpixel_renderer.h"
+
+AGZ_TRACER_BEGIN
+
+namespace
+{
+    // sampler stream of prepass rays. disjoint with pixel indices
+    constexpr uint64_t PREPASS_STREAM = uint64_t(1) << 62;
+}
+
+class IrradianceCacheRenderer : public PerPixelRenderer
+{
+    render::IrradianceCacheTraceParams trace_params_;
+    render::ic::CacheParams cache_params_;
+
+    int worker_count_;
+    int task_grid_size_;
+
+    int prepass_stride_;
+
+    std::string cache_filename_;
+
+    Box<render::ic::IrradianceCache> cache_;
+
+    /**
+     * @brief create records at pixel centers
+     *
+     * pixels are visited with a decreasing stride, so that records are
+     * created sparsely over the image before being refined
+     *
+     * random numbers of each ray only depend on its pixel and stride. records
+     * are still created concurrently, so with several threads the cache
+     * content may vary between runs
+     */
+    void prepass(
+        const FilmFilterApplier &filter, const Scene &scene,
+        RendererInteractor &reporter)
+    {
+        const int thread_count = thread::actual_worker_count(worker_count_);
+
+        Arena sampler_arena;
+        auto sampler_prototype = newRC<NativeSampler>(42, false);
+        std::vector<NativeSampler *> perthread_sampler;
+        for(int i = 0; i < thread_count; ++i)
+        {
+            perthread_sampler.push_back(
+                sampler_prototype->clone(thread_count + i, sampler_arena));
+        }
+
+        thread::thread_group_t thread_group(thread_count);
+
+        for(int stride = prepass_stride_; stride >= 1; stride /= 2)
+        {
+            if(stop_rendering_)
+                return;
+
+            reporter.message(
+                "irradiance cache prepass (stride = " +
+                std::to_string(stride) + ")");
+
+            const int grid_width  = (filter.width()  + stride - 1) / stride;
+            const int grid_height = (filter.height() + stride - 1) / stride;
+
+            parallel_for_2d_grid(
+                thread_count, grid_width, grid_height,
+                task_grid_size_, task_grid_size_, thread_group,
+                [&](int thread_index, const Rect2i &grid)
+            {
+                NativeSampler &sampler = *perthread_sampler[thread_index];
+                const Camera *camera = scene.get_camera();
+
+                Arena arena;
+
+                for(int gy = grid.low.y; gy < grid.high.y; ++gy)
+                {
+                    for(int gx = grid.low.x; gx < grid.high.x; ++gx)
+                    {
+                        const uint64_t pixel_index =
+                            uint64_t(gy) * stride * filter.width() + gx * stride;
+                        sampler.start_sample(
+                            PREPASS_STREAM | pixel_index, uint64_t(stride));
+
+                        const Vec2 film_coord = {
+                            (gx * stride + real(0.5)) / filter.width(),
+                            (gy * stride + real(0.5)) / filter.height()
+                        };
+
+                        const CameraSampleWeResult cam_sam = camera->sample_we(
+                            film_coord, sampler.sample2());
+                        AGZ_RENDER_STATS_ADD(CameraRays, 1);
+
+                        const Ray ray(cam_sam.pos_on_cam, cam_sam.pos_to_out);
+                        render::trace_irradiance_cache(
+                            trace_params_, *cache_, scene, ray, sampler, arena);
+
+                        AGZ_RENDER_STATS_ADD(ArenaBytes, arena.used_bytes());
+                        arena.release();
+                    }
+
+                    if(stop_rendering_)
+                        return false;
+                }
+
+                return true;
+            });
+        }
+    }
+
+public:
+
+    explicit IrradianceCacheRenderer(const IrradianceCacheRendererParams &params)
+        : PerPixelRenderer(
+            params.worker_count,
+            params.task_grid_size, params.spp)
+    {
+        trace_params_.forward_max_depth = params.forward_max_depth;
+
+        auto &gather_params = trace_params_.gather_params;
+        gather_params.theta_count = params.gather_theta_count;
+        gather_params.phi_count   = params.gather_phi_count;
+
+        gather_params.trace_params.min_depth = params.gather_min_depth;
+        gather_params.trace_params.max_depth = params.gather_max_depth;
+        gather_params.trace_params.cont_prob = params.gather_cont_prob;
+
+        cache_params_.accuracy      = params.accuracy;
+        cache_params_.min_radius    = params.min_radius;
+        cache_params_.max_radius    = params.max_radius;
+        cache_params_.use_gradients = params.use_gradients;
+
+        worker_count_   = params.worker_count;
+        task_grid_size_ = params.task_grid_size;
+        prepass_stride_ = params.prepass_stride;
+        cache_filename_ = params.cache_filename;
+    }
+
+    PartialFilm render_partial(
+        FilmFilterApplier filter, Scene &scene,
+        RendererInteractor &reporter,
+        const FilmPartition &partition) override
+    {
+        cache_ = newBox<render::ic::IrradianceCache>(
+            scene.world_bound(), cache_params_);
+
+        bool loaded = false;
+        if(!cache_filename_.empty() && std::filesystem::exists(cache_filename_))
+        {
+            try
+            {
+                cache_->load(cache_filename_);
+                loaded = true;
+                reporter.message(
+                    "irradiance cache loaded from " + cache_filename_);
+            }
+            catch(const std::exception &e)
+            {
+                // records read before the failure are dropped
+
+                reporter.message(
+                    "failed to load irradiance cache from " +
+                    cache_filename_ + ": " + e.what() + ". rebuild it");
+
+                cache_ = newBox<render::ic::IrradianceCache>(
+                    scene.world_bound(), cache_params_);
+            }
+        }
+
+        if(!loaded)
+        {
+            prepass(filter, scene, reporter);
+            if(stop_rendering_)
+                return {};
+        }
+
+        reporter.message(
+            "irradiance cache record count: " +
+            std::to_string(cache_->record_count()));
+
+        auto ret = PerPixelRenderer::render_partial(
+            filter, scene, reporter, partition);
+
+        // records created in this rendering are saved too, so that frames
+        // of a walkthrough can share and extend the same cache. only the
+        // first share of a partial rendering writes it
+
+        if(!cache_filename_.empty() && !stop_rendering_ && partition.index == 0)
+        {
+            cache_->save(cache_filename_);
+            reporter.message(
+                "irradiance cache saved to " + cache_filename_);
+        }
+
+        return ret;
+    }
+
+protected:
+
+    Pixel eval_pixel(
+        const Scene &scene, const Ray &ray,
+        const CameraRayDifferential &ray_diff,
+        Sampler &sampler, Arena &arena) const override
+    {
+        return render::trace_irradiance_cache(
+            trace_params_, *cache_, scene, ray, sampler, arena, &ray_diff);
+    }
+};
+
+RC<Renderer> create_irradiance_cache_renderer(
+    const IrradianceCacheRendererParams &params)
+{
+    return newRC<IrradianceCacheRenderer>(params);
+}
+
+AGZ_TRACER_END
@@ -0,0 +1,510 @@
+#include <agz/tracer/core/camera.h>
+#include <agz/tracer/core/renderer.h>
+#include <agz/tracer/core/renderer_interactor.h>
+#include <agz/tracer/core/scene.h>
+#include <agz/tracer/create/renderer.h>
+#include <agz/tracer/render/bidir_path_tracing.h>
+#include <agz/tracer/render/pssmlt.h>
+#include <agz/tracer/utility/parallel_grid.h>
+#include <agz/tracer/utility/render_stats.h>
+#include <agz/utility/thread.h>
+
+AGZ_TRACER_BEGIN
+
+namespace
+{
+    struct AtomicSpectrum
+    {
+        std::atomic<real> channels[SPECTRUM_COMPONENT_COUNT] = { 0 };
+
+        AtomicSpectrum() = default;
+
+        AtomicSpectrum(const AtomicSpectrum &s) noexcept
+        {
+            for(int i = 0; i < SPECTRUM_COMPONENT_COUNT; ++i)
+                channels[i] = s.channels[i].load();
+        }
+
+        void add(const FSpectrum &rhs) noexcept
+        {
+            for(int i = 0; i < SPECTRUM_COMPONENT_COUNT; ++i)
+                math::atomic_add(channels[i], rhs[i]);
+        }
+
+        Spectrum to_spectrum() const noexcept
+        {
+            Spectrum ret;
+            for(int i = 0; i < SPECTRUM_COMPONENT_COUNT; ++i)
+                ret[i] = channels[i].load();
+            return ret;
+        }
+    };
+
+    // primary sample streams
+
+    constexpr int CAMERA_STREAM     = 0;
+    constexpr int LIGHT_STREAM      = 1;
+    constexpr int CONNECTION_STREAM = 2;
+    constexpr int STREAM_COUNT      = 3;
+
+    /**
+     * @brief per-thread buffers for evaluating paths
+     */
+    struct PathSpace
+    {
+        std::vector<render::bdpt::Vertex> camera_subpath;
+        std::vector<render::bdpt::Vertex> light_subpath;
+        Arena arena;
+    };
+}
+
+/**
+ * @brief multiplexed metropolis light transport
+ *
+ * each markov chain has a fixed path depth. primary samples determine the
+ * camera subpath, the light subpath and the bdpt strategy (s, t) used to
+ * connect them, so that a chain can move between strategies.
+ */
+class MMLTRenderer : public Renderer
+{
+    MMLTRendererParams params_;
+
+    /**
+     * @brief eval the path with given depth (number of edges)
+     *
+     * @param pixel_coord output pixel coordinate of the path
+     *
+     * return weighted contribution divided by the probability of selecting
+     * the strategy
+     */
+    FSpectrum eval_path(
+        const Scene &scene, int depth, const Vec2 &full_res,
+        render::pssmlt::PSSMLTSampler &sampler,
+        PathSpace &space, Vec2 *pixel_coord) const;
+
+public:
+
+    explicit MMLTRenderer(const MMLTRendererParams &params);
+
+    RenderTarget render(
+        FilmFilterApplier filter, Scene &scene,
+        RendererInteractor &reporter) override;
+};
+
+RC<Renderer> create_mmlt_renderer(const MMLTRendererParams &params)
+{
+    return newRC<MMLTRenderer>(params);
+}
+
+FSpectrum MMLTRenderer::eval_path(
+    const Scene &scene, int depth, const Vec2 &full_res,
+    render::pssmlt::PSSMLTSampler &sampler,
+    PathSpace &space, Vec2 *pixel_coord) const
+{
+    using namespace render::bdpt;
+
+    // select strategy. paths with 2 vertices can only be sampled by
+    // the camera subpath
+
+    const int vertex_count = depth + 1;
+    const int strategy_count = vertex_count == 2 ? 1 : vertex_count;
+
+    sampler.start_stream(CONNECTION_STREAM);
+
+    const int s = vertex_count == 2 ? 2 : 1 + (std::min)(
+        static_cast<int>(sampler.sample1().u * strategy_count),
+        strategy_count - 1);
+    const int t = vertex_count - s;
+
+    // camera subpath
+
+    sampler.start_stream(CAMERA_STREAM);
+
+    const Sample2 film_sam = sampler.sample2();
+    *pixel_coord = { film_sam.u * full_res.x, film_sam.v * full_res.y };
+
+    const auto cam_sam = scene.get_camera()->sample_we(
+        { film_sam.u, film_sam.v }, sampler.sample2());
+    AGZ_RENDER_STATS_ADD(CameraRays, 1);
+    const Ray cam_ray(cam_sam.pos_on_cam, cam_sam.pos_to_out);
+
+    const CameraSubpath camera_subpath = build_camera_subpath(
+        s, cam_ray, scene, sampler, space.arena, space.camera_subpath.data());
+    if(camera_subpath.vertex_count != s)
+        return {};
+
+    // light subpath
+
+    sampler.start_stream(LIGHT_STREAM);
+
+    LightSubpath light_subpath;
+    if(t > 0)
+    {
+        const auto select_light = scene.sample_light(sampler.sample1());
+        if(!select_light.light)
+            return {};
+
+        light_subpath = build_light_subpath(
+            t, select_light, scene, sampler,
+            space.arena, space.light_subpath.data());
+        if(light_subpath.vertex_count != t)
+            return {};
+    }
+
+    // connect
+
+    sampler.start_stream(CONNECTION_STREAM);
+
+    FSpectrum radiance;
+
+    if(s == 2 && t == 0)
+        radiance = contrib_s2_t0(scene, camera_subpath.vertices);
+    else if(s == 1)
+    {
+        const Rect2 sample_pixel_bound = {
+            { 0, 0 }, { full_res.x - 1, full_res.y - 1 }
+        };
+
+        radiance = weighted_contrib_s1_tx(
+            scene, camera_subpath.vertices,
+            light_subpath.vertices, t, sampler,
+            sample_pixel_bound, full_res, *pixel_coord);
+    }
+    else if(t == 0)
+    {
+        radiance = weighted_contrib_sx_t0(
+            scene, camera_subpath.vertices, s);
+    }
+    else if(t == 1)
+    {
+        radiance = weighted_contrib_sx_t1(
+            scene, camera_subpath.vertices, s,
+            light_subpath.vertices, sampler);
+    }
+    else
+    {
+        radiance = weighted_contrib_sx_tx(
+            scene, camera_subpath.vertices, s,
+            light_subpath.vertices, t, sampler);
+    }
+
+    if(!radiance.is_finite())
+        return {};
+
+    return radiance * real(strategy_count);
+}
+
+MMLTRenderer::MMLTRenderer(const MMLTRendererParams &params)
+    : params_(params)
+{
+
+}
+
+RenderTarget MMLTRenderer::render(
+    FilmFilterApplier filter, Scene &scene,
+    RendererInteractor &reporter)
+{
+    const int thread_count = thread::actual_worker_count(params_.worker_count);
+
+    std::mutex reporter_mutex;
+    reporter.begin();
+
+    const Vec2 full_res = { real(filter.width()), real(filter.height()) };
+
+    // per thread resources
+
+    std::vector<PathSpace> perthread_spaces(thread_count);
+    for(auto &space : perthread_spaces)
+    {
+        space.camera_subpath.resize(params_.max_depth + 1);
+        space.light_subpath.resize(params_.max_depth + 1);
+    }
+
+    thread::thread_group_t thread_group;
+
+    // bootstrap. sample i of depth d is seeded by d * count + i, so that
+    // the chosen sample can be reproduced when starting a chain
+
+    const int depth_count = params_.max_depth;
+    const int bootstrap_count = params_.startup_sample_count;
+    const int total_bootstrap_count = depth_count * bootstrap_count;
+
+    std::vector<real> bootstrap_weights(total_bootstrap_count, real(0));
+    const int bootstrap_task_size = math::clamp(
+        total_bootstrap_count / 128, 1, 4096);
+
+    int finished_bootstrap_count = 0;
+
+    reporter.message("compute bootstrap samples");
+    reporter.new_stage();
+
+    parallel_for_1d_grid(
+        thread_count, total_bootstrap_count, bootstrap_task_size, thread_group,
+        [&](int thread_index, int beg, int end)
+    {
+        PathSpace &space = perthread_spaces[thread_index];
+
+        for(int i = beg; i < end; ++i)
+        {
+            if(stop_rendering_)
+                return false;
+
+            const int depth = 1 + i / bootstrap_count;
+
+            render::pssmlt::PSSMLTSampler sampler(
+                params_.sigma, params_.large_step_prob,
+                NativeSampler(i, false), STREAM_COUNT);
+
+            Vec2 pixel_coord;
+            bootstrap_weights[i] = eval_path(
+                scene, depth, full_res, sampler, space, &pixel_coord).lum();
+
+            if(space.arena.used_bytes() > 4 * 1024 * 1024)
+            {
+                AGZ_RENDER_STATS_ADD(ArenaBytes, space.arena.used_bytes());
+                space.arena.release();
+            }
+        }
+
+        {
+            std::lock_guard lk(reporter_mutex);
+            finished_bootstrap_count += end - beg;
+
+            const real percent = real(100) * finished_bootstrap_count
+                                           / total_bootstrap_count;
+            reporter.progress(percent, {});
+        }
+
+        return !stop_rendering_;
+    });
+    reporter.end_stage();
+
+    if(stop_rendering_)
+    {
+        reporter.end();
+        return {};
+    }
+
+    // b is the sum of average contributions of all depths
+
+    real b_sum = 0;
+    for(auto w : bootstrap_weights)
+        b_sum += w;
+    const real b = b_sum / bootstrap_count;
+
+    if(b <= 0)
+    {
+        reporter.message("no contributing bootstrap sample");
+        reporter.end();
+
+        RenderTarget ret;
+        ret.image = Image2D<Spectrum>(filter.height(), filter.width());
+        return ret;
+    }
+
+    // chains select bootstrap samples proportional to contribution, thus
+    // depths are selected proportional to their average contribution
+
+    reporter.message("construct bootstrap sampler");
+
+    math::distribution::alias_sampler_t<real, int> bootstrap_sampler(
+        bootstrap_weights.data(), total_bootstrap_count);
+
+    // film
+
+    Image2D<AtomicSpectrum> film(filter.height(), filter.width());
+
+    const Rect2i pixel_range = {
+        { 0, 0 },
+        { filter.width() - 1, filter.height() - 1 }
+    };
+
+    const real filter_radius = filter.radius();
+
+    auto splat = [&](const Vec2 &pixel_coord, const FSpectrum &value)
+    {
+        if(!value.is_finite())
+            return;
+
+        apply_image_filter(
+            pixel_range, filter_radius, pixel_coord,
+            [&](int px, int py, real x_rel, real y_rel)
+        {
+            const real w = filter.eval_filter(x_rel, y_rel);
+            film(py, px).add(w * value);
+        });
+    };
+
+    // perthread native samplers
+
+    std::vector<NativeSampler> perthread_native_sampler;
+    for(int i = 0; i < thread_count; ++i)
+    {
+        perthread_native_sampler.push_back(
+            NativeSampler(total_bootstrap_count + i, false));
+    }
+
+    auto run_markov_chain = [&](int thread_index, uint64_t mut_count)
+    {
+        PathSpace &space = perthread_spaces[thread_index];
+        auto &native_sampler = perthread_native_sampler[thread_index];
+
+        // reproduce the selected bootstrap sample
+
+        const int bootstrap_idx = bootstrap_sampler.sample(
+            native_sampler.sample1().u);
+        const int depth = 1 + bootstrap_idx / bootstrap_count;
+
+        render::pssmlt::PSSMLTSampler mlt_sampler(
+            params_.sigma, params_.large_step_prob,
+            NativeSampler(bootstrap_idx, false), STREAM_COUNT);
+
+        Vec2 current_pixel_coord;
+        FSpectrum current_spectrum = eval_path(
+            scene, depth, full_res, mlt_sampler, space, &current_pixel_coord);
+
+        // do mutations
+
+        for(uint64_t mut_idx = 0; mut_idx < mut_count; ++mut_idx)
+        {
+            if(stop_rendering_)
+                return false;
+
+            mlt_sampler.new_iteration();
+
+            Vec2 proposed_pixel_coord;
+            const FSpectrum proposed_spectrum = eval_path(
+                scene, depth, full_res, mlt_sampler,
+                space, &proposed_pixel_coord);
+
+            const real proposed_lum = proposed_spectrum.lum();
+            const real current_lum  = current_spectrum.lum();
+
+            const real accept_prob = current_lum > 0 ?
+                (std::min)(real(1), proposed_lum / current_lum) : real(1);
+
+            if(accept_prob > 0 && proposed_lum > 0)
+            {
+                splat(proposed_pixel_coord,
+                      proposed_spectrum * accept_prob / proposed_lum);
+            }
+
+            if(accept_prob < 1 && current_lum > 0)
+            {
+                splat(current_pixel_coord,
+                      current_spectrum * (1 - accept_prob) / current_lum);
+            }
+
+            if(native_sampler.sample1().u < accept_prob)
+            {
+                current_spectrum    = proposed_spectrum;
+                current_pixel_coord = proposed_pixel_coord;
+
+                mlt_sampler.accept();
+            }
+            else
+                mlt_sampler.reject();
+
+            if(space.arena.used_bytes() > 4 * 1024 * 1024)
+            {
+                AGZ_RENDER_STATS_ADD(ArenaBytes, space.arena.used_bytes());
+                space.arena.release();
+            }
+        }
+
+        return true;
+    };
+
+    // run markov chains
+
+    reporter.message("run markov chains");
+    reporter.new_stage();
+
+    const uint64_t total_mut_cnt =
+        uint64_t(params_.mut_per_pixel) *
+        uint64_t(filter.width()) *
+        uint64_t(filter.height());
+
+    auto chain_mut_count = [&](int chain_idx)
+    {
+        return (std::min)(
+                    total_mut_cnt,
+                    uint64_t(chain_idx + 1) * total_mut_cnt
+                    / uint64_t(params_.chain_count))
+             - uint64_t(chain_idx) * total_mut_cnt
+             / uint64_t(params_.chain_count);
+    };
+
+    const int chain_report_interval = reporter.need_image_preview() ?
+        math::clamp(params_.chain_count / 32, thread_count, 1000) :
+        params_.chain_count;
+
+    uint64_t finished_mut_cnt = 0;
+
+    for(int chain_idx = 0; chain_idx < params_.chain_count;
+        chain_idx += chain_report_interval)
+    {
+        if(stop_rendering_)
+            break;
+
+        const int chain_end = (std::min)(
+            chain_idx + chain_report_interval, params_.chain_count);
+
+        parallel_for_1d_grid(
+            thread_count, chain_end - chain_idx, 1, thread_group,
+            [&](int thread_index, int beg, int end)
+        {
+            assert(beg + 1 == end);
+
+            const uint64_t mut_cnt = chain_mut_count(chain_idx + beg);
+            if(!run_markov_chain(thread_index, mut_cnt))
+                return false;
+
+            {
+                std::lock_guard lk(reporter_mutex);
+                finished_mut_cnt += mut_cnt;
+
+                const real percent = real(100) * finished_mut_cnt
+                                               / total_mut_cnt;
+                reporter.progress(percent, {});
+            }
+
+            return !stop_rendering_;
+        });
+
+        if(reporter.need_image_preview() && finished_mut_cnt > 0)
+        {
+            auto get_img = [&]
+            {
+                const real scale = b / params_.mut_per_pixel
+                                 * total_mut_cnt / finished_mut_cnt;
+
+                return film.map([scale](const AtomicSpectrum &s)
+                {
+                    return scale * s.to_spectrum();
+                });
+            };
+
+            const real percent = real(100) * finished_mut_cnt
+                               / total_mut_cnt;
+            reporter.progress(percent, get_img);
+        }
+    }
+
+    reporter.end_stage();
+    reporter.end();
+
+    // compute final image
+
+    const real scale = b / params_.mut_per_pixel;
+
+    RenderTarget ret;
+    ret.image = film.map([scale](const AtomicSpectrum &s)
+    {
+        return scale * s.to_spectrum();
+    });
+
+    return ret;
+}
+
+AGZ_TRACER_END
@@ -1,8 +1,11 @@
+#include <typeinfo>
+
 #include <agz/tracer/core/camera.h>
 #include <agz/tracer/core/renderer_interactor.h>
 #include <agz/tracer/core/sampler.h>
 #include <agz/tracer/core/scene.h>
 #include <agz/tracer/utility/parallel_grid.h>
+#include <agz/tracer/utility/render_stats.h>
 #include <agz/utility/thread.h>
 
 #include "perpixel_renderer.h"
@@ -10,31 +13,49 @@
 AGZ_TRACER_BEGIN
 
 void PerPixelRenderer::render_grid(
-    const Scene &scene, Sampler &sampler,
-    Grid &grid, const Vec2i &full_res, int spp) const
+    const Scene &scene, NativeSampler &sampler,
+    Grid &grid, PixelCostRecorder &cost,
+    const Vec2i &full_res, int first_sample, int spp) const
 {
     Arena arena;
     const Camera *camera = scene.get_camera();
     auto sam_bound = grid.sample_pixels();
 
+    // differential rays are offset by one pixel, and shrink as spp grows
+    // since each sample only needs to cover its share of the pixel
+
+    const real diff_scale = (std::max)(
+        real(0.125), real(1) / std::sqrt(real(spp_)));
+    const Vec2 film_dxy(
+        diff_scale / full_res.x, diff_scale / full_res.y);
+
     for(int py = sam_bound.low.y; py <= sam_bound.high.y; ++py)
     {
         for(int px = sam_bound.low.x; px <= sam_bound.high.x; ++px)
         {
+            cost.begin_pixel();
+            AGZ_SCOPE_GUARD({ cost.end_pixel(px, py); });
+
+            const uint64_t pixel_index = uint64_t(py) * full_res.x + px;
+
             for(int i = 0; i < spp; ++i)
             {
+                sampler.start_sample(pixel_index, first_sample + i);
+
                 const Sample2 film_sam = sampler.sample2();
                 const real pixel_x = px + film_sam.u;
                 const real pixel_y = py + film_sam.v;
                 const real film_x = pixel_x / full_res.x;
                 const real film_y = pixel_y / full_res.y;
 
-                auto cam_ray = camera->sample_we(
-                    { film_x, film_y }, sampler.sample2());
+                CameraRayDifferential ray_diff;
+                auto cam_ray = camera->sample_we_differential(
+                    { film_x, film_y }, film_dxy, sampler.sample2(), &ray_diff);
+                AGZ_RENDER_STATS_ADD(CameraRays, 1);
 
                 const Ray ray(cam_ray.pos_on_cam, cam_ray.pos_to_out);
                 const render::Pixel pixel = eval_pixel(
-                    scene, ray, sampler, arena);
+                    scene, ray, ray_diff, sampler, arena);
 
                 if(pixel.value.is_finite())
                 {
@@ -43,6 +64,7 @@ void PerPixelRenderer::render_grid(
                         pixel.albedo, pixel.normal, pixel.denoise);
                 }
 
+                AGZ_RENDER_STATS_ADD(ArenaBytes, arena.used_bytes());
                 arena.release();
 
                 if(stop_rendering_)
@@ -53,14 +75,21 @@ void PerPixelRenderer::render_grid(
 }
 
 template<bool REPORTER_WITH_PREVIEW>
-RenderTarget PerPixelRenderer::render_impl(
-    FilmFilterApplier filter, Scene &scene, RendererInteractor &reporter)
+PartialFilm PerPixelRenderer::render_impl(
+    FilmFilterApplier filter, Scene &scene, RendererInteractor &reporter,
+    const FilmPartition &partition)
 {
     const int thread_count = thread::actual_worker_count(worker_count_);
+    const int first_sample = partition.first_sample(spp_);
+    const int spp = partition.spp(spp_);
 
     // prepare image buffer
 
-    ImageBuffer image_buffer(filter.width(), filter.height());
+    PartialFilm film(filter.width(), filter.height(), record_pixel_cost_);
+    film.partition = partition;
+
+    ImageBuffer &image_buffer = film.image_buffer;
+    Image2D<real> &cost_buffer = film.cost;
 
     auto get_img = std::function<Image2D<Spectrum>()>([&]()
     {
@@ -71,24 +100,73 @@ RenderTarget PerPixelRenderer::render_impl(
         return image_buffer.value * ratio;
     });
 
+    // resume from checkpoint
+
+    Checkpointer checkpointer(checkpoint_params_);
+    const std::string checkpoint_name = typeid(*this).name();
+    const CheckpointSampleRange checkpoint_range = {
+        spp_, partition.index, partition.count
+    };
+
+    int finished_spp = 0;
+
+    if(auto checkpoint = checkpointer.load(
+        checkpoint_name, filter.width(), filter.height(), checkpoint_range))
+    {
+        checkpoint->read(finished_spp);
+        checkpoint->read(image_buffer.value);
+        checkpoint->read(image_buffer.weight);
+        checkpoint->read(image_buffer.albedo);
+        checkpoint->read(image_buffer.normal);
+        checkpoint->read(image_buffer.denoise);
+        checkpoint->read(cost_buffer);
+    }
+
     // create per-thread samplers
+    // all samplers share the same seed and are reseeded by pixel and sample
+    // index before each sample
 
     Arena sampler_arena;
-    auto sampler_prototype = newRC<NativeSampler>(42, false);
-    std::vector<Sampler *> perthread_sampler;
+    std::vector<NativeSampler *> perthread_sampler;
     for(int i = 0; i < thread_count; ++i)
-        perthread_sampler.push_back(sampler_prototype->clone(i, sampler_arena));
+    {
+        perthread_sampler.push_back(
+            sampler_arena.create<NativeSampler>(42, false));
+    }
+
+    auto save_checkpoint = [&]
+    {
+        if(stop_rendering_ || !checkpointer.is_due())
+            return;
+
+        CheckpointWriter checkpoint(
+            checkpoint_name, filter.width(), filter.height(), checkpoint_range);
+        checkpoint.write(finished_spp);
+        checkpoint.write(image_buffer.value);
+        checkpoint.write(image_buffer.weight);
+        checkpoint.write(image_buffer.albedo);
+        checkpoint.write(image_buffer.normal);
+        checkpoint.write(image_buffer.denoise);
+        checkpoint.write(cost_buffer);
+        checkpointer.save_async(std::move(checkpoint));
+    };
 
     std::mutex reporter_mutex;
 
     reporter.begin();
     reporter.new_stage();
 
+    if(finished_spp > 0)
+    {
+        reporter.message(
+            "resumed at " + std::to_string(finished_spp) + " spp");
+    }
+
     // rendering iteration
 
     thread::thread_group_t thread_group(thread_count);
 
-    auto run_iter = [&](double prog_beg, double prog_end, int spp)
+    auto run_iter = [&](double prog_beg, double prog_end, int iter_spp)
     {
         int finished_pixel_count = 0;
 
@@ -103,9 +181,14 @@ RenderTarget PerPixelRenderer::render_impl(
                 Spectrum, real, Spectrum, Vec3, real>(
                     { rect.low, rect.high - Vec2i(1) });
 
+            PixelCostRecorder cost(
+                record_pixel_cost_ ? &cost_buffer : nullptr,
+                { rect.low, rect.high - Vec2i(1) });
+
             render_grid(
-                scene, *sampler, grid,
-                { filter.width(), filter.height() }, spp);
+                scene, *sampler, grid, cost,
+                { filter.width(), filter.height() },
+                first_sample + finished_spp, iter_spp);
 
             const int total_pixel_count = filter.width() * filter.height();
 
@@ -146,49 +229,45 @@ RenderTarget PerPixelRenderer::render_impl(
     };
 
     // start rendering
+    // checkpoints can only be saved between iterations
 
-    if(reporter.need_image_preview())
+    if(reporter.need_image_preview() || checkpointer.is_enabled())
     {
-        const double first_iter_prog_end = 100.0 / spp_;
-        run_iter(0, first_iter_prog_end, 1);
+        if(finished_spp == 0 && spp > 0)
+        {
+            const double first_iter_prog_end = 100.0 / spp;
+            run_iter(0, first_iter_prog_end, 1);
 
-        const int per_iter_spp = (std::max)(6, spp_ / 20);
-        int finished_spp = 1;
-        while(finished_spp < spp_)
+            finished_spp = 1;
+            save_checkpoint();
+        }
+
+        const int per_iter_spp = (std::max)(6, spp / 20);
+        while(finished_spp < spp)
         {
             if(stop_rendering_)
                 break;
 
             const int new_finished_spp = (std::min)(
-                spp_, finished_spp + per_iter_spp);
+                spp, finished_spp + per_iter_spp);
             const int delta_spp = new_finished_spp - finished_spp;
 
-            const double prog_beg = 100.0 * finished_spp / spp_;
-            const double prog_end = 100.0 * new_finished_spp / spp_;
+            const double prog_beg = 100.0 * finished_spp / spp;
+            const double prog_end = 100.0 * new_finished_spp / spp;
 
             run_iter(prog_beg, prog_end, delta_spp);
 
             finished_spp = new_finished_spp;
+            save_checkpoint();
         }
     }
     else
-        run_iter(0, 100, spp_);
+        run_iter(0, 100, spp);
 
     reporter.end_stage();
     reporter.end();
 
-    auto ratio = image_buffer.weight.map([](real w)
-    {
-        return w > 0 ? 1 / w : real(1);
-    });
-
-    RenderTarget render_target;
-    render_target.image   = image_buffer.value   * ratio;
-    render_target.albedo  = image_buffer.albedo  * ratio;
-    render_target.normal  = image_buffer.normal  * ratio;
-    render_target.denoise = image_buffer.denoise * ratio;
-
-    return render_target;
+    return film;
 }
 
 PerPixelRenderer::PerPixelRenderer(
@@ -200,10 +279,17 @@ PerPixelRenderer::PerPixelRenderer(
 
 RenderTarget PerPixelRenderer::render(
     FilmFilterApplier filter, Scene &scene, RendererInteractor &reporter)
+{
+    return render_partial(filter, scene, reporter, {}).to_render_target();
+}
+
+PartialFilm PerPixelRenderer::render_partial(
+    FilmFilterApplier filter, Scene &scene,
+    RendererInteractor &reporter, const FilmPartition &partition)
 {
     if(reporter.need_image_preview())
-        return render_impl<true>(filter, scene, reporter);
-    return render_impl<false>(filter, scene, reporter);
+        return render_impl<true>(filter, scene, reporter, partition);
+    return render_impl<false>(filter, scene, reporter, partition);
 }
 
 AGZ_TRACER_END
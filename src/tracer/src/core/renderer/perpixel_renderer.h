@@ -3,6 +3,7 @@
 #include <agz/tracer/core/renderer.h>
 #include <agz/tracer/core/render_target.h>
 #include <agz/tracer/render/path_tracing.h>
+#include <agz/tracer/utility/pixel_cost.h>
 
 AGZ_TRACER_BEGIN
 
@@ -14,13 +15,18 @@ class PerPixelRenderer : public Renderer
     using Grid = FilmFilterApplier::FilmGrid<
         Spectrum, real, Spectrum, Vec3, real>;
 
+    /**
+     * @brief render samples [first_sample, first_sample + spp) of each pixel
+     */
     void render_grid(
-        const Scene &scene, Sampler &sampler,
-        Grid &grid, const Vec2i &full_res, int spp) const;
+        const Scene &scene, NativeSampler &sampler,
+        Grid &grid, PixelCostRecorder &cost,
+        const Vec2i &full_res, int first_sample, int spp) const;
 
     template<bool REPORTER_WITH_PREVIEW>
-    RenderTarget render_impl(
-        FilmFilterApplier filter, Scene &scene, RendererInteractor &reporter);
+    PartialFilm render_impl(
+        FilmFilterApplier filter, Scene &scene, RendererInteractor &reporter,
+        const FilmPartition &partition);
 
     int worker_count_;
     int task_grid_size_;
@@ -31,17 +37,30 @@ protected:
 
     using Pixel = render::Pixel;
 
+    /**
+     * @param ray_diff differentials of the camera ray
+     */
     virtual Pixel eval_pixel(
         const Scene &scene, const Ray &ray,
+        const CameraRayDifferential &ray_diff,
         Sampler &sampler, Arena &arena) const = 0;
 
 public:
 
     PerPixelRenderer(int worker_count, int task_grid_size, int spp);
 
+    /**
+     * @brief forward to render_partial, where derived renderers prepare
+     *  their per-render data
+     */
     RenderTarget render(
         FilmFilterApplier filter, Scene &scene,
         RendererInteractor &reporter) override;
+
+    PartialFilm render_partial(
+        FilmFilterApplier filter, Scene &scene,
+        RendererInteractor &reporter,
+        const FilmPartition &partition) override;
 };
 
 AGZ_TRACER_END
@@ -6,6 +6,7 @@
 #include <agz/tracer/render/path_tracing.h>
 #include <agz/tracer/render/pssmlt.h>
 #include <agz/tracer/utility/parallel_grid.h>
+#include <agz/tracer/utility/render_stats.h>
 #include <agz/utility/thread.h>
 
 AGZ_TRACER_BEGIN
@@ -46,7 +47,7 @@ class PSSMLTPTRenderer : public Renderer
 
     render::Pixel (*trace_func_)(
         const render::TraceParams&, const Scene&,
-        const Ray&, Sampler&, Arena&);
+        const Ray&, Sampler&, Arena&, const CameraRayDifferential*);
 
     render::TraceParams trace_params_;
 
@@ -74,10 +75,11 @@ FSpectrum PSSMLTPTRenderer::eval_path(
 {
     const CameraSampleWeResult cam_sam =
         scene.get_camera()->sample_we(film_coord, sampler.sample2());
+    AGZ_RENDER_STATS_ADD(CameraRays, 1);
     const Ray ray(cam_sam.pos_on_cam, cam_sam.pos_to_out);
 
     const FSpectrum radiance = trace_func_(
-        trace_params_, scene, ray, sampler, arena).value;
+        trace_params_, scene, ray, sampler, arena, nullptr).value;
 
     return cam_sam.throughput * radiance;
 }
@@ -139,7 +141,10 @@ RenderTarget PSSMLTPTRenderer::render(
                 scene, film_coord, arena, sampler).lum();
 
             if(arena.used_bytes() > 4 * 1024 * 1024)
+            {
+                AGZ_RENDER_STATS_ADD(ArenaBytes, arena.used_bytes());
                 arena.release();
+            }
         }
 
         {
@@ -295,7 +300,10 @@ RenderTarget PSSMLTPTRenderer::render(
                 mlt_sampler.reject();
 
             if(local_arena.used_bytes() > 4 * 1024 * 1024)
+            {
+                AGZ_RENDER_STATS_ADD(ArenaBytes, local_arena.used_bytes());
                 local_arena.release();
+            }
         }
 
         return true;
@@ -1,5 +1,12 @@
+#include <agz/tracer/core/camera.h>
+#include <agz/tracer/core/renderer_interactor.h>
+#include <agz/tracer/core/sampler.h>
+#include <agz/tracer/core/scene.h>
 #include <agz/tracer/create/renderer.h>
+#include <agz/tracer/render/path_guiding.h>
 #include <agz/tracer/render/path_tracing.h>
+#include <agz/tracer/utility/parallel_grid.h>
+#include <agz/tracer/utility/render_stats.h>
 
 #include "./perpixel_renderer.h"
 
@@ -11,7 +18,125 @@ class PathTracingRenderer : public PerPixelRenderer
 
     render::Pixel(*eval_func_)(
         const render::TraceParams &, const Scene &,
-        const Ray &, Sampler &, Arena &);
+        const Ray &, Sampler &, Arena &, const CameraRayDifferential *);
+
+    int worker_count_;
+    int task_grid_size_;
+
+    int spp_;
+
+    bool use_guiding_;
+    int guiding_training_iterations_;
+    real guiding_training_budget_;
+    render::GuidingParams guiding_params_;
+    render::guiding::SDTreeParams sd_tree_params_;
+
+    Box<render::guiding::SDTree> sd_tree_;
+
+    /**
+     * @brief render training iterations to fill sd_tree_
+     *
+     * iteration i uses 2^i spp, and its image is discarded. the total spp of
+     * all iterations is limited to guiding_training_budget_ * render_spp
+     */
+    void train_guiding(
+        const FilmFilterApplier &filter, const Scene &scene,
+        RendererInteractor &reporter, int render_spp)
+    {
+        const int thread_count = thread::actual_worker_count(worker_count_);
+
+        // samplers are reseeded by pixel and sample index like the final
+        // pass. sample indices of training start after the final ones
+
+        Arena sampler_arena;
+        std::vector<NativeSampler *> perthread_sampler;
+        for(int i = 0; i < thread_count; ++i)
+        {
+            perthread_sampler.push_back(
+                sampler_arena.create<NativeSampler>(42, false));
+        }
+
+        std::vector<render::guiding::SDTreeRecorder> recorders(
+            thread_count, render::guiding::SDTreeRecorder(*sd_tree_));
+
+        thread::thread_group_t thread_group(thread_count);
+
+        const int budget = (std::max)(
+            1, static_cast<int>(guiding_training_budget_ * render_spp));
+        int trained_spp = 0;
+
+        for(int iter = 0; iter < guiding_training_iterations_; ++iter)
+        {
+            if(stop_rendering_)
+                return;
+
+            const int spp = (std::min)(
+                1 << (std::min)(iter, 16), budget - trained_spp);
+            if(spp <= 0)
+                break;
+
+            reporter.message(
+                "path guiding training iteration " + std::to_string(iter + 1) +
+                " (spp = " + std::to_string(spp) + ")");
+
+            parallel_for_2d_grid(
+                thread_count, filter.width(), filter.height(),
+                task_grid_size_, task_grid_size_, thread_group,
+                [&](int thread_index, const Rect2i &grid)
+            {
+                NativeSampler &sampler = *perthread_sampler[thread_index];
+                auto &recorder = recorders[thread_index];
+                const Camera *camera = scene.get_camera();
+
+                Arena arena;
+
+                for(int y = grid.low.y; y < grid.high.y; ++y)
+                {
+                    for(int x = grid.low.x; x < grid.high.x; ++x)
+                    {
+                        const uint64_t pixel_index =
+                            uint64_t(y) * filter.width() + x;
+
+                        for(int i = 0; i < spp; ++i)
+                        {
+                            sampler.start_sample(
+                                pixel_index, spp_ + trained_spp + i);
+
+                            const Sample2 film_sam = sampler.sample2();
+                            const Vec2 film_coord = {
+                                (x + film_sam.u) / filter.width(),
+                                (y + film_sam.v) / filter.height()
+                            };
+
+                            const CameraSampleWeResult cam_sam = camera->sample_we(
+                                film_coord, sampler.sample2());
+                            AGZ_RENDER_STATS_ADD(CameraRays, 1);
+
+                            const Ray ray(cam_sam.pos_on_cam, cam_sam.pos_to_out);
+                            render::trace_guided(
+                                params_, guiding_params_, *sd_tree_, &recorder,
+                                scene, ray, sampler, arena);
+
+                            AGZ_RENDER_STATS_ADD(ArenaBytes, arena.used_bytes());
+                            arena.release();
+                        }
+                    }
+
+                    if(stop_rendering_)
+                        return false;
+                }
+
+                return true;
+            });
+
+            sd_tree_->update(spp, recorders);
+            trained_spp += spp;
+        }
+
+        reporter.message(
+            "path guiding spatial leaf count: " +
+            std::to_string(sd_tree_->leaf_count()));
+    }
 
 public:
 
@@ -29,15 +154,55 @@ public:
             eval_func_ = &render::trace_std;
         else
             eval_func_ = &render::trace_nomis;
+
+        worker_count_   = params.worker_count;
+        task_grid_size_ = params.task_grid_size;
+
+        spp_ = params.spp;
+
+        use_guiding_                 = params.use_guiding;
+        guiding_training_iterations_ = params.guiding_training_iterations;
+        guiding_training_budget_     = params.guiding_training_budget;
+
+        guiding_params_.bsdf_sampling_fraction = params.guiding_bsdf_fraction;
+
+        sd_tree_params_.spatial_threshold     = params.guiding_spatial_threshold;
+        sd_tree_params_.directional_threshold = params.guiding_directional_threshold;
+    }
+
+    PartialFilm render_partial(
+        FilmFilterApplier filter, Scene &scene,
+        RendererInteractor &reporter,
+        const FilmPartition &partition) override
+    {
+        if(use_guiding_)
+        {
+            sd_tree_ = newBox<render::guiding::SDTree>(
+                scene.world_bound(), sd_tree_params_);
+
+            train_guiding(filter, scene, reporter, partition.spp(spp_));
+            if(stop_rendering_)
+                return {};
+        }
+
+        return PerPixelRenderer::render_partial(
+            filter, scene, reporter, partition);
     }
 
 protected:
 
     Pixel eval_pixel(
         const Scene &scene, const Ray &ray,
+        const CameraRayDifferential &ray_diff,
         Sampler &sampler, Arena &arena) const override
     {
-        return eval_func_(params_, scene, ray, sampler, arena);
+        if(use_guiding_)
+        {
+            return render::trace_guided(
+                params_, guiding_params_, *sd_tree_, nullptr,
+                scene, ray, sampler, arena, &ray_diff);
+        }
+        return eval_func_(params_, scene, ray, sampler, arena, &ray_diff);
     }
 };
 
@@ -5,10 +5,19 @@
 #include <agz/tracer/create/renderer.h>
 #include <agz/tracer/render/photon_mapping.h>
 #include <agz/tracer/utility/parallel_grid.h>
+#include <agz/tracer/utility/pixel_cost.h>
+#include <agz/tracer/utility/render_stats.h>
+#include <agz/tracer/utility/trace.h>
 #include <agz/utility/thread.h>
 
 AGZ_TRACER_BEGIN
 
+namespace
+{
+    // sampler stream of photons. disjoint with pixel indices
+    constexpr uint64_t PHOTON_STREAM = uint64_t(1) << 62;
+}
+
 class SPPMRenderer : public Renderer
 {
 public:
@@ -56,6 +65,9 @@ RenderTarget SPPMRenderer::render(
     Image2D<Spectrum> albedo_buffer (filter.height(), filter.width());
     Image2D<Vec3>     normal_buffer (filter.height(), filter.width());
     Image2D<real>     denoise_buffer(filter.height(), filter.width());
+    Image2D<real>     cost_buffer;
+    if(record_pixel_cost_)
+        cost_buffer = Image2D<real>(filter.height(), filter.width());
 
     Image2D<render::sppm::Pixel> sppm_pixels(filter.height(), filter.width());
     for(int y = 0; y < filter.height(); ++y)
@@ -64,14 +76,98 @@ RenderTarget SPPMRenderer::render(
             sppm_pixels(y, x).radius = init_radius;
     }
 
+    real max_radius = init_radius;
+
+    // resume from checkpoint
+    // visible points are rebuilt in each iteration and are not saved
+
+    Checkpointer checkpointer(checkpoint_params_);
+    const CheckpointSampleRange checkpoint_range = {
+        params_.iteration_count, 0, 1
+    };
+
+    int finished_iter = 0;
+
+    if(auto checkpoint = checkpointer.load(
+        "sppm", filter.width(), filter.height(), checkpoint_range))
+    {
+        checkpoint->read(finished_iter);
+        checkpoint->read(max_radius);
+
+        for(int y = 0; y < filter.height(); ++y)
+        {
+            for(int x = 0; x < filter.width(); ++x)
+            {
+                auto &pixel = sppm_pixels(y, x);
+                checkpoint->read(pixel.radius);
+                for(auto &phi : pixel.phi)
+                {
+                    real value;
+                    checkpoint->read(value);
+                    phi = value;
+                }
+                int M;
+                checkpoint->read(M);
+                pixel.M = M;
+                checkpoint->read(pixel.N);
+                checkpoint->read(pixel.tau);
+                checkpoint->read(pixel.direct_illum);
+            }
+        }
+
+        checkpoint->read(albedo_buffer);
+        checkpoint->read(normal_buffer);
+        checkpoint->read(denoise_buffer);
+        checkpoint->read(cost_buffer);
+
+        reporter.message(
+            "resumed at iter " + std::to_string(finished_iter));
+    }
+
+    auto save_checkpoint = [&]
+    {
+        if(stop_rendering_ || !checkpointer.is_due())
+            return;
+
+        CheckpointWriter checkpoint(
+            "sppm", filter.width(), filter.height(), checkpoint_range);
+        checkpoint.write(finished_iter);
+        checkpoint.write(max_radius);
+
+        for(int y = 0; y < filter.height(); ++y)
+        {
+            for(int x = 0; x < filter.width(); ++x)
+            {
+                auto &pixel = sppm_pixels(y, x);
+                checkpoint.write(pixel.radius);
+                for(auto &phi : pixel.phi)
+                    checkpoint.write(phi.load());
+                checkpoint.write(pixel.M.load());
+                checkpoint.write(pixel.N);
+                checkpoint.write(pixel.tau);
+                checkpoint.write(pixel.direct_illum);
+            }
+        }
+
+        checkpoint.write(albedo_buffer);
+        checkpoint.write(normal_buffer);
+        checkpoint.write(denoise_buffer);
+        checkpoint.write(cost_buffer);
+
+        checkpointer.save_async(std::move(checkpoint));
+    };
+
     // samplers
+    // all samplers share the same seed and are reseeded by pixel or photon
+    // index before each sample
 
     Arena sampler_arena;
-    auto sampler_prototype = newRC<NativeSampler>(42, false);
-
-    std::vector<Sampler *> perthread_sampler;
+    std::vector<NativeSampler *> perthread_sampler;
     for(int i = 0; i < thread_count; ++i)
-        perthread_sampler.push_back(sampler_prototype->clone(i, sampler_arena));
+    {
+        perthread_sampler.push_back(
+            sampler_arena.create<NativeSampler>(42, false));
+    }
 
     // vp arenas
 
@@ -97,11 +193,9 @@ RenderTarget SPPMRenderer::render(
 
     // run sppm iterations
 
-    real max_radius = init_radius;
-
     thread::thread_group_t thread_group;
 
-    for(int iter = 0; iter < params_.iteration_count; ++iter)
+    for(int iter = finished_iter; iter < params_.iteration_count; ++iter)
     {
         if(stop_rendering_)
             return {};
@@ -128,6 +222,7 @@ RenderTarget SPPMRenderer::render(
 
         int finished_pixel_count = 0;
 
+        trace::ScopedEvent vp_event("sppm", "find visible points");
         parallel_for_2d_grid(
             thread_count, filter.width(), filter.height(),
             params_.forward_task_grid_size, params_.forward_task_grid_size,
@@ -138,10 +233,19 @@ RenderTarget SPPMRenderer::render(
             auto sampler   = perthread_sampler [thread_index];
             auto &vp_arena = perthread_vp_arena[thread_index];
 
+            PixelCostRecorder cost(
+                record_pixel_cost_ ? &cost_buffer : nullptr,
+                { grid.low, grid.high - Vec2i(1) });
+
             for(int y = grid.low.y; y < grid.high.y; ++y)
             {
                 for(int x = grid.low.x; x < grid.high.x; ++x)
                 {
+                    cost.begin_pixel();
+
+                    sampler->start_sample(
+                        uint64_t(y) * filter.width() + x, iter);
+
                     const Sample2 film_sam = sampler->sample2();
                     const Vec2 film_coord = {
                         (x + film_sam.u) / filter.width(),
@@ -150,6 +254,7 @@ RenderTarget SPPMRenderer::render(
 
                     const CameraSampleWeResult cam_sam = camera->sample_we(
                         film_coord, sampler->sample2());
+                    AGZ_RENDER_STATS_ADD(CameraRays, 1);
 
                     const Ray ray(cam_sam.pos_on_cam, cam_sam.pos_to_out);
 
@@ -167,6 +272,8 @@ RenderTarget SPPMRenderer::render(
                     albedo_buffer(y, x) += gpixel.albedo;
                     normal_buffer(y, x) += gpixel.normal;
                     denoise_buffer(y, x) += gpixel.denoise;
+
+                    cost.end_pixel(x, y);
                 }
 
                 if(stop_rendering_)
@@ -183,12 +290,14 @@ RenderTarget SPPMRenderer::render(
 
             return true;
         });
+        vp_event.end();
 
         reporter.progress(progress_mid, {});
 
         // trace photons
 
         int finished_photon_count = 0;
+        trace::ScopedEvent photon_event("sppm", "trace photons");
         parallel_for_1d_grid(
             thread_count,
             params_.photons_per_iteration,
@@ -200,6 +309,10 @@ RenderTarget SPPMRenderer::render(
             Arena local_arena;
             for(int i = beg; i < end; ++i)
             {
+                sampler->start_sample(
+                    PHOTON_STREAM,
+                    uint64_t(iter) * params_.photons_per_iteration + i);
+
                 trace_photon(
                     params_.photon_min_depth,
                     params_.photon_max_depth,
@@ -207,7 +320,10 @@ RenderTarget SPPMRenderer::render(
                     vp_searcher, scene, local_arena, *sampler);
 
                 if(local_arena.used_bytes() > 4 * 1024 * 1024)
+                {
+                    AGZ_RENDER_STATS_ADD(ArenaBytes, local_arena.used_bytes());
                     local_arena.release();
+                }
 
                 if(stop_rendering_)
                     return false;
@@ -223,9 +339,12 @@ RenderTarget SPPMRenderer::render(
 
             return true;
         });
+        photon_event.end();
 
         // update pixel params
 
+        trace::ScopedEvent update_event("sppm", "update pixel params");
+
         max_radius = 0;
         for(int y = 0; y < filter.height(); ++y)
         {
@@ -258,6 +377,7 @@ RenderTarget SPPMRenderer::render(
                 }
             }
         });
+        update_event.end();
 
         // report progress
 
@@ -274,6 +394,9 @@ RenderTarget SPPMRenderer::render(
         }
         else
             reporter.progress(progress_end, {});
+
+        finished_iter = iter + 1;
+        save_checkpoint();
     }
 
     reporter.end_stage();
@@ -291,6 +414,7 @@ RenderTarget SPPMRenderer::render(
     ret.albedo  = albedo_buffer  * gbuffer_ratio;
     ret.normal  = normal_buffer  * gbuffer_ratio;
     ret.denoise = denoise_buffer * gbuffer_ratio;
+    ret.cost    = std::move(cost_buffer);
 
     return ret;
 }
@@ -6,12 +6,20 @@
 #include <agz/tracer/create/renderer.h>
 #include <agz/tracer/render/bidir_path_tracing.h>
 #include <agz/tracer/utility/parallel_grid.h>
+#include <agz/tracer/utility/pixel_cost.h>
+#include <agz/tracer/utility/render_stats.h>
 #include <agz/utility/thread.h>
 
 AGZ_TRACER_BEGIN
 
 namespace
 {
+    // sampler streams of light subpaths in the light vertex cache and
+    // their connections to the camera. disjoint with pixel indices
+
+    constexpr uint64_t LIGHT_SUBPATH_STREAM     = uint64_t(1) << 62;
+    constexpr uint64_t CAMERA_CONNECTION_STREAM = uint64_t(2) << 62;
+
     struct AtomicSpectrum
     {
         std::atomic<real> channels[SPECTRUM_COMPONENT_COUNT];
@@ -54,6 +62,11 @@ public:
         FilmFilterApplier filter, Scene &scene,
         RendererInteractor &reporter) override;
 
+    PartialFilm render_partial(
+        FilmFilterApplier filter, Scene &scene,
+        RendererInteractor &reporter,
+        const FilmPartition &partition) override;
+
 private:
 
     using ImageBuffer = ImageBufferTemplate<true, true, true, true, true>;
@@ -77,6 +90,19 @@ private:
 
         render::bdpt::Vertex *camera_subpath_space = nullptr;
         render::bdpt::Vertex *light_subpath_space  = nullptr;
+
+        // light vertex cache mode. subpaths resampled from the cache are
+        // copied into light_subpath_space
+
+        const render::bdpt::LightVertexCache *light_vertex_cache = nullptr;
+        int lvc_connections_per_vertex = 0;
+        render::bdpt::Vertex *light_vertex_space = nullptr;
+
+        // pixels sampled for the film filter radius are also sampled by
+        // their owner task with the same seeds. only the owner splats
+        // particles of these paths
+
+        bool splat_particles = true;
     };
 
     template<bool USE_MIS>
@@ -85,15 +111,56 @@ private:
         int px, int py,
         NativeSampler &sampler, Arena &arena);
 
+    /**
+     * @brief render samples [first_sample, first_sample + spp) of each pixel
+     */
     template<bool USE_MIS>
     int render_grid(
         const Scene &scene, NativeSampler &sampler,
-        FilmGridView &film_grid_view, ParticleImage &particle_image,
-        FilmFilterApplier filter, int spp);
+        FilmGridView &film_grid_view, PixelCostRecorder &cost,
+        ParticleImage &particle_image,
+        FilmFilterApplier filter, int first_sample, int spp,
+        const render::bdpt::LightVertexCache *light_vertex_cache = nullptr,
+        int lvc_connections_per_vertex = 0);
 
     template<bool REPORT_WITH_PREVIEW, bool USE_MIS>
-    RenderTarget render_impl(
-        FilmFilterApplier filter, Scene &scene, RendererInteractor &reporter);
+    PartialFilm render_impl(
+        FilmFilterApplier filter, Scene &scene, RendererInteractor &reporter,
+        const FilmPartition &partition);
+
+    /**
+     * @brief trace light subpaths of an iteration into the cache, and
+     *  splat their contributions to the particle image (s = 1)
+     *
+     * light subpaths are seeded with sample_index, the index of the
+     * iteration among all samples
+     *
+     * return number of cached vertices each camera vertex connects to
+     */
+    template<bool USE_MIS>
+    int build_light_vertex_cache(
+        const Scene &scene, FilmFilterApplier filter,
+        int thread_count, thread::thread_group_t &threads,
+        std::vector<NativeSampler*> &perthread_samplers,
+        render::bdpt::LightVertexCache &cache,
+        ParticleImage &particle_image, int sample_index);
+
+    template<bool USE_MIS>
+    PartialFilm render_lvc_impl(
+        FilmFilterApplier filter, Scene &scene, RendererInteractor &reporter,
+        const FilmPartition &partition);
+
+    static void write_image_buffers(
+        CheckpointWriter &checkpoint,
+        const ImageBuffer &image_buffer,
+        const ParticleImage &particle_image,
+        const Image2D<real> &cost_buffer);
+
+    static void read_image_buffers(
+        CheckpointReader &checkpoint,
+        ImageBuffer &image_buffer,
+        ParticleImage &particle_image,
+        Image2D<real> &cost_buffer);
 
     VolBDPTRendererParams params_;
 };
@@ -122,6 +189,7 @@ int VolBDPTRenderer::render_bdpt_path(
 
     const auto cam_sam = params.scene.get_camera()->sample_we(
         film_coord, sampler.sample2());
+    AGZ_RENDER_STATS_ADD(CameraRays, 1);
     const Ray cam_ray(cam_sam.pos_on_cam, cam_sam.pos_to_out);
 
     // build camera/light subpath
@@ -134,6 +202,42 @@ int VolBDPTRenderer::render_bdpt_path(
     if(!select_light.light)
         return 0;
 
+    if(params.light_vertex_cache)
+    {
+        // only the light vertex for t = 1 is sampled here
+
+        const auto light_vertex = build_light_subpath(
+            1, select_light, params.scene, sampler, arena,
+            params.light_vertex_space);
+
+        render::bdpt::EvalBDPTPathParams path_params = {
+            params.scene,
+            params.particle_sample_pixel_bound,
+            params.full_res,
+            sampler
+        };
+
+        const FSpectrum radiance = render::bdpt::eval_lvc_path<USE_MIS>(
+            path_params,
+            camera_subpath.vertices, camera_subpath.vertex_count,
+            light_vertex.vertices, light_vertex.vertex_count,
+            *params.light_vertex_cache, params.lvc_connections_per_vertex,
+            params.light_subpath_space);
+
+        if(radiance.is_finite())
+        {
+            params.film_grid_view.apply(
+                pixel_coord.x, pixel_coord.y,
+                radiance, 1,
+                camera_subpath.g_albedo,
+                camera_subpath.g_normal,
+                camera_subpath.g_denoise);
+        }
+
+        // light subpaths are counted when building the cache
+        return 0;
+    }
+
     const auto light_subpath = build_light_subpath(
         params_.lht_max_vtx_cnt, select_light, params.scene,
         sampler, arena, params.light_subpath_space);
@@ -151,7 +255,7 @@ int VolBDPTRenderer::render_bdpt_path(
         light_subpath.vertices, light_subpath.vertex_count,
         select_light, [&](const Vec2 &particle_coord, const FSpectrum &rad)
     {
-        if(rad.is_finite())
+        if(params.splat_particles && rad.is_finite())
         {
             apply_image_filter(
                 params.particle_pixel_range, params.filter.radius(),
@@ -173,20 +277,24 @@ int VolBDPTRenderer::render_bdpt_path(
             camera_subpath.g_denoise);
     }
 
-    return 1;
+    return params.splat_particles ? 1 : 0;
 }
 
 template<bool USE_MIS>
 int VolBDPTRenderer::render_grid(
     const Scene &scene, NativeSampler &sampler,
-    FilmGridView &film_grid_view, ParticleImage &particle_image,
-    FilmFilterApplier filter, int spp)
+    FilmGridView &film_grid_view, PixelCostRecorder &cost,
+    ParticleImage &particle_image,
+    FilmFilterApplier filter, int first_sample, int spp,
+    const render::bdpt::LightVertexCache *light_vertex_cache,
+    int lvc_connections_per_vertex)
 {
     if(scene.lights().empty())
         return 0;
 
     std::vector<render::bdpt::Vertex> cam_subpath(params_.cam_max_vtx_cnt);
     std::vector<render::bdpt::Vertex> lht_subpath(params_.lht_max_vtx_cnt);
+    std::vector<render::bdpt::Vertex> lht_vertex(1);
 
     const Rect2 particle_sample_pixel_bound = {
         { 0, 0 },
@@ -207,7 +315,10 @@ int VolBDPTRenderer::render_grid(
         particle_sample_pixel_bound,
         particle_pixel_range,
         cam_subpath.data(),
-        lht_subpath.data()
+        lht_subpath.data(),
+        light_vertex_cache,
+        lvc_connections_per_vertex,
+        lht_vertex.data()
     };
 
     int particle_count = 0;
@@ -215,18 +326,33 @@ int VolBDPTRenderer::render_grid(
     Arena arena;
 
     const Rect2i sample_pixels = film_grid_view.sample_pixels();
+    const Rect2i &owned_pixels = film_grid_view.pixels();
 
     for(int py = sample_pixels.low.y; py <= sample_pixels.high.y; ++py)
     {
         for(int px = sample_pixels.low.x; px <= sample_pixels.high.x; ++px)
         {
+            cost.begin_pixel();
+            AGZ_SCOPE_GUARD({ cost.end_pixel(px, py); });
+
+            eval_params.splat_particles =
+                owned_pixels.low.x <= px && px <= owned_pixels.high.x &&
+                owned_pixels.low.y <= py && py <= owned_pixels.high.y;
+
+            const uint64_t pixel_index = uint64_t(py) * filter.width() + px;
+
             for(int i = 0; i < spp; ++i)
             {
+                sampler.start_sample(pixel_index, first_sample + i);
+
                 particle_count += render_bdpt_path<USE_MIS>(
                     eval_params, px, py, sampler, arena);
 
                 if(arena.used_bytes() >= 32 * 1024 * 1024)
+                {
+                    AGZ_RENDER_STATS_ADD(ArenaBytes, arena.used_bytes());
                     arena.release();
+                }
 
                 if(stop_rendering_)
                     return particle_count;
@@ -237,14 +363,67 @@ int VolBDPTRenderer::render_grid(
     return particle_count;
 }
 
+void VolBDPTRenderer::write_image_buffers(
+    CheckpointWriter &checkpoint,
+    const ImageBuffer &image_buffer,
+    const ParticleImage &particle_image,
+    const Image2D<real> &cost_buffer)
+{
+    checkpoint.write(image_buffer.value);
+    checkpoint.write(image_buffer.weight);
+    checkpoint.write(image_buffer.albedo);
+    checkpoint.write(image_buffer.normal);
+    checkpoint.write(image_buffer.denoise);
+    checkpoint.write(particle_image.map([](const AtomicSpectrum &as)
+    {
+        return as.to_spectrum();
+    }));
+    checkpoint.write(cost_buffer);
+}
+
+void VolBDPTRenderer::read_image_buffers(
+    CheckpointReader &checkpoint,
+    ImageBuffer &image_buffer,
+    ParticleImage &particle_image,
+    Image2D<real> &cost_buffer)
+{
+    checkpoint.read(image_buffer.value);
+    checkpoint.read(image_buffer.weight);
+    checkpoint.read(image_buffer.albedo);
+    checkpoint.read(image_buffer.normal);
+    checkpoint.read(image_buffer.denoise);
+
+    Image2D<Spectrum> particle_spectrum(
+        particle_image.height(), particle_image.width());
+    checkpoint.read(particle_spectrum);
+    for(int y = 0; y < particle_image.height(); ++y)
+    {
+        for(int x = 0; x < particle_image.width(); ++x)
+        {
+            for(int i = 0; i < SPECTRUM_COMPONENT_COUNT; ++i)
+                particle_image(y, x).channels[i] = particle_spectrum(y, x)[i];
+        }
+    }
+
+    checkpoint.read(cost_buffer);
+}
+
 template<bool REPORT_WITH_PREVIEW, bool USE_MIS>
-RenderTarget VolBDPTRenderer::render_impl(
-    FilmFilterApplier filter, Scene &scene, RendererInteractor &reporter)
+PartialFilm VolBDPTRenderer::render_impl(
+    FilmFilterApplier filter, Scene &scene, RendererInteractor &reporter,
+    const FilmPartition &partition)
 {
+    const int first_sample = partition.first_sample(params_.spp);
+    const int spp = partition.spp(params_.spp);
+
     // initialize image buffers
 
-    ImageBuffer image_buffer(filter.width(), filter.height());
+    PartialFilm film(filter.width(), filter.height(), record_pixel_cost_);
+    film.partition = partition;
+
+    ImageBuffer &image_buffer = film.image_buffer;
     ParticleImage particle_image(filter.height(), filter.width());
+    Image2D<real> &cost_buffer = film.cost;
 
     std::atomic<uint64_t> particle_count = 0;
 
@@ -253,15 +432,50 @@ RenderTarget VolBDPTRenderer::render_impl(
     const int thread_count = thread::actual_worker_count(params_.worker_count);
     thread::thread_group_t threads(thread_count);
 
+    // resume from checkpoint
+
+    Checkpointer checkpointer(checkpoint_params_);
+    const CheckpointSampleRange checkpoint_range = {
+        params_.spp, partition.index, partition.count
+    };
+
+    int finished_spp = 0;
+
+    if(auto checkpoint = checkpointer.load(
+        "vol_bdpt", filter.width(), filter.height(), checkpoint_range))
+    {
+        uint64_t saved_particle_count = 0;
+        checkpoint->read(finished_spp);
+        checkpoint->read(saved_particle_count);
+        read_image_buffers(
+            *checkpoint, image_buffer, particle_image, cost_buffer);
+        particle_count = saved_particle_count;
+    }
+
+    auto save_checkpoint = [&]
+    {
+        if(stop_rendering_ || !checkpointer.is_due())
+            return;
+
+        CheckpointWriter checkpoint(
+            "vol_bdpt", filter.width(), filter.height(), checkpoint_range);
+        checkpoint.write(finished_spp);
+        checkpoint.write(particle_count.load());
+        write_image_buffers(
+            checkpoint, image_buffer, particle_image, cost_buffer);
+        checkpointer.save_async(std::move(checkpoint));
+    };
+
     // per-thread samplers
+    // all samplers share the same seed and are reseeded by pixel and sample
+    // index before each sample
 
     Arena sampler_arena;
-    auto sampler_prototype = newBox<NativeSampler>(42, false);
     std::vector<NativeSampler *> perthread_samplers;
     for(int i = 0; i < thread_count; ++i)
     {
         perthread_samplers.push_back(
-            sampler_prototype->clone(i, sampler_arena));
+            sampler_arena.create<NativeSampler>(42, false));
     }
 
     // reporter
@@ -269,15 +483,22 @@ RenderTarget VolBDPTRenderer::render_impl(
     reporter.begin();
     reporter.new_stage();
 
+    if(finished_spp > 0)
+    {
+        reporter.message(
+            "resumed at " + std::to_string(finished_spp) + " spp");
+    }
+
     std::mutex reporter_mutex;
 
     // do the real work
 
-    if constexpr(REPORT_WITH_PREVIEW)
+    if(REPORT_WITH_PREVIEW || checkpointer.is_enabled())
     {
         // 1. render 1 spp for fast previewing
         // 2. divide remaining spp(s) into tasks, then divide tasks into
-        //    iterations. sync all threads per iteration and update reporter
+        //    iterations. sync all threads per iteration, update reporter
+        //    and save checkpoint
 
         // previewing image computation
 
@@ -301,45 +522,55 @@ RenderTarget VolBDPTRenderer::render_impl(
 
         // render 1 spp for fast previewing
 
-        parallel_for_2d_grid(
-            thread_count,
-            filter.width(), filter.height(),
-            params_.task_grid_size, params_.task_grid_size,
-            threads, [&](int thread_index, const Rect2i &grid)
+        if(finished_spp == 0 && spp > 0)
         {
-            auto view = filter.create_subgrid_view({
-                grid.low, grid.high - Vec2i(1)},
-                image_buffer.value, image_buffer.weight,
-                image_buffer.albedo,
-                image_buffer.normal,
-                image_buffer.denoise);
+            parallel_for_2d_grid(
+                thread_count,
+                filter.width(), filter.height(),
+                params_.task_grid_size, params_.task_grid_size,
+                threads, [&](int thread_index, const Rect2i &grid)
+            {
+                auto view = filter.create_subgrid_view({
+                    grid.low, grid.high - Vec2i(1)},
+                    image_buffer.value, image_buffer.weight,
+                    image_buffer.albedo,
+                    image_buffer.normal,
+                    image_buffer.denoise);
 
-            const int delta_pc = render_grid<USE_MIS>(
-                scene, *perthread_samplers[thread_index],
-                view, particle_image, filter, 1);
+                PixelCostRecorder cost(
+                    record_pixel_cost_ ? &cost_buffer : nullptr,
+                    { grid.low, grid.high - Vec2i(1) });
 
-            particle_count += delta_pc;
+                const int delta_pc = render_grid<USE_MIS>(
+                    scene, *perthread_samplers[thread_index],
+                    view, cost, particle_image, filter, first_sample, 1);
 
-            return !stop_rendering_;
-        });
+                particle_count += delta_pc;
+
+                return !stop_rendering_;
+            });
 
-        reporter.progress(100.0 / params_.spp, get_img);
+            reporter.progress(100.0 / spp, get_img);
+
+            finished_spp = 1;
+            save_checkpoint();
+        }
 
         // render remaining spp
 
-        const int preview_spp_interval = (std::max)(1, (params_.spp - 1) / 25);
+        const int preview_spp_interval = (std::max)(1, (spp - 1) / 25);
 
-        uint64_t finished_sam = filter.width() * filter.height();
-        const uint64_t total_sam = params_.spp * finished_sam;
+        const uint64_t pixel_count = filter.width() * filter.height();
+        const uint64_t total_sam = spp * pixel_count;
+        uint64_t finished_sam = finished_spp * pixel_count;
 
-        int finished_spp = 1;
-        while(finished_spp < params_.spp)
+        while(finished_spp < spp)
         {
             if(stop_rendering_)
                 break;
 
             const int new_finished_spp = (std::min)(
-                params_.spp, finished_spp + preview_spp_interval);
+                spp, finished_spp + preview_spp_interval);
             const int delta_spp = new_finished_spp - finished_spp;
 
             parallel_for_2d_grid(
@@ -355,9 +586,14 @@ RenderTarget VolBDPTRenderer::render_impl(
                     image_buffer.normal,
                     image_buffer.denoise);
 
+                PixelCostRecorder cost(
+                    record_pixel_cost_ ? &cost_buffer : nullptr,
+                    { grid.low, grid.high - Vec2i(1) });
+
                 const int delta_pc = render_grid<USE_MIS>(
                     scene, *perthread_samplers[thread_index],
-                    view, particle_image, filter, delta_spp);
+                    view, cost, particle_image, filter,
+                    first_sample + finished_spp, delta_spp);
 
                 particle_count += delta_pc;
 
@@ -369,7 +605,9 @@ RenderTarget VolBDPTRenderer::render_impl(
             });
 
             finished_spp = new_finished_spp;
-            const double progress_percent = 100.0 * finished_spp / params_.spp;
+            save_checkpoint();
+
+            const double progress_percent = 100.0 * finished_spp / spp;
 
             std::lock_guard lock(reporter_mutex);
             reporter.progress(progress_percent, get_img);
@@ -398,9 +636,13 @@ RenderTarget VolBDPTRenderer::render_impl(
                 image_buffer.normal,
                 image_buffer.denoise);
 
+            PixelCostRecorder cost(
+                record_pixel_cost_ ? &cost_buffer : nullptr,
+                { grid.low, grid.high - Vec2i(1) });
+
             const int delta_pc = render_grid<USE_MIS>(
                 scene, *perthread_samplers[thread_index],
-                view, particle_image, filter, params_.spp);
+                view, cost, particle_image, filter, first_sample, spp);
 
             particle_count += delta_pc;
 
@@ -423,30 +665,288 @@ RenderTarget VolBDPTRenderer::render_impl(
     reporter.end_stage();
     reporter.end();
 
-    // forward image
+    film.particle_image = particle_image.map([](const AtomicSpectrum &as)
+    {
+        return as.to_spectrum();
+    });
+    film.particle_count = particle_count;
 
-    RenderTarget render_target;
+    return film;
+}
+
+template<bool USE_MIS>
+int VolBDPTRenderer::build_light_vertex_cache(
+    const Scene &scene, FilmFilterApplier filter,
+    int thread_count, thread::thread_group_t &threads,
+    std::vector<NativeSampler*> &perthread_samplers,
+    render::bdpt::LightVertexCache &cache,
+    ParticleImage &particle_image, int sample_index)
+{
+    const int subpath_count = filter.width() * filter.height();
+    const Camera *camera = scene.get_camera();
 
-    const auto fwd_ratio = image_buffer.weight.map([](real w)
+    // trace light subpaths
+
+    cache.clear(subpath_count);
+
+    parallel_for_1d_grid(
+        thread_count, subpath_count, 4096, threads,
+        [&](int thread_index, int beg, int end)
     {
-        return w > 0 ? 1 / w : real(0);
+        auto &sampler = *perthread_samplers[thread_index];
+        for(int i = beg; i < end; ++i)
+        {
+            sampler.start_sample(
+                LIGHT_SUBPATH_STREAM | uint64_t(i), sample_index);
+            cache.add_subpath(
+                thread_index, i, params_.lht_max_vtx_cnt, scene, sampler);
+        }
+        return !stop_rendering_;
     });
-    render_target.image   = image_buffer.value   * fwd_ratio;
-    render_target.albedo  = image_buffer.albedo  * fwd_ratio;
-    render_target.normal  = image_buffer.normal  * fwd_ratio;
-    render_target.denoise = image_buffer.denoise * fwd_ratio;
 
-    // backward image
+    cache.finalize();
+
+    if(stop_rendering_)
+        return 0;
+
+    // connect each light subpath to the camera
+
+    const int connections_per_vertex = params_.lvc_connection_count > 0 ?
+        params_.lvc_connection_count :
+        (std::max)(1, cache.average_vertex_count());
+    const real connect_count = cache.vertex_count() > 0 ?
+        cache.connect_count(connections_per_vertex) : real(1);
 
-    const real bwd_ratio = filter.width() * filter.height() *
-        (particle_count > 0 ? real(1) / particle_count : real(0));
-    render_target.image += particle_image.map(
-        [&](const AtomicSpectrum &as)
+    const Rect2 particle_sample_pixel_bound = {
+        { 0, 0 },
+        { real(filter.width() - 1), real(filter.height() - 1) }
+    };
+
+    const Rect2i particle_pixel_range = {
+        { 0, 0 },
+        { filter.width() - 1, filter.height() - 1 }
+    };
+
+    const Vec2 full_res = { real(filter.width()), real(filter.height()) };
+
+    parallel_for_1d_grid(
+        thread_count, cache.subpath_count(), 4096, threads,
+        [&](int thread_index, int beg, int end)
     {
-        return bwd_ratio * as.to_spectrum();
+        auto &sampler = *perthread_samplers[thread_index];
+        Arena arena;
+
+        render::bdpt::Vertex camera_vertex;
+
+        for(int i = beg; i < end; ++i)
+        {
+            const auto light_subpath = cache.subpath(i);
+            if(light_subpath.vertex_count < 2)
+                continue;
+
+            sampler.start_sample(
+                CAMERA_CONNECTION_STREAM | uint64_t(i), sample_index);
+
+            // a camera subpath with only the camera vertex
+
+            const Sample2 film_sam = sampler.sample2();
+            const auto cam_sam = camera->sample_we(
+                { film_sam.u, film_sam.v }, sampler.sample2());
+            AGZ_RENDER_STATS_ADD(CameraRays, 1);
+            const Ray cam_ray(cam_sam.pos_on_cam, cam_sam.pos_to_out);
+
+            const auto camera_subpath = build_camera_subpath(
+                1, cam_ray, scene, sampler, arena, &camera_vertex);
+
+            for(int t = 2; t <= light_subpath.vertex_count; ++t)
+            {
+                Vec2 particle_coord;
+                FSpectrum rad;
+
+                if constexpr(USE_MIS)
+                {
+                    rad = render::bdpt::weighted_contrib_s1_tx(
+                        scene, camera_subpath.vertices,
+                        light_subpath.vertices, t, sampler,
+                        particle_sample_pixel_bound, full_res,
+                        particle_coord, connect_count);
+                }
+                else
+                {
+                    rad = render::bdpt::unweighted_contrib_s1_tx(
+                        scene, camera_subpath.vertices,
+                        light_subpath.vertices, t, sampler,
+                        particle_sample_pixel_bound, full_res,
+                        particle_coord) / real(1 + t);
+                }
+
+                if(!rad.is_finite() || rad.is_black())
+                    continue;
+
+                apply_image_filter(
+                    particle_pixel_range, filter.radius(),
+                    particle_coord, [&](int pix, int piy, real rel_x, real rel_y)
+                {
+                    const real weight = filter.eval_filter(rel_x, rel_y);
+                    particle_image(piy, pix).add(weight * rad);
+                });
+            }
+
+            AGZ_RENDER_STATS_ADD(ArenaBytes, arena.used_bytes());
+            arena.release();
+        }
+
+        return !stop_rendering_;
     });
 
-    return render_target;
+    return connections_per_vertex;
+}
+
+template<bool USE_MIS>
+PartialFilm VolBDPTRenderer::render_lvc_impl(
+    FilmFilterApplier filter, Scene &scene, RendererInteractor &reporter,
+    const FilmPartition &partition)
+{
+    const int first_sample = partition.first_sample(params_.spp);
+    const int spp = partition.spp(params_.spp);
+
+    PartialFilm film(filter.width(), filter.height(), record_pixel_cost_);
+    film.partition = partition;
+
+    ImageBuffer &image_buffer = film.image_buffer;
+    ParticleImage particle_image(filter.height(), filter.width());
+    Image2D<real> &cost_buffer = film.cost;
+
+    uint64_t particle_count = 0;
+
+    const int thread_count = thread::actual_worker_count(params_.worker_count);
+    thread::thread_group_t threads(thread_count);
+
+    Checkpointer checkpointer(checkpoint_params_);
+    const CheckpointSampleRange checkpoint_range = {
+        params_.spp, partition.index, partition.count
+    };
+
+    int finished_iter = 0;
+
+    if(auto checkpoint = checkpointer.load(
+        "vol_bdpt_lvc", filter.width(), filter.height(), checkpoint_range))
+    {
+        checkpoint->read(finished_iter);
+        checkpoint->read(particle_count);
+        read_image_buffers(
+            *checkpoint, image_buffer, particle_image, cost_buffer);
+    }
+
+    auto save_checkpoint = [&]
+    {
+        if(stop_rendering_ || !checkpointer.is_due())
+            return;
+
+        CheckpointWriter checkpoint(
+            "vol_bdpt_lvc", filter.width(), filter.height(), checkpoint_range);
+        checkpoint.write(finished_iter);
+        checkpoint.write(particle_count);
+        write_image_buffers(
+            checkpoint, image_buffer, particle_image, cost_buffer);
+        checkpointer.save_async(std::move(checkpoint));
+    };
+
+    Arena sampler_arena;
+    std::vector<NativeSampler *> perthread_samplers;
+    for(int i = 0; i < thread_count; ++i)
+    {
+        perthread_samplers.push_back(
+            sampler_arena.create<NativeSampler>(42, false));
+    }
+
+    render::bdpt::LightVertexCache cache(thread_count);
+
+    auto get_img = [&]
+    {
+        const auto fwd_ratio = image_buffer.weight.map([](real w)
+        {
+            return w > 0 ? 1 / w : real(0);
+        });
+        const auto fwd_img = fwd_ratio * image_buffer.value;
+
+        const real bwd_ratio = filter.width() * filter.height() *
+            (particle_count > 0 ? real(1) / particle_count : real(0));
+        const auto bwd_img = particle_image.map([&](const AtomicSpectrum &as)
+        {
+            return bwd_ratio * as.to_spectrum();
+        });
+
+        return fwd_img + bwd_img;
+    };
+
+    reporter.begin();
+    reporter.new_stage();
+
+    if(finished_iter > 0)
+    {
+        reporter.message(
+            "resumed at " + std::to_string(finished_iter) + " spp");
+    }
+
+    // each iteration renders 1 spp with light subpaths shared by all pixels
+
+    for(int iter = finished_iter; iter < spp; ++iter)
+    {
+        if(stop_rendering_ || scene.lights().empty())
+            break;
+
+        const int connections_per_vertex = build_light_vertex_cache<USE_MIS>(
+            scene, filter, thread_count, threads,
+            perthread_samplers, cache, particle_image, first_sample + iter);
+
+        particle_count += cache.traced_subpath_count();
+
+        parallel_for_2d_grid(
+            thread_count,
+            filter.width(), filter.height(),
+            params_.task_grid_size, params_.task_grid_size,
+            threads, [&](int thread_index, const Rect2i &grid)
+        {
+            auto view = filter.create_subgrid_view({
+                grid.low, grid.high - Vec2i(1) },
+                image_buffer.value, image_buffer.weight,
+                image_buffer.albedo,
+                image_buffer.normal,
+                image_buffer.denoise);
+
+            PixelCostRecorder cost(
+                record_pixel_cost_ ? &cost_buffer : nullptr,
+                { grid.low, grid.high - Vec2i(1) });
+
+            render_grid<USE_MIS>(
+                scene, *perthread_samplers[thread_index],
+                view, cost, particle_image, filter, first_sample + iter, 1,
+                &cache, connections_per_vertex);
+
+            return !stop_rendering_;
+        });
+
+        finished_iter = iter + 1;
+        save_checkpoint();
+
+        const double percent = 100.0 * (iter + 1) / spp;
+        if(reporter.need_image_preview())
+            reporter.progress(percent, get_img);
+        else
+            reporter.progress(percent, {});
+    }
+
+    reporter.end_stage();
+    reporter.end();
+
+    film.particle_image = particle_image.map([](const AtomicSpectrum &as)
+    {
+        return as.to_spectrum();
+    });
+    film.particle_count = particle_count;
+
+    return film;
 }
 
 VolBDPTRenderer::VolBDPTRenderer(const VolBDPTRendererParams &params)
@@ -458,16 +958,30 @@ VolBDPTRenderer::VolBDPTRenderer(const VolBDPTRendererParams &params)
 RenderTarget VolBDPTRenderer::render(
     FilmFilterApplier filter, Scene &scene, RendererInteractor &reporter)
 {
+    return render_partial(filter, scene, reporter, {}).to_render_target();
+}
+
+PartialFilm VolBDPTRenderer::render_partial(
+    FilmFilterApplier filter, Scene &scene,
+    RendererInteractor &reporter, const FilmPartition &partition)
+{
+    if(params_.use_light_vertex_cache)
+    {
+        if(params_.use_mis)
+            return render_lvc_impl<true>(filter, scene, reporter, partition);
+        return render_lvc_impl<false>(filter, scene, reporter, partition);
+    }
+
     if(params_.use_mis)
     {
         if(reporter.need_image_preview())
-            return render_impl<true, true>(filter, scene, reporter);
-        return render_impl<false, true>(filter, scene, reporter);
+            return render_impl<true, true>(filter, scene, reporter, partition);
+        return render_impl<false, true>(filter, scene, reporter, partition);
     }
 
     if(reporter.need_image_preview())
-        return render_impl<true, false>(filter, scene, reporter);
-    return render_impl<false, false>(filter, scene, reporter);
+        return render_impl<true, false>(filter, scene, reporter, partition);
+    return render_impl<false, false>(filter, scene, reporter, partition);
 }
 
 RC<Renderer> create_vol_bdpt_renderer(const VolBDPTRendererParams &params)
@@ -42,6 +42,17 @@ public:
 
     }
 
+    void stats(const RenderStats &stats) override
+    {
+        AGZ_INFO("rendering statistics of {} threads:", stats.per_thread.size());
+        for(int i = 0; i < render_stats::CounterCount; ++i)
+        {
+            const auto counter = static_cast<render_stats::Counter>(i);
+            AGZ_INFO("    {:<24} {}",
+                     render_stats::counter_name(counter), stats.total[i]);
+        }
+    }
+
     void new_stage() override
     {
         percent_ = 0;
@@ -10,6 +10,8 @@
 #include <agz/tracer/core/scene.h>
 #include <agz/tracer/create/medium.h>
 #include <agz/tracer/create/scene.h>
+#include <agz/tracer/utility/render_stats.h>
+#include <agz/tracer/utility/trace.h>
 #include <agz/utility/misc.h>
 
 AGZ_TRACER_BEGIN
@@ -130,6 +132,7 @@ public:
 
     bool has_intersection(const Ray &r) const noexcept override
     {
+        AGZ_RENDER_STATS_ADD(ShadowRays, 1);
         return aggregate_->has_intersection(r);
     }
 
@@ -143,6 +146,7 @@ public:
     bool closest_intersection(
         const Ray &r, EntityIntersection *inct) const noexcept override
     {
+        AGZ_RENDER_STATS_ADD(ClosestHitRays, 1);
         return aggregate_->closest_intersection(r, inct);
     }
 
@@ -161,13 +165,19 @@ public:
 
     void start_rendering() override
     {
+        AGZ_TRACE_SCOPE("scene", "start rendering");
+
         AABB world_bound;
         for(auto &ent : entities_)
             world_bound |= ent->world_bound();
 
         if(envir_light_)
+        {
+            AGZ_TRACE_SCOPE("scene", "envir light preprocess");
             envir_light_->preprocess(world_bound);
+        }
 
+        AGZ_TRACE_SCOPE("scene", "light sampler construction");
         construct_light_sampler();
     }
 };
@@ -6,35 +6,61 @@
 #include <agz/utility/misc.h>
 #include <agz/utility/texture.h>
 
+#include "./mipmap.h"
+#include "./texel_sampler.h"
+
 AGZ_TRACER_BEGIN
 
 class HDRTexture : public Texture2D
 {
-    RC<const Image2D<math::color3f>> data_;
+    // texels with inv_gamma applied. the source image is only kept when
+    // inv_gamma is 1, where it is shared instead of copied
+    RC<const Image2D<math::color3f>> linear_data_;
+    bool nearest_ = false;
+
+    // only built from linear_data_ when sampled with trilinear/anisotropic
+    // filtering
+    MipmapChain<math::color3f> mipmap_;
+    bool anisotropic_ = false;
 
-    static FSpectrum nearest_sample_impl(
-        const texture::texture2d_t<math::color3f> *data, const Vec2 &uv) noexcept
+    FSpectrum sample_level0(const Vec2 &uv) const noexcept
     {
-        const auto tex = [&t = *data](int x, int y) { return t(y, x); };
-        return texture::nearest_sample2d(uv, tex, data->width(), data->height());
+        if(nearest_)
+            return nearest_sample_rgb(*linear_data_, nullptr, uv);
+        return bilinear_sample_rgb(*linear_data_, nullptr, uv);
     }
 
-    static FSpectrum linear_sample_impl(
-        const texture::texture2d_t<math::color3f> *data, const Vec2 &uv) noexcept
+    static RC<const Image2D<math::color3f>> linearize(
+        const Image2D<math::color3f> &data, real inv_gamma)
     {
-        const auto tex = [&t = *data](int x, int y) { return t(y, x); };
-        return texture::linear_sample2d(uv, tex, data->width(), data->height());
+        auto ret = newRC<Image2D<math::color3f>>(data.height(), data.width());
+        thread::parallel_forrange(0, data.height(), [&](int, int y)
+        {
+            for(int x = 0; x < data.width(); ++x)
+            {
+                const math::color3f &texel = data(y, x);
+                (*ret)(y, x) = math::color3f(
+                    std::pow(texel.r, inv_gamma),
+                    std::pow(texel.g, inv_gamma),
+                    std::pow(texel.b, inv_gamma));
+            }
+        });
+        return ret;
     }
 
-    using SampleImplFuncPtr = FSpectrum(*)(
-        const texture::texture2d_t<math::color3f>*, const Vec2&);
-    SampleImplFuncPtr sample_impl_ = linear_sample_impl;
-
 protected:
     
     FSpectrum sample_spectrum_impl(const Vec2 &uv) const noexcept override
     {
-        return sample_impl_(data_.get(), uv.saturate());
+        return sample_level0(uv);
+    }
+
+    FSpectrum sample_spectrum_impl(
+        const Vec2 &uv, const Vec2 &duvdx, const Vec2 &duvdy) const noexcept override
+    {
+        return anisotropic_ ?
+            mipmap_.sample_anisotropic(uv, duvdx, duvdy) :
+            mipmap_.sample_trilinear(uv, duvdx, duvdy);
     }
 
 public:
@@ -48,26 +74,42 @@ public:
 
         init_common_params(common_params);
 
-        data_ = std::move(data);
+        // gamma correction is done by this texture instead of Texture2D
+
+        linear_data_ = inv_gamma_ == 1 ?
+                       std::move(data) : linearize(*data, inv_gamma_);
+        inv_gamma_ = 1;
 
         if(sampler == "nearest")
-            sample_impl_ = nearest_sample_impl;
-        else if(sampler == "linear")
-            sample_impl_ = linear_sample_impl;
-        else
+            nearest_ = true;
+        else if(sampler == "trilinear" || sampler == "anisotropic")
+        {
+            // level 0 is still bilinearly sampled when uv derivatives
+            // are unavailable
+
+            mipmap_.initialize(linear_data_);
+            anisotropic_ = sampler == "anisotropic";
+            use_uv_differential_ = true;
+        }
+        else if(sampler != "linear")
             throw ObjectConstructionException("invalid sample method");
 
         AGZ_HIERARCHY_WRAP("in initializing hdr texture object")
     }
 
+    FSpectrum sample_spectrum(const Vec2 &uv) const noexcept override
+    {
+        return sample_level0(to_texture_uv(uv));
+    }
+
     int width() const noexcept override
     {
-        return data_->width();
+        return linear_data_->width();
     }
 
     int height() const noexcept override
     {
-        return data_->height();
+        return linear_data_->height();
     }
 };
 
@@ -7,37 +7,44 @@
 #include <agz/utility/misc.h>
 #include <agz/utility/texture.h>
 
+#include "./mipmap.h"
+#include "./texel_sampler.h"
+
 AGZ_TRACER_BEGIN
 
 class ImageTexture : public Texture2D
 {
     RC<const Image2D<math::color3b>> data_;
 
-    static FSpectrum nearest_sample_impl(
-        const texture::texture2d_t<math::color3b> *data, const Vec2 &uv) noexcept
-    {
-        const auto tex = [&t = *data](int x, int y)
-            { return math::from_color3b<real>(t(y, x)); };
-        return texture::nearest_sample2d(uv, tex, data->width(), data->height());
-    }
+    // converts texels to linear values. inv_gamma is folded into it
+    Color3bLUT lut_;
+    bool nearest_ = false;
 
-    static FSpectrum linear_sample_impl(
-        const texture::texture2d_t<math::color3b> *data, const Vec2 &uv) noexcept
+    // only built when sampled with trilinear/anisotropic filtering.
+    // levels are filtered in linear space, same as level 0 lookups
+    MipmapChain<math::color3b> mipmap_;
+    bool anisotropic_ = false;
+
+    FSpectrum sample_level0(const Vec2 &uv) const noexcept
     {
-        const auto tex = [&t = *data](int x, int y)
-            { return math::from_color3b<real>(t(y, x)); };
-        return texture::linear_sample2d(uv, tex, data->width(), data->height());
+        if(nearest_)
+            return nearest_sample_rgb(*data_, &lut_, uv);
+        return bilinear_sample_rgb(*data_, &lut_, uv);
     }
 
-    using SampleImplFuncPtr = FSpectrum(*)(
-        const texture::texture2d_t<math::color3b>*, const Vec2&);
-    SampleImplFuncPtr sample_impl_ = linear_sample_impl;
-
 protected:
 
     FSpectrum sample_spectrum_impl(const Vec2 &uv) const noexcept override
     {
-        return sample_impl_(data_.get(), uv.saturate());
+        return sample_level0(uv);
+    }
+
+    FSpectrum sample_spectrum_impl(
+        const Vec2 &uv, const Vec2 &duvdx, const Vec2 &duvdy) const noexcept override
+    {
+        return anisotropic_ ?
+            mipmap_.sample_anisotropic(uv, duvdx, duvdy) :
+            mipmap_.sample_trilinear(uv, duvdx, duvdy);
     }
 
 public:
@@ -52,15 +59,32 @@ public:
         assert(data && data->is_available());
         data_ = std::move(data);
 
+        // gamma correction is done by this texture instead of Texture2D
+
+        lut_.initialize(inv_gamma_);
+        const real inv_gamma = inv_gamma_;
+        inv_gamma_ = 1;
 
         if(sampler == "nearest")
-            sample_impl_ = nearest_sample_impl;
-        else if(sampler == "linear")
-            sample_impl_ = linear_sample_impl;
-        else
+            nearest_ = true;
+        else if(sampler == "trilinear" || sampler == "anisotropic")
+        {
+            // level 0 is still bilinearly sampled when uv derivatives
+            // are unavailable
+
+            mipmap_.initialize(data_, inv_gamma);
+            anisotropic_ = sampler == "anisotropic";
+            use_uv_differential_ = true;
+        }
+        else if(sampler != "linear")
             throw ObjectConstructionException("invalid sample method");
     }
 
+    FSpectrum sample_spectrum(const Vec2 &uv) const noexcept override
+    {
+        return sample_level0(to_texture_uv(uv));
+    }
+
     int width() const noexcept override
     {
         return data_->width();
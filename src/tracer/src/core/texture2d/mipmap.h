@@ -0,0 +1,297 @@
+#pragma once
+
+#include <vector>
+
+#include <agz/tracer/common.h>
+#include <agz/utility/texture.h>
+#include <agz/utility/thread.h>
+
+#include "./texel_sampler.h"
+
+AGZ_TRACER_BEGIN
+
+/**
+ * @brief lookup at fractional lod by blending two neighboring levels
+ *
+ * sample_level interface: FSpectrum sample_level(const Vec2 &uv, int level)
+ */
+template<typename SampleLevel>
+FSpectrum mip_sample_lod(
+    const Vec2 &uv, real lod, int level_count, const SampleLevel &sample_level)
+{
+    const int max_level = level_count - 1;
+    if(lod <= 0)
+        return sample_level(uv, 0);
+    if(lod >= max_level)
+        return sample_level(uv, max_level);
+
+    const int level = static_cast<int>(lod);
+    const real t = lod - level;
+
+    const FSpectrum low  = sample_level(uv, level);
+    const FSpectrum high = sample_level(uv, level + 1);
+    return low + t * (high - low);
+}
+
+/**
+ * @brief trilinear lookup on a mip chain whose level 0 is width * height
+ */
+template<typename SampleLevel>
+FSpectrum mip_sample_trilinear(
+    const Vec2 &uv, const Vec2 &duvdx, const Vec2 &duvdy,
+    int width, int height, int level_count, const SampleLevel &sample_level)
+{
+    const real w = real(width), h = real(height);
+
+    const real len_x = Vec2(duvdx.x * w, duvdx.y * h).length();
+    const real len_y = Vec2(duvdy.x * w, duvdy.y * h).length();
+    const real footprint = (std::max)(len_x, len_y);
+
+    if(footprint <= 1)
+        return sample_level(uv, 0);
+    return mip_sample_lod(uv, std::log2(footprint), level_count, sample_level);
+}
+
+/**
+ * @brief anisotropic lookup made of several trilinear taps along the
+ *  major axis of the footprint
+ *
+ * at most max_anisotropy taps are used
+ */
+template<typename SampleLevel>
+FSpectrum mip_sample_anisotropic(
+    const Vec2 &uv, const Vec2 &duvdx, const Vec2 &duvdy,
+    int width, int height, int level_count, const SampleLevel &sample_level,
+    int max_anisotropy = 8)
+{
+    const real w = real(width), h = real(height);
+
+    const real len_x = Vec2(duvdx.x * w, duvdx.y * h).length();
+    const real len_y = Vec2(duvdy.x * w, duvdy.y * h).length();
+
+    real major_len = len_x, minor_len = len_y;
+    Vec2 major_axis = duvdx;
+    if(len_x < len_y)
+    {
+        std::swap(major_len, minor_len);
+        major_axis = duvdy;
+    }
+
+    if(major_len <= 1)
+        return sample_level(uv, 0);
+
+    // clamp eccentricity by blurring along the minor axis
+
+    minor_len = (std::max)(minor_len, major_len / max_anisotropy);
+
+    const int tap_count = math::clamp(
+        static_cast<int>(std::ceil(major_len / minor_len)), 1, max_anisotropy);
+    const real lod = minor_len > 1 ? std::log2(minor_len) : real(0);
+
+    FSpectrum sum;
+    for(int i = 0; i < tap_count; ++i)
+    {
+        const real offset = (i + real(0.5)) / tap_count - real(0.5);
+        sum += mip_sample_lod(
+            uv + offset * major_axis, lod, level_count, sample_level);
+    }
+
+    return sum / real(tap_count);
+}
+
+/**
+ * @brief mip chain of an image texture
+ *
+ * level 0 is the original image. each following level is a 2x2 box-filtered
+ * version of the previous one, until 1x1 is reached
+ *
+ * 8-bit texels may be gamma-encoded. they are decoded before filtering and
+ * lookups, and re-encoded when storing filtered levels, so that all levels
+ * return linear values
+ */
+template<typename Texel>
+class MipmapChain
+{
+public:
+
+    /**
+     * @brief max ratio between major and minor axis of the footprint
+     *  in anisotropic lookup
+     */
+    static constexpr int MAX_ANISOTROPY = 8;
+
+    /**
+     * @brief build the mip chain at once
+     *
+     * @param inv_gamma decoding exponent of 8-bit texels. float texels must
+     *  be linear
+     */
+    void initialize(RC<const Image2D<Texel>> level0, real inv_gamma = 1);
+
+    int level_count() const noexcept;
+
+    const Image2D<Texel> &level(int i) const noexcept;
+
+    const std::vector<RC<const Image2D<Texel>>> &all_levels() const noexcept;
+
+    /**
+     * @brief bilinear lookup at the given level
+     */
+    FSpectrum sample_level(const Vec2 &uv, int level) const noexcept;
+
+    /**
+     * @brief trilinear lookup. footprint size is given by uv derivatives
+     */
+    FSpectrum sample_trilinear(
+        const Vec2 &uv, const Vec2 &duvdx, const Vec2 &duvdy) const noexcept;
+
+    /**
+     * @brief anisotropic lookup made of several trilinear taps along the
+     *  major axis of the footprint
+     */
+    FSpectrum sample_anisotropic(
+        const Vec2 &uv, const Vec2 &duvdx, const Vec2 &duvdy) const noexcept;
+
+private:
+
+    FSpectrum to_spectrum(const math::color3b &texel) const noexcept;
+
+    FSpectrum to_spectrum(const math::color3f &texel) const noexcept;
+
+    Texel from_spectrum(const FSpectrum &spec) const noexcept;
+
+    std::vector<RC<const Image2D<Texel>>> levels_;
+
+    Color3bLUT lut_;
+    real encode_gamma_ = 1;
+};
+
+template<typename Texel>
+void MipmapChain<Texel>::initialize(
+    RC<const Image2D<Texel>> level0, real inv_gamma)
+{
+    assert((inv_gamma == 1 || std::is_same_v<Texel, math::color3b>));
+    lut_.initialize(inv_gamma);
+    encode_gamma_ = 1 / inv_gamma;
+
+    levels_.clear();
+    levels_.push_back(std::move(level0));
+
+    for(;;)
+    {
+        const Image2D<Texel> &last = *levels_.back();
+        const int last_w = last.width();
+        const int last_h = last.height();
+        if(last_w <= 1 && last_h <= 1)
+            break;
+
+        const int w = (std::max)(last_w / 2, 1);
+        const int h = (std::max)(last_h / 2, 1);
+
+        auto next = newRC<Image2D<Texel>>(h, w);
+        thread::parallel_forrange(0, h, [&](int, int y)
+        {
+            const int y0 = (std::min)(2 * y,     last_h - 1);
+            const int y1 = (std::min)(2 * y + 1, last_h - 1);
+            for(int x = 0; x < w; ++x)
+            {
+                const int x0 = (std::min)(2 * x,     last_w - 1);
+                const int x1 = (std::min)(2 * x + 1, last_w - 1);
+                const FSpectrum sum = to_spectrum(last(y0, x0))
+                                    + to_spectrum(last(y0, x1))
+                                    + to_spectrum(last(y1, x0))
+                                    + to_spectrum(last(y1, x1));
+                (*next)(y, x) = from_spectrum(real(0.25) * sum);
+            }
+        });
+
+        levels_.push_back(std::move(next));
+    }
+}
+
+template<typename Texel>
+int MipmapChain<Texel>::level_count() const noexcept
+{
+    return static_cast<int>(levels_.size());
+}
+
+template<typename Texel>
+const Image2D<Texel> &MipmapChain<Texel>::level(int i) const noexcept
+{
+    return *levels_[i];
+}
+
+template<typename Texel>
+const std::vector<RC<const Image2D<Texel>>> &
+    MipmapChain<Texel>::all_levels() const noexcept
+{
+    return levels_;
+}
+
+template<typename Texel>
+FSpectrum MipmapChain<Texel>::sample_level(
+    const Vec2 &uv, int level) const noexcept
+{
+    const Image2D<Texel> &data = *levels_[level];
+    const auto tex = [&data, this](int x, int y)
+        { return to_spectrum(data(y, x)); };
+    return texture::linear_sample2d(
+        uv.saturate(), tex, data.width(), data.height());
+}
+
+template<typename Texel>
+FSpectrum MipmapChain<Texel>::sample_trilinear(
+    const Vec2 &uv, const Vec2 &duvdx, const Vec2 &duvdy) const noexcept
+{
+    return mip_sample_trilinear(
+        uv, duvdx, duvdy, levels_[0]->width(), levels_[0]->height(),
+        level_count(), [this](const Vec2 &level_uv, int level)
+    {
+        return sample_level(level_uv, level);
+    });
+}
+
+template<typename Texel>
+FSpectrum MipmapChain<Texel>::sample_anisotropic(
+    const Vec2 &uv, const Vec2 &duvdx, const Vec2 &duvdy) const noexcept
+{
+    return mip_sample_anisotropic(
+        uv, duvdx, duvdy, levels_[0]->width(), levels_[0]->height(),
+        level_count(), [this](const Vec2 &level_uv, int level)
+    {
+        return sample_level(level_uv, level);
+    }, MAX_ANISOTROPY);
+}
+
+template<typename Texel>
+FSpectrum MipmapChain<Texel>::to_spectrum(
+    const math::color3b &texel) const noexcept
+{
+    return FSpectrum(lut_[texel.r], lut_[texel.g], lut_[texel.b]);
+}
+
+template<typename Texel>
+FSpectrum MipmapChain<Texel>::to_spectrum(
+    const math::color3f &texel) const noexcept
+{
+    return FSpectrum(texel.r, texel.g, texel.b);
+}
+
+template<typename Texel>
+Texel MipmapChain<Texel>::from_spectrum(const FSpectrum &spec) const noexcept
+{
+    if constexpr(std::is_same_v<Texel, math::color3b>)
+    {
+        if(encode_gamma_ == 1)
+            return math::to_color3b<real>(spec);
+
+        return math::to_color3b<real>(Spectrum(
+            std::pow(math::saturate(real(spec.r)), encode_gamma_),
+            std::pow(math::saturate(real(spec.g)), encode_gamma_),
+            std::pow(math::saturate(real(spec.b)), encode_gamma_)));
+    }
+    else
+        return Texel(spec.r, spec.g, spec.b);
+}
+
+AGZ_TRACER_END
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <cmath>
+
+#ifdef AGZ_UTILS_SSE
+#include <xmmintrin.h>
+#endif
+
+#include <agz/tracer/common.h>
+
+AGZ_TRACER_BEGIN
+
+/**
+ * @brief table converting 8-bit channels to linear floats
+ *
+ * inv_gamma is folded into the table, so that lookups of gamma-encoded
+ * images need no std::pow
+ */
+class Color3bLUT
+{
+    float table_[256] = {};
+
+public:
+
+    explicit Color3bLUT(real inv_gamma = 1) noexcept
+    {
+        initialize(inv_gamma);
+    }
+
+    void initialize(real inv_gamma) noexcept
+    {
+        for(int i = 0; i < 256; ++i)
+        {
+            const float linear = static_cast<float>(i) / 255;
+            table_[i] = inv_gamma == 1 ?
+                        linear : std::pow(linear, static_cast<float>(inv_gamma));
+        }
+    }
+
+    float operator[](unsigned char c) const noexcept
+    {
+        return table_[c];
+    }
+};
+
+namespace texel_sampler_detail
+{
+
+    /**
+     * @brief texel position and weights of a bilinear lookup
+     *
+     * texel centres are at (i + 0.5) / size, and out-of-range neighbors
+     * are clamped to the edge
+     */
+    struct BilinearTaps
+    {
+        int x0, y0, x1, y1;
+        float wx, wy;
+    };
+
+    inline BilinearTaps compute_bilinear_taps(
+        const Vec2 &uv, int width, int height) noexcept
+    {
+        const real fu = math::saturate(uv.x) * width;
+        const real fv = math::saturate(uv.y) * height;
+
+        const int pu = math::clamp(static_cast<int>(fu), 0, width  - 1);
+        const int pv = math::clamp(static_cast<int>(fv), 0, height - 1);
+
+        const int dpu = fu > pu + real(0.5) ? 1 : -1;
+        const int dpv = fv > pv + real(0.5) ? 1 : -1;
+
+        BilinearTaps ret;
+        ret.x0 = pu;
+        ret.y0 = pv;
+        ret.x1 = math::clamp(pu + dpu, 0, width  - 1);
+        ret.y1 = math::clamp(pv + dpv, 0, height - 1);
+        ret.wx = static_cast<float>((std::min)(std::abs(fu - pu - real(0.5)), real(1)));
+        ret.wy = static_cast<float>((std::min)(std::abs(fv - pv - real(0.5)), real(1)));
+        return ret;
+    }
+
+    inline void nearest_texel(
+        const Vec2 &uv, int width, int height, int *x, int *y) noexcept
+    {
+        *x = math::clamp(static_cast<int>(math::saturate(uv.x) * width),  0, width  - 1);
+        *y = math::clamp(static_cast<int>(math::saturate(uv.y) * height), 0, height - 1);
+    }
+
+#ifdef AGZ_UTILS_SSE
+
+    inline __m128 load_texel(const math::color3f &c, const Color3bLUT *) noexcept
+    {
+        return _mm_set_ps(0, c.b, c.g, c.r);
+    }
+
+    inline __m128 load_texel(const math::color3b &c, const Color3bLUT *lut) noexcept
+    {
+        return _mm_set_ps(0, (*lut)[c.b], (*lut)[c.g], (*lut)[c.r]);
+    }
+
+    inline FSpectrum to_spectrum(__m128 v) noexcept
+    {
+        alignas(16) float rgba[4];
+        _mm_store_ps(rgba, v);
+        return FSpectrum(rgba[0], rgba[1], rgba[2]);
+    }
+
+#else
+
+    inline FSpectrum load_texel(const math::color3f &c, const Color3bLUT *) noexcept
+    {
+        return FSpectrum(c.r, c.g, c.b);
+    }
+
+    inline FSpectrum load_texel(const math::color3b &c, const Color3bLUT *lut) noexcept
+    {
+        return FSpectrum((*lut)[c.r], (*lut)[c.g], (*lut)[c.b]);
+    }
+
+#endif
+
+} // namespace texel_sampler_detail
+
+/**
+ * @brief nearest lookup of rgb texels
+ *
+ * lut is required for math::color3b texels and ignored for math::color3f ones
+ */
+template<typename Texel>
+FSpectrum nearest_sample_rgb(
+    const Image2D<Texel> &data, const Color3bLUT *lut, const Vec2 &uv) noexcept
+{
+    using namespace texel_sampler_detail;
+
+    int x, y;
+    nearest_texel(uv, data.width(), data.height(), &x, &y);
+
+#ifdef AGZ_UTILS_SSE
+    return to_spectrum(load_texel(data(y, x), lut));
+#else
+    return load_texel(data(y, x), lut);
+#endif
+}
+
+/**
+ * @brief bilinear lookup of rgb texels
+ *
+ * gives the same result as texture::linear_sample2d within float tolerance.
+ * lut is required for math::color3b texels and ignored for math::color3f ones
+ */
+template<typename Texel>
+FSpectrum bilinear_sample_rgb(
+    const Image2D<Texel> &data, const Color3bLUT *lut, const Vec2 &uv) noexcept
+{
+    using namespace texel_sampler_detail;
+
+    const BilinearTaps taps = compute_bilinear_taps(
+        uv, data.width(), data.height());
+
+#ifdef AGZ_UTILS_SSE
+
+    const __m128 t00 = load_texel(data(taps.y0, taps.x0), lut);
+    const __m128 t10 = load_texel(data(taps.y0, taps.x1), lut);
+    const __m128 t01 = load_texel(data(taps.y1, taps.x0), lut);
+    const __m128 t11 = load_texel(data(taps.y1, taps.x1), lut);
+
+    const __m128 wx = _mm_set1_ps(taps.wx);
+    const __m128 wy = _mm_set1_ps(taps.wy);
+
+    const __m128 row0 = _mm_add_ps(t00, _mm_mul_ps(_mm_sub_ps(t10, t00), wx));
+    const __m128 row1 = _mm_add_ps(t01, _mm_mul_ps(_mm_sub_ps(t11, t01), wx));
+    return to_spectrum(_mm_add_ps(row0, _mm_mul_ps(_mm_sub_ps(row1, row0), wy)));
+
+#else
+
+    const FSpectrum t00 = load_texel(data(taps.y0, taps.x0), lut);
+    const FSpectrum t10 = load_texel(data(taps.y0, taps.x1), lut);
+    const FSpectrum t01 = load_texel(data(taps.y1, taps.x0), lut);
+    const FSpectrum t11 = load_texel(data(taps.y1, taps.x1), lut);
+
+    const FSpectrum row0 = t00 + (t10 - t00) * taps.wx;
+    const FSpectrum row1 = t01 + (t11 - t01) * taps.wx;
+    return row0 + (row1 - row0) * taps.wy;
+
+#endif
+}
+
+AGZ_TRACER_END
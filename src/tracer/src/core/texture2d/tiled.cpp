@@ -0,0 +1,217 @@
+#include <agz/tracer/core/texture2d.h>
+#include <agz/tracer/utility/tile_cache.h>
+
+#include "./mipmap.h"
+
+AGZ_TRACER_BEGIN
+
+/**
+ * @brief texture whose texels are streamed from a tiled file through the
+ *  process-wide tile cache
+ */
+template<typename Texel>
+class TiledTexture : public Texture2D
+{
+    RC<const TiledImageFile> file_;
+
+    // decodes rgb8 texels with inv_gamma of the file
+    Color3bLUT lut_;
+
+    bool nearest_     = false;
+    bool anisotropic_ = false;
+
+    FSpectrum to_spectrum(const Texel &texel) const noexcept
+    {
+        if constexpr(std::is_same_v<Texel, math::color3b>)
+            return FSpectrum(lut_[texel.r], lut_[texel.g], lut_[texel.b]);
+        else
+            return FSpectrum(texel.r, texel.g, texel.b);
+    }
+
+    /**
+     * @brief texel accessor of a level
+     *
+     * the last fetched tile is kept, so that a bilinear lookup usually
+     * queries the tile cache only once
+     */
+    class LevelAccessor
+    {
+        const TiledTexture &tex_;
+        const TiledImageFile &file_;
+        int level_;
+
+        int tile_size_;
+
+        mutable int tx_ = -1, ty_ = -1;
+        mutable RC<const TileCache::TileData> tile_;
+
+    public:
+
+        LevelAccessor(const TiledTexture &tex, int level) noexcept
+            : tex_(tex), file_(*tex.file_), level_(level),
+              tile_size_(tex.file_->tile_size())
+        {
+
+        }
+
+        FSpectrum operator()(int x, int y) const
+        {
+            const int tx = x / tile_size_, ty = y / tile_size_;
+            if(tx != tx_ || ty != ty_)
+            {
+                tile_ = file_.tile(level_, tx, ty);
+                tx_ = tx;
+                ty_ = ty;
+            }
+
+            const int lx = x - tx * tile_size_, ly = y - ty * tile_size_;
+            const Texel *texels = reinterpret_cast<const Texel*>(tile_->data());
+            return tex_.to_spectrum(texels[ly * tile_size_ + lx]);
+        }
+    };
+
+    FSpectrum sample_level(const Vec2 &uv, int level) const
+    {
+        const LevelAccessor tex(*this, level);
+        const int w = file_->width(level), h = file_->height(level);
+        if(nearest_)
+            return texture::nearest_sample2d(uv.saturate(), tex, w, h);
+        return texture::linear_sample2d(uv.saturate(), tex, w, h);
+    }
+
+protected:
+
+    // tile loading may throw (e.g. on allocation failure). such texels are
+    // treated as black, as unreadable tiles are
+
+    FSpectrum sample_spectrum_impl(const Vec2 &uv) const noexcept override
+    {
+        try
+        {
+            return sample_level(uv, 0);
+        }
+        catch(...)
+        {
+            return FSpectrum();
+        }
+    }
+
+    FSpectrum sample_spectrum_impl(
+        const Vec2 &uv, const Vec2 &duvdx, const Vec2 &duvdy) const noexcept override
+    {
+        const auto sample_level_func = [this](const Vec2 &level_uv, int level)
+        {
+            return sample_level(level_uv, level);
+        };
+
+        try
+        {
+            if(anisotropic_)
+            {
+                return mip_sample_anisotropic(
+                    uv, duvdx, duvdy, width(), height(),
+                    file_->level_count(), sample_level_func);
+            }
+
+            return mip_sample_trilinear(
+                uv, duvdx, duvdy, width(), height(),
+                file_->level_count(), sample_level_func);
+        }
+        catch(...)
+        {
+            return FSpectrum();
+        }
+    }
+
+public:
+
+    TiledTexture(
+        const Texture2DCommonParams &common_params,
+        RC<const TiledImageFile> file,
+        const std::string &sampler)
+    {
+        init_common_params(common_params);
+
+        file_ = std::move(file);
+
+        // gamma correction is done by this texture instead of Texture2D.
+        // the tiled file is built with its own inv_gamma, which is expected
+        // to be the same as the one given by common_params
+
+        lut_.initialize(file_->inv_gamma());
+        inv_gamma_ = 1;
+
+        if(sampler == "nearest")
+            nearest_ = true;
+        else if(sampler == "trilinear" || sampler == "anisotropic")
+        {
+            anisotropic_ = sampler == "anisotropic";
+            use_uv_differential_ = file_->level_count() > 1;
+        }
+        else if(sampler != "linear")
+            throw ObjectConstructionException("invalid sample method");
+    }
+
+    int width() const noexcept override
+    {
+        return file_->width(0);
+    }
+
+    int height() const noexcept override
+    {
+        return file_->height(0);
+    }
+};
+
+RC<Texture2D> create_tiled_texture(
+    const Texture2DCommonParams &common_params,
+    RC<const TiledImageFile> file, const std::string &sampler)
+{
+    if(file->texel_format() == TiledImageFile::TexelFormat::RGB8)
+    {
+        return newRC<TiledTexture<math::color3b>>(
+            common_params, std::move(file), sampler);
+    }
+    return newRC<TiledTexture<math::color3f>>(
+        common_params, std::move(file), sampler);
+}
+
+void write_tiled_texture(
+    const std::string &filename, int tile_size,
+    RC<const Image2D<math::color3b>> data, real inv_gamma)
+{
+    MipmapChain<math::color3b> mipmap;
+    mipmap.initialize(std::move(data), inv_gamma);
+    TiledImageFile::write(filename, tile_size, mipmap.all_levels(), inv_gamma);
+}
+
+void write_tiled_texture(
+    const std::string &filename, int tile_size,
+    RC<const Image2D<math::color3f>> data, real inv_gamma)
+{
+    // float texels are linearized before building the mip chain
+
+    if(inv_gamma != 1)
+    {
+        auto linear_data = newRC<Image2D<math::color3f>>(
+            data->height(), data->width());
+        thread::parallel_forrange(0, data->height(), [&](int, int y)
+        {
+            for(int x = 0; x < data->width(); ++x)
+            {
+                const math::color3f &texel = (*data)(y, x);
+                (*linear_data)(y, x) = math::color3f(
+                    std::pow(texel.r, inv_gamma),
+                    std::pow(texel.g, inv_gamma),
+                    std::pow(texel.b, inv_gamma));
+            }
+        });
+        data = std::move(linear_data);
+    }
+
+    MipmapChain<math::color3f> mipmap;
+    mipmap.initialize(std::move(data));
+    TiledImageFile::write(filename, tile_size, mipmap.all_levels(), inv_gamma);
+}
+
+AGZ_TRACER_END
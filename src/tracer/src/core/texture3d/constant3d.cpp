@@ -45,6 +45,16 @@ public:
         return texel_.r;
     }
 
+    real max_real_in_bound(const AABB &uvw_bound) const noexcept override
+    {
+        return texel_.r;
+    }
+
+    real min_real_in_bound(const AABB &uvw_bound) const noexcept override
+    {
+        return texel_.r;
+    }
+
     FSpectrum sample_spectrum(const FVec3 &uvw) const noexcept override
     {
         return texel_;
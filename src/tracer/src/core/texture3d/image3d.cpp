@@ -30,25 +30,30 @@ class ImageTexture3D : public Texture3D
     FSpectrum max_spec_;
     real max_real_;
 
+    real texel_real(int x, int y, int z) const noexcept
+    {
+        SWITCH_ET(
+        {
+            return data_->at(z, y, x);
+        },
+        {
+            return data_->at(z, y, x) / real(255);
+        },
+        {
+            return data_->at(z, y, x).r;
+        },
+        {
+            return math::from_color3b<real>(data_->at(z, y, x)).r;
+        });
+    }
+
 protected:
 
     real sample_real_impl(const FVec3 &uvw) const noexcept override
     {
         auto access_texel = [&](int x, int y, int z)
         {
-            SWITCH_ET(
-            {
-                return data_->at(z, y, x);
-            },
-            {
-                return data_->at(z, y, x) / real(255);
-            },
-            {
-                return data_->at(z, y, x).r;
-            },
-            {
-                return math::from_color3b<real>(data_->at(z, y, x)).r;
-            });
+            return texel_real(x, y, z);
         };
 
         if constexpr(USE_LINEAR_INTERP)
@@ -170,6 +175,50 @@ public:
     {
         return max_real_;
     }
+
+    real max_real_in_bound(const AABB &uvw_bound) const noexcept override
+    {
+        const Vec3i size(data_->width(), data_->height(), data_->depth());
+        Vec3i beg, end;
+        texel_range_in_bound(uvw_bound, size, beg, end);
+
+        real ret = REAL_MIN;
+        for(int z = beg.z; z <= end.z; ++z)
+        {
+            for(int y = beg.y; y <= end.y; ++y)
+            {
+                for(int x = beg.x; x <= end.x; ++x)
+                    ret = (std::max)(ret, texel_real(x, y, z));
+            }
+        }
+
+        if(inv_gamma_ != 1)
+            ret = std::pow((std::max)(ret, real(0)), inv_gamma_);
+
+        return ret;
+    }
+
+    real min_real_in_bound(const AABB &uvw_bound) const noexcept override
+    {
+        const Vec3i size(data_->width(), data_->height(), data_->depth());
+        Vec3i beg, end;
+        texel_range_in_bound(uvw_bound, size, beg, end);
+
+        real ret = REAL_MAX;
+        for(int z = beg.z; z <= end.z; ++z)
+        {
+            for(int y = beg.y; y <= end.y; ++y)
+            {
+                for(int x = beg.x; x <= end.x; ++x)
+                    ret = (std::min)(ret, texel_real(x, y, z));
+            }
+        }
+
+        if(inv_gamma_ != 1)
+            ret = std::pow((std::max)(ret, real(0)), inv_gamma_);
+
+        return ret;
+    }
 };
 
 RC<Texture3D> create_image3d(
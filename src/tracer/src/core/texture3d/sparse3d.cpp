@@ -0,0 +1,104 @@
+#include <agz/tracer/core/texture3d.h>
+#include <agz/tracer/utility/brick_volume.h>
+
+AGZ_TRACER_BEGIN
+
+template<bool USE_LINEAR_INTERP>
+class SparseTexture3D : public Texture3D
+{
+    RC<const BrickVolume> data_;
+
+    real max_real_;
+
+protected:
+
+    real sample_real_impl(const FVec3 &uvw) const noexcept override
+    {
+        if constexpr(USE_LINEAR_INTERP)
+            return data_->sample_linear(uvw);
+        else
+            return data_->sample_nearest(uvw);
+    }
+
+    FSpectrum sample_spectrum_impl(const FVec3 &uvw) const noexcept override
+    {
+        return FSpectrum(sample_real_impl(uvw));
+    }
+
+public:
+
+    SparseTexture3D(
+        const Texture3DCommonParams &common_params,
+        RC<const BrickVolume> data)
+    {
+        init_common_params(common_params);
+        data_ = std::move(data);
+
+        max_real_ = data_->max_value();
+    }
+
+    int width() const noexcept override
+    {
+        return data_->size().x;
+    }
+
+    int height() const noexcept override
+    {
+        return data_->size().y;
+    }
+
+    int depth() const noexcept override
+    {
+        return data_->size().z;
+    }
+
+    FSpectrum max_spectrum() const noexcept override
+    {
+        return FSpectrum(max_real_);
+    }
+
+    real max_real() const noexcept override
+    {
+        return max_real_;
+    }
+
+    real max_real_in_bound(const AABB &uvw_bound) const noexcept override
+    {
+        Vec3i beg, end;
+        texel_range_in_bound(uvw_bound, data_->size(), beg, end);
+
+        real ret = data_->range_in_texel_box(beg, end).second;
+        if(inv_gamma_ != 1)
+            ret = std::pow((std::max)(ret, real(0)), inv_gamma_);
+
+        return ret;
+    }
+
+    real min_real_in_bound(const AABB &uvw_bound) const noexcept override
+    {
+        Vec3i beg, end;
+        texel_range_in_bound(uvw_bound, data_->size(), beg, end);
+
+        real ret = data_->range_in_texel_box(beg, end).first;
+        if(inv_gamma_ != 1)
+            ret = std::pow((std::max)(ret, real(0)), inv_gamma_);
+
+        return ret;
+    }
+};
+
+RC<Texture3D> create_sparse3d(
+    const Texture3DCommonParams &common_params,
+    RC<const BrickVolume> data,
+    bool use_linear_sampler)
+{
+    if(use_linear_sampler)
+    {
+        return newRC<SparseTexture3D<true>>(
+            common_params, std::move(data));
+    }
+    return newRC<SparseTexture3D<false>>(
+        common_params, std::move(data));
+}
+
+AGZ_TRACER_END
@@ -4,9 +4,11 @@
 #include <agz/tracer/core/light.h>
 #include <agz/tracer/core/material.h>
 #include <agz/tracer/core/medium.h>
+#include <agz/tracer/core/sampler.h>
 #include <agz/tracer/core/scene.h>
 
 #include <agz/tracer/render/bidir_path_tracing.h>
+#include <agz/tracer/utility/render_stats.h>
 
 AGZ_TRACER_RENDER_BEGIN
 
@@ -140,12 +142,26 @@ namespace
         return (!math::is_finite(x) || x <= 0) ? 1 : x;
     }
 
+    /**
+     * @brief relative sample count of strategy (s, t)
+     *
+     * connections with s >= 2 and t >= 2 are sampled connect_count times as
+     * often as other strategies when using a light vertex cache
+     */
+    real strategy_count(int s, int t, real connect_count) noexcept
+    {
+        return (s >= 2 && t >= 2) ? connect_count : real(1);
+    }
+
     real mis_weight_common(
         const Vertex *C, int s,
-        const Vertex *L, int t)
+        const Vertex *L, int t,
+        real connect_count)
     {
         assert(s >= 1 && s + t >= 3);
 
+        const real inv_cur_count = 1 / strategy_count(s, t, connect_count);
+
         real sum_pdf = 1;
         real cur_pdf = 1;
 
@@ -162,7 +178,10 @@ namespace
             cur_pdf *= mul / div;
 
             if(!L[i].is_delta && !L[i - 1].is_delta)
-                sum_pdf += cur_pdf;
+            {
+                sum_pdf += cur_pdf * inv_cur_count
+                         * strategy_count(s + t - i, i, connect_count);
+            }
         }
 
         // light beg
@@ -175,7 +194,7 @@ namespace
             cur_pdf *= mul / div;
 
             if(!L[0].is_delta)
-                sum_pdf += cur_pdf;
+                sum_pdf += cur_pdf * inv_cur_count;
         }
 
         // ===== process camera subpath =====
@@ -192,7 +211,10 @@ namespace
             cur_pdf *= mul / div;
 
             if(!C[i].is_delta && !C[i - 1].is_delta)
-                sum_pdf += cur_pdf;
+            {
+                sum_pdf += cur_pdf * inv_cur_count
+                         * strategy_count(i, s + t - i, connect_count);
+            }
         }
 
         return 1 / sum_pdf;
@@ -262,6 +284,123 @@ namespace
 
 } // namespace anonymous
 
+LightVertexCache::LightVertexCache(int thread_count)
+{
+    for(int i = 0; i < thread_count; ++i)
+        blocks_.push_back(newBox<Block>());
+}
+
+void LightVertexCache::clear(int subpath_count)
+{
+    for(auto &block : blocks_)
+    {
+        AGZ_RENDER_STATS_ADD(ArenaBytes, block->arena.used_bytes());
+        block->arena.release();
+        block->vertices.clear();
+    }
+
+    slots_.assign(subpath_count, Slot());
+
+    subpaths_.clear();
+    entries_.clear();
+    traced_subpath_count_ = 0;
+}
+
+void LightVertexCache::add_subpath(
+    int thread_index, int subpath_index, int max_vertex_count,
+    const Scene &scene, Sampler &sampler)
+{
+    Block &block = *blocks_[thread_index];
+
+    Slot &slot = slots_[subpath_index];
+    slot.block        = thread_index;
+    slot.vertex_count = 0;
+
+    const auto select_light = scene.sample_light(sampler.sample1());
+    if(!select_light.light)
+        return;
+
+    const size_t offset = block.vertices.size();
+    block.vertices.resize(offset + max_vertex_count);
+
+    const auto subpath = build_light_subpath(
+        max_vertex_count, select_light, scene, sampler,
+        block.arena, block.vertices.data() + offset);
+
+    block.vertices.resize(offset + subpath.vertex_count);
+
+    slot.offset       = offset;
+    slot.vertex_count = subpath.vertex_count;
+}
+
+void LightVertexCache::finalize()
+{
+    subpaths_.clear();
+    entries_.clear();
+    traced_subpath_count_ = 0;
+
+    // block vertex arrays no longer grow, so pointers into them are stable
+
+    for(auto &slot : slots_)
+    {
+        if(slot.vertex_count < 0)
+            continue;
+        ++traced_subpath_count_;
+
+        if(!slot.vertex_count)
+            continue;
+
+        LightSubpath subpath;
+        subpath.vertices     = blocks_[slot.block]->vertices.data() + slot.offset;
+        subpath.vertex_count = slot.vertex_count;
+        subpaths_.push_back(subpath);
+
+        for(int t = 2; t <= slot.vertex_count; ++t)
+            entries_.push_back({ subpath.vertices, t });
+    }
+}
+
+int LightVertexCache::traced_subpath_count() const noexcept
+{
+    return traced_subpath_count_;
+}
+
+int LightVertexCache::subpath_count() const noexcept
+{
+    return static_cast<int>(subpaths_.size());
+}
+
+LightSubpath LightVertexCache::subpath(int i) const noexcept
+{
+    return subpaths_[i];
+}
+
+int LightVertexCache::vertex_count() const noexcept
+{
+    return static_cast<int>(entries_.size());
+}
+
+const LightVertexCache::Entry &LightVertexCache::sample(real u) const noexcept
+{
+    const int count = static_cast<int>(entries_.size());
+    const int idx = (std::min)(static_cast<int>(u * count), count - 1);
+    return entries_[idx];
+}
+
+real LightVertexCache::connect_count(int connections_per_vertex) const noexcept
+{
+    return real(connections_per_vertex) * traced_subpath_count_
+         / (std::max)(vertex_count(), 1);
+}
+
+int LightVertexCache::average_vertex_count() const noexcept
+{
+    if(!traced_subpath_count_)
+        return 0;
+    return static_cast<int>(
+        std::round(real(vertex_count()) / traced_subpath_count_));
+}
+
 CameraSubpath build_camera_subpath(
     int max_vertex_count, const Ray &ray,
     const Scene &scene, Sampler &sampler,
@@ -878,7 +1017,8 @@ FSpectrum unweighted_contrib_sx_tx(
 
 real mis_weight_sx_t0(
     const Scene &scene,
-    Vertex *camera_subpath, int s)
+    Vertex *camera_subpath, int s,
+    real connect_count)
 {
     // ..., a, b
 
@@ -938,12 +1078,13 @@ real mis_weight_sx_t0(
         return 0;
 
     return mis_weight_common(
-        camera_subpath, s, nullptr, 0);
+        camera_subpath, s, nullptr, 0, connect_count);
 }
 
 real mis_weight_sx_t1(
     const Scene &scene,
-    Vertex *camera_subpath, int s, Vertex *light_subpath)
+    Vertex *camera_subpath, int s, Vertex *light_subpath,
+    real connect_count)
 {
     assert(s >= 2);
 
@@ -1013,13 +1154,14 @@ real mis_weight_sx_t1(
     }
 
     return mis_weight_common(
-        camera_subpath, s, light_subpath, 1);
+        camera_subpath, s, light_subpath, 1, connect_count);
 }
 
 real mis_weight_s1_tx(
     const Scene &scene,
     Vertex *camera_subpath,
-    Vertex *light_subpath, int t)
+    Vertex *light_subpath, int t,
+    real connect_count)
 {
     assert(t >= 2);
 
@@ -1061,12 +1203,13 @@ real mis_weight_s1_tx(
     };
 
     return mis_weight_common(
-        &camera_vertex, 1, light_subpath, t);
+        &camera_vertex, 1, light_subpath, t, connect_count);
 }
 
 real mis_weight_sx_tx(
     Vertex *camera_subpath, int s,
-    Vertex *light_subpath, int t)
+    Vertex *light_subpath, int t,
+    real connect_count)
 {
     assert(s >= 2 && t >= 2);
 
@@ -1125,12 +1268,13 @@ real mis_weight_sx_tx(
 
     return mis_weight_common(
         camera_subpath, s,
-        light_subpath, t);
+        light_subpath, t, connect_count);
 }
 
 FSpectrum weighted_contrib_sx_t0(
     const Scene &scene,
-    Vertex *camera_subpath, int s)
+    Vertex *camera_subpath, int s,
+    real connect_count)
 {
     const FSpectrum unweighted_contrib = unweighted_contrib_sx_t0(
         scene, camera_subpath, s);
@@ -1139,7 +1283,8 @@ FSpectrum weighted_contrib_sx_t0(
     if(unweighted_contrib.is_black())
         return {};
 
-    const real weight = mis_weight_sx_t0(scene, camera_subpath, s);
+    const real weight = mis_weight_sx_t0(
+        scene, camera_subpath, s, connect_count);
 
     return weight * unweighted_contrib;
 }
@@ -1148,7 +1293,8 @@ FSpectrum weighted_contrib_sx_t1(
     const Scene &scene,
     Vertex *camera_subpath, int s,
     Vertex *light_subpath,
-    Sampler &sampler)
+    Sampler &sampler,
+    real connect_count)
 {
     const FSpectrum unweighted_contrib = unweighted_contrib_sx_t1(
         scene, camera_subpath, s, light_subpath, sampler);
@@ -1158,7 +1304,7 @@ FSpectrum weighted_contrib_sx_t1(
         return {};
 
     const real weight = mis_weight_sx_t1(
-        scene, camera_subpath, s, light_subpath);
+        scene, camera_subpath, s, light_subpath, connect_count);
 
     return weight * unweighted_contrib;
 }
@@ -1170,7 +1316,8 @@ FSpectrum weighted_contrib_s1_tx(
     Sampler &sampler,
     const Rect2 &sample_pixel_bound,
     const Vec2 &full_res,
-    Vec2 &pixel_coord)
+    Vec2 &pixel_coord,
+    real connect_count)
 {
     const FSpectrum unweighted_contrib = unweighted_contrib_s1_tx(
         scene, camera_subpath, light_subpath, t,
@@ -1182,7 +1329,7 @@ FSpectrum weighted_contrib_s1_tx(
         return {};
 
     const real weight = mis_weight_s1_tx(
-        scene, camera_subpath, light_subpath, t);
+        scene, camera_subpath, light_subpath, t, connect_count);
 
     return weight * unweighted_contrib;
 }
@@ -1191,7 +1338,8 @@ FSpectrum weighted_contrib_sx_tx(
     const Scene &scene,
     Vertex *camera_subpath, int s,
     Vertex *light_subpath, int t,
-    Sampler &sampler)
+    Sampler &sampler,
+    real connect_count)
 {
     const FSpectrum unweighted_contrib = unweighted_contrib_sx_tx(
         scene, camera_subpath, s, light_subpath, t, sampler);
@@ -1201,7 +1349,7 @@ FSpectrum weighted_contrib_sx_tx(
         return {};
 
     const real weight = mis_weight_sx_tx(
-        camera_subpath, s, light_subpath, t);
+        camera_subpath, s, light_subpath, t, connect_count);
 
     return weight * unweighted_contrib;
 }
@@ -0,0 +1,648 @@
+#include <fstream>
+#include <limits>
+#include <vector>
+
+#include <agz/tracer/core/bsdf.h>
+#include <agz/tracer/core/entity.h>
+#include <agz/tracer/core/light.h>
+#include <agz/tracer/core/material.h>
+#include <agz/tracer/core/sampler.h>
+#include <agz/tracer/core/scene.h>
+#include <agz/tracer/render/direct_illum.h>
+#include <agz/tracer/render/irradiance_cache.h>
+#include <agz/tracer/utility/render_stats.h>
+
+AGZ_TRACER_RENDER_BEGIN
+
+namespace ic
+{
+
+namespace
+{
+    constexpr int MAX_OCTREE_DEPTH = 24;
+
+    constexpr uint64_t CACHE_MAGIC = 0x3148434143525249ull;
+
+    // pos, nor, radius, irradiance and gradients
+    constexpr int RECORD_REAL_COUNT = 7 + 7 * SPECTRUM_COMPONENT_COUNT;
+
+    void add_grad(FVec3 *grad, const FVec3 &dir, const FSpectrum &value) noexcept
+    {
+        for(int i = 0; i < SPECTRUM_COMPONENT_COUNT; ++i)
+            grad[i] += dir * value[i];
+    }
+
+    void pack_vec3(const FVec3 &v, real *&out) noexcept
+    {
+        *out++ = v.x;
+        *out++ = v.y;
+        *out++ = v.z;
+    }
+
+    FVec3 unpack_vec3(const real *&in) noexcept
+    {
+        const FVec3 ret(in[0], in[1], in[2]);
+        in += 3;
+        return ret;
+    }
+
+    /**
+     * @brief indirect incident radiance along ray
+     *
+     * @param hit_distance distance to the first intersection. infinity when
+     *  there is no intersection
+     */
+    FSpectrum gather_radiance(
+        const TraceParams &params, const Scene &scene, const Ray &ray,
+        Sampler &sampler, Arena &arena, real *hit_distance)
+    {
+        EntityIntersection inct;
+        if(!scene.closest_intersection(ray, &inct))
+        {
+            *hit_distance = std::numeric_limits<real>::infinity();
+            return {};
+        }
+
+        *hit_distance = (std::max)(distance(inct.pos, ray.o), EPS());
+
+        // radiance emitted by the first intersected entity is direct
+        // illumination of the gathering point, which is excluded here
+
+        return trace_std_from(params, scene, ray, inct, sampler, arena).value;
+    }
+}
+
+struct IrradianceCache::RecordNode
+{
+    Record record;
+    RecordNode *next = nullptr;
+};
+
+struct IrradianceCache::RecordRef
+{
+    const Record *record = nullptr;
+    RecordRef *next = nullptr;
+};
+
+struct IrradianceCache::OctreeNode
+{
+    std::atomic<OctreeNode*> children[8] = {
+        nullptr, nullptr, nullptr, nullptr,
+        nullptr, nullptr, nullptr, nullptr
+    };
+
+    std::atomic<RecordRef*> records = nullptr;
+};
+
+IrradianceCache::IrradianceCache(
+    const AABB &world_bound, const CacheParams &params)
+    : params_(params), all_records_(nullptr), record_count_(0)
+{
+    const FVec3 extent = world_bound.high - world_bound.low;
+    const real diagonal = (std::max)(extent.length(), EPS());
+    const real margin = diagonal / 1000;
+
+    min_radius_ = params.min_radius * diagonal;
+    max_radius_ = params.max_radius * diagonal;
+
+    root_low_  = world_bound.low - FVec3(margin);
+    root_size_ = (std::max)({ extent.x, extent.y, extent.z }) + 2 * margin;
+
+    root_ = new OctreeNode;
+}
+
+IrradianceCache::~IrradianceCache()
+{
+    destroy(root_);
+
+    RecordNode *node = all_records_.load();
+    while(node)
+    {
+        RecordNode *next = node->next;
+        delete node;
+        node = next;
+    }
+}
+
+bool IrradianceCache::lookup(
+    const FVec3 &pos, const FVec3 &nor, FSpectrum *irradiance) const noexcept
+{
+    const real a = params_.accuracy;
+    const real inv_a = 1 / a;
+
+    FSpectrum sum;
+    real weight_sum = 0;
+
+    const OctreeNode *node = root_;
+    FVec3 low = root_low_;
+    real size = root_size_;
+
+    while(node)
+    {
+        for(const RecordRef *ref = node->records.load(std::memory_order_acquire);
+            ref; ref = ref->next)
+        {
+            const Record &rec = *ref->record;
+
+            const FVec3 diff = pos - rec.pos;
+            const real dist = diff.length();
+            if(dist >= a * rec.radius)
+                continue;
+
+            // split-sphere error estimation
+
+            const real cos_nor = dot(nor, rec.nor);
+            const real err = dist / rec.radius
+                           + std::sqrt((std::max)(real(0), 1 - cos_nor));
+            if(err >= a)
+                continue;
+
+            // pos is in front of the record
+
+            if(dot(diff, nor + rec.nor) < -real(0.1) * rec.radius)
+                continue;
+
+            FSpectrum value = rec.irradiance;
+            if(params_.use_gradients)
+            {
+                const FVec3 rot_axis = cross(rec.nor, nor);
+                for(int i = 0; i < SPECTRUM_COMPONENT_COUNT; ++i)
+                {
+                    value[i] += dot(rot_axis, rec.rot_grad[i])
+                              + dot(diff, rec.trans_grad[i]);
+                    value[i] = (std::max)(value[i], real(0));
+                }
+            }
+
+            const real weight = 1 / (std::max)(err, EPS()) - inv_a;
+            sum += weight * value;
+            weight_sum += weight;
+        }
+
+        // go to the child containing pos
+
+        const real half = size / 2;
+
+        int child_idx = 0;
+        for(int i = 0; i < 3; ++i)
+        {
+            if(pos[i] >= low[i] + half)
+            {
+                child_idx |= 1 << i;
+                low[i] += half;
+            }
+        }
+
+        node = node->children[child_idx].load(std::memory_order_acquire);
+        size = half;
+    }
+
+    if(weight_sum <= 0)
+        return false;
+
+    *irradiance = sum / weight_sum;
+    return true;
+}
+
+void IrradianceCache::insert(const Record &record)
+{
+    auto record_node = new RecordNode;
+    record_node->record = record;
+
+    Record &rec = record_node->record;
+
+    // irradiance changes too fast to be interpolated within radius
+
+    if(params_.use_gradients)
+    {
+        for(int i = 0; i < SPECTRUM_COMPONENT_COUNT; ++i)
+        {
+            const real grad_len = rec.trans_grad[i].length();
+            if(grad_len > 0 && rec.irradiance[i] > 0)
+                rec.radius = (std::min)(rec.radius, rec.irradiance[i] / grad_len);
+        }
+    }
+
+    rec.radius = math::clamp(rec.radius, min_radius_, max_radius_);
+
+    // add to record list
+
+    record_node->next = all_records_.load(std::memory_order_relaxed);
+    while(!all_records_.compare_exchange_weak(
+        record_node->next, record_node,
+        std::memory_order_release, std::memory_order_relaxed))
+        ;
+
+    ++record_count_;
+
+    // add to octree nodes overlapping the valid region of the record
+
+    const FVec3 influence(params_.accuracy * rec.radius);
+    const AABB record_bound(rec.pos - influence, rec.pos + influence);
+
+    insert(root_, root_low_, root_size_, 0, &rec, record_bound);
+}
+
+void IrradianceCache::insert(
+    OctreeNode *node, const FVec3 &low, real size, int depth,
+    const Record *record, const AABB &record_bound)
+{
+    // records are stored at the first level where nodes are not larger
+    // than their valid regions. thus a lookup only needs to check nodes
+    // along the path from root to the point
+
+    const real record_size = record_bound.high.x - record_bound.low.x;
+    if(depth >= MAX_OCTREE_DEPTH || size <= record_size)
+    {
+        auto ref = new RecordRef;
+        ref->record = record;
+        ref->next = node->records.load(std::memory_order_relaxed);
+        while(!node->records.compare_exchange_weak(
+            ref->next, ref,
+            std::memory_order_release, std::memory_order_relaxed))
+            ;
+        return;
+    }
+
+    const real half = size / 2;
+
+    for(int child_idx = 0; child_idx < 8; ++child_idx)
+    {
+        FVec3 child_low = low;
+        bool overlap = true;
+
+        for(int i = 0; i < 3; ++i)
+        {
+            if(child_idx & (1 << i))
+                child_low[i] += half;
+
+            if(child_low[i] > record_bound.high[i] ||
+               child_low[i] + half < record_bound.low[i])
+                overlap = false;
+        }
+
+        if(!overlap)
+            continue;
+
+        // create the child if it doesn't exist. the loser of concurrent
+        // creation uses the winner's node
+
+        auto &child_ptr = node->children[child_idx];
+        OctreeNode *child = child_ptr.load(std::memory_order_acquire);
+        if(!child)
+        {
+            auto new_child = new OctreeNode;
+            if(child_ptr.compare_exchange_strong(
+                child, new_child,
+                std::memory_order_acq_rel, std::memory_order_acquire))
+                child = new_child;
+            else
+                delete new_child;
+        }
+
+        insert(child, child_low, half, depth + 1, record, record_bound);
+    }
+}
+
+void IrradianceCache::destroy(OctreeNode *node) noexcept
+{
+    if(!node)
+        return;
+
+    for(auto &child : node->children)
+        destroy(child.load());
+
+    RecordRef *ref = node->records.load();
+    while(ref)
+    {
+        RecordRef *next = ref->next;
+        delete ref;
+        ref = next;
+    }
+
+    delete node;
+}
+
+size_t IrradianceCache::record_count() const noexcept
+{
+    return record_count_;
+}
+
+void IrradianceCache::save(const std::string &filename) const
+{
+    std::vector<real> data;
+    data.reserve(record_count_ * RECORD_REAL_COUNT);
+
+    for(const RecordNode *node = all_records_.load(); node; node = node->next)
+    {
+        const Record &rec = node->record;
+
+        data.resize(data.size() + RECORD_REAL_COUNT);
+        real *out = data.data() + data.size() - RECORD_REAL_COUNT;
+
+        pack_vec3(rec.pos, out);
+        pack_vec3(rec.nor, out);
+        *out++ = rec.radius;
+
+        for(int i = 0; i < SPECTRUM_COMPONENT_COUNT; ++i)
+            *out++ = rec.irradiance[i];
+        for(int i = 0; i < SPECTRUM_COMPONENT_COUNT; ++i)
+            pack_vec3(rec.trans_grad[i], out);
+        for(int i = 0; i < SPECTRUM_COMPONENT_COUNT; ++i)
+            pack_vec3(rec.rot_grad[i], out);
+    }
+
+    std::ofstream fout(filename, std::ios::out | std::ios::binary);
+    if(!fout)
+        throw ObjectConstructionException("failed to open " + filename);
+
+    const uint32_t real_size = sizeof(real);
+    const uint32_t record_real_count = RECORD_REAL_COUNT;
+    const uint64_t count = data.size() / RECORD_REAL_COUNT;
+
+    fout.write(reinterpret_cast<const char*>(&CACHE_MAGIC),       sizeof(CACHE_MAGIC));
+    fout.write(reinterpret_cast<const char*>(&real_size),         sizeof(real_size));
+    fout.write(reinterpret_cast<const char*>(&record_real_count), sizeof(record_real_count));
+    fout.write(reinterpret_cast<const char*>(&count),             sizeof(count));
+
+    fout.write(reinterpret_cast<const char*>(data.data()),
+               static_cast<std::streamsize>(data.size() * sizeof(real)));
+
+    if(!fout)
+    {
+        throw ObjectConstructionException(
+            "failed to write irradiance cache: " + filename);
+    }
+}
+
+void IrradianceCache::load(const std::string &filename)
+{
+    std::ifstream fin(filename, std::ios::in | std::ios::binary);
+    if(!fin)
+        throw ObjectConstructionException("failed to open " + filename);
+
+    uint64_t magic = 0, count = 0;
+    uint32_t real_size = 0, record_real_count = 0;
+    fin.read(reinterpret_cast<char*>(&magic),             sizeof(magic));
+    fin.read(reinterpret_cast<char*>(&real_size),         sizeof(real_size));
+    fin.read(reinterpret_cast<char*>(&record_real_count), sizeof(record_real_count));
+    fin.read(reinterpret_cast<char*>(&count),             sizeof(count));
+
+    if(!fin || magic != CACHE_MAGIC || real_size != sizeof(real) ||
+       record_real_count != RECORD_REAL_COUNT)
+    {
+        throw ObjectConstructionException(
+            "invalid irradiance cache: " + filename);
+    }
+
+    std::vector<real> data(count * RECORD_REAL_COUNT);
+    fin.read(reinterpret_cast<char*>(data.data()),
+             static_cast<std::streamsize>(data.size() * sizeof(real)));
+
+    if(!fin)
+    {
+        throw ObjectConstructionException(
+            "failed to read irradiance cache: " + filename);
+    }
+
+    const real *in = data.data();
+    for(uint64_t r = 0; r < count; ++r)
+    {
+        Record rec;
+        rec.pos    = unpack_vec3(in);
+        rec.nor    = unpack_vec3(in);
+        rec.radius = *in++;
+
+        for(int i = 0; i < SPECTRUM_COMPONENT_COUNT; ++i)
+            rec.irradiance[i] = *in++;
+        for(int i = 0; i < SPECTRUM_COMPONENT_COUNT; ++i)
+            rec.trans_grad[i] = unpack_vec3(in);
+        for(int i = 0; i < SPECTRUM_COMPONENT_COUNT; ++i)
+            rec.rot_grad[i] = unpack_vec3(in);
+
+        insert(rec);
+    }
+}
+
+Record compute_record(
+    const GatherParams &params, const Scene &scene,
+    const EntityIntersection &inct, const FVec3 &nor,
+    Sampler &sampler)
+{
+    const int M = params.theta_count;
+    const int N = params.phi_count;
+
+    const FCoord coord = FCoord::from_z(nor);
+
+    // gathering paths use their own arena, since the caller's arena holds
+    // bsdf of the current shading point
+
+    Arena arena;
+
+    std::vector<FSpectrum> radiance(M * N);
+    std::vector<real> hit_distance(M * N);
+
+    Record record;
+    record.pos = inct.pos;
+    record.nor = nor;
+
+    // stratified cosine-weighted gathering. rotational gradient is
+    // accumulated along with irradiance
+
+    FSpectrum radiance_sum;
+    real inv_dist_sum = 0;
+
+    for(int j = 0; j < M; ++j)
+    {
+        for(int k = 0; k < N; ++k)
+        {
+            const Sample2 sam = sampler.sample2();
+
+            const real sin_theta = std::sqrt((j + sam.u) / M);
+            const real cos_theta = std::sqrt((std::max)(real(0), 1 - sin_theta * sin_theta));
+            const real phi = 2 * PI_r * (k + sam.v) / N;
+
+            const FVec3 horizontal = coord.local_to_global(
+                FVec3(std::cos(phi), std::sin(phi), 0));
+            const FVec3 dir = coord.local_to_global(FVec3(
+                sin_theta * std::cos(phi),
+                sin_theta * std::sin(phi),
+                cos_theta)).normalize();
+
+            const int idx = j * N + k;
+
+            FSpectrum li = gather_radiance(
+                params.trace_params, scene, Ray(inct.eps_offset(dir), dir),
+                sampler, arena, &hit_distance[idx]);
+            if(!li.is_finite())
+                li = FSpectrum();
+            radiance[idx] = li;
+
+            AGZ_RENDER_STATS_ADD(ArenaBytes, arena.used_bytes());
+            arena.release();
+
+            radiance_sum += li;
+            inv_dist_sum += 1 / hit_distance[idx];
+
+            const real tan_theta = sin_theta / (std::max)(cos_theta, EPS());
+            add_grad(record.rot_grad, cross(nor, horizontal) * tan_theta, li);
+        }
+    }
+
+    const real scale = PI_r / (M * N);
+
+    record.irradiance = scale * radiance_sum;
+    for(auto &g : record.rot_grad)
+        g *= scale;
+
+    record.radius = inv_dist_sum > 0 ? (M * N) / inv_dist_sum
+                                     : std::numeric_limits<real>::max();
+
+    // translational gradient (ward & heckbert 1992). radiance changes
+    // across boundaries between strata when pos moves
+
+    for(int k = 0; k < N; ++k)
+    {
+        const int prev_k = (k + N - 1) % N;
+
+        const real phi_mid = 2 * PI_r * (k + real(0.5)) / N;
+        const real phi_low = 2 * PI_r * k / N;
+
+        const FVec3 u_k = coord.local_to_global(
+            FVec3(std::cos(phi_mid), std::sin(phi_mid), 0));
+        const FVec3 v_k = coord.local_to_global(
+            FVec3(-std::sin(phi_low), std::cos(phi_low), 0));
+
+        FSpectrum sum_u, sum_v;
+
+        for(int j = 0; j < M; ++j)
+        {
+            const int idx = j * N + k;
+
+            if(j > 0)
+            {
+                const int prev_idx = (j - 1) * N + k;
+
+                const real sin2_theta = real(j) / M;
+                const real sin_theta = std::sqrt(sin2_theta);
+                const real min_dist = (std::min)(
+                    hit_distance[idx], hit_distance[prev_idx]);
+
+                sum_u += (radiance[idx] - radiance[prev_idx])
+                       * (sin_theta * (1 - sin2_theta) / min_dist);
+            }
+
+            const int prev_idx = j * N + prev_k;
+
+            const real sin_theta_low  = std::sqrt(real(j) / M);
+            const real sin_theta_high = std::sqrt(real(j + 1) / M);
+            const real min_dist = (std::min)(
+                hit_distance[idx], hit_distance[prev_idx]);
+
+            sum_v += (radiance[idx] - radiance[prev_idx])
+                   * ((sin_theta_high - sin_theta_low) / min_dist);
+        }
+
+        add_grad(record.trans_grad, u_k * (2 * PI_r / N), sum_u);
+        add_grad(record.trans_grad, v_k, sum_v);
+    }
+
+    return record;
+}
+
+} // namespace ic
+
+Pixel trace_irradiance_cache(
+    const IrradianceCacheTraceParams &params,
+    ic::IrradianceCache &cache,
+    const Scene &scene, const Ray &ray,
+    Sampler &sampler, Arena &arena,
+    const CameraRayDifferential *ray_diff)
+{
+    Pixel pixel;
+
+    FSpectrum coef(1);
+    Ray r = ray;
+
+    for(int depth = 0; depth < params.forward_max_depth; ++depth)
+    {
+        EntityIntersection inct;
+        if(!scene.closest_intersection(r, &inct))
+        {
+            if(depth == 0)
+            {
+                if(auto env = scene.envir_light())
+                    pixel.value += coef * env->radiance(r.o, r.d);
+            }
+            return pixel;
+        }
+
+        if(depth == 0 && ray_diff)
+            compute_uv_differentials(inct, *ray_diff);
+
+        const ShadingPoint shd = inct.material->shade(inct, arena);
+
+        if(depth == 0)
+        {
+            pixel.albedo = shd.bsdf->albedo();
+            pixel.normal = shd.shading_normal;
+            if(inct.entity->get_no_denoise_flag())
+                pixel.denoise = 0;
+
+            if(auto light = inct.entity->as_light())
+            {
+                pixel.value += coef * light->radiance(
+                    inct.pos, inct.geometry_coord.z, inct.uv, inct.wr);
+            }
+        }
+
+        // direct illumination
+
+        FSpectrum direct_illum;
+        for(int i = 0; i < params.direct_illum_sample_count; ++i)
+        {
+            for(auto light : scene.lights())
+                direct_illum += mis_sample_light(scene, light, inct, shd, sampler);
+            direct_illum += mis_sample_bsdf(scene, inct, shd, sampler);
+        }
+        pixel.value += coef * direct_illum
+                     / real(params.direct_illum_sample_count);
+
+        // indirect illumination from the cache
+
+        if(shd.bsdf->has_diffuse_component())
+        {
+            FVec3 nor = inct.geometry_coord.z;
+            if(dot(nor, inct.wr) < 0)
+                nor = -nor;
+
+            FSpectrum irradiance;
+            if(!cache.lookup(inct.pos, nor, &irradiance))
+            {
+                const ic::Record record = ic::compute_record(
+                    params.gather_params, scene, inct, nor, sampler);
+                cache.insert(record);
+                irradiance = record.irradiance;
+            }
+
+            pixel.value += coef * shd.bsdf->albedo() / PI_r * irradiance;
+            return pixel;
+        }
+
+        // continue through non-diffuse surfaces
+
+        const auto bsdf_sample = shd.bsdf->sample_all(
+            inct.wr, TransMode::Radiance, sampler.sample3());
+        if(!bsdf_sample.f || bsdf_sample.pdf < EPS())
+            return pixel;
+
+        coef *= bsdf_sample.f / bsdf_sample.pdf
+              * std::abs(cos(inct.geometry_coord.z, bsdf_sample.dir));
+
+        r = Ray(inct.eps_offset(bsdf_sample.dir), bsdf_sample.dir.normalize());
+    }
+
+    return pixel;
+}
+
+AGZ_TRACER_RENDER_END
@@ -0,0 +1,794 @@
+#include <agz/tracer/core/bsdf.h>
+#include <agz/tracer/core/bssrdf.h>
+#include <agz/tracer/core/entity.h>
+#include <agz/tracer/core/light.h>
+#include <agz/tracer/core/material.h>
+#include <agz/tracer/core/medium.h>
+#include <agz/tracer/core/sampler.h>
+#include <agz/tracer/core/scene.h>
+#include <agz/tracer/render/direct_illum.h>
+#include <agz/tracer/render/path_guiding.h>
+#include <agz/utility/thread.h>
+
+AGZ_TRACER_RENDER_BEGIN
+
+namespace guiding
+{
+
+FVec3 square_to_dir(const Vec2 &p) noexcept
+{
+    const real cos_theta = 2 * p.x - 1;
+    const real sin_theta = local_angle::cos_2_sin(cos_theta);
+    const real phi = 2 * PI_r * p.y;
+    return FVec3(
+        sin_theta * std::cos(phi), sin_theta * std::sin(phi), cos_theta);
+}
+
+Vec2 dir_to_square(const FVec3 &dir) noexcept
+{
+    const real cos_theta = math::clamp<real>(dir.z, -1, 1);
+    const real phi = local_angle::phi(dir);
+    return Vec2(
+        math::saturate((cos_theta + 1) / 2),
+        math::saturate(phi / (2 * PI_r)));
+}
+
+real DTree::Node::sum(int quadrant) const noexcept
+{
+    return sums[quadrant];
+}
+
+real DTree::Node::total() const noexcept
+{
+    return sum(0) + sum(1) + sum(2) + sum(3);
+}
+
+DTree::DTree()
+{
+    nodes_.emplace_back();
+}
+
+void DTree::record(const FVec3 &dir, real value) noexcept
+{
+    if(!(value > 0) || !std::isfinite(value))
+        return;
+
+    Vec2 p = dir_to_square(dir);
+    int node_idx = 0;
+
+    for(;;)
+    {
+        Node &node = nodes_[node_idx];
+
+        const int qx = p.x >= real(0.5) ? 1 : 0;
+        const int qy = p.y >= real(0.5) ? 1 : 0;
+        const int q = qx + 2 * qy;
+
+        node.sums[q] += value;
+
+        if(!node.children[q])
+            return;
+
+        p.x = 2 * p.x - qx;
+        p.y = 2 * p.y - qy;
+        node_idx = node.children[q];
+    }
+}
+
+void DTree::merge(const DTree &other) noexcept
+{
+    assert(nodes_.size() == other.nodes_.size());
+    for(size_t i = 0; i < nodes_.size(); ++i)
+    {
+        for(int q = 0; q < 4; ++q)
+            nodes_[i].sums[q] += other.nodes_[i].sums[q];
+    }
+}
+
+void DTree::clear_energy() noexcept
+{
+    for(auto &node : nodes_)
+    {
+        for(auto &sum : node.sums)
+            sum = 0;
+    }
+}
+
+real DTree::total() const noexcept
+{
+    return nodes_[0].total();
+}
+
+FVec3 DTree::sample(const Sample2 &sam, real *pdf) const noexcept
+{
+    Vec2 p(sam.u, sam.v);
+    Vec2 origin;
+    real size = 1;
+    real pdf_square = 1;
+
+    int node_idx = 0;
+
+    for(;;)
+    {
+        const Node &node = nodes_[node_idx];
+
+        // nodes without energy are sampled uniformly
+
+        const real total = node.total();
+        if(total <= 0)
+            break;
+
+        // select a column and then a quadrant in the column
+
+        const real left = node.sum(0) + node.sum(2);
+        const real right = total - left;
+
+        int qx;
+        if(right <= 0 || (left > 0 && p.x * total < left))
+        {
+            qx = 0;
+            p.x = p.x * total / left;
+        }
+        else
+        {
+            qx = 1;
+            p.x = (p.x * total - left) / right;
+        }
+
+        const real bottom = node.sum(qx);
+        const real top    = node.sum(qx + 2);
+        const real column = bottom + top;
+
+        int qy;
+        if(top <= 0 || (bottom > 0 && p.y * column < bottom))
+        {
+            qy = 0;
+            p.y = p.y * column / bottom;
+        }
+        else
+        {
+            qy = 1;
+            p.y = (p.y * column - bottom) / top;
+        }
+
+        p.x = math::saturate(p.x);
+        p.y = math::saturate(p.y);
+
+        const int q = qx + 2 * qy;
+        pdf_square *= 4 * node.sum(q) / total;
+
+        size /= 2;
+        origin.x += qx * size;
+        origin.y += qy * size;
+
+        if(!node.children[q])
+            break;
+        node_idx = node.children[q];
+    }
+
+    *pdf = pdf_square / (4 * PI_r);
+    return square_to_dir(origin + size * p);
+}
+
+real DTree::pdf(const FVec3 &dir) const noexcept
+{
+    Vec2 p = dir_to_square(dir);
+    real pdf_square = 1;
+
+    int node_idx = 0;
+
+    for(;;)
+    {
+        const Node &node = nodes_[node_idx];
+
+        const real total = node.total();
+        if(total <= 0)
+            break;
+
+        const int qx = p.x >= real(0.5) ? 1 : 0;
+        const int qy = p.y >= real(0.5) ? 1 : 0;
+        const int q = qx + 2 * qy;
+
+        pdf_square *= 4 * node.sum(q) / total;
+
+        if(!node.children[q])
+            break;
+
+        p.x = 2 * p.x - qx;
+        p.y = 2 * p.y - qy;
+        node_idx = node.children[q];
+    }
+
+    return pdf_square / (4 * PI_r);
+}
+
+DTree DTree::refined(real energy_threshold, int max_depth) const
+{
+    DTree ret;
+
+    const real total_energy = total();
+    if(total_energy <= 0)
+        return ret;
+
+    struct Task
+    {
+        int new_node;
+        int old_node; // -1 when the old tree has no corresponding node
+        real energy[4];
+        int depth;
+    };
+
+    std::vector<Task> tasks;
+
+    Task root_task = { 0, 0, {}, 1 };
+    for(int i = 0; i < 4; ++i)
+        root_task.energy[i] = nodes_[0].sum(i);
+    tasks.push_back(root_task);
+
+    while(!tasks.empty())
+    {
+        const Task task = tasks.back();
+        tasks.pop_back();
+
+        for(int q = 0; q < 4; ++q)
+        {
+            if(task.depth >= max_depth ||
+               task.energy[q] <= energy_threshold * total_energy)
+                continue;
+
+            Task child_task;
+            child_task.depth = task.depth + 1;
+
+            const int old_child = task.old_node >= 0 ?
+                                  nodes_[task.old_node].children[q] : 0;
+            if(old_child)
+            {
+                child_task.old_node = old_child;
+                for(int i = 0; i < 4; ++i)
+                    child_task.energy[i] = nodes_[old_child].sum(i);
+            }
+            else
+            {
+                // energy of unrefined quadrants is assumed to be uniform
+                child_task.old_node = -1;
+                for(int i = 0; i < 4; ++i)
+                    child_task.energy[i] = task.energy[q] / 4;
+            }
+
+            child_task.new_node = static_cast<int>(ret.nodes_.size());
+            ret.nodes_.emplace_back();
+            ret.nodes_[task.new_node].children[q] = child_task.new_node;
+
+            tasks.push_back(child_task);
+        }
+    }
+
+    return ret;
+}
+
+size_t DTree::node_count() const noexcept
+{
+    return nodes_.size();
+}
+
+SDTreeRecorder::SDTreeRecorder(const SDTree &sd_tree)
+    : sd_tree_(&sd_tree), leaves_(sd_tree.leaves_.size())
+{
+
+}
+
+void SDTreeRecorder::record(int leaf, const FVec3 &dir, real value)
+{
+    Leaf &l = leaves_[leaf];
+    if(!l.touched)
+    {
+        l.dtree = sd_tree_->leaves_[leaf].building;
+        l.dtree.clear_energy();
+        l.touched = true;
+    }
+
+    ++l.sample_count;
+    l.dtree.record(dir, value);
+}
+
+SDTree::SDTree(const AABB &world_bound, const SDTreeParams &params)
+    : params_(params)
+{
+    const FVec3 extent = world_bound.high - world_bound.low;
+    const real margin = (std::max)(extent.length() / 1000, EPS());
+
+    bound_low_  = world_bound.low - FVec3(margin);
+    bound_size_ = extent + FVec3(2 * margin);
+
+    Node root;
+    root.leaf = 0;
+    nodes_.push_back(root);
+    leaves_.emplace_back();
+}
+
+int SDTree::find_leaf(const FVec3 &pos) const noexcept
+{
+    FVec3 p;
+    for(int i = 0; i < 3; ++i)
+        p[i] = math::saturate((pos[i] - bound_low_[i]) / bound_size_[i]);
+
+    int node_idx = 0;
+    for(;;)
+    {
+        const Node &node = nodes_[node_idx];
+        if(node.leaf >= 0)
+            return node.leaf;
+
+        const int a = node.axis;
+        if(p[a] < real(0.5))
+        {
+            p[a] = 2 * p[a];
+            node_idx = node.children[0];
+        }
+        else
+        {
+            p[a] = 2 * p[a] - 1;
+            node_idx = node.children[1];
+        }
+    }
+}
+
+const DTree &SDTree::sampling_dtree(int leaf) const noexcept
+{
+    return leaves_[leaf].sampling;
+}
+
+void SDTree::update(int iteration_spp, std::vector<SDTreeRecorder> &recorders)
+{
+    // merge recorders in a fixed order, and building trees -> sampling trees
+
+    thread::parallel_forrange(
+        0, static_cast<int>(leaves_.size()), [&](int, int i)
+    {
+        Leaf &leaf = leaves_[i];
+        for(auto &recorder : recorders)
+        {
+            auto &record = recorder.leaves_[i];
+            if(!record.touched)
+                continue;
+            leaf.building.merge(record.dtree);
+            leaf.sample_count += record.sample_count;
+        }
+
+        leaf.sampling = leaf.building;
+        leaf.building = leaf.sampling.refined(
+            params_.directional_threshold, params_.max_directional_depth);
+    });
+
+    // split spatial leaves with too many samples
+
+    const uint64_t max_sample_count = static_cast<uint64_t>(
+        params_.spatial_threshold * std::sqrt(real(iteration_spp)));
+
+    std::vector<int> node_stack;
+    for(int i = 0; i < static_cast<int>(nodes_.size()); ++i)
+    {
+        if(nodes_[i].leaf >= 0)
+            node_stack.push_back(i);
+    }
+
+    while(!node_stack.empty())
+    {
+        const int node_idx = node_stack.back();
+        node_stack.pop_back();
+
+        const int leaf_idx = nodes_[node_idx].leaf;
+        const uint64_t count = leaves_[leaf_idx].sample_count;
+        if(count <= max_sample_count)
+        {
+            leaves_[leaf_idx].sample_count = 0;
+            continue;
+        }
+
+        // samples are assumed to be evenly distributed in children
+
+        const int axis = nodes_[node_idx].axis;
+        leaves_[leaf_idx].sample_count = count / 2;
+
+        const int new_leaf_idx = static_cast<int>(leaves_.size());
+        Leaf new_leaf(leaves_[leaf_idx]);
+        leaves_.push_back(new_leaf);
+
+        Node child0, child1;
+        child0.axis = child1.axis = (axis + 1) % 3;
+        child0.leaf = leaf_idx;
+        child1.leaf = new_leaf_idx;
+
+        const int child0_idx = static_cast<int>(nodes_.size());
+        const int child1_idx = child0_idx + 1;
+        nodes_.push_back(child0);
+        nodes_.push_back(child1);
+
+        Node &node = nodes_[node_idx];
+        node.leaf = -1;
+        node.children[0] = child0_idx;
+        node.children[1] = child1_idx;
+
+        node_stack.push_back(child0_idx);
+        node_stack.push_back(child1_idx);
+    }
+
+    for(auto &recorder : recorders)
+        recorder = SDTreeRecorder(*this);
+}
+
+int SDTree::leaf_count() const noexcept
+{
+    return static_cast<int>(leaves_.size());
+}
+
+} // namespace guiding
+
+namespace
+{
+    constexpr int MAX_GUIDED_VERTEX_COUNT = 32;
+
+    /**
+     * @brief path vertex at which incident radiance is recorded
+     */
+    struct GuidedVertex
+    {
+        int leaf;
+        FVec3 dir;
+        real pdf;
+
+        // path throughput after sampling dir
+        FSpectrum coef;
+
+        // pixel value when dir is sampled
+        FSpectrum pixel_value;
+
+        // emitted radiance found along dir, which is accounted by nee
+        // and thus not included in pixel value
+        FSpectrum emission;
+    };
+
+    struct GuidedPath
+    {
+        GuidedVertex vertices[MAX_GUIDED_VERTEX_COUNT];
+        int vertex_count = 0;
+
+        void record(
+            guiding::SDTreeRecorder &recorder, const FSpectrum &pixel_value) const
+        {
+            for(int i = 0; i < vertex_count; ++i)
+            {
+                const GuidedVertex &v = vertices[i];
+
+                FSpectrum radiance = v.emission;
+                const FSpectrum delta = pixel_value - v.pixel_value;
+                for(int c = 0; c < SPECTRUM_COMPONENT_COUNT; ++c)
+                {
+                    if(v.coef[c] > 0)
+                        radiance[c] += delta[c] / v.coef[c];
+                }
+
+                recorder.record(v.leaf, v.dir, radiance.lum() / v.pdf);
+            }
+        }
+    };
+
+    Pixel trace_guided_impl(
+        const TraceParams &params, const GuidingParams &guiding_params,
+        const guiding::SDTree &sd_tree,
+        const Scene &scene, const Ray &ray,
+        Sampler &sampler, Arena &arena,
+        const CameraRayDifferential *ray_diff,
+        GuidedPath *path)
+    {
+        FSpectrum coef(1);
+        Ray r = ray;
+
+        Pixel pixel;
+
+        int scattering_count = 0;
+
+        // vertex whose sampled direction is being traced
+        GuidedVertex *last_vertex = nullptr;
+
+        const real bsdf_frac = guiding_params.bsdf_sampling_fraction;
+
+        for(int depth = 1, s_depth = 1; depth <= params.max_depth; ++depth)
+        {
+            // apply RR strategy
+
+            if(depth > params.min_depth)
+            {
+                if(sampler.sample1().u > params.cont_prob)
+                    return pixel;
+                coef /= params.cont_prob;
+            }
+
+            // find closest entity intersection
+
+            EntityIntersection ent_inct;
+            const bool has_ent_inct = scene.closest_intersection(r, &ent_inct);
+            if(!has_ent_inct)
+            {
+                if(auto light = scene.envir_light())
+                {
+                    if(depth == 1)
+                        pixel.value += coef * light->radiance(r.o, r.d);
+                    else if(last_vertex)
+                        last_vertex->emission += light->radiance(r.o, r.d);
+                }
+                return pixel;
+            }
+
+            if(depth == 1 && ray_diff)
+                compute_uv_differentials(ent_inct, *ray_diff);
+
+            // fill gbuffer
+
+            const ShadingPoint ent_shd = ent_inct.material->shade(ent_inct, arena);
+            if(depth == 1)
+            {
+                pixel.normal = ent_shd.shading_normal;
+                pixel.albedo = ent_shd.bsdf->albedo();
+                if(ent_inct.entity->get_no_denoise_flag())
+                    pixel.denoise = 0;
+            }
+
+            // sample medium scattering
+
+            const auto medium = ent_inct.wr_medium();
+
+            if(scattering_count < medium->get_max_scattering_count())
+            {
+                const auto medium_sample = medium->sample_scattering(
+                    r.o, ent_inct.pos, sampler, arena);
+
+                coef *= medium_sample.throughput;
+
+                if(medium_sample.is_scattering_happened())
+                {
+                    ++scattering_count;
+
+                    // radiance received by medium is not recorded
+                    last_vertex = nullptr;
+
+                    const auto &scattering_point = medium_sample.scattering_point;
+                    const auto phase_function = medium_sample.phase_function;
+
+                    FSpectrum direct_illum;
+                    for(int i = 0; i < params.direct_illum_sample_count; ++i)
+                    {
+                        for(auto light : scene.lights())
+                        {
+                            direct_illum += coef * mis_sample_light(
+                                scene, light, scattering_point, phase_function, sampler);
+                        }
+                        direct_illum += coef * mis_sample_bsdf(
+                            scene, scattering_point, phase_function, sampler);
+                    }
+
+                    pixel.value += direct_illum / real(params.direct_illum_sample_count);
+
+                    const auto bsdf_sample = phase_function->sample_all(
+                        scattering_point.wr, TransMode::Radiance, sampler.sample3());
+                    if(!bsdf_sample.f || bsdf_sample.pdf < EPS())
+                        return pixel;
+
+                    r = Ray(scattering_point.pos, bsdf_sample.dir.normalize());
+                    coef *= bsdf_sample.f / bsdf_sample.pdf;
+                    continue;
+                }
+            }
+            else
+            {
+                const FSpectrum ab = medium->ab(r.o, ent_inct.pos, sampler);
+                coef *= ab;
+            }
+
+            scattering_count = 0;
+
+            // process surface scattering
+
+            if(auto light = ent_inct.entity->as_light())
+            {
+                const FSpectrum le = light->radiance(
+                    ent_inct.pos, ent_inct.geometry_coord.z,
+                    ent_inct.uv, ent_inct.wr);
+
+                if(depth == 1)
+                    pixel.value += coef * le;
+                else if(last_vertex)
+                    last_vertex->emission += le;
+            }
+
+            last_vertex = nullptr;
+
+            // direct illumination
+
+            FSpectrum direct_illum;
+            for(int i = 0; i < params.direct_illum_sample_count; ++i)
+            {
+                for(auto light : scene.lights())
+                {
+                    direct_illum += coef * mis_sample_light(
+                        scene, light, ent_inct, ent_shd, sampler);
+                }
+                direct_illum += coef * mis_sample_bsdf(
+                    scene, ent_inct, ent_shd, sampler);
+            }
+
+            pixel.value += real(1) / params.direct_illum_sample_count * direct_illum;
+
+            // sample the mixture of bsdf and guiding distribution
+
+            const int leaf = sd_tree.find_leaf(ent_inct.pos);
+            const guiding::DTree &dtree = sd_tree.sampling_dtree(leaf);
+
+            const bool use_guiding = !ent_shd.bsdf->is_delta() &&
+                                     dtree.total() > 0;
+
+            auto bsdf_sample = BSDF_SAMPLE_RESULT_INVALID;
+            real pdf;
+
+            if(!use_guiding)
+            {
+                bsdf_sample = ent_shd.bsdf->sample_all(
+                    ent_inct.wr, TransMode::Radiance, sampler.sample3());
+                pdf = bsdf_sample.pdf;
+            }
+            else
+            {
+                const Sample3 sam = sampler.sample3();
+                if(sam.u < bsdf_frac)
+                {
+                    bsdf_sample = ent_shd.bsdf->sample_all(
+                        ent_inct.wr, TransMode::Radiance,
+                        { sam.u / bsdf_frac, sam.v, sam.w });
+
+                    if(bsdf_sample.is_delta)
+                        pdf = bsdf_frac * bsdf_sample.pdf;
+                    else
+                    {
+                        pdf = bsdf_frac * bsdf_sample.pdf
+                            + (1 - bsdf_frac) * dtree.pdf(bsdf_sample.dir);
+                    }
+                }
+                else
+                {
+                    real guide_pdf;
+                    const FVec3 dir = dtree.sample(
+                        { (sam.u - bsdf_frac) / (1 - bsdf_frac), sam.v },
+                        &guide_pdf);
+
+                    bsdf_sample.dir = dir;
+                    bsdf_sample.f = ent_shd.bsdf->eval_all(
+                        dir, ent_inct.wr, TransMode::Radiance);
+                    bsdf_sample.is_delta = false;
+
+                    pdf = bsdf_frac * ent_shd.bsdf->pdf_all(dir, ent_inct.wr)
+                        + (1 - bsdf_frac) * guide_pdf;
+                }
+            }
+
+            if(!bsdf_sample.f || pdf < EPS())
+                return pixel;
+
+            bool is_new_sample_delta = bsdf_sample.is_delta;
+            AGZ_SCOPE_GUARD({
+                if(is_new_sample_delta && depth >= 2 && s_depth <= params.specular_depth)
+                {
+                    --depth;
+                    ++s_depth;
+                }
+            });
+
+            const real abscos = std::abs(cos(
+                ent_inct.geometry_coord.z, bsdf_sample.dir));
+            coef *= bsdf_sample.f * abscos / pdf;
+
+            r = Ray(ent_inct.eps_offset(bsdf_sample.dir),
+                    bsdf_sample.dir.normalize());
+
+            if(path && !bsdf_sample.is_delta &&
+               path->vertex_count < MAX_GUIDED_VERTEX_COUNT)
+            {
+                last_vertex = &path->vertices[path->vertex_count++];
+                last_vertex->leaf        = leaf;
+                last_vertex->dir         = r.d;
+                last_vertex->pdf         = pdf;
+                last_vertex->coef        = coef;
+                last_vertex->pixel_value = pixel.value;
+                last_vertex->emission    = FSpectrum();
+            }
+
+            // bssrdf
+
+            if(!ent_shd.bssrdf)
+                continue;
+
+            const bool pos_in = ent_inct.geometry_coord.in_positive_z_hemisphere(
+                bsdf_sample.dir);
+            const bool pos_out = ent_inct.geometry_coord.in_positive_z_hemisphere(
+                ent_inct.wr);
+
+            if(!pos_in && pos_out)
+            {
+                // radiance leaving the subsurface exit point isn't incident
+                // radiance of the entering direction
+
+                if(last_vertex)
+                {
+                    --path->vertex_count;
+                    last_vertex = nullptr;
+                }
+
+                const auto bssrdf_sample = ent_shd.bssrdf->sample_pi(
+                    sampler.sample3(), arena);
+                if(!bssrdf_sample.coef)
+                    return pixel;
+
+                coef *= bssrdf_sample.coef / bssrdf_sample.pdf;
+
+                auto &new_inct = bssrdf_sample.inct;
+                auto new_shd = new_inct.material->shade(new_inct, arena);
+
+                FSpectrum new_direct_illum;
+                for(int i = 0; i < params.direct_illum_sample_count; ++i)
+                {
+                    for(auto light : scene.lights())
+                    {
+                        new_direct_illum += coef * mis_sample_light(
+                            scene, light, new_inct, new_shd, sampler);
+                    }
+                    new_direct_illum += coef * mis_sample_bsdf(
+                        scene, new_inct, new_shd, sampler);
+                }
+
+                pixel.value += real(1) / params.direct_illum_sample_count
+                             * new_direct_illum;
+
+                const auto new_bsdf_sample = new_shd.bsdf->sample_all(
+                    new_inct.wr, TransMode::Radiance, sampler.sample3());
+                if(!new_bsdf_sample.f)
+                    return pixel;
+
+                const real new_abscos = std::abs(cos(
+                    new_inct.geometry_coord.z, new_bsdf_sample.dir));
+                coef *= new_bsdf_sample.f * new_abscos / new_bsdf_sample.pdf;
+
+                r = Ray(new_inct.eps_offset(new_bsdf_sample.dir),
+                        new_bsdf_sample.dir.normalize());
+
+                is_new_sample_delta = new_bsdf_sample.is_delta;
+            }
+        }
+
+        return pixel;
+    }
+}
+
+Pixel trace_guided(
+    const TraceParams &params, const GuidingParams &guiding_params,
+    const guiding::SDTree &sd_tree, guiding::SDTreeRecorder *recorder,
+    const Scene &scene, const Ray &ray,
+    Sampler &sampler, Arena &arena, const CameraRayDifferential *ray_diff)
+{
+    if(!recorder)
+    {
+        return trace_guided_impl(
+            params, guiding_params, sd_tree,
+            scene, ray, sampler, arena, ray_diff, nullptr);
+    }
+
+    GuidedPath path;
+    const Pixel pixel = trace_guided_impl(
+        params, guiding_params, sd_tree,
+        scene, ray, sampler, arena, ray_diff, &path);
+
+    if(pixel.value.is_finite())
+        path.record(*recorder, pixel.value);
+
+    return pixel;
+}
+
+AGZ_TRACER_RENDER_END
@@ -12,221 +12,307 @@
 
 AGZ_TRACER_RENDER_BEGIN
 
-Pixel trace_std(
-    const TraceParams &params, const Scene &scene, const Ray &ray,
-    Sampler &sampler, Arena &arena)
+void compute_uv_differentials(
+    EntityIntersection &inct, const CameraRayDifferential &ray_diff)
 {
-    FSpectrum coef(1);
-    Ray r = ray;
-
-    Pixel pixel;
+    // intersect differential rays with the tangent plane
+
+    const FVec3 &nor = inct.geometry_coord.z;
+    const real d = dot(nor, inct.pos);
+
+    const real cos_x = dot(nor, ray_diff.rx.d);
+    const real cos_y = dot(nor, ray_diff.ry.d);
+    if(!cos_x || !cos_y)
+        return;
+
+    const real tx = (d - dot(nor, ray_diff.rx.o)) / cos_x;
+    const real ty = (d - dot(nor, ray_diff.ry.o)) / cos_y;
+    if(!std::isfinite(tx) || !std::isfinite(ty))
+        return;
+
+    const FVec3 dpdx = ray_diff.rx.at(tx) - inct.pos;
+    const FVec3 dpdy = ray_diff.ry.at(ty) - inct.pos;
+
+    // solve dp = dpdu * du + dpdv * dv on the two axes where the plane
+    // projects best
+
+    int ax0, ax1;
+    if(std::abs(nor.x) > std::abs(nor.y) && std::abs(nor.x) > std::abs(nor.z))
+        ax0 = 1, ax1 = 2;
+    else if(std::abs(nor.y) > std::abs(nor.z))
+        ax0 = 0, ax1 = 2;
+    else
+        ax0 = 0, ax1 = 1;
+
+    const real a00 = inct.dpdu[ax0], a01 = inct.dpdv[ax0];
+    const real a10 = inct.dpdu[ax1], a11 = inct.dpdv[ax1];
+    const real det = a00 * a11 - a01 * a10;
+    if(std::abs(det) < real(1e-12))
+        return;
+    const real inv_det = 1 / det;
+
+    auto solve = [&](const FVec3 &dp)
+    {
+        const Vec2 duv(
+            inv_det * (a11 * dp[ax0] - a01 * dp[ax1]),
+            inv_det * (a00 * dp[ax1] - a10 * dp[ax0]));
+        return std::isfinite(duv.x) && std::isfinite(duv.y) ? duv : Vec2();
+    };
 
-    int scattering_count = 0;
+    inct.duvdx = solve(dpdx);
+    inct.duvdy = solve(dpdy);
+}
 
-    for(int depth = 1, s_depth = 1; depth <= params.max_depth; ++depth)
+namespace
+{
+    /*
+     * first_inct is the closest intersection of ray when not nullptr, in
+     * which case radiance emitted at it is not included
+     */
+    Pixel trace_std_impl(
+        const TraceParams &params, const Scene &scene, const Ray &ray,
+        const EntityIntersection *first_inct,
+        Sampler &sampler, Arena &arena, const CameraRayDifferential *ray_diff)
     {
-        // apply RR strategy
+        FSpectrum coef(1);
+        Ray r = ray;
 
-        if(depth > params.min_depth)
-        {
-            if(sampler.sample1().u > params.cont_prob)
-                return pixel;
-            coef /= params.cont_prob;
-        }
+        Pixel pixel;
 
-        // find closest entity intersection
+        int scattering_count = 0;
 
-        EntityIntersection ent_inct;
-        const bool has_ent_inct = scene.closest_intersection(r, &ent_inct);
-        if(!has_ent_inct)
+        for(int depth = 1, s_depth = 1; depth <= params.max_depth; ++depth)
         {
-            if(depth == 1)
+            // apply RR strategy
+
+            if(depth > params.min_depth)
             {
-                if(auto light = scene.envir_light())
-                    pixel.value += coef * light->radiance(r.o, r.d);
+                if(sampler.sample1().u > params.cont_prob)
+                    return pixel;
+                coef /= params.cont_prob;
             }
-            return pixel;
-        }
 
-        // fill gbuffer
+            // find closest entity intersection
 
-        const ShadingPoint ent_shd = ent_inct.material->shade(ent_inct, arena);
-        if(depth == 1)
-        {
-            pixel.normal = ent_shd.shading_normal;
-            pixel.albedo = ent_shd.bsdf->albedo();
-            if(ent_inct.entity->get_no_denoise_flag())
-                pixel.denoise = 0;
-        }
+            EntityIntersection ent_inct;
+            bool has_ent_inct;
+            if(depth == 1 && first_inct)
+            {
+                ent_inct = *first_inct;
+                has_ent_inct = true;
+            }
+            else
+                has_ent_inct = scene.closest_intersection(r, &ent_inct);
+            if(!has_ent_inct)
+            {
+                if(depth == 1)
+                {
+                    if(auto light = scene.envir_light())
+                        pixel.value += coef * light->radiance(r.o, r.d);
+                }
+                return pixel;
+            }
 
-        // sample medium scattering
+            if(depth == 1 && ray_diff)
+                compute_uv_differentials(ent_inct, *ray_diff);
 
-        const auto medium = ent_inct.wr_medium();
+            // fill gbuffer
 
-        if(scattering_count < medium->get_max_scattering_count())
-        {
-            const auto medium_sample = medium->sample_scattering(
-                r.o, ent_inct.pos, sampler, arena);
+            const ShadingPoint ent_shd = ent_inct.material->shade(ent_inct, arena);
+            if(depth == 1)
+            {
+                pixel.normal = ent_shd.shading_normal;
+                pixel.albedo = ent_shd.bsdf->albedo();
+                if(ent_inct.entity->get_no_denoise_flag())
+                    pixel.denoise = 0;
+            }
 
-            // tr is accounted here
-            coef *= medium_sample.throughput;
+            // sample medium scattering
 
-            // process medium scattering
+            const auto medium = ent_inct.wr_medium();
 
-            if(medium_sample.is_scattering_happened())
+            if(scattering_count < medium->get_max_scattering_count())
             {
-                ++scattering_count;
+                const auto medium_sample = medium->sample_scattering(
+                    r.o, ent_inct.pos, sampler, arena);
 
-                const auto &scattering_point = medium_sample.scattering_point;
-                const auto phase_function = medium_sample.phase_function;
+                // tr is accounted here
+                coef *= medium_sample.throughput;
 
-                // compute direct illumination
+                // process medium scattering
 
-                FSpectrum direct_illum;
-                for(int i = 0; i < params.direct_illum_sample_count; ++i)
+                if(medium_sample.is_scattering_happened())
                 {
-                    for(auto light : scene.lights())
+                    ++scattering_count;
+
+                    const auto &scattering_point = medium_sample.scattering_point;
+                    const auto phase_function = medium_sample.phase_function;
+
+                    // compute direct illumination
+
+                    FSpectrum direct_illum;
+                    for(int i = 0; i < params.direct_illum_sample_count; ++i)
                     {
-                        direct_illum += coef * mis_sample_light(
-                            scene, light, scattering_point, phase_function, sampler);
+                        for(auto light : scene.lights())
+                        {
+                            direct_illum += coef * mis_sample_light(
+                                scene, light, scattering_point, phase_function, sampler);
+                        }
+                        direct_illum += coef * mis_sample_bsdf(
+                            scene, scattering_point, phase_function, sampler);
                     }
-                    direct_illum += coef * mis_sample_bsdf(
-                        scene, scattering_point, phase_function, sampler);
-                }
 
-                pixel.value += direct_illum / real(params.direct_illum_sample_count);
+                    pixel.value += direct_illum / real(params.direct_illum_sample_count);
 
-                // sample phase function
+                    // sample phase function
 
-                const auto bsdf_sample = phase_function->sample_all(
-                    scattering_point.wr, TransMode::Radiance, sampler.sample3());
-                if(!bsdf_sample.f || bsdf_sample.pdf < EPS())
-                    return pixel;
+                    const auto bsdf_sample = phase_function->sample_all(
+                        scattering_point.wr, TransMode::Radiance, sampler.sample3());
+                    if(!bsdf_sample.f || bsdf_sample.pdf < EPS())
+                        return pixel;
 
-                r = Ray(scattering_point.pos, bsdf_sample.dir.normalize());
-                coef *= bsdf_sample.f / bsdf_sample.pdf;
-                continue;
+                    r = Ray(scattering_point.pos, bsdf_sample.dir.normalize());
+                    coef *= bsdf_sample.f / bsdf_sample.pdf;
+                    continue;
+                }
+            }
+            else
+            {
+                // continus scattering count is too large
+                // only account absorbtion here
+                const FSpectrum ab = medium->ab(r.o, ent_inct.pos, sampler);
+                coef *= ab;
             }
-        }
-        else
-        {
-            // continus scattering count is too large
-            // only account absorbtion here
-            const FSpectrum ab = medium->ab(r.o, ent_inct.pos, sampler);
-            coef *= ab;
-        }
 
-        scattering_count = 0;
+            scattering_count = 0;
 
-        // process surface scattering
+            // process surface scattering
 
-        if(depth == 1)
-        {
-            if(auto light = ent_inct.entity->as_light())
+            if(depth == 1 && !first_inct)
             {
-                pixel.value += coef * light->radiance(
-                    ent_inct.pos, ent_inct.geometry_coord.z, ent_inct.uv, ent_inct.wr);
+                if(auto light = ent_inct.entity->as_light())
+                {
+                    pixel.value += coef * light->radiance(
+                        ent_inct.pos, ent_inct.geometry_coord.z, ent_inct.uv, ent_inct.wr);
+                }
             }
-        }
 
-        // direct illumination
+            // direct illumination
 
-        FSpectrum direct_illum;
-        for(int i = 0; i < params.direct_illum_sample_count; ++i)
-        {
-            for(auto light : scene.lights())
+            FSpectrum direct_illum;
+            for(int i = 0; i < params.direct_illum_sample_count; ++i)
             {
-                direct_illum += coef * mis_sample_light(
-                    scene, light, ent_inct, ent_shd, sampler);
+                for(auto light : scene.lights())
+                {
+                    direct_illum += coef * mis_sample_light(
+                        scene, light, ent_inct, ent_shd, sampler);
+                }
+                direct_illum += coef * mis_sample_bsdf(
+                    scene, ent_inct, ent_shd, sampler);
             }
-            direct_illum += coef * mis_sample_bsdf(
-                scene, ent_inct, ent_shd, sampler);
-        }
 
-        pixel.value += real(1) / params.direct_illum_sample_count * direct_illum;
+            pixel.value += real(1) / params.direct_illum_sample_count * direct_illum;
 
-        // sample bsdf
+            // sample bsdf
 
-        auto bsdf_sample = ent_shd.bsdf->sample_all(
-            ent_inct.wr, TransMode::Radiance, sampler.sample3());
-        if(!bsdf_sample.f || bsdf_sample.pdf < EPS())
-            return pixel;
+            auto bsdf_sample = ent_shd.bsdf->sample_all(
+                ent_inct.wr, TransMode::Radiance, sampler.sample3());
+            if(!bsdf_sample.f || bsdf_sample.pdf < EPS())
+                return pixel;
 
-        bool is_new_sample_delta = bsdf_sample.is_delta;
-        AGZ_SCOPE_GUARD({
-            if(is_new_sample_delta && depth >= 2 && s_depth <= params.specular_depth)
-            {
-                --depth;
-                ++s_depth;
-            }
-        });
+            bool is_new_sample_delta = bsdf_sample.is_delta;
+            AGZ_SCOPE_GUARD({
+                if(is_new_sample_delta && depth >= 2 && s_depth <= params.specular_depth)
+                {
+                    --depth;
+                    ++s_depth;
+                }
+            });
 
-        const real abscos = std::abs(cos(
-            ent_inct.geometry_coord.z, bsdf_sample.dir));
-        coef *= bsdf_sample.f * abscos / bsdf_sample.pdf;
+            const real abscos = std::abs(cos(
+                ent_inct.geometry_coord.z, bsdf_sample.dir));
+            coef *= bsdf_sample.f * abscos / bsdf_sample.pdf;
 
-        r = Ray(ent_inct.eps_offset(bsdf_sample.dir),
-                bsdf_sample.dir.normalize());
+            r = Ray(ent_inct.eps_offset(bsdf_sample.dir),
+                    bsdf_sample.dir.normalize());
 
-        // bssrdf
+            // bssrdf
 
-        if(!ent_shd.bssrdf)
-            continue;
+            if(!ent_shd.bssrdf)
+                continue;
 
-        const bool pos_in = ent_inct.geometry_coord.in_positive_z_hemisphere(
-            bsdf_sample.dir);
-        const bool pos_out = ent_inct.geometry_coord.in_positive_z_hemisphere(
-            ent_inct.wr);
+            const bool pos_in = ent_inct.geometry_coord.in_positive_z_hemisphere(
+                bsdf_sample.dir);
+            const bool pos_out = ent_inct.geometry_coord.in_positive_z_hemisphere(
+                ent_inct.wr);
 
-        if(!pos_in && pos_out)
-        {
-            const auto bssrdf_sample = ent_shd.bssrdf->sample_pi(
-                sampler.sample3(), arena);
-            if(!bssrdf_sample.coef)
-                return pixel;
+            if(!pos_in && pos_out)
+            {
+                const auto bssrdf_sample = ent_shd.bssrdf->sample_pi(
+                    sampler.sample3(), arena);
+                if(!bssrdf_sample.coef)
+                    return pixel;
 
-            coef *= bssrdf_sample.coef / bssrdf_sample.pdf;
+                coef *= bssrdf_sample.coef / bssrdf_sample.pdf;
 
-            auto &new_inct = bssrdf_sample.inct;
-            auto new_shd = new_inct.material->shade(new_inct, arena);
+                auto &new_inct = bssrdf_sample.inct;
+                auto new_shd = new_inct.material->shade(new_inct, arena);
 
-            FSpectrum new_direct_illum;
-            for(int i = 0; i < params.direct_illum_sample_count; ++i)
-            {
-                for(auto light : scene.lights())
+                FSpectrum new_direct_illum;
+                for(int i = 0; i < params.direct_illum_sample_count; ++i)
                 {
-                    new_direct_illum += coef * mis_sample_light(
-                        scene, light, new_inct, new_shd, sampler);
+                    for(auto light : scene.lights())
+                    {
+                        new_direct_illum += coef * mis_sample_light(
+                            scene, light, new_inct, new_shd, sampler);
+                    }
+                    new_direct_illum += coef * mis_sample_bsdf(
+                        scene, new_inct, new_shd, sampler);
                 }
-                new_direct_illum += coef * mis_sample_bsdf(
-                    scene, new_inct, new_shd, sampler);
-            }
 
-            pixel.value += real(1) / params.direct_illum_sample_count
-                         * new_direct_illum;
+                pixel.value += real(1) / params.direct_illum_sample_count
+                             * new_direct_illum;
 
-            const auto new_bsdf_sample = new_shd.bsdf->sample_all(
-                new_inct.wr, TransMode::Radiance, sampler.sample3());
-            if(!new_bsdf_sample.f)
-                return pixel;
+                const auto new_bsdf_sample = new_shd.bsdf->sample_all(
+                    new_inct.wr, TransMode::Radiance, sampler.sample3());
+                if(!new_bsdf_sample.f)
+                    return pixel;
 
-            const real new_abscos = std::abs(cos(
-                new_inct.geometry_coord.z, new_bsdf_sample.dir));
-            coef *= new_bsdf_sample.f * new_abscos / new_bsdf_sample.pdf;
+                const real new_abscos = std::abs(cos(
+                    new_inct.geometry_coord.z, new_bsdf_sample.dir));
+                coef *= new_bsdf_sample.f * new_abscos / new_bsdf_sample.pdf;
 
-            r = Ray(new_inct.eps_offset(new_bsdf_sample.dir),
-                    new_bsdf_sample.dir.normalize());
+                r = Ray(new_inct.eps_offset(new_bsdf_sample.dir),
+                        new_bsdf_sample.dir.normalize());
 
-            is_new_sample_delta = new_bsdf_sample.is_delta;
+                is_new_sample_delta = new_bsdf_sample.is_delta;
+            }
         }
+
+        return pixel;
     }
 
-    return pixel;
+} // namespace anonymous
+
+Pixel trace_std(
+    const TraceParams &params, const Scene &scene, const Ray &ray,
+    Sampler &sampler, Arena &arena, const CameraRayDifferential *ray_diff)
+{
+    return trace_std_impl(
+        params, scene, ray, nullptr, sampler, arena, ray_diff);
+}
+
+Pixel trace_std_from(
+    const TraceParams &params, const Scene &scene, const Ray &ray,
+    const EntityIntersection &first_inct, Sampler &sampler, Arena &arena)
+{
+    return trace_std_impl(
+        params, scene, ray, &first_inct, sampler, arena, nullptr);
 }
 
 Pixel trace_nomis(
     const TraceParams &params, const Scene &scene, const Ray &ray,
-    Sampler &sampler, Arena &arena)
+    Sampler &sampler, Arena &arena, const CameraRayDifferential *ray_diff)
 {
     FSpectrum coef(1);
     Ray r = ray;
@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include <agz/tracer/render/pssmlt.h>
 
 AGZ_TRACER_RENDER_BEGIN
@@ -7,19 +9,28 @@ namespace pssmlt
 
 PSSMLTSampler::PSSMLTSampler(
     real sigma, real large_mut_prob,
-    const NativeSampler &native_sampler)
+    const NativeSampler &native_sampler,
+    int stream_count)
     : uniform_sampler_(native_sampler),
       sigma_(sigma),
       large_mut_prob_(large_mut_prob), is_curr_large_(true),
       curr_iter_(0), last_large_iter_(0),
-      next_dim_(0)
+      stream_count_(stream_count), stream_index_(0),
+      next_stream_dims_(stream_count, 0)
 {
 
 }
 
+void PSSMLTSampler::start_stream(int stream_index)
+{
+    assert(0 <= stream_index && stream_index < stream_count_);
+    stream_index_ = stream_index;
+}
+
 Sample1 PSSMLTSampler::sample1()
 {
-    const size_t dim = next_dim_++;
+    const size_t dim = stream_index_
+                     + stream_count_ * next_stream_dims_[stream_index_]++;
     if(dim >= primary_samples_.size())
         primary_samples_.resize(dim + 1);
 
@@ -88,7 +99,8 @@ Sample5 PSSMLTSampler::sample5()
 void PSSMLTSampler::new_iteration()
 {
     curr_iter_++;
-    next_dim_ = 0;
+    stream_index_ = 0;
+    std::fill(next_stream_dims_.begin(), next_stream_dims_.end(), 0);
     is_curr_large_ = uniform_sampler_.sample1().u < large_mut_prob_;
 }
 
@@ -0,0 +1,265 @@
+#include <filesystem>
+#include <fstream>
+
+#include <agz/tracer/utility/checkpoint.h>
+#include <agz/tracer/utility/logger.h>
+#include <agz/utility/file.h>
+
+AGZ_TRACER_BEGIN
+
+namespace
+{
+    constexpr uint64_t CHECKPOINT_MAGIC = 0x3154504b43525441ull;
+
+    constexpr uint32_t CHECKPOINT_VERSION = 3;
+
+    void write_checkpoint_file(
+        const std::string &filename, const std::vector<char> &data)
+    {
+        const std::string tmp_filename = filename + ".tmp";
+
+        {
+            std::ofstream fout(
+                tmp_filename, std::ios::out | std::ios::binary | std::ios::trunc);
+            if(!fout)
+                throw ObjectConstructionException("failed to open " + tmp_filename);
+
+            fout.write(data.data(), static_cast<std::streamsize>(data.size()));
+            fout.flush();
+
+            if(!fout)
+            {
+                throw ObjectConstructionException(
+                    "failed to write checkpoint: " + tmp_filename);
+            }
+        }
+
+        std::filesystem::rename(tmp_filename, filename);
+    }
+}
+
+std::string CheckpointSampleRange::to_string() const
+{
+    return std::to_string(spp) + " spp, partition " +
+           std::to_string(partition_index) + "/" +
+           std::to_string(partition_count);
+}
+
+CheckpointWriter::CheckpointWriter(
+    const std::string &renderer_name, int width, int height,
+    const CheckpointSampleRange &sample_range)
+{
+    write(CHECKPOINT_MAGIC);
+    write(CHECKPOINT_VERSION);
+    write(uint32_t(sizeof(real)));
+    write(renderer_name);
+    write(int32_t(width));
+    write(int32_t(height));
+    write(int32_t(sample_range.spp));
+    write(int32_t(sample_range.partition_index));
+    write(int32_t(sample_range.partition_count));
+}
+
+void CheckpointWriter::write(const std::string &str)
+{
+    write(uint64_t(str.size()));
+    data_.insert(data_.end(), str.begin(), str.end());
+}
+
+void CheckpointWriter::write(const Spectrum &s)
+{
+    for(int i = 0; i < SPECTRUM_COMPONENT_COUNT; ++i)
+        write(s[i]);
+}
+
+void CheckpointWriter::write(const FSpectrum &s)
+{
+    for(int i = 0; i < SPECTRUM_COMPONENT_COUNT; ++i)
+        write(real(s[i]));
+}
+
+void CheckpointWriter::write(const Vec3 &v)
+{
+    write(v.x);
+    write(v.y);
+    write(v.z);
+}
+
+CheckpointReader::CheckpointReader(
+    std::vector<char> data,
+    const std::string &renderer_name, int width, int height)
+    : data_(std::move(data)), offset_(0)
+{
+    uint64_t magic = 0;
+    uint32_t version = 0, real_size = 0;
+    read(magic);
+    read(version);
+    read(real_size);
+
+    if(magic != CHECKPOINT_MAGIC || version != CHECKPOINT_VERSION ||
+       real_size != sizeof(real))
+        throw ObjectConstructionException("invalid checkpoint header");
+
+    std::string name;
+    int32_t ckpt_width = 0, ckpt_height = 0;
+    read(name);
+    read(ckpt_width);
+    read(ckpt_height);
+
+    if(name != renderer_name)
+    {
+        throw ObjectConstructionException(
+            "checkpoint is saved by another renderer: " + name);
+    }
+
+    if(ckpt_width != width || ckpt_height != height)
+    {
+        throw ObjectConstructionException(
+            "unmatched film size in checkpoint: " +
+            std::to_string(ckpt_width) + "x" + std::to_string(ckpt_height));
+    }
+
+    int32_t spp = 0, partition_index = 0, partition_count = 0;
+    read(spp);
+    read(partition_index);
+    read(partition_count);
+
+    if(spp < 0 || partition_count <= 0 ||
+       partition_index < 0 || partition_index >= partition_count)
+        throw ObjectConstructionException("invalid sampling range in checkpoint");
+
+    sample_range_ = { spp, partition_index, partition_count };
+}
+
+const CheckpointSampleRange &CheckpointReader::sample_range() const noexcept
+{
+    return sample_range_;
+}
+
+void CheckpointReader::read(std::string &str)
+{
+    uint64_t size = 0;
+    read(size);
+    if(size > data_.size() - offset_)
+        throw ObjectConstructionException("unexpected end of checkpoint");
+
+    str.assign(data_.data() + offset_, static_cast<size_t>(size));
+    offset_ += static_cast<size_t>(size);
+}
+
+void CheckpointReader::read(Spectrum &s)
+{
+    for(int i = 0; i < SPECTRUM_COMPONENT_COUNT; ++i)
+        read(s[i]);
+}
+
+void CheckpointReader::read(FSpectrum &s)
+{
+    real c[SPECTRUM_COMPONENT_COUNT];
+    for(auto &v : c)
+        read(v);
+    s = FSpectrum(c[0], c[1], c[2]);
+}
+
+void CheckpointReader::read(Vec3 &v)
+{
+    read(v.x);
+    read(v.y);
+    read(v.z);
+}
+
+void CheckpointReader::read_bytes(void *output, size_t bytes)
+{
+    if(bytes > data_.size() - offset_)
+        throw ObjectConstructionException("unexpected end of checkpoint");
+
+    std::memcpy(output, data_.data() + offset_, bytes);
+    offset_ += bytes;
+}
+
+Checkpointer::Checkpointer(CheckpointParams params)
+    : params_(std::move(params)), last_save_(Clock::now())
+{
+
+}
+
+Checkpointer::~Checkpointer()
+{
+    wait_pending();
+}
+
+bool Checkpointer::is_enabled() const noexcept
+{
+    return params_.is_enabled();
+}
+
+std::optional<CheckpointReader> Checkpointer::load(
+    const std::string &renderer_name, int width, int height,
+    const CheckpointSampleRange &sample_range) const
+{
+    if(!params_.is_enabled() || !params_.resume)
+        return std::nullopt;
+
+    if(!std::filesystem::exists(params_.filename))
+    {
+        AGZ_INFO("checkpoint {} not found. start a new render",
+                 params_.filename);
+        return std::nullopt;
+    }
+
+    std::ifstream fin(params_.filename, std::ios::in | std::ios::binary);
+    if(!fin)
+        throw ObjectConstructionException("failed to open " + params_.filename);
+
+    std::vector<char> data(
+        (std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+
+    CheckpointReader reader(std::move(data), renderer_name, width, height);
+    if(reader.sample_range() != sample_range)
+    {
+        throw ObjectConstructionException(
+            "checkpoint is saved with another sampling range (" +
+            reader.sample_range().to_string() + "), expected " +
+            sample_range.to_string());
+    }
+
+    AGZ_INFO("resuming from checkpoint {}", params_.filename);
+    return reader;
+}
+
+bool Checkpointer::is_due() const noexcept
+{
+    if(!params_.is_enabled())
+        return false;
+    const std::chrono::duration<real> elapsed = Clock::now() - last_save_;
+    return elapsed.count() >= params_.interval;
+}
+
+void Checkpointer::save_async(CheckpointWriter writer)
+{
+    wait_pending();
+    last_save_ = Clock::now();
+
+    pending_ = std::async(std::launch::async,
+        [filename = params_.filename, writer = std::move(writer)]
+    {
+        try
+        {
+            file::create_directory_for_file(filename);
+            write_checkpoint_file(filename, writer.data());
+            AGZ_INFO("checkpoint saved to {}", filename);
+        }
+        catch(const std::exception &e)
+        {
+            AGZ_ERROR("failed to save checkpoint: {}", e.what());
+        }
+    });
+}
+
+void Checkpointer::wait_pending() noexcept
+{
+    if(pending_.valid())
+        pending_.wait();
+}
+
+AGZ_TRACER_END
@@ -0,0 +1,159 @@
+#include <fstream>
+
+#include <agz/tracer/utility/checkpoint.h>
+#include <agz/tracer/utility/partial_film.h>
+#include <agz/utility/file.h>
+
+AGZ_TRACER_BEGIN
+
+namespace
+{
+    const std::string PARTIAL_FILM_NAME = "partial_film";
+}
+
+PartialFilm::PartialFilm(int width, int height, bool with_cost)
+    : image_buffer(width, height)
+{
+    if(with_cost)
+        cost = Image2D<real>(height, width);
+}
+
+void PartialFilm::merge(const PartialFilm &other)
+{
+    if(other.width() != width() || other.height() != height())
+        throw ObjectConstructionException("unmatched partial film size");
+
+    image_buffer.value   += other.image_buffer.value;
+    image_buffer.weight  += other.image_buffer.weight;
+    image_buffer.albedo  += other.image_buffer.albedo;
+    image_buffer.normal  += other.image_buffer.normal;
+    image_buffer.denoise += other.image_buffer.denoise;
+
+    if(other.particle_image.is_available())
+    {
+        if(particle_image.is_available())
+            particle_image += other.particle_image;
+        else
+            particle_image = other.particle_image;
+    }
+    particle_count += other.particle_count;
+
+    if(other.cost.is_available())
+    {
+        if(cost.is_available())
+            cost += other.cost;
+        else
+            cost = other.cost;
+    }
+}
+
+RenderTarget PartialFilm::to_render_target() const
+{
+    RenderTarget ret;
+
+    const auto ratio = image_buffer.weight.map([](real w)
+    {
+        return w > 0 ? 1 / w : real(0);
+    });
+    ret.image   = image_buffer.value   * ratio;
+    ret.albedo  = image_buffer.albedo  * ratio;
+    ret.normal  = image_buffer.normal  * ratio;
+    ret.denoise = image_buffer.denoise * ratio;
+    ret.cost    = cost;
+
+    if(particle_image.is_available() && particle_count > 0)
+    {
+        const real particle_ratio =
+            real(width()) * height() / real(particle_count);
+        ret.image += particle_image.map([&](const Spectrum &s)
+        {
+            return particle_ratio * s;
+        });
+    }
+
+    return ret;
+}
+
+void PartialFilm::save(const std::string &filename) const
+{
+    // partial films don't know the total spp, which is left as 0
+
+    CheckpointWriter writer(
+        PARTIAL_FILM_NAME, width(), height(),
+        { 0, partition.index, partition.count });
+
+    writer.write(image_buffer.value);
+    writer.write(image_buffer.weight);
+    writer.write(image_buffer.albedo);
+    writer.write(image_buffer.normal);
+    writer.write(image_buffer.denoise);
+
+    writer.write(uint8_t(particle_image.is_available()));
+    if(particle_image.is_available())
+        writer.write(particle_image);
+    writer.write(particle_count);
+
+    writer.write(uint8_t(cost.is_available()));
+    if(cost.is_available())
+        writer.write(cost);
+
+    file::create_directory_for_file(filename);
+    std::ofstream fout(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if(!fout)
+        throw ObjectConstructionException("failed to open " + filename);
+
+    fout.write(writer.data().data(),
+               static_cast<std::streamsize>(writer.data().size()));
+    if(!fout)
+    {
+        throw ObjectConstructionException(
+            "failed to write partial film: " + filename);
+    }
+}
+
+PartialFilm PartialFilm::load(
+    const std::string &filename, int width, int height)
+{
+    std::ifstream fin(filename, std::ios::in | std::ios::binary);
+    if(!fin)
+        throw ObjectConstructionException("failed to open " + filename);
+
+    std::vector<char> data(
+        (std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+    CheckpointReader reader(std::move(data), PARTIAL_FILM_NAME, width, height);
+
+    PartialFilm ret(width, height, false);
+
+    // validated by reader
+    ret.partition = {
+        reader.sample_range().partition_index,
+        reader.sample_range().partition_count
+    };
+
+    reader.read(ret.image_buffer.value);
+    reader.read(ret.image_buffer.weight);
+    reader.read(ret.image_buffer.albedo);
+    reader.read(ret.image_buffer.normal);
+    reader.read(ret.image_buffer.denoise);
+
+    uint8_t has_particle_image = 0;
+    reader.read(has_particle_image);
+    if(has_particle_image)
+    {
+        ret.particle_image.initialize(height, width);
+        reader.read(ret.particle_image);
+    }
+    reader.read(ret.particle_count);
+
+    uint8_t has_cost = 0;
+    reader.read(has_cost);
+    if(has_cost)
+    {
+        ret.cost.initialize(height, width);
+        reader.read(ret.cost);
+    }
+
+    return ret;
+}
+
+AGZ_TRACER_END
@@ -0,0 +1,141 @@
+#include <memory>
+#include <mutex>
+
+#include <agz/tracer/utility/render_stats.h>
+
+AGZ_TRACER_BEGIN
+
+namespace render_stats
+{
+
+const char *counter_name(Counter counter) noexcept
+{
+    static const char *NAMES[CounterCount] = {
+        "camera_rays",
+        "closest_hit_rays",
+        "shadow_rays",
+        "bvh_nodes_visited",
+        "triangles_tested",
+        "bsdf_samples",
+        "medium_null_collisions",
+        "arena_bytes"
+    };
+    return NAMES[counter];
+}
+
+#ifdef USE_RENDER_STATS
+
+namespace
+{
+    /**
+     * @brief owns counters of all thread slots
+     *
+     * slots are never freed, so that counters of exited threads are still
+     * included in collected stats
+     */
+    class Registry
+    {
+        std::mutex mutex_;
+        std::vector<std::unique_ptr<ThreadCounters>> slots_;
+        std::vector<ThreadCounters*> free_slots_;
+
+    public:
+
+        static Registry &instance()
+        {
+            static Registry ret;
+            return ret;
+        }
+
+        ThreadCounters *acquire()
+        {
+            std::lock_guard lk(mutex_);
+            if(!free_slots_.empty())
+            {
+                auto ret = free_slots_.back();
+                free_slots_.pop_back();
+                return ret;
+            }
+            slots_.push_back(std::make_unique<ThreadCounters>());
+            return slots_.back().get();
+        }
+
+        void release(ThreadCounters *counters)
+        {
+            std::lock_guard lk(mutex_);
+            free_slots_.push_back(counters);
+        }
+
+        void reset() noexcept
+        {
+            std::lock_guard lk(mutex_);
+            for(auto &s : slots_)
+            {
+                for(auto &v : s->values)
+                    v.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        RenderStats collect()
+        {
+            RenderStats ret;
+            ret.enabled = true;
+
+            std::lock_guard lk(mutex_);
+            for(auto &s : slots_)
+            {
+                CounterValues values = {};
+                bool nonzero = false;
+                for(int i = 0; i < CounterCount; ++i)
+                {
+                    values[i] = s->values[i].load(std::memory_order_relaxed);
+                    ret.total[i] += values[i];
+                    nonzero |= values[i] != 0;
+                }
+                if(nonzero)
+                    ret.per_thread.push_back(values);
+            }
+
+            return ret;
+        }
+    };
+}
+
+ThreadSlot::ThreadSlot()
+    : counters_(Registry::instance().acquire())
+{
+
+}
+
+ThreadSlot::~ThreadSlot()
+{
+    Registry::instance().release(counters_);
+}
+
+void reset() noexcept
+{
+    Registry::instance().reset();
+}
+
+RenderStats collect()
+{
+    return Registry::instance().collect();
+}
+
+#else
+
+void reset() noexcept
+{
+
+}
+
+RenderStats collect()
+{
+    return {};
+}
+
+#endif
+
+} // namespace render_stats
+
+AGZ_TRACER_END
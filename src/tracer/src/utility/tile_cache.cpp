@@ -0,0 +1,342 @@
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <cstring>
+
+#include <agz/tracer/utility/tile_cache.h>
+
+AGZ_TRACER_BEGIN
+
+TileCache &TileCache::instance()
+{
+    static TileCache cache;
+    return cache;
+}
+
+void TileCache::set_budget(size_t bytes) noexcept
+{
+    budget_.store(bytes, std::memory_order_relaxed);
+}
+
+size_t TileCache::budget() const noexcept
+{
+    return budget_.load(std::memory_order_relaxed);
+}
+
+uint32_t TileCache::new_source_id() noexcept
+{
+    return next_source_id_.fetch_add(1, std::memory_order_relaxed);
+}
+
+TileCache::Stats TileCache::stats() const noexcept
+{
+    Stats ret;
+    for(auto &shard : shards_)
+    {
+        ret.hits      += shard.hits     .load(std::memory_order_relaxed);
+        ret.misses    += shard.misses   .load(std::memory_order_relaxed);
+        ret.evictions += shard.evictions.load(std::memory_order_relaxed);
+
+        std::shared_lock lk(shard.mutex);
+        ret.resident_bytes += shard.bytes;
+    }
+    ret.budget_bytes = budget();
+    return ret;
+}
+
+void TileCache::reset_stats() noexcept
+{
+    for(auto &shard : shards_)
+    {
+        shard.hits      = 0;
+        shard.misses    = 0;
+        shard.evictions = 0;
+    }
+}
+
+TileCache::Shard &TileCache::shard_of(uint64_t key) noexcept
+{
+    // neighboring tiles of the same source go to different shards
+
+    const uint64_t h = key * uint64_t(0x9e3779b97f4a7c15);
+    return shards_[(h >> 32) % SHARD_COUNT];
+}
+
+RC<const TileCache::TileData> TileCache::find(Shard &shard, uint64_t key)
+{
+    std::shared_lock lk(shard.mutex);
+
+    const auto it = shard.key2entry.find(key);
+    if(it == shard.key2entry.end())
+        return nullptr;
+
+    Entry &entry = *it->second;
+    if(!entry.referenced.load(std::memory_order_relaxed))
+        entry.referenced.store(true, std::memory_order_relaxed);
+    return entry.data;
+}
+
+RC<const TileCache::TileData> TileCache::insert(
+    Shard &shard, uint64_t key, TileData data)
+{
+    auto new_data = newRC<const TileData>(std::move(data));
+    const size_t shard_budget = budget() / SHARD_COUNT;
+
+    std::unique_lock lk(shard.mutex);
+
+    // another thread may have loaded the same tile
+
+    if(auto it = shard.key2entry.find(key); it != shard.key2entry.end())
+    {
+        it->second->referenced.store(true, std::memory_order_relaxed);
+        return it->second->data;
+    }
+
+    // insert right behind the hand, so that the new tile is visited last
+
+    const auto new_entry = shard.entries.emplace(shard.hand, key, new_data);
+    shard.key2entry[key] = new_entry;
+    shard.bytes += new_data->size();
+
+    // the newly inserted tile is never evicted. every pass of the hand
+    // clears reference bits, so the loop ends within two rounds
+
+    while(shard.bytes > shard_budget && shard.entries.size() > 1)
+    {
+        if(shard.hand == shard.entries.end())
+            shard.hand = shard.entries.begin();
+
+        Entry &candidate = *shard.hand;
+        if(shard.hand == new_entry ||
+           candidate.referenced.load(std::memory_order_relaxed))
+        {
+            candidate.referenced.store(false, std::memory_order_relaxed);
+            ++shard.hand;
+            continue;
+        }
+
+        shard.bytes -= candidate.data->size();
+        shard.key2entry.erase(candidate.key);
+        shard.hand = shard.entries.erase(shard.hand);
+        shard.evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    return new_data;
+}
+
+TiledImageFile::TiledImageFile(const std::string &filename)
+{
+    // header is parsed with a stream. tiles are read through the native handle
+
+    std::ifstream fin(filename, std::ios::in | std::ios::binary);
+    if(!fin)
+        throw ObjectConstructionException("failed to open file: " + filename);
+
+    char magic[sizeof(MAGIC)];
+    fin.read(magic, sizeof(magic));
+    if(!fin || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+    {
+        throw ObjectConstructionException(
+            "invalid tiled texture file: " + filename);
+    }
+
+    auto read_int = [&]
+    {
+        int32_t ret;
+        fin.read(reinterpret_cast<char*>(&ret), sizeof(ret));
+        if(!fin)
+        {
+            throw ObjectConstructionException(
+                "failed to read tiled texture header from " + filename);
+        }
+        return ret;
+    };
+
+    const int32_t format = read_int();
+    if(format != static_cast<int32_t>(TexelFormat::RGB8) &&
+       format != static_cast<int32_t>(TexelFormat::RGB32F))
+    {
+        throw ObjectConstructionException(
+            "unknown texel format in " + filename);
+    }
+    format_ = static_cast<TexelFormat>(format);
+
+    tile_size_ = read_int();
+    if(tile_size_ <= 0)
+        throw ObjectConstructionException("invalid tile size in " + filename);
+
+    const int32_t level_count = read_int();
+    if(level_count <= 0 || level_count > MAX_LEVEL_COUNT)
+        throw ObjectConstructionException("invalid level count in " + filename);
+
+    float inv_gamma;
+    fin.read(reinterpret_cast<char*>(&inv_gamma), sizeof(inv_gamma));
+    if(!fin || !(inv_gamma > 0))
+        throw ObjectConstructionException("invalid inv_gamma in " + filename);
+    inv_gamma_ = inv_gamma;
+
+    levels_.resize(level_count);
+    for(auto &level : levels_)
+    {
+        level.width  = read_int();
+        level.height = read_int();
+        if(level.width <= 0 || level.height <= 0)
+        {
+            throw ObjectConstructionException(
+                "invalid level size in " + filename);
+        }
+        level.tile_count_x = (level.width  - 1) / tile_size_ + 1;
+        level.tile_count_y = (level.height - 1) / tile_size_ + 1;
+    }
+
+    const int64_t tile_bytes =
+        int64_t(tile_size_) * tile_size_ * texel_bytes();
+    int64_t offset = static_cast<int64_t>(fin.tellg());
+    uint32_t tile_base = 0;
+
+    for(int i = 0; i < level_count; ++i)
+    {
+        Level &level = levels_[i];
+        level.first_tile_offset = offset;
+        level_tile_base_[i] = tile_base;
+
+        const int tile_count = level.tile_count_x * level.tile_count_y;
+        offset += tile_count * tile_bytes;
+        tile_base += static_cast<uint32_t>(tile_count);
+    }
+
+#if defined(_WIN32)
+    const HANDLE handle = CreateFileA(
+        filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if(handle == INVALID_HANDLE_VALUE)
+        throw ObjectConstructionException("failed to open file: " + filename);
+    handle_ = reinterpret_cast<intptr_t>(handle);
+#else
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0)
+        throw ObjectConstructionException("failed to open file: " + filename);
+    handle_ = fd;
+#endif
+
+    source_id_ = TileCache::instance().new_source_id();
+}
+
+TiledImageFile::~TiledImageFile()
+{
+#if defined(_WIN32)
+    CloseHandle(reinterpret_cast<HANDLE>(handle_));
+#else
+    close(static_cast<int>(handle_));
+#endif
+}
+
+TiledImageFile::TexelFormat TiledImageFile::texel_format() const noexcept
+{
+    return format_;
+}
+
+int TiledImageFile::texel_bytes() const noexcept
+{
+    return format_ == TexelFormat::RGB8 ?
+           int(sizeof(math::color3b)) : int(sizeof(math::color3f));
+}
+
+int TiledImageFile::tile_size() const noexcept
+{
+    return tile_size_;
+}
+
+real TiledImageFile::inv_gamma() const noexcept
+{
+    return inv_gamma_;
+}
+
+int TiledImageFile::level_count() const noexcept
+{
+    return static_cast<int>(levels_.size());
+}
+
+int TiledImageFile::width(int level) const noexcept
+{
+    return levels_[level].width;
+}
+
+int TiledImageFile::height(int level) const noexcept
+{
+    return levels_[level].height;
+}
+
+int TiledImageFile::tile_count_x(int level) const noexcept
+{
+    return levels_[level].tile_count_x;
+}
+
+int TiledImageFile::tile_count_y(int level) const noexcept
+{
+    return levels_[level].tile_count_y;
+}
+
+RC<const TileCache::TileData> TiledImageFile::tile(
+    int level, int tx, int ty) const
+{
+    const uint32_t tile_index = level_tile_base_[level]
+                              + ty * levels_[level].tile_count_x + tx;
+    const uint64_t key = (uint64_t(source_id_) << 32) | tile_index;
+
+    return TileCache::instance().get(key, [&]
+    {
+        return read_tile(level, tx, ty);
+    });
+}
+
+TileCache::TileData TiledImageFile::read_tile(
+    int level, int tx, int ty) const
+{
+    const Level &lvl = levels_[level];
+    const size_t tile_bytes =
+        size_t(tile_size_) * tile_size_ * texel_bytes();
+    const int64_t offset = lvl.first_tile_offset
+        + int64_t(ty * lvl.tile_count_x + tx) * int64_t(tile_bytes);
+
+    TileCache::TileData ret(tile_bytes);
+
+#if defined(_WIN32)
+    OVERLAPPED overlapped = {};
+    overlapped.Offset     = static_cast<DWORD>(uint64_t(offset));
+    overlapped.OffsetHigh = static_cast<DWORD>(uint64_t(offset) >> 32);
+
+    DWORD read_bytes = 0;
+    const bool ok = ReadFile(
+        reinterpret_cast<HANDLE>(handle_), ret.data(), DWORD(tile_bytes),
+        &read_bytes, &overlapped) && read_bytes == tile_bytes;
+#else
+    size_t read_bytes = 0;
+    while(read_bytes < tile_bytes)
+    {
+        const ssize_t n = pread(
+            static_cast<int>(handle_), ret.data() + read_bytes,
+            tile_bytes - read_bytes, off_t(offset + int64_t(read_bytes)));
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            break;
+        read_bytes += size_t(n);
+    }
+    const bool ok = read_bytes == tile_bytes;
+#endif
+
+    // keep rendering with black texels if the file is truncated or removed
+
+    if(!ok)
+        std::memset(ret.data(), 0, tile_bytes);
+
+    return ret;
+}
+
+AGZ_TRACER_END
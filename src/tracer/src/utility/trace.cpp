@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <json.hpp>
+
+#include <agz/tracer/utility/trace.h>
+
+AGZ_TRACER_BEGIN
+
+namespace trace
+{
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    const Clock::time_point EPOCH = Clock::now();
+
+    int64_t now_ns() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now() - EPOCH).count();
+    }
+
+    struct Event
+    {
+        const char *category = nullptr;
+        char name[ScopedEvent::MAX_NAME_LENGTH + 1] = {};
+        int64_t begin_ns = 0;
+        int64_t end_ns   = 0;
+    };
+
+    /**
+     * @brief events of a thread slot
+     *
+     * only the owner thread writes to it. written is the total number of
+     * appended events, and the latest events.size() ones are kept
+     */
+    struct Ring
+    {
+        int thread_slot = 0;
+        std::vector<Event> events;
+        std::atomic<uint64_t> written = 0;
+
+        void append(const Event &e) noexcept
+        {
+            const uint64_t idx = written.load(std::memory_order_relaxed);
+            events[idx % events.size()] = e;
+            written.store(idx + 1, std::memory_order_release);
+        }
+    };
+
+    /**
+     * @brief owns ring buffers of all thread slots
+     *
+     * ring buffers of exited threads are reused by later ones, so that
+     * short-lived worker threads do not keep allocating new buffers
+     */
+    class Registry
+    {
+        std::mutex mutex_;
+        size_t capacity_ = 1 << 16;
+        std::vector<std::unique_ptr<Ring>> rings_;
+        std::vector<Ring*> free_rings_;
+
+    public:
+
+        static Registry &instance()
+        {
+            static Registry ret;
+            return ret;
+        }
+
+        Ring *acquire()
+        {
+            std::lock_guard lk(mutex_);
+            if(!free_rings_.empty())
+            {
+                auto ret = free_rings_.back();
+                free_rings_.pop_back();
+                return ret;
+            }
+
+            auto ring = std::make_unique<Ring>();
+            ring->thread_slot = static_cast<int>(rings_.size());
+            ring->events.resize(capacity_);
+            rings_.push_back(std::move(ring));
+            return rings_.back().get();
+        }
+
+        void release(Ring *ring)
+        {
+            std::lock_guard lk(mutex_);
+            free_rings_.push_back(ring);
+        }
+
+        void reset(size_t capacity)
+        {
+            std::lock_guard lk(mutex_);
+            capacity_ = (std::max)(capacity, size_t(1));
+            for(auto &r : rings_)
+            {
+                r->events.assign(capacity_, Event{});
+                r->written.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        nlohmann::json to_json()
+        {
+            std::lock_guard lk(mutex_);
+
+            auto events = nlohmann::json::array();
+            uint64_t dropped_count = 0;
+
+            {
+                nlohmann::json process_name;
+                process_name["name"] = "process_name";
+                process_name["ph"]   = "M";
+                process_name["pid"]  = 0;
+                process_name["args"]["name"] = "Atrc";
+                events.push_back(std::move(process_name));
+            }
+
+            for(auto &r : rings_)
+            {
+                const uint64_t written = r->written.load(std::memory_order_acquire);
+                if(!written)
+                    continue;
+
+                const uint64_t count = (std::min<uint64_t>)(written, r->events.size());
+                dropped_count += written - count;
+
+                nlohmann::json thread_name;
+                thread_name["name"] = "thread_name";
+                thread_name["ph"]   = "M";
+                thread_name["pid"]  = 0;
+                thread_name["tid"]  = r->thread_slot;
+                thread_name["args"]["name"] = "thread " + std::to_string(r->thread_slot);
+                events.push_back(std::move(thread_name));
+
+                for(uint64_t i = written - count; i < written; ++i)
+                {
+                    const Event &e = r->events[i % r->events.size()];
+
+                    nlohmann::json event;
+                    event["name"] = e.name;
+                    event["cat"]  = e.category;
+                    event["ph"]   = "X";
+                    event["ts"]   = e.begin_ns / 1000.0;
+                    event["dur"]  = (e.end_ns - e.begin_ns) / 1000.0;
+                    event["pid"]  = 0;
+                    event["tid"]  = r->thread_slot;
+                    events.push_back(std::move(event));
+                }
+            }
+
+            nlohmann::json ret;
+            ret["traceEvents"]     = std::move(events);
+            ret["displayTimeUnit"] = "ms";
+            ret["otherData"]["dropped_events"] = dropped_count;
+            return ret;
+        }
+    };
+
+    class ThreadSlot
+    {
+        Ring *ring_;
+
+    public:
+
+        ThreadSlot()
+            : ring_(Registry::instance().acquire())
+        {
+
+        }
+
+        ~ThreadSlot()
+        {
+            Registry::instance().release(ring_);
+        }
+
+        ThreadSlot(const ThreadSlot &) = delete;
+
+        ThreadSlot &operator=(const ThreadSlot &) = delete;
+
+        Ring &ring() noexcept { return *ring_; }
+    };
+
+    Ring &local_ring()
+    {
+        thread_local ThreadSlot slot;
+        return slot.ring();
+    }
+}
+
+void start(size_t events_per_thread)
+{
+    Registry::instance().reset(events_per_thread);
+    detail::enabled.store(true, std::memory_order_release);
+}
+
+void stop() noexcept
+{
+    detail::enabled.store(false, std::memory_order_release);
+}
+
+void write_chrome_trace(const std::string &filename)
+{
+    std::ofstream fout(filename, std::ofstream::trunc);
+    if(!fout)
+        throw std::runtime_error("failed to open trace file: " + filename);
+    fout << Registry::instance().to_json().dump() << std::endl;
+}
+
+ScopedEvent::ScopedEvent(const char *category, std::string_view name) noexcept
+    : category_(nullptr), begin_ns_(0)
+{
+    if(!is_enabled())
+        return;
+
+    category_ = category;
+    const size_t len = (std::min)(name.size(), MAX_NAME_LENGTH);
+    std::memcpy(name_, name.data(), len);
+    name_[len] = '\0';
+    begin_ns_ = now_ns();
+}
+
+ScopedEvent::~ScopedEvent()
+{
+    end();
+}
+
+void ScopedEvent::end() noexcept
+{
+    if(!category_)
+        return;
+
+    Event e;
+    e.category = category_;
+    std::memcpy(e.name, name_, sizeof(name_));
+    e.begin_ns = begin_ns_;
+    e.end_ns   = now_ns();
+
+    local_ring().append(e);
+    category_ = nullptr;
+}
+
+} // namespace trace
+
+AGZ_TRACER_END